@@ -0,0 +1,197 @@
+/// @brief BitstreamQueue overflow and DecoderFeeder recovery on the host
+/// @details first fills a queue past its capacity without a consumer and
+///     checks that access units are dropped up to the next IDR and accepted
+///     again from it. Then feeds a stub decoder at a camera rate through a
+///     DecoderFeeder, stalls the decoder, and checks that every gap the
+///     decoder sees ends on a key frame; reports drops and the time push
+///     took on the receive thread. Exits 1 when a check fails.
+///     built by benchmarks/CMakeLists.txt, no BSP needed
+///     ./bitstream_queue_bench [capacity] [gop] [stall_ms]
+
+#include "codec/decoder_feeder.hpp"
+#include "codec/stub_video_decoder.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static int g_failed = 0;
+
+static void check(bool ok, const char* what)
+{
+    printf("%-58s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        g_failed++;
+}
+
+/// @brief an H.264 access unit, IDR slice or P slice, with pts in the payload
+static std::vector<uint8_t> make_au(bool key, uint64_t pts)
+{
+    std::vector<uint8_t> au = {0, 0, 0, 1, (uint8_t)(key ? 0x65 : 0x41)};
+    for (int i = 0; i < 8; i++)
+        au.push_back((uint8_t)(pts >> (i * 8)) | 0x80);    // never a start code
+    au.resize(512, 0x55);
+    return au;
+}
+
+static int push(ax::BitstreamQueue& queue, bool key, uint64_t pts)
+{
+    std::vector<uint8_t> au = make_au(key, pts);
+    return queue.push(au.data(), au.size(), pts);
+}
+
+static void queue_checks(int capacity)
+{
+    ax::BitstreamQueue queue(capacity);
+    check(push(queue, false, 0) != ax::AX_SUCCESS, "P frame before the first IDR is dropped");
+
+    // IDR + P frames past the capacity, nobody pops
+    uint64_t pts = 1;
+    int accepted = 0;
+    for (int i = 0; i < capacity * 2; i++, pts++)
+    {
+        if (push(queue, i == 0, pts) == ax::AX_SUCCESS)
+            accepted++;
+    }
+    check(accepted == capacity && queue.size() == capacity, "queue takes exactly its capacity");
+
+    // the consumer catches up, the rest of the GOP is still dropped
+    ax::AccessUnit au;
+    while (queue.pop(au, 0) == ax::AX_SUCCESS)
+        ;
+    check(push(queue, false, pts++) != ax::AX_SUCCESS, "P frames after an overflow wait for an IDR");
+    check(push(queue, true, pts++) == ax::AX_SUCCESS, "next IDR is accepted");
+    check(push(queue, false, pts++) == ax::AX_SUCCESS, "P frames after it are accepted again");
+
+    // an IDR arriving on a full queue flushes the stale GOP
+    while ((int)queue.size() < capacity)
+        push(queue, false, pts++);
+    uint64_t idr = pts++;
+    check(push(queue, true, idr) == ax::AX_SUCCESS && queue.size() == 1, "IDR on a full queue flushes it");
+    check(queue.pop(au, 0) == ax::AX_SUCCESS && au.key && au.pts == idr, "decoding restarts on that IDR");
+}
+
+/// @brief stub decoder remembering what it was sent
+class RecordingDecoder : public ax::StubVideoDecoder
+{
+public:
+    struct Sent
+    {
+        uint64_t pts;
+        bool key;
+    };
+
+    int SendStream(const uint8_t* buf, int len, uint64_t pts, int timeout)
+    {
+        int ret = StubVideoDecoder::SendStream(buf, len, pts, timeout);
+        if (ret == ax::AX_SUCCESS)
+        {
+            std::lock_guard<std::mutex> lg(m_sentLock);
+            m_sent.push_back({pts, ax::is_key_frame(buf, len, ax::VIDEO_CODEC_H264)});
+        }
+        return ret;
+    }
+
+    std::vector<Sent> sent()
+    {
+        std::lock_guard<std::mutex> lg(m_sentLock);
+        return m_sent;
+    }
+
+private:
+    std::mutex m_sentLock;
+    std::vector<Sent> m_sent;
+};
+
+static void feeder_run(int capacity, int gop, int stall_ms)
+{
+    const int fps = 50;
+    const int frames = fps * 4;
+
+    RecordingDecoder decoder;
+    ax::VideoDecoderAttr attr;
+    attr.codec = ax::VIDEO_CODEC_H264;
+    attr.width = 64;
+    attr.height = 32;
+    attr.frame_buf_cnt = 4;
+    if (decoder.Open(attr) != ax::AX_SUCCESS)
+    {
+        check(false, "stub decoder opens");
+        return;
+    }
+
+    ax::DecoderFeeder feeder(capacity, ax::VIDEO_CODEC_H264);
+    feeder.Start(&decoder);
+
+    // the application side takes and releases frames
+    std::atomic<bool> running(true);
+    std::thread consumer([&] {
+        ax::DecodedFrame frame;
+        while (running)
+        {
+            if (decoder.GetFrame(frame, 20) == ax::AX_SUCCESS)
+                decoder.ReleaseFrame(frame);
+        }
+    });
+
+    // receive thread at a camera rate, the decoder stalls once in the middle
+    double push_max_us = 0, push_sum_us = 0;
+    auto next = Clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+        if (i == frames / 3)
+            decoder.Stall(stall_ms);
+        next += std::chrono::microseconds(1000000 / fps);
+        std::this_thread::sleep_until(next);
+
+        std::vector<uint8_t> au = make_au(i % gop == 0, i);
+        auto t0 = Clock::now();
+        feeder.Push(au.data(), au.size(), i);
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+        push_max_us = std::max(push_max_us, us);
+        push_sum_us += us;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    feeder.Stop();
+    running = false;
+    consumer.join();
+    decoder.Close();
+
+    std::vector<RecordingDecoder::Sent> sent = decoder.sent();
+    int gaps = 0, bad_gaps = 0;
+    for (size_t i = 1; i < sent.size(); i++)
+    {
+        if (sent[i].pts == sent[i - 1].pts + 1)
+            continue;
+        gaps++;
+        if (!sent[i].key)
+            bad_gaps++;
+    }
+
+    printf("capacity %d, gop %d, stall %d ms: %d of %d decoded, %llu dropped, %d gaps, push avg %.1f us max %.1f us\n",
+        capacity, gop, stall_ms, (int)sent.size(), frames, (unsigned long long)feeder.queue().dropped(),
+        gaps, push_sum_us / frames, push_max_us);
+    check(!sent.empty() && sent[0].key, "decoder starts on an IDR");
+    check(bad_gaps == 0, "every gap the decoder sees ends on an IDR");
+    check(stall_ms * fps / 1000 <= capacity || gaps > 0, "a stall longer than the queue drops frames");
+    check(!sent.empty() && sent.back().pts >= (uint64_t)(frames - gop), "decoding resumes after the stall");
+}
+
+int main(int argc, char** argv)
+{
+    int capacity = argc > 1 ? atoi(argv[1]) : 16;
+    int gop = argc > 2 ? atoi(argv[2]) : 25;
+    int stall_ms = argc > 3 ? atoi(argv[3]) : 800;
+
+    queue_checks(capacity);
+    feeder_run(capacity, gop, stall_ms);
+    return g_failed ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+/// @brief NV12 to BGR/RGB: scalar vs SIMD vs cv::cvtColor, 1..N threads
+/// @details converts one synthetic NV12 frame repeatedly into interleaved
+///     u8, planar float with mean/scale and planar int8, the usual NN inputs.
+///     Checks the SIMD path against the scalar one bit for bit and reports
+///     the largest difference to floating point BT.601. The OpenCV rows
+///     (cvtColor, plus split/convertTo for planar output) are only built
+///     when CMake finds OpenCV.
+///     built by benchmarks/CMakeLists.txt, no BSP needed
+///     ./color_bench [width] [height] [iterations] [max threads]
+
+#include "imgproc/color_convert.hpp"
+
+#if AX_BENCH_OPENCV
+#include "video_frame_cv.hpp"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct BenchCase
+{
+    const char* name;
+    ax::ColorConvertParams params;
+};
+
+static double ms_since(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static void report(const char* name, int threads, double ms, int width, int height)
+{
+    printf("%-36s %2d thr %8.3f ms/frame %8.1f Mpix/s\n",
+        name, threads, ms, (double)width * height / ms / 1000.0);
+}
+
+/// @brief a frame with gradients and noise, so no branch or cache line is predictable
+static ax::VideoFrame make_frame(int width, int height)
+{
+    ax::VideoFrame frame = ax::VideoFrame::Allocate(ax::PIXEL_FORMAT_NV12, width, height);
+    uint32_t state = 12345;
+    for (int y = 0; y < height; y++)
+    {
+        uint8_t* row = frame.data[0] + (size_t)y * frame.stride[0];
+        for (int x = 0; x < width; x++)
+        {
+            state = state * 1664525 + 1013904223;
+            row[x] = (uint8_t)(16 + ((x + y) * 219 / (width + height)) + (state >> 29));
+        }
+    }
+    for (int y = 0; y < height / 2; y++)
+    {
+        uint8_t* row = frame.data[1] + (size_t)y * frame.stride[1];
+        for (int x = 0; x < width; x++)
+        {
+            state = state * 1664525 + 1013904223;
+            row[x] = (uint8_t)(16 + (x & 1 ? y * 448 / height : x * 224 / width) + (state >> 30));
+        }
+    }
+    return frame;
+}
+
+static double time_convert(const ax::VideoFrame& frame, void* dst, const ax::ColorConvertParams& params,
+    ax::BandPool* pool, bool simd, int iterations)
+{
+    ax::color::convert(frame, dst, params, 0, pool, simd);
+    auto t0 = Clock::now();
+    for (int i = 0; i < iterations; i++)
+        ax::color::convert(frame, dst, params, 0, pool, simd);
+    return ms_since(t0) / iterations;
+}
+
+/// @brief largest difference of the u8 RGB output to BT.601 limited range in double
+static int max_error(const ax::VideoFrame& frame, const uint8_t* rgb)
+{
+    int worst = 0;
+    for (int y = 0; y < frame.height; y++)
+    {
+        for (int x = 0; x < frame.width; x++)
+        {
+            double Y = 1.164 * (frame.data[0][(size_t)y * frame.stride[0] + x] - 16);
+            const uint8_t* uv = frame.data[1] + (size_t)(y / 2) * frame.stride[1] + (x & ~1);
+            double d = uv[0] - 128.0;
+            double e = uv[1] - 128.0;
+            double ref[3] = { Y + 1.596 * e, Y - 0.392 * d - 0.813 * e, Y + 2.017 * d };
+            for (int k = 0; k < 3; k++)
+            {
+                int v = (int)lround(std::min(255.0, std::max(0.0, ref[k])));
+                worst = std::max(worst, abs(v - rgb[((size_t)y * frame.width + x) * 3 + k]));
+            }
+        }
+    }
+    return worst;
+}
+
+#if AX_BENCH_OPENCV
+/// @brief what a consumer does today: cvtColor, then a second pass for planar tensors
+static double time_opencv(const ax::VideoFrame& frame, const ax::ColorConvertParams& params,
+    void* dst, int iterations)
+{
+    cv::Mat nv12 = utils::to_mat(frame);
+    int code = params.format == ax::PIXEL_FORMAT_BGR ? cv::COLOR_YUV2BGR_NV12 : cv::COLOR_YUV2RGB_NV12;
+    int depth = params.type == ax::TENSOR_TYPE_FLOAT32 ? CV_32F : (params.type == ax::TENSOR_TYPE_INT8 ? CV_8S : CV_8U);
+    size_t plane = (size_t)frame.width * frame.height * ax::tensor_type_size(params.type);
+    cv::Mat rgb;
+
+    auto run = [&]() {
+        if (params.layout == ax::TENSOR_LAYOUT_NHWC && params.type == ax::TENSOR_TYPE_UINT8)
+        {
+            cv::Mat out(frame.height, frame.width, CV_8UC3, dst);
+            cv::cvtColor(nv12, out, code);
+            return;
+        }
+        cv::cvtColor(nv12, rgb, code);
+        cv::Mat channels[3];
+        cv::split(rgb, channels);
+        for (int k = 0; k < 3; k++)
+        {
+            cv::Mat out(frame.height, frame.width, depth, (uint8_t*)dst + plane * k);
+            channels[k].convertTo(out, depth, params.scale[k], -params.mean[k] * params.scale[k]);
+        }
+    };
+
+    run();
+    auto t0 = Clock::now();
+    for (int i = 0; i < iterations; i++)
+        run();
+    return ms_since(t0) / iterations;
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    int width = argc > 1 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int iterations = argc > 3 ? atoi(argv[3]) : 50;
+    int max_threads = argc > 4 ? atoi(argv[4]) : 4;
+
+#if AX_COLOR_NEON
+    const char* isa = "neon";
+#elif AX_COLOR_SSE2 && defined(__SSSE3__)
+    const char* isa = "ssse3";
+#elif AX_COLOR_SSE2
+    const char* isa = "sse2";
+#else
+    const char* isa = "none";
+#endif
+    printf("%dx%d nv12, %d iterations, simd %s\n", width, height, iterations, isa);
+
+    ax::VideoFrame frame = make_frame(width, height);
+    if (!frame.valid())
+    {
+        printf("frame allocation failed\n");
+        return 1;
+    }
+
+    std::vector<BenchCase> cases(3);
+    cases[0].name = "bgr nhwc u8";
+    cases[1].name = "rgb nchw float mean/scale";
+    cases[1].params.format = ax::PIXEL_FORMAT_RGB;
+    cases[1].params.layout = ax::TENSOR_LAYOUT_NCHW;
+    cases[1].params.type = ax::TENSOR_TYPE_FLOAT32;
+    cases[2].name = "rgb nchw int8 mean/scale";
+    cases[2].params.format = ax::PIXEL_FORMAT_RGB;
+    cases[2].params.layout = ax::TENSOR_LAYOUT_NCHW;
+    cases[2].params.type = ax::TENSOR_TYPE_INT8;
+    const float mean[3] = { 123.675f, 116.28f, 103.53f };
+    const float scale[3] = { 1 / 58.395f, 1 / 57.12f, 1 / 57.375f };
+    for (int k = 0; k < 3; k++)
+    {
+        cases[1].params.mean[k] = mean[k];
+        cases[1].params.scale[k] = scale[k];
+        // int8 gets a quantisation scale on top, the full range is [-2.1, 2.6]
+        cases[2].params.mean[k] = mean[k];
+        cases[2].params.scale[k] = scale[k] * 48;
+    }
+
+    std::vector<ax::BandPool*> pools;
+    for (int t = 1; t <= max_threads; t *= 2)
+        pools.push_back(new ax::BandPool(t));
+
+    int status = 0;
+    for (const BenchCase& c : cases)
+    {
+        size_t bytes = (size_t)width * height * 3 * ax::tensor_type_size(c.params.type);
+        std::vector<uint8_t> scalar(bytes), simd(bytes);
+
+        double ms = time_convert(frame, scalar.data(), c.params, nullptr, false, iterations);
+        report((std::string(c.name) + ", scalar").c_str(), 1, ms, width, height);
+        for (ax::BandPool* pool : pools)
+        {
+            ms = time_convert(frame, simd.data(), c.params, pool, true, iterations);
+            report((std::string(c.name) + ", simd").c_str(), pool->threads(), ms, width, height);
+        }
+        if (scalar != simd)
+        {
+            printf("%s: simd output differs from scalar\n", c.name);
+            status = 1;
+        }
+
+#if AX_BENCH_OPENCV
+        std::vector<uint8_t> reference(bytes);
+        ms = time_opencv(frame, c.params, reference.data(), iterations);
+        report((std::string(c.name) + ", opencv").c_str(), cv::getNumThreads(), ms, width, height);
+#endif
+        printf("\n");
+    }
+
+    // accuracy of u8 RGB only, the other outputs are linear maps of the same pixels
+    ax::ColorConvertParams rgb;
+    rgb.format = ax::PIXEL_FORMAT_RGB;
+    std::vector<uint8_t> out((size_t)width * height * 3);
+    ax::nv12_to_rgb(frame, out.data(), rgb);
+    printf("max error vs BT.601 %d\n", max_error(frame, out.data()));
+
+    for (ax::BandPool* pool : pools)
+        delete pool;
+    return status;
+}
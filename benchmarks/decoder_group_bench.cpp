@@ -0,0 +1,158 @@
+/// @brief decoder group allocation across channels on the host
+/// @details opens stub decoder channels from several threads at once and
+///     checks that every channel gets its own group, that the module init
+///     runs once for the first channel and deinit once after the last, that
+///     running out of groups or asking for a held group fails, and that a
+///     failed module init holds nothing. Then times Acquire/Release churn.
+///     Exits 1 when a check fails.
+///     built by benchmarks/CMakeLists.txt, no BSP needed
+///     ./decoder_group_bench [threads] [iterations]
+
+#include "codec/stub_video_decoder.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static int g_failed = 0;
+
+static void check(bool ok, const char* what)
+{
+    printf("%-58s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        g_failed++;
+}
+
+static ax::VideoDecoderAttr channel_attr()
+{
+    ax::VideoDecoderAttr attr;
+    attr.codec = ax::VIDEO_CODEC_H264;
+    attr.width = 64;
+    attr.height = 32;
+    attr.frame_buf_cnt = 2;
+    return attr;
+}
+
+static void channel_checks()
+{
+    ax::DecoderGroupAllocator& groups = ax::StubVideoDecoder::Groups();
+    ax::StubVideoDecoder::ModuleCalls& module = ax::StubVideoDecoder::Module();
+    int max_groups = groups.MaxGroups();
+    int inits = module.inits, deinits = module.deinits;
+
+    // every channel opens from its own thread, as the pull nodes do
+    std::vector<std::unique_ptr<ax::StubVideoDecoder>> channels;
+    std::vector<int> results(max_groups);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < max_groups; i++)
+        channels.emplace_back(new ax::StubVideoDecoder());
+    for (int i = 0; i < max_groups; i++)
+        threads.emplace_back([&, i] { results[i] = channels[i]->Open(channel_attr()); });
+    for (auto& t : threads)
+        t.join();
+
+    std::set<int> used;
+    bool opened = true;
+    for (int i = 0; i < max_groups; i++)
+    {
+        opened = opened && results[i] == ax::AX_SUCCESS;
+        used.insert(channels[i]->Group());
+    }
+    check(opened && (int)used.size() == max_groups && groups.InUse() == max_groups,
+          "all channels open, each on its own group");
+    check(module.inits == inits + 1 && module.deinits == deinits, "module init runs once for all channels");
+
+    ax::StubVideoDecoder extra;
+    check(extra.Open(channel_attr()) == ax::AX_ERR_QUEUE_FULL, "one channel more than groups fails");
+
+    // closing some channels frees their groups without deinit
+    int freed = channels[3]->Group();
+    channels[3]->Close();
+    channels[7]->Close();
+    check(groups.InUse() == max_groups - 2 && module.deinits == deinits, "closing some channels keeps the module");
+
+    ax::StubVideoDecoder pinned(0, freed);
+    ax::StubVideoDecoder taken(0, channels[0]->Group());
+    check(pinned.Open(channel_attr()) == ax::AX_SUCCESS && pinned.Group() == freed, "a freed group can be asked for");
+    check(taken.Open(channel_attr()) == ax::AX_ERR_QUEUE_FULL, "a held group can not be asked for");
+    check(extra.Open(channel_attr()) == ax::AX_SUCCESS, "a waiting channel gets the other freed group");
+
+    ax::StubVideoDecoder outside(0, max_groups);
+    check(outside.Open(channel_attr()) == ax::AX_ERR_ILLEGAL_PARAM, "a group past the limit is rejected");
+
+    // the last channel out deinits the module, the next one inits it again
+    pinned.Close();
+    extra.Close();
+    for (auto& channel : channels)
+        channel->Close();
+    check(groups.InUse() == 0 && module.deinits == deinits + 1, "module deinit runs after the last channel");
+    check(extra.Open(channel_attr()) == ax::AX_SUCCESS && module.inits == inits + 2, "the next channel inits the module again");
+    extra.Close();
+}
+
+static void failed_init_checks()
+{
+    int inits = 0, deinits = 0;
+    bool fail = true;
+    ax::DecoderGroupAllocator groups(2,
+        [&] { inits++; return fail ? (int)ax::AX_ERR_INIT_FAIL : (int)ax::AX_SUCCESS; },
+        [&] { deinits++; return (int)ax::AX_SUCCESS; });
+
+    check(groups.Acquire() == ax::AX_ERR_INIT_FAIL && groups.InUse() == 0, "a failed module init holds no group");
+    fail = false;
+    int a = groups.Acquire();
+    int b = groups.Acquire();
+    check(a == 0 && b == 1 && inits == 2, "the next channel retries the module init");
+    groups.Release(a);
+    groups.Release(a);
+    check(groups.InUse() == 1 && deinits == 0, "releasing a group twice counts once");
+    groups.Release(b);
+    check(groups.InUse() == 0 && deinits == 1, "deinit after the last release");
+}
+
+static void churn(int threads, int iterations)
+{
+    int calls = 0;
+    ax::DecoderGroupAllocator groups(16,
+        [&] { calls++; return (int)ax::AX_SUCCESS; },
+        [&] { calls++; return (int)ax::AX_SUCCESS; });
+
+    auto t0 = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&] {
+            for (int i = 0; i < iterations; i++)
+            {
+                int grp = groups.Acquire();
+                if (grp >= 0)
+                    groups.Release(grp);
+            }
+        });
+    }
+    for (auto& t : workers)
+        t.join();
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+
+    printf("%d threads x %d acquire/release: %.0f ns per pair, %d module init/deinit calls\n",
+           threads, iterations, ns / ((double)threads * iterations), calls);
+    check(groups.InUse() == 0 && calls % 2 == 0, "churn leaves no group held and the module deinit");
+}
+
+int main(int argc, char** argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 8;
+    int iterations = argc > 2 ? atoi(argv[2]) : 100000;
+
+    channel_checks();
+    failed_init_checks();
+    churn(threads, iterations);
+    return g_failed ? 1 : 0;
+}
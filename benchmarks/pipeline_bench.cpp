@@ -0,0 +1,417 @@
+/// @brief micro benchmarks of the pipeline core: Stream, OutputPort fan-out, Packet and graphs
+/// @details reports throughput, p50/p99 per hop latency and heap allocations
+///     per packet, counted by replacing the global operator new. Producers
+///     run flat out, latency is at saturation and includes queueing. Graphs
+///     run SyntheticFrameSource -> relays -> CountingSink, so they measure
+///     the framework alone.
+///     built by benchmarks/CMakeLists.txt, no BSP needed
+///     ./pipeline_bench [packets] [filter], e.g. ./pipeline_bench 200000 graph
+
+#include "pipeline_builder.hpp"
+#include "nodes/SyntheticFrameSourceNode.hpp"
+#include "nodes/CountingSinkNode.hpp"
+
+#include <new>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<uint64_t> g_allocs(0);
+
+static void* counted_alloc(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size)
+{
+    return counted_alloc(size);
+}
+
+void* operator new[](size_t size)
+{
+    return counted_alloc(size);
+}
+
+// the deletes stay out of line, inlined gcc pairs their free with the
+// caller's operator new and warns -Wmismatched-new-delete
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+struct BenchItem
+{
+    Clock::time_point t0;
+};
+
+static double elapsed_ns(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+/// @brief one row of the report
+struct BenchResult
+{
+    uint64_t packets;
+    double seconds;
+    uint64_t allocs;
+    int hops;
+    std::vector<double> latency_ns;     // end to end, per packet
+
+    BenchResult(): packets(0), seconds(0), allocs(0), hops(1) { }
+};
+
+static void report(const char* name, BenchResult& r)
+{
+    std::sort(r.latency_ns.begin(), r.latency_ns.end());
+    double p50 = r.latency_ns.empty() ? 0 : r.latency_ns[r.latency_ns.size() / 2] / r.hops;
+    double p99 = r.latency_ns.empty() ? 0 : r.latency_ns[r.latency_ns.size() * 99 / 100] / r.hops;
+    printf("%-28s %9.3f Mpkt/s  hop p50 %9.0f ns  p99 %9.0f ns  allocs/pkt %6.2f\n",
+        name, r.packets / r.seconds / 1e6, p50, p99, r.packets ? (double)r.allocs / r.packets : 0.0);
+}
+
+static void report_op(const char* name, uint64_t ops, double seconds, uint64_t allocs)
+{
+    printf("%-28s %9.2f ns/op                                       allocs/op  %6.2f\n",
+        name, seconds * 1e9 / ops, (double)allocs / ops);
+}
+
+// ---------------------------------------------------------------- streams
+
+static void consume(ax::InputPort& port, uint64_t count, std::vector<double>& latency)
+{
+    ax::Packet packet;
+    uint64_t received = 0;
+    while (received < count)
+    {
+        if (port.recv(packet, 100) != ax::AX_SUCCESS)
+            continue;
+        latency.push_back(elapsed_ns(packet.get<BenchItem>().t0));
+        received++;
+    }
+}
+
+/// @brief producers push straight into one stream read by one consumer
+static BenchResult bench_stream(int producers, uint64_t packets)
+{
+    ax::InputPort iport("bench_input");
+    auto stream = std::make_shared<ax::Stream>(1024);
+    iport.set_stream(stream);
+
+    uint64_t total = packets / producers * producers;
+    BenchResult r;
+    r.latency_ns.reserve(total);
+
+    uint64_t allocs = g_allocs.load();
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&]() {
+            for (uint64_t i = 0; i < total / producers; i++)
+                stream->push(ax::Packet(BenchItem{Clock::now()}));
+        });
+    }
+    consume(iport, total, r.latency_ns);
+    for (auto& t : threads)
+        t.join();
+
+    r.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    r.allocs = g_allocs.load() - allocs;
+    r.packets = total;
+    return r;
+}
+
+/// @brief one OutputPort::send delivered to consumers streams
+static BenchResult bench_fanout(int consumers, uint64_t packets)
+{
+    ax::OutputPort oport("bench_output");
+    std::vector<std::shared_ptr<ax::InputPort>> iports;
+    for (int c = 0; c < consumers; c++)
+    {
+        iports.push_back(std::make_shared<ax::InputPort>("bench_input"));
+        oport.connect(iports.back(), 1024);
+    }
+
+    BenchResult r;
+    std::vector<std::vector<double>> latency(consumers);
+    for (auto& l : latency)
+        l.reserve(packets);
+
+    uint64_t allocs = g_allocs.load();
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int c = 0; c < consumers; c++)
+        threads.emplace_back([&, c]() { consume(*iports[c], packets, latency[c]); });
+    for (uint64_t i = 0; i < packets; i++)
+        oport.send(ax::Packet(BenchItem{Clock::now()}));
+    for (auto& t : threads)
+        t.join();
+
+    r.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    r.allocs = g_allocs.load() - allocs;
+    r.packets = packets;
+    for (auto& l : latency)
+        r.latency_ns.insert(r.latency_ns.end(), l.begin(), l.end());
+    return r;
+}
+
+// ---------------------------------------------------------------- packets
+
+static void bench_packet(uint64_t ops)
+{
+    BenchItem item = { Clock::now() };
+    std::vector<ax::Packet> keep(1024);
+
+    uint64_t allocs = g_allocs.load();
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < ops; i++)
+        keep[i & 1023] = ax::Packet(item);
+    report_op("packet construct", ops, std::chrono::duration<double>(Clock::now() - start).count(), g_allocs.load() - allocs);
+
+    ax::Packet src(item);
+    allocs = g_allocs.load();
+    start = Clock::now();
+    for (uint64_t i = 0; i < ops; i++)
+        keep[i & 1023] = src;
+    report_op("packet copy", ops, std::chrono::duration<double>(Clock::now() - start).count(), g_allocs.load() - allocs);
+
+    int64_t sum = 0;
+    allocs = g_allocs.load();
+    start = Clock::now();
+    for (uint64_t i = 0; i < ops; i++)
+        sum += src.get<BenchItem>().t0.time_since_epoch().count() & 1;
+    report_op("packet get<T>", ops, std::chrono::duration<double>(Clock::now() - start).count(), g_allocs.load() - allocs);
+
+    allocs = g_allocs.load();
+    start = Clock::now();
+    for (uint64_t i = 0; i < ops; i++)
+        sum += src.isType<BenchItem>() ? 1 : 0;
+    report_op("packet isType<T>", ops, std::chrono::duration<double>(Clock::now() - start).count(), g_allocs.load() - allocs);
+
+    if (sum == 42)
+        printf("\n");
+}
+
+// ---------------------------------------------------------------- graphs
+
+class RelayBenchNode : public ax::Node
+{
+public:
+    int Init(const Json::Value&)
+    {
+        AddInputPort("bench_input");
+        AddOutputPort("bench_output");
+        return ax::AX_SUCCESS;
+    }
+
+    bool Schedulable() const { return true; }
+
+    int Process(std::vector<ax::Packet>& inputs)
+    {
+        return m_outputPorts[0]->send(inputs[0]);
+    }
+};
+
+/// @brief joins the two branches of a diamond
+class JoinBenchNode : public ax::Node
+{
+public:
+    int Init(const Json::Value&)
+    {
+        AddInputPort("left_input");
+        AddInputPort("right_input");
+        AddOutputPort("bench_output");
+        return ax::AX_SUCCESS;
+    }
+
+    bool Schedulable() const { return true; }
+
+    int Process(std::vector<ax::Packet>& inputs)
+    {
+        return m_outputPorts[0]->send(inputs[0]);
+    }
+};
+
+static uint64_t g_graphPackets = 100000;
+
+AX_REGISTER_NODE("BenchRelay", [](const Json::Value&) { return std::make_shared<RelayBenchNode>(); })
+AX_REGISTER_NODE("BenchJoin", [](const Json::Value&) { return std::make_shared<JoinBenchNode>(); })
+
+static void add_node(Json::Value& graph, const std::string& name, const std::string& type,
+    const Json::Value& config = Json::Value())
+{
+    Json::Value node;
+    node["name"] = name;
+    node["type"] = type;
+    if (!config.isNull())
+        node["config"] = config;
+    graph["nodes"].append(node);
+}
+
+/// @brief "packets" frames as fast as they come back, tiny unless a size is given
+static void add_source(Json::Value& graph, int width = 16, int height = 16)
+{
+    Json::Value config;
+    config["width"] = width;
+    config["height"] = height;
+    config["fps"] = 0;
+    config["count"] = (Json::UInt64)g_graphPackets;
+    // keep the frame buffers around 256 MB
+    config["pool"] = std::max(16, std::min(4096, (int)((256u << 20) / (width * height * 3 / 2))));
+    add_node(graph, "src", "SyntheticFrameSource", config);
+}
+
+static void add_sink(Json::Value& graph)
+{
+    Json::Value config;
+    config["samples"] = (Json::UInt64)g_graphPackets;
+    add_node(graph, "sink", "CountingSink", config);
+}
+
+static void add_edge(Json::Value& graph, const std::string& from, const std::string& to)
+{
+    Json::Value edge;
+    edge["from"] = from;
+    edge["to"] = to;
+    graph["edges"].append(edge);
+}
+
+/// @brief source -> relays -> sink
+static Json::Value linear_graph(int relays, int width = 16, int height = 16)
+{
+    Json::Value graph;
+    graph["default_capacity"] = 256;
+    add_source(graph, width, height);
+    std::string prev = "src";
+    for (int i = 0; i < relays; i++)
+    {
+        std::string name = "relay" + std::to_string(i);
+        add_node(graph, name, "BenchRelay");
+        add_edge(graph, prev + (i ? ".bench_output" : ".frame_output"), name + ".bench_input");
+        prev = name;
+    }
+    add_sink(graph);
+    add_edge(graph, prev + (relays ? ".bench_output" : ".frame_output"), "sink.input");
+    return graph;
+}
+
+/// @brief source -> left, right -> join -> sink
+static Json::Value diamond_graph()
+{
+    Json::Value graph;
+    graph["default_capacity"] = 256;
+    add_source(graph);
+    add_node(graph, "left", "BenchRelay");
+    add_node(graph, "right", "BenchRelay");
+    add_node(graph, "join", "BenchJoin");
+    add_sink(graph);
+    add_edge(graph, "src.frame_output", "left.bench_input");
+    add_edge(graph, "src.frame_output", "right.bench_input");
+    add_edge(graph, "left.bench_output", "join.left_input");
+    add_edge(graph, "right.bench_output", "join.right_input");
+    add_edge(graph, "join.bench_output", "sink.input");
+    return graph;
+}
+
+static BenchResult bench_graph(const Json::Value& graph, const char* mode, int hops)
+{
+    Json::Value config;
+    config["graph"] = graph;
+    config["scheduler"]["mode"] = mode;
+
+    BenchResult r;
+    ax::GraphPipeline pipeline(config);
+    if (pipeline.Init(config) != ax::AX_SUCCESS)
+    {
+        printf("graph init failed\n");
+        return r;
+    }
+    auto sink = std::static_pointer_cast<ax::CountingSinkNode>(pipeline.FindNode("sink"));
+
+    uint64_t allocs = g_allocs.load();
+    Clock::time_point start = Clock::now();
+    if (pipeline.Start() != ax::AX_SUCCESS)
+    {
+        printf("graph start failed\n");
+        return r;
+    }
+
+    Clock::time_point deadline = start + std::chrono::seconds(60);
+    while (sink->Received() < g_graphPackets && Clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    r.seconds = (sink->LastReceived() - std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count()) / 1e9;
+    r.allocs = g_allocs.load() - allocs;
+    r.packets = sink->Received();
+    r.hops = hops;
+    pipeline.Stop();
+    r.latency_ns.assign(sink->Samples().begin(), sink->Samples().end());
+    if (sink->Missing() || sink->Reordered())
+        printf("sequence broken, %llu missing %llu reordered\n", (unsigned long long)sink->Missing(), (unsigned long long)sink->Reordered());
+    if (r.packets < g_graphPackets)
+        printf("timed out, %llu of %llu delivered\n", (unsigned long long)r.packets, (unsigned long long)g_graphPackets);
+    return r;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t packets = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+    std::string filter = argc > 2 ? argv[2] : "";
+    g_graphPackets = packets / 2;
+
+    auto selected = [&](const char* group) { return filter.empty() || filter == group; };
+
+    if (selected("stream"))
+    {
+        BenchResult r = bench_stream(1, packets);
+        report("stream 1:1", r);
+        r = bench_fanout(4, packets);
+        report("port send 1:4 fan-out", r);
+        r = bench_stream(4, packets);
+        report("stream 4:1", r);
+    }
+
+    if (selected("packet"))
+        bench_packet(packets * 10);
+
+    if (selected("graph"))
+    {
+        const char* modes[] = { "thread", "event" };
+        for (const char* mode : modes)
+        {
+            BenchResult r = bench_graph(linear_graph(3), mode, 4);
+            report((std::string("linear 5 nodes, ") + mode).c_str(), r);
+            r = bench_graph(diamond_graph(), mode, 3);
+            report((std::string("diamond 5 nodes, ") + mode).c_str(), r);
+            r = bench_graph(linear_graph(3, 1920, 1080), mode, 4);
+            report((std::string("linear 1080p nv12, ") + mode).c_str(), r);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,332 @@
+/// @brief detection post-processing: naive loops vs Postprocessor scalar vs SIMD
+/// @details decodes YOLO style heads replayed from a recording. Without a
+///     recording argument, synthetic heads (objects with clusters of
+///     overlapping anchors over low background scores) are recorded to a
+///     temporary segment first, so the timed input always comes from a
+///     replayed mapping like ReplayNode hands out. The naive version reads
+///     the classes of one anchor at a time across rows, sorts every
+///     candidate and runs full pairwise NMS with a division per pair. All
+///     three must find the same boxes. A recording given on the command
+///     line is decoded as YOLOv8 heads.
+///     built by benchmarks/CMakeLists.txt, no BSP needed
+///     ./postprocess_bench [iterations] [recording.axrec]
+
+#include "infer/postprocess.hpp"
+#include "record/packet_types.hpp"
+#include "record/segment_file.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct BenchCase
+{
+    const char* name;
+    ax::PostprocessParams params;
+    int batch;
+    int classes;
+};
+
+static double ms_since(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static float logit(float p)
+{
+    return logf(p / (1 - p));
+}
+
+/// @brief one head of [batch, 4 + obj + classes, 1, anchors] with objects at random places
+static ax::Tensor make_head(const BenchCase& c, int anchors, uint32_t seed)
+{
+    const ax::PostprocessParams& p = c.params;
+    int first = 4 + (p.objectness ? 1 : 0);
+    ax::Tensor head = ax::Tensor::Allocate(ax::TENSOR_TYPE_FLOAT32, ax::TENSOR_LAYOUT_NCHW,
+        c.batch, first + c.classes, 1, anchors);
+    uint32_t state = seed;
+    auto rnd = [&state]() {
+        state = state * 1664525 + 1013904223;
+        return (state >> 8) / 16777216.0f;
+    };
+    auto score = [&p](float prob) { return p.sigmoid ? logit(prob) : prob; };
+
+    for (int b = 0; b < c.batch; b++)
+    {
+        float* rows = head.as<float>() + (size_t)b * head.channels * anchors;
+        for (size_t i = 0; i < (size_t)head.channels * anchors; i++)
+            rows[i] = 0;
+        for (int i = 0; i < anchors; i++)
+        {
+            rows[i] = rnd() * 640;
+            rows[anchors + i] = rnd() * 640;
+            rows[2 * anchors + i] = 8 + rnd() * 64;
+            rows[3 * anchors + i] = 8 + rnd() * 64;
+            if (p.objectness)
+                rows[4 * anchors + i] = score(0.01f + rnd() * 0.2f);
+            for (int k = 0; k < c.classes; k++)
+                rows[(first + k) * anchors + i] = score(0.001f + rnd() * 0.03f);
+            // a few stray anchors above the threshold
+            if (rnd() < 0.01f)
+            {
+                if (p.objectness)
+                    rows[4 * anchors + i] = score(0.9f);
+                rows[(first + (int)(rnd() * c.classes)) * anchors + i] = score(0.3f + rnd() * 0.2f);
+            }
+        }
+        // objects, each seen by a cluster of neighbouring anchors with jittered boxes
+        for (int o = 0; o < 40; o++)
+        {
+            float cx = rnd() * 600 + 20, cy = rnd() * 600 + 20, w = 20 + rnd() * 150, h = 20 + rnd() * 150;
+            int label = (int)(rnd() * c.classes);
+            int at = (int)(rnd() * (anchors - 32));
+            for (int i = at; i < at + 24; i++)
+            {
+                rows[i] = cx + (rnd() - 0.5f) * 6;
+                rows[anchors + i] = cy + (rnd() - 0.5f) * 6;
+                rows[2 * anchors + i] = w * (0.9f + rnd() * 0.2f);
+                rows[3 * anchors + i] = h * (0.9f + rnd() * 0.2f);
+                if (p.objectness)
+                    rows[4 * anchors + i] = score(0.6f + rnd() * 0.39f);
+                rows[(first + label) * anchors + i] = score(0.4f + rnd() * 0.59f);
+            }
+        }
+    }
+    head.transform.scale_x = head.transform.scale_y = 3;
+    head.transform.offset_y = -100;
+    return head;
+}
+
+/// @brief the straightforward version: per anchor class loop, full sort, all pairs NMS
+static void naive(const ax::PostprocessParams& p, const ax::Tensor& head, int index, ax::Detections& dets)
+{
+    int first = 4 + (p.objectness ? 1 : 0);
+    int classes = head.channels - first;
+    size_t n = (size_t)head.height * head.width;
+    const float* rows = head.as<float>() + (size_t)index * head.channels * n;
+    auto act = [&p](float v) { return p.sigmoid ? 1.0f / (1.0f + expf(-v)) : v; };
+
+    struct Box
+    {
+        float x0, y0, x1, y1, score;
+        int label, index;
+    };
+    std::vector<Box> boxes;
+    for (size_t i = 0; i < n; i++)
+    {
+        int label = 0;
+        float best = act(rows[first * n + i]);
+        for (int k = 1; k < classes; k++)
+        {
+            float v = act(rows[(first + k) * n + i]);
+            if (v > best)
+            {
+                best = v;
+                label = k;
+            }
+        }
+        if (p.objectness)
+            best *= act(rows[4 * n + i]);
+        if (best <= p.score_threshold)
+            continue;
+        float cx = rows[i], cy = rows[n + i], w = rows[2 * n + i], h = rows[3 * n + i];
+        boxes.push_back(Box{cx - w * 0.5f, cy - h * 0.5f, cx + w * 0.5f, cy + h * 0.5f, best, label, (int)i});
+    }
+    std::sort(boxes.begin(), boxes.end(), [](const Box& a, const Box& b) {
+        return a.score > b.score || (a.score == b.score && a.index < b.index);
+    });
+    if ((int)boxes.size() > p.top_k)
+        boxes.resize(p.top_k);
+
+    std::vector<bool> removed(boxes.size(), false);
+    dets.pts = head.pts;
+    dets.boxes.clear();
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        if (removed[i])
+            continue;
+        const Box& a = boxes[i];
+        if ((int)dets.size() < p.max_detections)
+        {
+            ax::Detection d;
+            d.x0 = head.transform.source_x(a.x0);
+            d.y0 = head.transform.source_y(a.y0);
+            d.x1 = head.transform.source_x(a.x1);
+            d.y1 = head.transform.source_y(a.y1);
+            d.score = a.score;
+            d.label = a.label;
+            d.track = -1;
+            dets.boxes.push_back(d);
+        }
+        for (size_t j = i + 1; j < boxes.size(); j++)
+        {
+            const Box& b = boxes[j];
+            if (removed[j] || (!p.class_agnostic && a.label != b.label))
+                continue;
+            float w = std::max(std::min(a.x1, b.x1) - std::max(a.x0, b.x0), 0.0f);
+            float h = std::max(std::min(a.y1, b.y1) - std::max(a.y0, b.y0), 0.0f);
+            float inter = w * h;
+            float iou = inter / ((a.x1 - a.x0) * (a.y1 - a.y0) + (b.x1 - b.x0) * (b.y1 - b.y0) - inter);
+            if (iou > p.iou_threshold)
+                removed[j] = true;
+        }
+    }
+}
+
+/// @brief boxes that differ, same order expected
+static int differences(const ax::Detections& a, const ax::Detections& b)
+{
+    int diff = abs((int)a.size() - (int)b.size());
+    for (size_t i = 0; i < std::min(a.size(), b.size()); i++)
+    {
+        const ax::Detection& x = a.boxes[i];
+        const ax::Detection& y = b.boxes[i];
+        if (x.label != y.label || fabsf(x.score - y.score) > 1e-5f || fabsf(x.x0 - y.x0) > 1e-3f
+            || fabsf(x.y0 - y.y0) > 1e-3f || fabsf(x.x1 - y.x1) > 1e-3f || fabsf(x.y1 - y.y1) > 1e-3f)
+            diff++;
+    }
+    return diff;
+}
+
+static void record_heads(const std::string& path, const std::vector<BenchCase>& cases, int anchors)
+{
+    ax::SegmentWriter writer;
+    if (writer.Open(path) != ax::AX_SUCCESS)
+        return;
+    const ax::PacketCodec* codec = ax::PacketCodecRegistry::Instance().Find(ax::record::TYPE_TENSOR);
+    for (size_t c = 0; c < cases.size(); c++)
+    {
+        for (int f = 0; f < 4; f++)
+        {
+            ax::Packet packet(make_head(cases[c], anchors, 7 + c * 100 + f));
+            uint32_t size = codec->size(packet);
+            uint8_t* dst = writer.Append(codec->id, f, c, size);
+            if (!dst)
+                break;
+            codec->write(packet, dst);
+            writer.Commit(dst);
+        }
+    }
+    writer.Close();
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    std::string path = argc > 2 ? argv[2] : "";
+
+#if AX_POST_NEON
+    const char* isa = "neon";
+#elif AX_POST_SSE2
+    const char* isa = "sse2";
+#else
+    const char* isa = "none";
+#endif
+
+    // yolov8 80 classes at 640: 8400 anchors, yolov5 style with objectness and logits
+    std::vector<BenchCase> cases(3);
+    cases[0].name = "v8 80 classes";
+    cases[0].batch = 1;
+    cases[0].classes = 80;
+    cases[1].name = "v5 obj + sigmoid 80 classes";
+    cases[1].params.objectness = true;
+    cases[1].params.sigmoid = true;
+    cases[1].batch = 1;
+    cases[1].classes = 80;
+    cases[2].name = "v8 80 classes batch 4";
+    cases[2].batch = 4;
+    cases[2].classes = 80;
+    const int anchors = 8400;
+
+    bool temporary = path.empty();
+    if (temporary)
+    {
+        path = "/tmp/postprocess_bench." + std::to_string(getpid()) + ".axrec";
+        record_heads(path, cases, anchors);
+    }
+    ax::SegmentReader reader;
+    if (reader.Open(path) != ax::AX_SUCCESS)
+    {
+        printf("cannot open %s\n", path.c_str());
+        return 1;
+    }
+
+    // the recording keeps which case a head belongs to in seq
+    std::vector<std::vector<ax::Tensor>> heads(cases.size());
+    const ax::PacketCodec* codec = ax::PacketCodecRegistry::Instance().Find(ax::record::TYPE_TENSOR);
+    ax::SegmentReader::Record rec;
+    while (reader.Next(rec))
+    {
+        if (rec.type != ax::record::TYPE_TENSOR)
+            continue;
+        ax::Packet packet = codec->read(rec.data, rec.size, reader.Mapping());
+        if (packet.isValid())
+            heads[temporary ? rec.seq % cases.size() : 0].push_back(packet.get<ax::Tensor>());
+    }
+    if (temporary)
+        unlink(path.c_str());
+    printf("%d iterations, simd %s, recording %s\n", iterations, isa, temporary ? "synthetic" : path.c_str());
+
+    int status = 0;
+    for (size_t c = 0; c < cases.size(); c++)
+    {
+        if (heads[c].empty())
+            continue;
+        ax::PostprocessParams params = cases[c].params;
+        ax::Postprocessor post(params);
+        const ax::Tensor& first = heads[c][0];
+        printf("%s: %d x %d x %d\n", cases[c].name, first.batch, first.channels, first.height * first.width);
+
+        // every path on every head, results compared before timing
+        int diff = 0;
+        size_t found = 0;
+        for (const ax::Tensor& head : heads[c])
+        {
+            std::vector<ax::Detections> simd, scalar;
+            post.Run(head, simd, true);
+            post.Run(head, scalar, false);
+            for (int b = 0; b < head.batch; b++)
+            {
+                ax::Detections ref;
+                naive(params, head, b, ref);
+                diff += differences(ref, simd[b]) + differences(ref, scalar[b]);
+                found += ref.size();
+            }
+        }
+        printf("  %zu boxes over %zu heads, %d differences\n", found, heads[c].size(), diff);
+        if (diff)
+            status = 1;
+
+        double ms[3];
+        for (int path_id = 0; path_id < 3; path_id++)
+        {
+            std::vector<ax::Detections> dets;
+            ax::Detections one;
+            auto t0 = Clock::now();
+            for (int i = 0; i < iterations; i++)
+            {
+                const ax::Tensor& head = heads[c][i % heads[c].size()];
+                if (path_id == 0)
+                {
+                    for (int b = 0; b < head.batch; b++)
+                        naive(params, head, b, one);
+                }
+                else
+                    post.Run(head, dets, path_id == 2);
+            }
+            ms[path_id] = ms_since(t0) / iterations;
+        }
+        printf("  %-10s %8.3f ms/head\n", "naive", ms[0]);
+        printf("  %-10s %8.3f ms/head %6.1fx\n", "scalar", ms[1], ms[0] / ms[1]);
+        printf("  %-10s %8.3f ms/head %6.1fx\n", "simd", ms[2], ms[0] / ms[2]);
+    }
+    return status;
+}
@@ -0,0 +1,213 @@
+/// @brief thread-per-node vs event scheduler on relay chains
+/// @details channels x hops pass-through nodes fed at a fixed frame rate,
+///     reports threads, context switches and per hop latency for both modes.
+///     built by benchmarks/CMakeLists.txt, no BSP needed
+///     ./scheduler_bench [channels] [hops] [fps] [seconds]
+
+#include "ax_pipeline.hpp"
+
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+
+typedef std::chrono::steady_clock Clock;
+
+struct BenchItem
+{
+    Clock::time_point t0;
+};
+
+class RelayBenchNode : public ax::Node
+{
+public:
+    RelayBenchNode(const std::string& name):
+        Node(name)
+    { }
+
+    int Init(const Json::Value&)
+    {
+        AddInputPort("bench_input");
+        AddOutputPort("bench_output");
+        return ax::AX_SUCCESS;
+    }
+
+    bool Schedulable() const { return true; }
+
+    int Process(std::vector<ax::Packet>& inputs)
+    {
+        return m_outputPorts[0]->send(inputs[0]);
+    }
+};
+
+class SinkBenchNode : public ax::Node
+{
+public:
+    SinkBenchNode(const std::string& name, std::vector<double>* latency, std::mutex* lock):
+        Node(name),
+        m_latency(latency),
+        m_lock(lock)
+    { }
+
+    int Init(const Json::Value&)
+    {
+        AddInputPort("bench_input");
+        return ax::AX_SUCCESS;
+    }
+
+    bool Schedulable() const { return true; }
+
+    int Process(std::vector<ax::Packet>& inputs)
+    {
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - inputs[0].get<BenchItem>().t0).count();
+        std::lock_guard<std::mutex> lg(*m_lock);
+        m_latency->push_back(us);
+        return ax::AX_SUCCESS;
+    }
+
+private:
+    std::vector<double>* m_latency;
+    std::mutex* m_lock;
+};
+
+class BenchPipeline : public ax::AX_Pipeline
+{
+public:
+    BenchPipeline(const Json::Value& config):
+        AX_Pipeline(config)
+    { }
+
+    int Init(const Json::Value& config)
+    {
+        int channels = config["channels"].asInt();
+        int hops = config["hops"].asInt();
+        for (int c = 0; c < channels; c++)
+        {
+            std::shared_ptr<ax::Node> prev;
+            for (int h = 0; h < hops; h++)
+            {
+                std::string name = "ch" + std::to_string(c) + "_" + std::to_string(h);
+                std::shared_ptr<ax::Node> node;
+                if (h == hops - 1)
+                    node = std::make_shared<SinkBenchNode>(name, &m_latency, &m_latencyLock);
+                else
+                    node = std::make_shared<RelayBenchNode>(name);
+                if (!AddNode(node))
+                    return ax::AX_ERR_INIT_FAIL;
+
+                if (prev)
+                    prev->Connect(node);
+                else
+                    m_heads.push_back(node);
+                prev = node;
+            }
+        }
+
+        // channel 0 takes the pipeline input stream created by Start
+        for (size_t c = 1; c < m_heads.size(); c++)
+            m_heads[c]->GetInputPort(0)->set_stream(std::make_shared<ax::Stream>());
+
+        m_hasInit = true;
+        return ax::AX_SUCCESS;
+    }
+
+    std::vector<std::shared_ptr<ax::Stream>> Inputs()
+    {
+        std::vector<std::shared_ptr<ax::Stream>> inputs;
+        for (auto& head : m_heads)
+            inputs.push_back(head->GetInputPort(0)->stream());
+        return inputs;
+    }
+
+    std::vector<double> m_latency;
+    std::mutex m_latencyLock;
+
+private:
+    std::vector<std::shared_ptr<ax::Node>> m_heads;
+};
+
+static int thread_count()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 8, "Threads:") == 0)
+            return std::stoi(line.substr(8));
+    }
+    return -1;
+}
+
+static long context_switches()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+static void run(const char* mode, int channels, int hops, int fps, int seconds)
+{
+    Json::Value config;
+    config["channels"] = channels;
+    config["hops"] = hops;
+    config["scheduler"]["mode"] = mode;
+
+    BenchPipeline pipeline(config);
+    if (pipeline.Init(config) != ax::AX_SUCCESS || pipeline.Start() != ax::AX_SUCCESS)
+    {
+        printf("%s: start failed\n", mode);
+        return;
+    }
+    auto inputs = pipeline.Inputs();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int threads = thread_count();
+    long csw = context_switches();
+
+    // all channels fed from this thread, like frames arriving from the decoders
+    Clock::time_point next = Clock::now();
+    Clock::time_point end = next + std::chrono::seconds(seconds);
+    int sent = 0;
+    while (next < end)
+    {
+        for (auto& s : inputs)
+            s->push(ax::Packet(BenchItem{Clock::now()}));
+        sent += inputs.size();
+        next += std::chrono::microseconds(1000000 / fps);
+        std::this_thread::sleep_until(next);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    csw = context_switches() - csw;
+    pipeline.Stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<double> latency;
+    {
+        std::lock_guard<std::mutex> lg(pipeline.m_latencyLock);
+        latency = pipeline.m_latency;
+    }
+    std::sort(latency.begin(), latency.end());
+    double mean = 0;
+    for (double l : latency)
+        mean += l;
+    mean = latency.empty() ? 0 : mean / latency.size();
+    double p99 = latency.empty() ? 0 : latency[latency.size() * 99 / 100];
+
+    printf("%-7s threads %4d  ctx switches/s %8.0f  hop latency mean %7.1f us  p99 %7.1f us  delivered %zu/%d\n",
+        mode, threads, (double)csw / seconds, mean / hops, p99 / hops, latency.size(), sent);
+}
+
+int main(int argc, char** argv)
+{
+    int channels = argc > 1 ? atoi(argv[1]) : 16;
+    int hops = argc > 2 ? atoi(argv[2]) : 5;
+    int fps = argc > 3 ? atoi(argv[3]) : 30;
+    int seconds = argc > 4 ? atoi(argv[4]) : 3;
+
+    printf("%d channels x %d nodes, %d fps\n", channels, hops, fps);
+    run("thread", channels, hops, fps, seconds);
+    run("event", channels, hops, fps, seconds);
+    return 0;
+}
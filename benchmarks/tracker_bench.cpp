@@ -0,0 +1,203 @@
+/// @brief Tracker::Update cost and identity stability on simulated scenes
+/// @details objects move at constant velocity with jittered boxes, some
+///     detections are missed, some scores fall into the low band and a few
+///     false positives appear, like a detector on a crowded 1080p scene.
+///     Reports the per frame update time with the SIMD and the scalar IoU
+///     rows, and how often a ground truth object changed track id. With a
+///     skip interval, frames in between are not detected and the tracker
+///     predicts over the gap, like behind a DetectGateNode.
+///     built by benchmarks/CMakeLists.txt, no BSP needed
+///     ./tracker_bench [objects] [frames]
+
+#include "track/tracker.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Object
+{
+    float cx, cy, w, h, vx, vy;
+    int label;
+};
+
+struct Scene
+{
+    std::vector<Object> objects;
+    uint32_t state;
+
+    float rnd()
+    {
+        state = state * 1664525 + 1013904223;
+        return (state >> 8) / 16777216.0f;
+    }
+};
+
+static Scene make_scene(int objects, uint32_t seed)
+{
+    Scene s;
+    s.state = seed;
+    for (int i = 0; i < objects; i++)
+    {
+        Object o;
+        o.w = 20 + s.rnd() * 80;
+        o.h = 40 + s.rnd() * 120;
+        o.cx = o.w + s.rnd() * (1920 - 2 * o.w);
+        o.cy = o.h + s.rnd() * (1080 - 2 * o.h);
+        o.vx = (s.rnd() - 0.5f) * 6;
+        o.vy = (s.rnd() - 0.5f) * 3;
+        o.label = s.rnd() < 0.8f ? 0 : 2;
+        s.objects.push_back(o);
+    }
+    return s;
+}
+
+/// @brief move every object, bounce off the borders
+static void step(Scene& s)
+{
+    for (Object& o : s.objects)
+    {
+        o.cx += o.vx;
+        o.cy += o.vy;
+        if (o.cx < o.w / 2 || o.cx > 1920 - o.w / 2)
+            o.vx = -o.vx;
+        if (o.cy < o.h / 2 || o.cy > 1080 - o.h / 2)
+            o.vy = -o.vy;
+    }
+}
+
+/// @brief detections of the scene, truth[i] is the object of box i or -1
+static void detect(Scene& s, ax::Detections& dets, std::vector<int>& truth)
+{
+    dets.boxes.clear();
+    truth.clear();
+    for (size_t i = 0; i < s.objects.size(); i++)
+    {
+        const Object& o = s.objects[i];
+        if (s.rnd() < 0.05f)
+            continue;
+        ax::Detection d;
+        float jx = (s.rnd() - 0.5f) * o.w * 0.06f, jy = (s.rnd() - 0.5f) * o.h * 0.06f;
+        d.x0 = o.cx - o.w / 2 + jx;
+        d.y0 = o.cy - o.h / 2 + jy;
+        d.x1 = o.cx + o.w / 2 + jx;
+        d.y1 = o.cy + o.h / 2 + jy;
+        d.score = s.rnd() < 0.15f ? 0.15f + s.rnd() * 0.3f : 0.6f + s.rnd() * 0.4f;
+        d.label = o.label;
+        d.track = -1;
+        dets.boxes.push_back(d);
+        truth.push_back((int)i);
+    }
+    for (int k = 0; k < 3; k++)
+    {
+        ax::Detection d;
+        d.x0 = s.rnd() * 1800;
+        d.y0 = s.rnd() * 1000;
+        d.x1 = d.x0 + 30;
+        d.y1 = d.y0 + 60;
+        d.score = 0.2f + s.rnd() * 0.5f;
+        d.label = 0;
+        d.track = -1;
+        dets.boxes.push_back(d);
+        truth.push_back(-1);
+    }
+}
+
+struct Result
+{
+    double us_avg;
+    double us_max;
+    int switches;
+    size_t matched;
+    size_t detected;
+};
+
+static Result run(int objects, int frames, int interval, bool simd)
+{
+    Scene scene = make_scene(objects, 42);
+    ax::Tracker tracker((ax::TrackerParams()));
+    ax::Detections dets, out;
+    std::vector<int> truth;
+    std::map<int, int> owner;       // ground truth object -> track id
+    Result r = { 0, 0, 0, 0, 0 };
+    int updates = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        step(scene);
+        if (f % interval)
+            continue;
+        detect(scene, dets, truth);
+        auto t0 = Clock::now();
+        tracker.Update(dets, f ? interval : 1, out, simd);
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+        // the first frames build the tracks, time the steady state
+        if (f >= 10 * interval)
+        {
+            r.us_avg += us;
+            r.us_max = std::max(r.us_max, us);
+            updates++;
+        }
+
+        // a track box belongs to the object whose detection it overlaps most
+        for (const ax::Detection& t : out.boxes)
+        {
+            int best = -1;
+            float best_iou = 0.5f;
+            for (size_t i = 0; i < dets.boxes.size(); i++)
+            {
+                const ax::Detection& d = dets.boxes[i];
+                float w = std::max(std::min(t.x1, d.x1) - std::max(t.x0, d.x0), 0.0f);
+                float h = std::max(std::min(t.y1, d.y1) - std::max(t.y0, d.y0), 0.0f);
+                float iou = w * h / (t.area() + d.area() - w * h);
+                if (iou > best_iou)
+                {
+                    best_iou = iou;
+                    best = truth[i];
+                }
+            }
+            if (best < 0)
+                continue;
+            r.matched++;
+            auto it = owner.find(best);
+            if (it != owner.end() && it->second != t.track)
+                r.switches++;
+            owner[best] = t.track;
+        }
+        r.detected += objects;
+    }
+    r.us_avg /= std::max(updates, 1);
+    return r;
+}
+
+int main(int argc, char** argv)
+{
+    int objects = argc > 1 ? atoi(argv[1]) : 200;
+    int frames = argc > 2 ? atoi(argv[2]) : 1000;
+
+#if AX_TRACK_NEON
+    const char* isa = "neon";
+#elif AX_TRACK_SSE2
+    const char* isa = "sse2";
+#else
+    const char* isa = "none";
+#endif
+    printf("%d objects, %d frames, simd %s\n", objects, frames, isa);
+
+    for (int interval : {1, 2, 3})
+    {
+        for (bool simd : {false, true})
+        {
+            Result r = run(objects, frames, interval, simd);
+            printf("detect 1/%d %-6s %8.1f us/update avg %8.1f max  %5d id switches  %5.1f%% tracked\n",
+                interval, simd ? "simd" : "scalar", r.us_avg, r.us_max, r.switches,
+                100.0 * r.matched / std::max<size_t>(r.detected, 1));
+        }
+    }
+    return 0;
+}
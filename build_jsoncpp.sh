@@ -1,5 +1,7 @@
 #!/usr/bin/env bash
 pwd=`pwd`
+# toolchain name under toolchains/, "host" for the off-board build
+toolchain=${1:-ax620a}
 third_party=${pwd}/third-party/jsoncpp
 install_path=${pwd}/third-party-install/jsoncpp
 
@@ -12,7 +14,7 @@ fi
 cd ${third_party}               
 mkdir jsoncpp-build
 cd jsoncpp-build
-cmake .. -DCMAKE_INSTALL_PREFIX=${install_path} -DCMAKE_TOOLCHAIN_FILE=${pwd}/toolchains/ax620a.cmake -DJSONCPP_WITH_TESTS=OFF -DJSONCPP_WITH_POST_BUILD_UNITTEST=OFF -DJSONCPP_WITH_EXAMPLE=OFF
+cmake .. -DCMAKE_INSTALL_PREFIX=${install_path} -DCMAKE_TOOLCHAIN_FILE=${pwd}/toolchains/${toolchain}.cmake -DJSONCPP_WITH_TESTS=OFF -DJSONCPP_WITH_POST_BUILD_UNITTEST=OFF -DJSONCPP_WITH_EXAMPLE=OFF
 make -j8
 make install
 cd ${pwd}
\ No newline at end of file
@@ -1,5 +1,7 @@
 #!/usr/bin/env bash
 pwd=`pwd`
+# toolchain name under toolchains/, "host" for the off-board build
+toolchain=${1:-ax620a}
 third_party=${pwd}/third-party/RTSP
 install_path=${pwd}/third-party-install/RTSP
 
@@ -12,7 +14,7 @@ fi
 cd ${third_party}               
 mkdir RTSP-build
 cd RTSP-build
-cmake .. -DCMAKE_INSTALL_PREFIX=${install_path} -DCMAKE_TOOLCHAIN_FILE=${pwd}/toolchains/ax620a.cmake
+cmake .. -DCMAKE_INSTALL_PREFIX=${install_path} -DCMAKE_TOOLCHAIN_FILE=${pwd}/toolchains/${toolchain}.cmake
 make -j8
 make install
 cd ${pwd}
\ No newline at end of file
@@ -10,17 +10,51 @@
 
 #pragma once
 
+#include <set>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
 #include <thread>
+#include <condition_variable>
 
 #include "err.hpp"
 #include "node.hpp"
+#include "scheduler.hpp"
+#include "metrics.hpp"
+#include "metrics_server.hpp"
+#include "trace.hpp"
+#include "thread_utils.hpp"
 #include "json/json.h"
 
 namespace ax
 {
     typedef std::shared_ptr<Node>       NodePtr;
 
+    enum NodePlacement
+    {
+        NODE_PLACEMENT_THREAD = 0,      // own Run thread
+        NODE_PLACEMENT_SCHEDULER        // worker pool, needs Process
+    };
+
     /// @brief Pipeline base class
+    /// @details By default every node runs its own Run thread. With
+    ///     {"scheduler": {"mode": "event", "workers": 4}}
+    ///     nodes implementing Process share a pool of workers instead, the
+    ///     others (sources driven by hardware or network) keep their thread.
+    ///     {"scheduler": {"parallelism": {"node_name": 4}}} runs that node on
+    ///     up to 4 workers at once with its outputs kept in input order, in
+    ///     thread mode too.
+    ///     Threads are named after their node and take a utils::ThreadPolicy,
+    ///     {"threads": {"default": {"nice": 5}, "workers": {"cpus": "2-3"},
+    ///                  "nodes": {"RTSP_Pull_0": {"cpus": [0], "priority": 20}}}}
+    ///     Start publishes the metrics of every node and of every input
+    ///     stream, as "<node>.<port>", to MetricsRegistry::Instance().
+    ///     {"metrics": {"listen": "9100"}} serves them for Prometheus while
+    ///     started, see MetricsServer for the address forms.
+    ///     {"trace": {"enabled": true, "capacity": 1024, "output": "trace.json"}}
+    ///     traces frames through nodes and streams, Stop writes the last
+    ///     capacity frames to output in Chrome trace-event format.
     class AX_Pipeline
     {
     public:
@@ -31,11 +65,77 @@ namespace ax
             m_input_stream(nullptr)
         { }
 
-        virtual ~AX_Pipeline() {}
+        virtual ~AX_Pipeline()
+        {
+            if (m_hasStart)
+            {
+                AX_Pipeline::Stop();
+            }
+            else
+            {
+                // prepared before a Start that never came
+                {
+                    std::lock_guard<std::mutex> lg(m_prepare->lock);
+                    m_prepare->owner = nullptr;
+                }
+                m_prepare->cond.notify_all();
+                JoinPrepares(std::chrono::steady_clock::now() + std::chrono::milliseconds(3000));
+            }
+        }
 
         virtual int Init(const Json::Value& config) = 0;
 
+        /// @brief run the slow part of node initialisation concurrently
+        /// @details Node::Prepare of every node runs on its own thread. This waits
+        ///     until each node is prepared or has used up its timeout,
+        ///     {"init": {"timeout_ms": 5000, "node_timeout_ms": {"node_name": 10000}}}.
+        ///     Nodes failing keep retrying in the background with a backoff from
+        ///     "retry_min_ms" (500) doubling up to "retry_max_ms" (30000), and
+        ///     start as soon as they succeed once the pipeline is started.
+        ///     Start calls it for nodes not prepared yet.
+        /// @return AX_ERR_TIMEOUT when some node is still not prepared
+        int PrepareNodes()
+        {
+            if (!m_hasInit)
+                return AX_ERR_NOT_INIT;
+
+            const Json::Value& init_config = m_config["init"];
+            int default_timeout = init_config.get("timeout_ms", 5000).asInt();
+            int retry_min = init_config.get("retry_min_ms", 500).asInt();
+            int retry_max = init_config.get("retry_max_ms", 30000).asInt();
+
+            std::vector<std::pair<Node*, std::chrono::steady_clock::time_point>> deadlines;
+            auto now = std::chrono::steady_clock::now();
+            for (const auto& node : m_nodes)
+            {
+                int timeout = init_config["node_timeout_ms"].get(node->name(), default_timeout).asInt();
+                deadlines.push_back(std::make_pair(node.get(), now + std::chrono::milliseconds(timeout)));
+                PrepareNode(node, retry_min, retry_max);
+            }
+
+            std::sort(deadlines.begin(), deadlines.end(),
+                [](const std::pair<Node*, std::chrono::steady_clock::time_point>& a,
+                   const std::pair<Node*, std::chrono::steady_clock::time_point>& b) { return a.second < b.second; });
+
+            // wait for each node up to its own deadline, in deadline order
+            int ret = AX_SUCCESS;
+            std::shared_ptr<PrepareState> prepare = m_prepare;
+            std::unique_lock<std::mutex> lk(prepare->lock);
+            for (const auto& d : deadlines)
+            {
+                Node* node = d.first;
+                prepare->cond.wait_until(lk, d.second, [&]() { return prepare->ready.count(node) > 0; });
+                if (!prepare->ready.count(node))
+                {
+                    printf("[%s]: not ready in time, retrying in background\n", node->name());
+                    ret = AX_ERR_TIMEOUT;
+                }
+            }
+            return ret;
+        }
+
         /// @brief start nodes
+        /// @details nodes not prepared yet are started later by their retry
         virtual int Start()
         {
             if (!m_hasInit)
@@ -43,7 +143,8 @@ namespace ax
             if (m_hasStart)
                 return AX_SUCCESS;
 
-            if (!m_input_stream)
+            // pipelines made of sources only have no input stream
+            if (!m_input_stream && GetInputPort())
             {
                 m_input_stream = CreateInputStream();
                 if (!m_input_stream)
@@ -51,36 +152,197 @@ namespace ax
                     return AX_ERR_NULL_PTR;
                 }
             }
-                
-            // Run
+
+            const Json::Value& trace_config = m_config["trace"];
+            if (trace_config.get("enabled", false).asBool())
+                Tracer::Instance().Enable(true, trace_config.get("capacity", 1024).asUInt());
+
+            // packets left from a previous run are dropped
+            for (const auto& node : m_nodes)
+            {
+                ReopenStreams(node);
+                Instrument(node);
+            }
+
+            std::string metrics_listen = m_config["metrics"].get("listen", "").asString();
+            if (!metrics_listen.empty())
+            {
+                m_metricsServer.reset(new MetricsServer());
+                if (m_metricsServer->Start(metrics_listen) != AX_SUCCESS)
+                    m_metricsServer.reset();
+            }
+
+            const Json::Value& sched_config = m_config["scheduler"];
+            const Json::Value& parallelism = sched_config["parallelism"];
+            bool event_mode = sched_config.get("mode", "thread").asString() == "event";
+            m_scheduled.clear();
             for (auto& node : m_nodes)
             {
-                node->SetRunning();
+                auto placement = m_placements.find(node.get());
+                if (!node->Schedulable())
+                {
+                    if (placement != m_placements.end() && placement->second == NODE_PLACEMENT_SCHEDULER)
+                        printf("[%s]: does not implement Process, runs on its own thread\n", node->name());
+                    continue;
+                }
+                if (parallelism.isMember(node->name()))
+                    node->SetParallelism(parallelism[node->name()].asInt());
+                if (placement != m_placements.end())
+                {
+                    if (placement->second == NODE_PLACEMENT_THREAD)
+                        continue;
+                }
+                else if (!event_mode && node->Parallelism() <= 1)
+                    continue;
+
+                if (!m_scheduler)
+                {
+                    m_scheduler.reset(new Scheduler(sched_config.get("workers", 0).asInt()));
+                    m_scheduler->SetWorkerPolicy(utils::ThreadPolicy::from_json(m_config["threads"]["workers"]));
+                }
+                m_scheduled.insert(node.get());
+            }
 
-                std::thread t(&Node::Run, node);
-                t.detach();
+            PrepareNodes();
+
+            // Run, under the prepare lock so that a node prepared meanwhile is started exactly once
+            int ret = AX_SUCCESS;
+            {
+                std::lock_guard<std::mutex> lg(m_prepare->lock);
+                for (auto& node : m_nodes)
+                {
+                    if (!m_prepare->ready.count(node.get()))
+                        continue;
+                    if (LaunchNode(node) != AX_SUCCESS)
+                    {
+                        printf("[%s]: launch failed\n", node->name());
+                        ret = AX_ERR_INIT_FAIL;
+                        break;
+                    }
+                }
+                m_hasStart = true;
             }
 
-            m_hasStart = true;
+            // the nodes launched so far are stopped and joined like on a normal stop
+            if (ret != AX_SUCCESS)
+            {
+                Stop();
+                return ret;
+            }
+
+            if (m_scheduler)
+                m_scheduler->Start();
             return AX_SUCCESS;
         }
 
-        /// @brief stop nodes
-        virtual int Stop()
+        /// @brief stop nodes and wait for them to exit
+        /// @details streams are closed to wake nodes blocked on them, nodes
+        ///     still running after timeout are left detached and listed by Stragglers()
+        /// @param timeout  milliseconds to wait for the node threads
+        /// @return AX_ERR_TIMEOUT when some node did not exit in time
+        virtual int Stop(int timeout = 3000)
         {
             if (!m_hasInit)
                 return AX_ERR_NOT_INIT;
             if (!m_hasStart)
                 return AX_SUCCESS;
 
+            // no more late starts, retries give up
+            std::shared_ptr<PrepareState> prepare = m_prepare;
+            {
+                std::lock_guard<std::mutex> lg(prepare->lock);
+                prepare->owner = nullptr;
+                m_hasStart = false;
+            }
+            prepare->cond.notify_all();
+
             for (const auto& node : m_nodes)
             {
                 node->Stop();
             }
-            m_hasStart = false;
+            for (const auto& node : m_nodes)
+            {
+                CloseStreams(node);
+            }
+            if (m_scheduler)
+            {
+                m_scheduler->Stop();
+                m_scheduler.reset();
+            }
+            m_scheduled.clear();
+
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+            m_stragglers = JoinNodes(m_nodes, timeout);
+            JoinPrepares(deadline);
+
+            m_metricsServer.reset();
+
+            std::string trace_output = m_config["trace"].get("output", "").asString();
+            if (!trace_output.empty())
+                Tracer::Instance().WriteChrome(trace_output);
+
+            // nodes are prepared again by the next Start
+            m_prepare = std::make_shared<PrepareState>(this);
+            return m_stragglers.empty() ? AX_SUCCESS : AX_ERR_TIMEOUT;
+        }
+
+        /// @brief stop, re-init and start the named nodes, the rest keeps running
+        /// @details packets in flight to the restarted nodes are dropped, their
+        ///     ports stay connected so Init must tolerate ports already existing.
+        ///     Prepare runs in the background, the nodes start once it succeeds.
+        ///     Nodes still retrying their Prepare are left alone.
+        /// @param timeout  milliseconds to wait for the nodes to exit
+        int Restart(const std::vector<std::string>& node_names, int timeout = 3000)
+        {
+            if (!m_hasStart)
+                return AX_ERR_NOT_INIT;
+
+            std::vector<NodePtr> nodes;
+            for (const auto& node_name : node_names)
+            {
+                NodePtr node = FindNode(node_name);
+                if (!node)
+                {
+                    printf("restart: no node %s\n", node_name.c_str());
+                    return AX_ERR_ILLEGAL_PARAM;
+                }
+
+                std::lock_guard<std::mutex> lg(m_prepare->lock);
+                if (m_prepare->preparing.count(node.get()))
+                    continue;
+                m_prepare->ready.erase(node.get());
+                nodes.push_back(node);
+            }
+
+            for (const auto& node : nodes)
+            {
+                node->Stop();
+                CloseInputStreams(node);
+                if (IsScheduled(node))
+                    m_scheduler->Remove(node);
+            }
+
+            m_stragglers = JoinNodes(nodes, timeout);
+            if (!m_stragglers.empty())
+                return AX_ERR_TIMEOUT;
+
+            const Json::Value& init_config = m_config["init"];
+            for (const auto& node : nodes)
+            {
+                ReopenStreams(node, false);
+                if (0 != node->Init(NodeConfig(node)))
+                {
+                    printf("restart: init %s failed\n", node->name());
+                    return AX_ERR_INIT_FAIL;
+                }
+                PrepareNode(node, init_config.get("retry_min_ms", 500).asInt(), init_config.get("retry_max_ms", 30000).asInt());
+            }
             return AX_SUCCESS;
         }
 
+        /// @brief nodes that did not exit within the last Stop or Restart timeout
+        const std::vector<std::string>& Stragglers() const { return m_stragglers; }
+
         bool AddNode(NodePtr new_node)
         {
             if (FindNode(new_node->name()) != nullptr)
@@ -95,6 +357,53 @@ namespace ax
             return true;
         }
 
+        /// @brief add a node initialised with its own config instead of the pipeline's
+        bool AddNode(NodePtr new_node, const Json::Value& node_config)
+        {
+            if (FindNode(new_node->name()) != nullptr)
+                return false;
+
+            if (0 != new_node->Init(node_config))
+            {
+                return false;
+            }
+
+            m_nodeConfigs[new_node.get()] = node_config;
+            m_nodes.push_back(new_node);
+            return true;
+        }
+
+        /// @brief config the node was initialised with
+        const Json::Value& NodeConfig(const NodePtr& node) const
+        {
+            auto it = m_nodeConfigs.find(node.get());
+            return it != m_nodeConfigs.end() ? it->second : m_config;
+        }
+
+        /// @brief policy of the node's threads, overrides "threads" in the config
+        void SetThreadPolicy(const NodePtr& node, const utils::ThreadPolicy& policy)
+        {
+            m_threadPolicies[node.get()] = policy;
+        }
+
+        utils::ThreadPolicy ThreadPolicyOf(const NodePtr& node) const
+        {
+            auto it = m_threadPolicies.find(node.get());
+            if (it != m_threadPolicies.end())
+                return it->second;
+
+            const Json::Value& threads = m_config["threads"];
+            if (threads["nodes"].isMember(node->name()))
+                return utils::ThreadPolicy::from_json(threads["nodes"][node->name()]);
+            return utils::ThreadPolicy::from_json(threads["default"]);
+        }
+
+        /// @brief run the node on its own thread or on the scheduler whatever the scheduler mode
+        void SetPlacement(const NodePtr& node, NodePlacement placement)
+        {
+            m_placements[node.get()] = placement;
+        }
+
         NodePtr GetNode(int index)
         {
             if (index >= m_nodes.size())
@@ -179,11 +488,272 @@ namespace ax
             return output_stream;
         }
 
+    protected:
+        /// @brief preparation of the nodes, shared with the prepare threads
+        struct PrepareState
+        {
+            PrepareState(AX_Pipeline* p): owner(p) { }
+
+            std::mutex lock;
+            std::condition_variable cond;
+            AX_Pipeline* owner;         // null once stopped, late starts go through it
+            std::set<Node*> preparing;  // a prepare thread is running
+            std::set<Node*> ready;
+        };
+
+        /// @brief start a prepared node, called with the prepare lock held
+        int LaunchNode(const NodePtr& node)
+        {
+            node->SetRunning();
+            if (IsScheduled(node))
+                return m_scheduler->Add(node);
+
+            RunNode(node);
+            return AX_SUCCESS;
+        }
+
+        /// @brief run Prepare on its own thread until it succeeds or the pipeline stops
+        void PrepareNode(const NodePtr& node, int retry_min, int retry_max)
+        {
+            std::shared_ptr<PrepareState> prepare = m_prepare;
+            {
+                std::lock_guard<std::mutex> lg(prepare->lock);
+                if (prepare->ready.count(node.get()) || prepare->preparing.count(node.get()))
+                    return;
+                prepare->preparing.insert(node.get());
+            }
+
+            // threads created by Prepare, like the RTP receive thread, inherit the policy
+            utils::ThreadPolicy policy = ThreadPolicyOf(node);
+            std::thread t([node, prepare, retry_min, retry_max, policy]() {
+                utils::set_thread_name(node->name());
+                utils::apply_thread_policy(policy, node->name());
+                int delay = retry_min;
+                std::unique_lock<std::mutex> lk(prepare->lock, std::defer_lock);
+                while (true)
+                {
+                    int ret = node->Prepare();
+
+                    lk.lock();
+                    if (ret == AX_SUCCESS && prepare->owner)
+                    {
+                        prepare->ready.insert(node.get());
+                        if (prepare->owner->m_hasStart)
+                            prepare->owner->LaunchNode(node);
+                        break;
+                    }
+                    if (!prepare->owner)
+                        break;
+
+                    printf("[%s]: prepare failed ret=0x%x, retry in %d ms\n", node->name(), ret, delay);
+                    prepare->cond.wait_for(lk, std::chrono::milliseconds(delay), [&]() { return !prepare->owner; });
+                    if (!prepare->owner)
+                        break;
+                    lk.unlock();
+                    delay = std::min(delay * 2, retry_max);
+                }
+
+                prepare->preparing.erase(node.get());
+                lk.unlock();
+                prepare->cond.notify_all();
+            });
+
+            std::lock_guard<std::mutex> lg(m_threadLock);
+            m_prepareThreads.emplace_back(node, std::move(t));
+        }
+
+        /// @brief join the prepare threads, detach those stuck in Prepare at the deadline
+        void JoinPrepares(std::chrono::steady_clock::time_point deadline)
+        {
+            std::shared_ptr<PrepareState> prepare = m_prepare;
+            std::set<Node*> stuck;
+            {
+                std::unique_lock<std::mutex> lk(prepare->lock);
+                prepare->cond.wait_until(lk, deadline, [&]() { return prepare->preparing.empty(); });
+                stuck = prepare->preparing;
+            }
+
+            std::lock_guard<std::mutex> lg(m_threadLock);
+            for (auto& t : m_prepareThreads)
+            {
+                if (stuck.count(t.first.get()))
+                {
+                    printf("[%s]: still preparing after stop, detached\n", t.first->name());
+                    t.second.detach();
+                }
+                else
+                {
+                    t.second.join();
+                }
+            }
+            m_prepareThreads.clear();
+        }
+
+        /// @brief exits of the node threads, outlives the pipeline for detached stragglers
+        struct ThreadExits
+        {
+            std::mutex lock;
+            std::condition_variable cond;
+            std::set<Node*> running;
+        };
+
+        bool IsScheduled(const NodePtr& node) const
+        {
+            return m_scheduled.count(node.get()) > 0;
+        }
+
+        void RunNode(const NodePtr& node)
+        {
+            std::shared_ptr<ThreadExits> exits = m_exits;
+            {
+                std::lock_guard<std::mutex> lg(exits->lock);
+                exits->running.insert(node.get());
+            }
+
+            utils::ThreadPolicy policy = ThreadPolicyOf(node);
+            std::thread t([node, exits, policy]() {
+                utils::set_thread_name(node->name());
+                utils::apply_thread_policy(policy, node->name());
+                node->Run();
+                {
+                    std::lock_guard<std::mutex> lg(exits->lock);
+                    exits->running.erase(node.get());
+                }
+                exits->cond.notify_all();
+            });
+
+            std::lock_guard<std::mutex> lg(m_threadLock);
+            m_threads.emplace_back(node, std::move(t));
+        }
+
+        /// @brief join the threads of nodes, detach those still running at the deadline
+        /// @return names of the detached nodes
+        std::vector<std::string> JoinNodes(const std::vector<NodePtr>& nodes, int timeout)
+        {
+            std::set<Node*> wanted;
+            for (const auto& node : nodes)
+                wanted.insert(node.get());
+
+            auto all_exited = [&]() {
+                for (Node* n : wanted)
+                {
+                    if (m_exits->running.count(n))
+                        return false;
+                }
+                return true;
+            };
+
+            std::set<Node*> still_running;
+            {
+                std::unique_lock<std::mutex> lk(m_exits->lock);
+                m_exits->cond.wait_for(lk, std::chrono::milliseconds(timeout), all_exited);
+                for (Node* n : wanted)
+                {
+                    if (m_exits->running.count(n))
+                        still_running.insert(n);
+                }
+            }
+
+            std::vector<std::string> stragglers;
+            std::lock_guard<std::mutex> lg(m_threadLock);
+            for (auto it = m_threads.begin(); it != m_threads.end();)
+            {
+                Node* n = it->first.get();
+                if (!wanted.count(n))
+                {
+                    ++it;
+                    continue;
+                }
+
+                if (still_running.count(n))
+                {
+                    printf("[%s]: still running %d ms after stop, detached\n", n->name(), timeout);
+                    stragglers.push_back(n->name());
+                    it->second.detach();
+                }
+                else
+                {
+                    it->second.join();
+                }
+                it = m_threads.erase(it);
+            }
+            return stragglers;
+        }
+
+        void CloseInputStreams(const NodePtr& node)
+        {
+            for (int i = 0; i < node->GetInputPortNum(); i++)
+            {
+                auto s = node->GetInputPort(i)->stream();
+                if (s)
+                    s->close();
+            }
+        }
+
+        void CloseStreams(const NodePtr& node)
+        {
+            CloseInputStreams(node);
+            for (int i = 0; i < node->GetOutputPortNum(); i++)
+            {
+                for (const auto& s : node->GetOutputPort(i)->streams())
+                    s->close();
+            }
+        }
+
+        /// @brief publish the metrics of the node and its input streams, name them for traces
+        void Instrument(const NodePtr& node)
+        {
+            MetricsRegistry& registry = MetricsRegistry::Instance();
+            Tracer& tracer = Tracer::Instance();
+            registry.AddNode(node->name(), node->metrics());
+            node->SetTraceId(tracer.Id(node->name()));
+            for (int i = 0; i < node->GetInputPortNum(); i++)
+            {
+                auto stream = node->GetInputPort(i)->stream();
+                if (!stream)
+                    continue;
+                std::string name = std::string(node->name()) + "." + node->GetInputPort(i)->name();
+                registry.AddStream(name, stream->metrics());
+                stream->set_trace_id(tracer.Id(name));
+            }
+        }
+
+        /// @brief reopen and empty the streams of a node
+        /// @param outputs  also the streams it feeds, otherwise only its inputs
+        void ReopenStreams(const NodePtr& node, bool outputs = true)
+        {
+            for (int i = 0; i < node->GetInputPortNum(); i++)
+            {
+                auto s = node->GetInputPort(i)->stream();
+                if (s)
+                    s->reopen(true);
+            }
+            if (!outputs)
+                return;
+            for (int i = 0; i < node->GetOutputPortNum(); i++)
+            {
+                for (const auto& s : node->GetOutputPort(i)->streams())
+                    s->reopen(true);
+            }
+        }
+
     protected:
         Json::Value m_config;
         std::vector<NodePtr> m_nodes;
         bool m_hasInit;
         bool m_hasStart;
         std::shared_ptr<Stream> m_input_stream;
+        std::unique_ptr<Scheduler> m_scheduler;
+        std::unique_ptr<MetricsServer> m_metricsServer;
+        std::set<Node*> m_scheduled;
+        std::map<Node*, Json::Value> m_nodeConfigs;
+        std::map<Node*, NodePlacement> m_placements;
+        std::map<Node*, utils::ThreadPolicy> m_threadPolicies;
+        std::shared_ptr<ThreadExits> m_exits = std::make_shared<ThreadExits>();
+        std::shared_ptr<PrepareState> m_prepare = std::make_shared<PrepareState>(this);
+        std::mutex m_threadLock;    // m_threads and m_prepareThreads, late starts come from prepare threads
+        std::vector<std::pair<NodePtr, std::thread>> m_threads;
+        std::vector<std::pair<NodePtr, std::thread>> m_prepareThreads;
+        std::vector<std::string> m_stragglers;
     };
 }
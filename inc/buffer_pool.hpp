@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ax
+{
+    /// @brief Fixed number of equally sized, aligned buffers, allocated once.
+    /// @details Get hands out a shared_ptr that puts the buffer back when the
+    ///     last packet holding it is gone, so frames travel the pipeline
+    ///     without per frame allocations of the pixel data. Buffers may
+    ///     outlive the pool object.
+    class BufferPool
+    {
+    public:
+        BufferPool(size_t size, int count, size_t align = 64):
+            m_state(std::make_shared<State>())
+        {
+            m_state->size = size;
+            size_t aligned = (size + align - 1) / align * align;
+            for (int i = 0; i < count; i++)
+            {
+                void* ptr = nullptr;
+                if (posix_memalign(&ptr, align, aligned ? aligned : align) != 0)
+                    break;
+                m_state->all.push_back((uint8_t*)ptr);
+                m_state->free.push_back((uint8_t*)ptr);
+            }
+        }
+
+        /// @brief take a free buffer
+        /// @param timeout milliseconds to wait for one, 0 to return at once, -1 to wait for ever
+        /// @return nullptr when none became free
+        std::shared_ptr<uint8_t> Get(int timeout = 0)
+        {
+            std::shared_ptr<State> state = m_state;
+            std::unique_lock<std::mutex> lk(state->lock);
+            auto has_free = [&state] { return !state->free.empty(); };
+            if (timeout < 0)
+                state->cond.wait(lk, has_free);
+            else if (timeout > 0)
+                state->cond.wait_for(lk, std::chrono::milliseconds(timeout), has_free);
+            if (state->free.empty())
+                return nullptr;
+
+            uint8_t* ptr = state->free.back();
+            state->free.pop_back();
+            return std::shared_ptr<uint8_t>(ptr, [state](uint8_t* p) {
+                {
+                    std::lock_guard<std::mutex> lg(state->lock);
+                    state->free.push_back(p);
+                }
+                state->cond.notify_one();
+            });
+        }
+
+        size_t size() const { return m_state->size; }
+
+        int count() const { return m_state->all.size(); }
+
+        int available() const
+        {
+            std::lock_guard<std::mutex> lg(m_state->lock);
+            return m_state->free.size();
+        }
+
+    private:
+        struct State
+        {
+            size_t size;
+            std::mutex lock;
+            std::condition_variable cond;
+            std::vector<uint8_t*> all;
+            std::vector<uint8_t*> free;
+
+            ~State()
+            {
+                for (uint8_t* p : all)
+                    ::free(p);
+            }
+        };
+
+        std::shared_ptr<State> m_state;
+    };
+}
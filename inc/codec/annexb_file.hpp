@@ -0,0 +1,271 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "err.hpp"
+#include "codec/bitstream_queue.hpp"
+
+namespace ax
+{
+    /// @brief first 00 00 01 at or after p, end if there is none
+    /// @details memchr finds the 01 byte with the libc's vector loop, so long
+    ///     runs of slice data are skipped a word at a time
+    inline const uint8_t* find_start_code(const uint8_t* p, const uint8_t* end)
+    {
+        const uint8_t* q = p + 2;
+        while (q < end)
+        {
+            q = (const uint8_t*)memchr(q, 1, end - q);
+            if (!q)
+                return end;
+            if (q[-1] == 0 && q[-2] == 0)
+                return q - 2;
+            // the next start code needs two zeros after this 01
+            q += 3;
+        }
+        return end;
+    }
+
+    /// @brief whether the NAL starting with header byte nal begins a new access
+    ///     unit after slices were seen: AUD, parameter sets, SEI, or the first
+    ///     slice of a picture
+    /// @param nal NAL header, the slice header after it tells the first slice of a picture
+    /// @param is_vcl set when the NAL is a slice
+    inline bool starts_access_unit(const uint8_t* nal, const uint8_t* end, int codec, bool* is_vcl)
+    {
+        if (codec == VIDEO_CODEC_H265)
+        {
+            int type = (nal[0] >> 1) & 0x3f;
+            *is_vcl = type < 32;
+            if (*is_vcl)
+                return nal + 2 < end && (nal[2] & 0x80);
+            return (type >= 32 && type <= 35) || type == 39 || (type >= 41 && type <= 44) || (type >= 48 && type <= 55);
+        }
+
+        int type = nal[0] & 0x1f;
+        *is_vcl = type >= 1 && type <= 5;
+        if (*is_vcl)
+            return nal + 1 < end && (nal[1] & 0x80);   // first_mb_in_slice == 0
+        return type == 6 || type == 7 || type == 8 || type == 9 || (type >= 14 && type <= 18);
+    }
+
+    /// @brief Memory mapped H.264/H.265 elementary stream split into access units.
+    /// @details Each unit keeps its start codes and parameter sets stay with
+    ///     the IDR that follows them, the way RTSPClient delivers frames, so
+    ///     a unit can go straight to VideoDecoder::SendStream.
+    class AnnexBFile
+    {
+    public:
+        AnnexBFile():
+            m_data(nullptr),
+            m_size(0),
+            m_codec(VIDEO_CODEC_H264)
+        { }
+
+        ~AnnexBFile() { Close(); }
+
+        AnnexBFile(const AnnexBFile&) = delete;
+        AnnexBFile& operator=(const AnnexBFile&) = delete;
+
+        /// @param codec VIDEO_CODEC_*, -1 to tell by the extension (.265/.h265/.hevc)
+        int Open(const std::string& path, int codec = -1)
+        {
+            Close();
+
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                printf("open %s failed!\n", path.c_str());
+                return AX_ERR_INIT_FAIL;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size < 4)
+            {
+                printf("%s is empty!\n", path.c_str());
+                close(fd);
+                return AX_ERR_INIT_FAIL;
+            }
+
+            void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (data == MAP_FAILED)
+            {
+                printf("mmap %s failed!\n", path.c_str());
+                return AX_ERR_INIT_FAIL;
+            }
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            m_data = (const uint8_t*)data;
+            m_size = st.st_size;
+
+            if (codec < 0)
+            {
+                size_t dot = path.rfind('.');
+                std::string ext = dot == std::string::npos ? "" : path.substr(dot + 1);
+                codec = (ext == "265" || ext == "h265" || ext == "hevc") ? VIDEO_CODEC_H265 : VIDEO_CODEC_H264;
+            }
+            m_codec = codec;
+
+            Index();
+            if (m_units.empty())
+            {
+                printf("no access unit in %s!\n", path.c_str());
+                Close();
+                return AX_ERR_INIT_FAIL;
+            }
+            return AX_SUCCESS;
+        }
+
+        void Close()
+        {
+            if (m_data)
+                munmap((void*)m_data, m_size);
+            m_data = nullptr;
+            m_size = 0;
+            m_units.clear();
+        }
+
+        int Codec() const { return m_codec; }
+
+        size_t Count() const { return m_units.size(); }
+
+        const uint8_t* Data(size_t i) const { return m_data + m_units[i].offset; }
+
+        int Size(size_t i) const { return m_units[i].size; }
+
+        bool Key(size_t i) const { return m_units[i].key; }
+
+    private:
+        struct Unit
+        {
+            size_t offset;
+            int size;
+            bool key;
+        };
+
+        void AddUnit(const uint8_t* begin, const uint8_t* end)
+        {
+            Unit unit;
+            unit.offset = begin - m_data;
+            unit.size = end - begin;
+            unit.key = is_key_frame(begin, unit.size, m_codec);
+            m_units.push_back(unit);
+        }
+
+        /// @brief one pass over the mapping, a unit ends where the next one's first NAL starts
+        void Index()
+        {
+            const uint8_t* end = m_data + m_size;
+            const uint8_t* au_begin = nullptr;
+            bool seen_vcl = false;
+
+            const uint8_t* sc = find_start_code(m_data, end);
+            while (sc < end)
+            {
+                const uint8_t* nal = sc + 3;
+                // 4字节起始码的前导0归本单元
+                const uint8_t* nal_begin = (sc > m_data && sc[-1] == 0) ? sc - 1 : sc;
+                if (nal >= end)
+                    break;
+
+                bool is_vcl = false;
+                bool starts = starts_access_unit(nal, end, m_codec, &is_vcl);
+                if (au_begin && seen_vcl && starts)
+                {
+                    AddUnit(au_begin, nal_begin);
+                    au_begin = nullptr;
+                    seen_vcl = false;
+                }
+                if (!au_begin)
+                    au_begin = nal_begin;
+                seen_vcl |= is_vcl;
+
+                sc = find_start_code(nal, end);
+            }
+            if (au_begin && seen_vcl)
+                AddUnit(au_begin, end);
+        }
+
+    private:
+        const uint8_t* m_data;
+        size_t m_size;
+        int m_codec;
+        std::vector<Unit> m_units;
+    };
+
+    /// @brief Walks an AnnexBFile at a frame rate, scaled by rate, optionally looping.
+    /// @details pts is a 90 kHz clock like RTP video timestamps and keeps
+    ///     increasing across loops.
+    class AnnexBPlayer
+    {
+    public:
+        /// @param rate 1 for real time, 4 for 4x, 0 for as fast as possible
+        AnnexBPlayer(const AnnexBFile& file, double fps = 25, double rate = 1, bool loop = false):
+            m_file(file),
+            m_fps(fps > 0 ? fps : 25),
+            m_rate(rate),
+            m_loop(loop),
+            m_index(0),
+            m_frames(0)
+        { }
+
+        /// @brief back to the first unit, pacing restarts from now
+        void Rewind()
+        {
+            m_index = 0;
+            m_frames = 0;
+        }
+
+        /// @brief next access unit, sleeping until it is due
+        /// @param key set to whether the unit is a decoder restart point
+        /// @return AX_ERR_CLOSED after the last unit when not looping
+        int Next(const uint8_t*& buf, int& len, uint64_t& pts, bool* key = nullptr)
+        {
+            if (m_index >= m_file.Count())
+            {
+                if (!m_loop)
+                    return AX_ERR_CLOSED;
+                m_index = 0;
+            }
+
+            if (m_frames == 0)
+                m_start = std::chrono::steady_clock::now();
+            else if (m_rate > 0)
+            {
+                auto due = m_start + std::chrono::microseconds((int64_t)(m_frames * 1e6 / (m_fps * m_rate)));
+                std::this_thread::sleep_until(due);
+            }
+
+            buf = m_file.Data(m_index);
+            len = m_file.Size(m_index);
+            pts = (uint64_t)(m_frames * 90000 / m_fps);
+            if (key)
+                *key = m_file.Key(m_index);
+            m_index++;
+            m_frames++;
+            return AX_SUCCESS;
+        }
+
+        uint64_t Frames() const { return m_frames; }
+
+    private:
+        const AnnexBFile& m_file;
+        double m_fps;
+        double m_rate;
+        bool m_loop;
+        size_t m_index;
+        uint64_t m_frames;
+        std::chrono::steady_clock::time_point m_start;
+    };
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <string.h>
+#include <stdio.h>
+
+#include "codec/video_decoder.hpp"
+#include "codec/decoder_group_allocator.hpp"
+
+#include "ax_sys_api.h"
+#include "ax_vdec_api.h"
+
+// 16字节对齐
+#define ALIGN_16(x)     ((x + 15) / 16 * 16)
+
+#ifndef AX_VDEC_MAX_GRP_NUM
+#define AX_VDEC_MAX_GRP_NUM     16
+#endif
+
+namespace ax
+{
+    /// @brief VDEC group in non-link mode
+    class AXVideoDecoder : public VideoDecoder
+    {
+    public:
+        /// @param grp -1 to take any free group from the process-wide allocator
+        AXVideoDecoder(int grp = -1):
+            m_nRequestGrp(grp),
+            m_nVdecGrp(-1),
+            m_isOpen(false)
+        { }
+
+        ~AXVideoDecoder() { Close(); }
+
+        /// @brief VDEC groups of this process, AX_VDEC_Init/DeInit shared by all of them
+        static DecoderGroupAllocator& Groups()
+        {
+            static DecoderGroupAllocator allocator(AX_VDEC_MAX_GRP_NUM,
+                [] {
+                    // 初始化VDEC
+                    int ret = AX_VDEC_Init();
+                    if (ret != AX_SUCCESS)
+                        printf("AX_VDEC_Init failed! ret=0x%x\n", ret);
+                    return ret;
+                },
+                [] {
+                    // 关闭VDEC
+                    int ret = AX_VDEC_DeInit();
+                    if (ret != AX_SUCCESS)
+                        printf("AX_VDEC_Deinit failed! ret=0x%x\n", ret);
+                    return ret;
+                });
+            return allocator;
+        }
+
+        int Open(const VideoDecoderAttr& attr)
+        {
+            int ret = Groups().Acquire(m_nRequestGrp);
+            if (ret < 0)
+            {
+                printf("no free vdec group! ret=0x%x\n", ret);
+                return ret;
+            }
+            m_nVdecGrp = ret;
+
+            // 创建解码通道
+            AX_VDEC_GRP_ATTR_S stGrpAttr;
+            memset(&stGrpAttr, 0, sizeof(AX_VDEC_GRP_ATTR_S));
+            stGrpAttr.enType = attr.codec == VIDEO_CODEC_H265 ? PT_H265 : PT_H264;
+            stGrpAttr.enMode = VIDEO_MODE_STREAM;
+            stGrpAttr.enLinkMode = AX_NONLINK_MODE;
+            stGrpAttr.u32PicWidth = ALIGN_16(attr.width);
+            stGrpAttr.u32PicHeight = ALIGN_16(attr.height);
+            stGrpAttr.u32FrameHeight = attr.height;
+            stGrpAttr.u32StreamBufSize = attr.height * attr.width * 3 / 2;
+            stGrpAttr.u32FrameBufCnt = attr.frame_buf_cnt > 0 ? attr.frame_buf_cnt : 10;
+            stGrpAttr.s32DestroyTimeout = 0;
+            stGrpAttr.stVdecVideoAttr.eOutOrder = VIDEO_OUTPUT_ORDER_DISP;
+
+            ret = AX_VDEC_CreateGrp(m_nVdecGrp, &stGrpAttr);
+            if (ret != AX_SUCCESS)
+            {
+                printf("AX_VDEC_CreateGrp failed! ret=0x%x\n", ret);
+                Groups().Release(m_nVdecGrp);
+                m_nVdecGrp = -1;
+                return ret;
+            }
+
+            // 开始接收码流
+            ret = AX_VDEC_StartRecvStream(m_nVdecGrp);
+            if (ret != AX_SUCCESS)
+            {
+                printf("AX_VDEC_StartRecvStream failed! ret=0x%x\n", ret);
+                AX_VDEC_DestroyGrp(m_nVdecGrp);
+                Groups().Release(m_nVdecGrp);
+                m_nVdecGrp = -1;
+                return ret;
+            }
+
+            m_isOpen = true;
+            return AX_SUCCESS;
+        }
+
+        void Close()
+        {
+            if (!m_isOpen)
+                return;
+
+            int ret = AX_SUCCESS;
+
+            // 销毁解码通道
+            ret = AX_VDEC_DestroyGrp(m_nVdecGrp);
+            if (ret != AX_SUCCESS)
+            {
+                printf("AX_VDEC_DestroyGrp failed! ret=0x%x\n", ret);
+            }
+
+            // 最后一个解码通道释放时关闭VDEC
+            Groups().Release(m_nVdecGrp);
+            m_nVdecGrp = -1;
+            m_isOpen = false;
+        }
+
+        int Group() const { return m_nVdecGrp; }
+
+        int SendStream(const uint8_t* buf, int len, uint64_t pts, int timeout)
+        {
+            AX_VDEC_STREAM_S stream;
+            memset(&stream, 0, sizeof(AX_VDEC_STREAM_S));
+            stream.pu8Addr = (AX_U8*)buf;
+            stream.u32Len = len;
+            stream.u64PTS = pts;
+            int ret = AX_VDEC_SendStream(m_nVdecGrp, &stream, timeout);
+            if (ret == AX_ERR_VDEC_BUF_FULL)
+                return AX_ERR_TIMEOUT;
+            return ret;
+        }
+
+        int GetFrame(DecodedFrame& frame, int timeout)
+        {
+            AX_VIDEO_FRAME_INFO_S* pstFrameInfo = new AX_VIDEO_FRAME_INFO_S;
+            int ret = AX_VDEC_GetFrame(m_nVdecGrp, pstFrameInfo, timeout);
+            if (ret != AX_SUCCESS)
+            {
+                delete pstFrameInfo;
+                return ret;
+            }
+
+            const AX_VIDEO_FRAME_S& vf = pstFrameInfo->stVFrame;
+            frame.width = vf.u32Width;
+            frame.height = vf.u32Height;
+            frame.stride = vf.u32PicStride[0];
+            frame.size = vf.u32FrameSize;
+            frame.phy_addr = vf.u64PhyAddr[0];
+            frame.vir_addr = (void*)vf.u64VirAddr[0];
+            // VDEC按16行对齐分配, UV平面不一定紧跟在height行之后
+            frame.uv_stride = vf.u32PicStride[1];
+            frame.uv_phy_addr = vf.u64PhyAddr[1];
+            frame.uv_vir_addr = (void*)vf.u64VirAddr[1];
+            frame.pts = vf.u64PTS;
+            frame.priv = pstFrameInfo;
+            return AX_SUCCESS;
+        }
+
+        int ReleaseFrame(DecodedFrame& frame)
+        {
+            AX_VIDEO_FRAME_INFO_S* pstFrameInfo = (AX_VIDEO_FRAME_INFO_S*)frame.priv;
+            if (!pstFrameInfo)
+                return AX_ERR_NULL_PTR;
+
+            int ret = AX_VDEC_ReleaseFrame(m_nVdecGrp, pstFrameInfo);
+            delete pstFrameInfo;
+            frame.priv = nullptr;
+            return ret;
+        }
+
+    private:
+        int m_nRequestGrp;
+        int m_nVdecGrp;
+        bool m_isOpen;
+    };
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "err.hpp"
+#include "codec/video_decoder.hpp"
+
+namespace ax
+{
+    /// @brief return true if the Annex-B unit is a decoder restart point: an IDR/IRAP
+    ///     slice or parameter sets, which RTSP clients may deliver as separate units
+    inline bool is_key_frame(const uint8_t* buf, int len, int codec)
+    {
+        for (int i = 0; i + 3 < len; i++)
+        {
+            if (buf[i] != 0 || buf[i + 1] != 0 || buf[i + 2] != 1)
+                continue;
+
+            uint8_t nal = buf[i + 3];
+            if (codec == VIDEO_CODEC_H264)
+            {
+                int type = nal & 0x1f;
+                if (type == 5 || type == 7 || type == 8)
+                    return true;
+            }
+            else if (codec == VIDEO_CODEC_H265)
+            {
+                int type = (nal >> 1) & 0x3f;
+                if ((type >= 16 && type <= 21) || (type >= 32 && type <= 34))
+                    return true;
+            }
+            i += 2;
+        }
+        return false;
+    }
+
+    struct AccessUnit
+    {
+        std::vector<uint8_t> data;
+        uint64_t pts;
+        bool key;
+    };
+
+    /// @brief Bounded access unit queue between RTP receive and decoder submission.
+    /// @details push never blocks. When full, a key frame flushes the queue
+    ///     (everything before it is stale) and a non key frame is dropped
+    ///     together with the rest of its GOP.
+    class BitstreamQueue
+    {
+    public:
+        BitstreamQueue(int capacity = 32, int codec = VIDEO_CODEC_H264):
+            m_capacity(capacity),
+            m_codec(codec),
+            m_waitKey(true),
+            m_closed(false),
+            m_pushed(0),
+            m_dropped(0)
+        { }
+
+        int push(const uint8_t* buf, int len, uint64_t pts)
+        {
+            bool key = is_key_frame(buf, len, m_codec);
+
+            std::unique_lock<std::mutex> lk(m_lock);
+            if (m_closed)
+                return AX_ERR_NOT_INIT;
+
+            if (m_queue.size() >= (size_t)m_capacity)
+            {
+                if (!key)
+                {
+                    m_waitKey = true;
+                    m_dropped++;
+                    return AX_ERR_QUEUE_FULL;
+                }
+                m_dropped += m_queue.size();
+                for (auto& old : m_queue)
+                    recycle(old);
+                m_queue.clear();
+            }
+
+            // decoder can't start (or restart after a drop) on a P frame
+            if (m_waitKey && !key)
+            {
+                m_dropped++;
+                return AX_ERR_QUEUE_FULL;
+            }
+            m_waitKey = false;
+
+            AccessUnit au;
+            if (!m_free.empty())
+            {
+                au.data.swap(m_free.back());
+                m_free.pop_back();
+            }
+            au.data.assign(buf, buf + len);
+            au.pts = pts;
+            au.key = key;
+            m_queue.push_back(std::move(au));
+            m_pushed++;
+
+            lk.unlock();
+            m_cond.notify_one();
+            return AX_SUCCESS;
+        }
+
+        /// @brief take the oldest access unit, the previous buffer of au is reused
+        /// @param timeout milliseconds, AX_ERR_QUEUE_EMPTY on timeout or close
+        int pop(AccessUnit& au, int timeout)
+        {
+            std::unique_lock<std::mutex> lk(m_lock);
+            if (!m_cond.wait_for(lk, std::chrono::milliseconds(timeout), [this] { return !m_queue.empty() || m_closed; }))
+                return AX_ERR_QUEUE_EMPTY;
+            if (m_queue.empty())
+                return AX_ERR_QUEUE_EMPTY;
+
+            recycle(au);
+            au = std::move(m_queue.front());
+            m_queue.pop_front();
+            return AX_SUCCESS;
+        }
+
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                m_closed = true;
+            }
+            m_cond.notify_all();
+        }
+
+        void reopen()
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_closed = false;
+            m_waitKey = true;
+            m_queue.clear();
+        }
+
+        int size()
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            return m_queue.size();
+        }
+
+        int capacity() const { return m_capacity; }
+        uint64_t pushed() const { return m_pushed; }
+        uint64_t dropped() const { return m_dropped; }
+
+    private:
+        // keep buffers of consumed access units, called with m_lock held
+        void recycle(AccessUnit& au)
+        {
+            if (au.data.capacity() > 0 && m_free.size() < (size_t)m_capacity)
+            {
+                m_free.push_back(std::vector<uint8_t>());
+                m_free.back().swap(au.data);
+            }
+        }
+
+    private:
+        int m_capacity;
+        int m_codec;
+        bool m_waitKey;
+        bool m_closed;
+        std::atomic<uint64_t> m_pushed;
+        std::atomic<uint64_t> m_dropped;
+
+        std::mutex m_lock;
+        std::condition_variable m_cond;
+        std::deque<AccessUnit> m_queue;
+        std::vector<std::vector<uint8_t>> m_free;
+    };
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <atomic>
+#include <thread>
+
+#include "codec/bitstream_queue.hpp"
+#include "codec/video_decoder.hpp"
+
+namespace ax
+{
+    /// @brief Owns the thread that moves access units from a BitstreamQueue
+    ///     into a VideoDecoder, so the network thread only does a copy.
+    class DecoderFeeder
+    {
+    public:
+        DecoderFeeder(int queue_size = 32, int codec = VIDEO_CODEC_H264):
+            m_queue(queue_size, codec),
+            m_decoder(nullptr),
+            m_isRunning(false),
+            m_sent(0),
+            m_retries(0)
+        { }
+
+        ~DecoderFeeder() { Stop(); }
+
+        int Start(VideoDecoder* decoder)
+        {
+            if (!decoder)
+                return AX_ERR_NULL_PTR;
+            if (m_isRunning)
+                return AX_SUCCESS;
+
+            m_decoder = decoder;
+            m_queue.reopen();
+            m_isRunning = true;
+            m_thread = std::thread(&DecoderFeeder::Loop, this);
+            return AX_SUCCESS;
+        }
+
+        void Stop()
+        {
+            if (!m_isRunning)
+                return;
+
+            m_isRunning = false;
+            m_queue.close();
+            if (m_thread.joinable())
+                m_thread.join();
+        }
+
+        /// @brief called from the RTP callback, never blocks on the decoder
+        int Push(const uint8_t* buf, int len, uint64_t pts)
+        {
+            return m_queue.push(buf, len, pts);
+        }
+
+        BitstreamQueue& queue() { return m_queue; }
+        uint64_t sent() const { return m_sent; }
+        uint64_t retries() const { return m_retries; }
+
+    private:
+        void Loop()
+        {
+            AccessUnit au;
+            while (m_isRunning)
+            {
+                if (AX_SUCCESS != m_queue.pop(au, 100))
+                    continue;
+
+                // a busy decoder only delays this thread, the AU is retried
+                // until it is accepted; the queue absorbs the backlog
+                int ret = AX_ERR_TIMEOUT;
+                while (m_isRunning)
+                {
+                    ret = m_decoder->SendStream(au.data.data(), au.data.size(), au.pts, 100);
+                    if (ret != AX_ERR_TIMEOUT)
+                        break;
+                    m_retries++;
+                }
+
+                if (ret == AX_SUCCESS)
+                    m_sent++;
+                else if (m_isRunning)
+                    printf("decoder SendStream failed! ret=0x%x\n", ret);
+            }
+        }
+
+    private:
+        BitstreamQueue m_queue;
+        VideoDecoder* m_decoder;
+        std::atomic<bool> m_isRunning;
+        std::thread m_thread;
+        std::atomic<uint64_t> m_sent;
+        std::atomic<uint64_t> m_retries;
+    };
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "err.hpp"
+
+namespace ax
+{
+    /// @brief Hands out decoder group ids of one decoder backend and
+    ///     refcounts the backend's module init: the first holder runs
+    ///     init, the last release runs deinit.
+    class DecoderGroupAllocator
+    {
+    public:
+        typedef std::function<int()> ModuleFunc;
+
+        DecoderGroupAllocator(int max_groups, ModuleFunc init = nullptr, ModuleFunc deinit = nullptr):
+            m_used(max_groups, false),
+            m_holders(0),
+            m_init(init),
+            m_deinit(deinit)
+        { }
+
+        /// @brief reserve a group
+        /// @param grp -1 for any free group, otherwise that exact group
+        /// @return group id, AX_ERR_QUEUE_FULL if none is free, or the error of module init
+        int Acquire(int grp = -1)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            if (grp >= (int)m_used.size())
+                return AX_ERR_ILLEGAL_PARAM;
+
+            if (grp < 0)
+            {
+                for (size_t i = 0; i < m_used.size(); i++)
+                {
+                    if (!m_used[i])
+                    {
+                        grp = i;
+                        break;
+                    }
+                }
+                if (grp < 0)
+                    return AX_ERR_QUEUE_FULL;
+            }
+            else if (m_used[grp])
+            {
+                return AX_ERR_QUEUE_FULL;
+            }
+
+            if (m_holders == 0 && m_init)
+            {
+                int ret = m_init();
+                if (ret != AX_SUCCESS)
+                    return ret;
+            }
+
+            m_used[grp] = true;
+            m_holders++;
+            return grp;
+        }
+
+        void Release(int grp)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            if (grp < 0 || grp >= (int)m_used.size() || !m_used[grp])
+                return;
+
+            m_used[grp] = false;
+            if (--m_holders == 0 && m_deinit)
+                m_deinit();
+        }
+
+        int InUse()
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            return m_holders;
+        }
+
+        int MaxGroups() const { return m_used.size(); }
+
+    private:
+        std::mutex m_lock;
+        std::vector<bool> m_used;
+        int m_holders;
+        ModuleFunc m_init;
+        ModuleFunc m_deinit;
+    };
+}
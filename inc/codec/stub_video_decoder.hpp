@@ -0,0 +1,230 @@
+#pragma once
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "codec/video_decoder.hpp"
+#include "codec/decoder_group_allocator.hpp"
+
+namespace ax
+{
+    /// @brief Host decoder stand-in: every access unit becomes a grey NV12
+    ///     frame after a configurable latency. With a small frame pool it
+    ///     reports busy like VDEC when frames are not released. Groups come
+    ///     from an allocator with the same limit as VDEC, so channel
+    ///     allocation and the refcounted module init behave as on the board.
+    /// @details Also the base of HostVideoDecoder: the frame buffers, the
+    ///     queue of frames with the time they can be taken and the group
+    ///     live here, subclasses draw into a buffer by overriding Draw.
+    class StubVideoDecoder : public VideoDecoder
+    {
+    public:
+        StubVideoDecoder(int latency_ms = 0, int grp = -1):
+            m_latencyMs(latency_ms),
+            m_stallMs(0),
+            m_isOpen(false),
+            m_requestGrp(grp),
+            m_grp(-1)
+        { }
+
+        ~StubVideoDecoder() { StubVideoDecoder::Close(); }
+
+        /// @brief module init/deinit calls so far, stand-ins for AX_VDEC_Init/DeInit
+        struct ModuleCalls
+        {
+            std::atomic<int> inits;
+            std::atomic<int> deinits;
+        };
+
+        static ModuleCalls& Module()
+        {
+            static ModuleCalls calls = {{0}, {0}};
+            return calls;
+        }
+
+        static DecoderGroupAllocator& Groups()
+        {
+            static DecoderGroupAllocator allocator(16,
+                [] { Module().inits++; return (int)AX_SUCCESS; },
+                [] { Module().deinits++; return (int)AX_SUCCESS; });
+            return allocator;
+        }
+
+        /// @brief simulate a decoder hiccup, the next SendStream stalls for ms
+        void Stall(int ms)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_stallMs = ms;
+        }
+
+        int Open(const VideoDecoderAttr& attr)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            if (m_isOpen)
+                return AX_SUCCESS;
+
+            int grp = Groups().Acquire(m_requestGrp);
+            if (grp < 0)
+                return grp;
+            m_grp = grp;
+
+            m_attr = attr;
+            if (m_attr.frame_buf_cnt <= 0)
+                m_attr.frame_buf_cnt = 8;
+
+            m_stride = (attr.width + 15) / 16 * 16;
+            m_frameSize = m_stride * attr.height * 3 / 2;
+            m_buffers.assign(m_attr.frame_buf_cnt, std::vector<uint8_t>(m_frameSize, 128));
+            m_freeBuffers.clear();
+            for (int i = 0; i < m_attr.frame_buf_cnt; i++)
+                m_freeBuffers.push_back(i);
+            m_ready.clear();
+            m_stallMs = 0;
+            m_isOpen = true;
+            return AX_SUCCESS;
+        }
+
+        void Close()
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            if (!m_isOpen)
+                return;
+
+            Groups().Release(m_grp);
+            m_grp = -1;
+            m_isOpen = false;
+            m_cond.notify_all();
+        }
+
+        int Group() const { return m_grp; }
+
+        int SendStream(const uint8_t* buf, int len, uint64_t pts, int timeout)
+        {
+            if (!buf || len <= 0)
+                return AX_ERR_ILLEGAL_PARAM;
+
+            if (m_latencyMs > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(m_latencyMs));
+            return Decode(pts, timeout, 0);
+        }
+
+        int GetFrame(DecodedFrame& frame, int timeout)
+        {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout < 0 ? 0 : timeout);
+            std::unique_lock<std::mutex> lk(m_lock);
+            while (true)
+            {
+                if (!m_isOpen)
+                    return AX_ERR_NOT_INIT;
+
+                auto now = std::chrono::steady_clock::now();
+                if (!m_ready.empty() && m_ready.front().ready <= now)
+                    break;
+
+                // 等到最早一帧可取, 或者超时
+                auto until = m_ready.empty() ? deadline : std::min(deadline, m_ready.front().ready);
+                if (timeout < 0 && m_ready.empty())
+                    m_cond.wait(lk);
+                else if (timeout < 0)
+                    m_cond.wait_until(lk, m_ready.front().ready);
+                else if (now >= deadline)
+                    return AX_ERR_TIMEOUT;
+                else
+                    m_cond.wait_until(lk, until);
+            }
+
+            frame = m_ready.front().frame;
+            m_ready.pop_front();
+            return AX_SUCCESS;
+        }
+
+        int ReleaseFrame(DecodedFrame& frame)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_freeBuffers.push_back((int)(intptr_t)frame.priv);
+            m_cond.notify_all();
+            return AX_SUCCESS;
+        }
+
+    protected:
+        struct PendingFrame
+        {
+            DecodedFrame frame;
+            std::chrono::steady_clock::time_point ready;
+        };
+
+        /// @brief fill the picture of a buffer about to be queued, m_lock held
+        virtual void Draw(uint8_t* nv12) { (void)nv12; }
+
+        /// @brief one access unit to one frame, takeable ready_ms from now
+        /// @details a Stall set before is served first, blocking the caller
+        int Decode(uint64_t pts, int timeout, int ready_ms)
+        {
+            int stall;
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                stall = m_stallMs;
+                m_stallMs = 0;
+            }
+            if (stall > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(stall));
+
+            std::unique_lock<std::mutex> lk(m_lock);
+            auto has_buffer = [this] { return !m_freeBuffers.empty() || !m_isOpen; };
+            if (timeout < 0)
+                m_cond.wait(lk, has_buffer);
+            else if (!m_cond.wait_for(lk, std::chrono::milliseconds(timeout), has_buffer))
+                return AX_ERR_TIMEOUT;
+            if (!m_isOpen)
+                return AX_ERR_NOT_INIT;
+
+            Emit(pts, std::chrono::steady_clock::now() + std::chrono::milliseconds(ready_ms));
+            return AX_SUCCESS;
+        }
+
+        /// @brief draw a free buffer and queue it, m_lock held and a buffer free
+        void Emit(uint64_t pts, std::chrono::steady_clock::time_point ready)
+        {
+            int index = m_freeBuffers.front();
+            m_freeBuffers.pop_front();
+            Draw(m_buffers[index].data());
+
+            PendingFrame pending;
+            memset(&pending.frame, 0, sizeof(DecodedFrame));
+            pending.frame.width = m_attr.width;
+            pending.frame.height = m_attr.height;
+            pending.frame.stride = m_stride;
+            pending.frame.size = m_frameSize;
+            pending.frame.vir_addr = m_buffers[index].data();
+            pending.frame.pts = pts;
+            pending.frame.priv = (void*)(intptr_t)index;
+            pending.ready = ready;
+            m_ready.push_back(pending);
+            m_cond.notify_all();
+        }
+
+    protected:
+        int m_latencyMs;
+        int m_stallMs;
+        bool m_isOpen;
+        int m_requestGrp;
+        int m_grp;
+        VideoDecoderAttr m_attr;
+        int m_stride;
+        int m_frameSize;
+
+        std::mutex m_lock;
+        std::condition_variable m_cond;
+        std::vector<std::vector<uint8_t>> m_buffers;
+        std::deque<int> m_freeBuffers;
+        std::deque<PendingFrame> m_ready;
+    };
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "err.hpp"
+
+namespace ax
+{
+    enum VideoCodec
+    {
+        VIDEO_CODEC_H264 = 0,
+        VIDEO_CODEC_H265 = 1
+    };
+
+    struct VideoDecoderAttr
+    {
+        int codec;
+        int width;
+        int height;
+        int frame_buf_cnt;
+    };
+
+    /// @brief NV12 frame owned by the decoder until ReleaseFrame
+    struct DecodedFrame
+    {
+        int width;
+        int height;
+        int stride;
+        uint32_t size;
+        uint64_t phy_addr;
+        void* vir_addr;
+        uint64_t pts;
+        void* priv;
+        // UV平面, 为0时紧跟Y平面(stride * height)
+        int uv_stride;
+        uint64_t uv_phy_addr;
+        void* uv_vir_addr;
+    };
+
+    /// @brief Decoder backend used by pull nodes, hardware or stub
+    class VideoDecoder
+    {
+    public:
+        virtual ~VideoDecoder() {}
+
+        /// @brief reserve a decoder group and start it
+        virtual int Open(const VideoDecoderAttr& attr) = 0;
+
+        virtual void Close() = 0;
+
+        /// @brief submit one access unit (Annex-B)
+        /// @param timeout -1 for blocking, otherwise milliseconds, AX_ERR_TIMEOUT if decoder stays busy
+        virtual int SendStream(const uint8_t* buf, int len, uint64_t pts, int timeout) = 0;
+
+        virtual int GetFrame(DecodedFrame& frame, int timeout) = 0;
+
+        virtual int ReleaseFrame(DecodedFrame& frame) = 0;
+
+        /// @brief group held since Open, -1 when closed
+        virtual int Group() const = 0;
+    };
+}
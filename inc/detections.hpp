@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace ax
+{
+    /// @brief one object, box corners in frame pixels
+    struct Detection
+    {
+        float x0;
+        float y0;
+        float x1;
+        float y1;
+        float score;
+        int32_t label;
+        int32_t track;              // -1 until a tracker assigns one
+
+        float width() const { return x1 - x0; }
+        float height() const { return y1 - y0; }
+        float area() const { return (x1 - x0) * (y1 - y0); }
+    };
+
+    static_assert(sizeof(Detection) == 28, "Detection is recorded as is");
+
+    /// @brief objects found in one frame, by descending score
+    struct Detections
+    {
+        uint64_t pts;
+        std::vector<Detection> boxes;
+
+        Detections(): pts(0) { }
+
+        size_t size() const { return boxes.size(); }
+        bool empty() const { return boxes.empty(); }
+    };
+}
@@ -10,6 +10,8 @@ namespace ax
         AX_ERR_NULL_PTR    = -1000 - 3,
         AX_ERR_ILLEGAL_PARAM = -1000 - 4,
         AX_ERR_INIT_FAIL   = -1000 - 5,
-        AX_ERR_NOT_INIT    = -1000 - 6
+        AX_ERR_NOT_INIT    = -1000 - 6,
+        AX_ERR_TIMEOUT     = -1000 - 7,
+        AX_ERR_CLOSED      = -1000 - 8
     };
 }
\ No newline at end of file
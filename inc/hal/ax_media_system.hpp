@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string.h>
+#include <stdio.h>
+
+#include "hal/media_system.hpp"
+
+#include "ax_sys_api.h"
+
+#ifndef AX_MAX_COMM_POOLS
+#define AX_MAX_COMM_POOLS       16
+#endif
+
+namespace ax
+{
+    /// @brief AX_SYS and the CMM common pools
+    class AXMediaSystem : public MediaSystem
+    {
+    public:
+        int Init()
+        {
+            int ret = AX_SYS_Init();
+            if (ret != AX_SUCCESS)
+                printf("AX_SYS_Init failed! ret=0x%x\n", ret);
+            return ret;
+        }
+
+        int Deinit()
+        {
+            return AX_SYS_Deinit();
+        }
+
+        int InitPool(const std::vector<PoolConfig>& pools)
+        {
+            if (pools.empty() || pools.size() > AX_MAX_COMM_POOLS)
+                return AX_ERR_ILLEGAL_PARAM;
+
+            AX_POOL_FLOORPLAN_T pool_plan;
+            memset(&pool_plan, 0, sizeof(AX_POOL_FLOORPLAN_T));
+            for (size_t i = 0; i < pools.size(); i++)
+            {
+                pool_plan.CommPool[i].BlkSize = pools[i].blk_size;
+                pool_plan.CommPool[i].BlkCnt = pools[i].blk_cnt;
+            }
+
+            int ret = AX_POOL_SetConfig(&pool_plan);
+            if (ret != AX_SUCCESS)
+            {
+                printf("AX_POOL_SetConfig failed! ret=0x%x\n", ret);
+                return ret;
+            }
+
+            ret = AX_POOL_Init();
+            if (ret != AX_SUCCESS)
+                printf("AX_POOL_Init failed! ret=0x%x\n", ret);
+            return ret;
+        }
+
+        int ExitPool()
+        {
+            return AX_POOL_Exit();
+        }
+
+        int GetBlock(uint32_t size, PoolBlock& block)
+        {
+            AX_BLK blk = AX_POOL_GetBlock(AX_INVALID_POOLID, size, NULL);
+            if (blk == AX_INVALID_BLOCKID)
+                return AX_ERR_QUEUE_FULL;
+
+            block.handle = blk;
+            block.phy_addr = AX_POOL_Handle2PhysAddr(blk);
+            block.vir_addr = AX_POOL_GetBlockVirAddr(blk);
+            block.size = size;
+            return AX_SUCCESS;
+        }
+
+        int ReleaseBlock(PoolBlock& block)
+        {
+            int ret = AX_POOL_ReleaseBlock(block.handle);
+            block.vir_addr = nullptr;
+            return ret;
+        }
+    };
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <string.h>
+#include <stdio.h>
+
+#include "hal/video_encoder.hpp"
+#include "codec/decoder_group_allocator.hpp"
+
+#include "ax_sys_api.h"
+#include "ax_venc_api.h"
+
+#ifndef AX_VENC_MAX_CHN_NUM
+#define AX_VENC_MAX_CHN_NUM     16
+#endif
+
+namespace ax
+{
+    /// @brief VENC channel in non-link mode
+    class AXVideoEncoder : public VideoEncoder
+    {
+    public:
+        /// @param chn -1 to take any free channel from the process-wide allocator
+        AXVideoEncoder(int chn = -1):
+            m_nRequestChn(chn),
+            m_nVencChn(-1),
+            m_isOpen(false)
+        { }
+
+        ~AXVideoEncoder() { Close(); }
+
+        /// @brief VENC channels of this process, AX_VENC_Init/Deinit shared by all of them
+        static DecoderGroupAllocator& Channels()
+        {
+            static DecoderGroupAllocator allocator(AX_VENC_MAX_CHN_NUM,
+                [] {
+                    // 初始化VENC
+                    AX_VENC_MOD_ATTR_S vencAttr;
+                    memset(&vencAttr, 0, sizeof(AX_VENC_MOD_ATTR_S));
+                    vencAttr.enVencType = VENC_VIDEO_ENCODER;
+                    int ret = AX_VENC_Init(&vencAttr);
+                    if (ret != AX_SUCCESS)
+                        printf("AX_VENC_Init failed! ret=0x%x\n", ret);
+                    return ret;
+                },
+                [] {
+                    // 关闭VENC
+                    int ret = AX_VENC_Deinit();
+                    if (ret != AX_SUCCESS)
+                        printf("AX_VENC_Deinit failed! ret=0x%x\n", ret);
+                    return ret;
+                });
+            return allocator;
+        }
+
+        static void SetChnAttr(const VideoEncoderAttr& attr, AX_VENC_CHN_ATTR_S& stVencChnAttr)
+        {
+            memset(&stVencChnAttr, 0, sizeof(AX_VENC_CHN_ATTR_S));
+
+            stVencChnAttr.stVencAttr.u32MaxPicWidth = 0;
+            stVencChnAttr.stVencAttr.u32MaxPicHeight = 0;
+
+            stVencChnAttr.stVencAttr.u32PicWidthSrc = attr.width;   /*the picture width*/
+            stVencChnAttr.stVencAttr.u32PicHeightSrc = attr.height; /*the picture height*/
+
+            stVencChnAttr.stVencAttr.u32CropOffsetX = 0;
+            stVencChnAttr.stVencAttr.u32CropOffsetY = 0;
+            stVencChnAttr.stVencAttr.u32CropWidth = 0;
+            stVencChnAttr.stVencAttr.u32CropHeight = 0;
+            stVencChnAttr.stVencAttr.u32VideoRange = 1; /* 0: Narrow Range(NR), Y[16,235], Cb/Cr[16,240]; 1: Full Range(FR), Y/Cb/Cr[0,255] */
+
+            stVencChnAttr.stVencAttr.u32BufSize = attr.width * attr.height * 3 / 2; /*stream buffer size*/
+            stVencChnAttr.stVencAttr.u32MbLinesPerSlice = 0;                         /*get stream mode is slice mode or frame mode?*/
+            stVencChnAttr.stVencAttr.enLinkMode = AX_NOLINK_MODE;
+            stVencChnAttr.stVencAttr.u32GdrDuration = 0;
+            /* GOP Setting */
+            stVencChnAttr.stGopAttr.enGopMode = VENC_GOPMODE_NORMALP;
+
+            stVencChnAttr.stRcAttr.s32FirstFrameStartQp = -1;
+            if (attr.codec == VIDEO_CODEC_H265)
+            {
+                stVencChnAttr.stVencAttr.enType = PT_H265;
+                stVencChnAttr.stVencAttr.enProfile = VENC_HEVC_MAIN_PROFILE;
+                stVencChnAttr.stVencAttr.enLevel = VENC_HEVC_LEVEL_6;
+
+                AX_VENC_H265_CBR_S stH265Cbr;
+                memset(&stH265Cbr, 0, sizeof(stH265Cbr));
+                stVencChnAttr.stRcAttr.enRcMode = VENC_RC_MODE_H265CBR;
+                stH265Cbr.u32Gop = attr.gop;
+                stH265Cbr.u32SrcFrameRate = attr.fps;  /* input frame rate */
+                stH265Cbr.fr32DstFrameRate = attr.fps; /* target frame rate */
+                stH265Cbr.u32BitRate = attr.bitrate_kbps;
+                stH265Cbr.u32MinQp = 10;
+                stH265Cbr.u32MaxQp = 51;
+                stH265Cbr.u32MinIQp = 10;
+                stH265Cbr.u32MaxIQp = 51;
+                stH265Cbr.s32IntraQpDelta = -2;
+                memcpy(&stVencChnAttr.stRcAttr.stH265Cbr, &stH265Cbr, sizeof(AX_VENC_H265_CBR_S));
+            }
+            else
+            {
+                stVencChnAttr.stVencAttr.enType = PT_H264;
+                stVencChnAttr.stVencAttr.enProfile = VENC_H264_MAIN_PROFILE;
+                stVencChnAttr.stVencAttr.enLevel = VENC_H264_LEVEL_5_2;
+
+                AX_VENC_H264_CBR_S stH264Cbr;
+                memset(&stH264Cbr, 0, sizeof(stH264Cbr));
+                stVencChnAttr.stRcAttr.enRcMode = VENC_RC_MODE_H264CBR;
+                stH264Cbr.u32Gop = attr.gop;
+                stH264Cbr.u32SrcFrameRate = attr.fps;  /* input frame rate */
+                stH264Cbr.fr32DstFrameRate = attr.fps; /* target frame rate */
+                stH264Cbr.u32BitRate = attr.bitrate_kbps;
+                stH264Cbr.u32MinQp = 10;
+                stH264Cbr.u32MaxQp = 51;
+                stH264Cbr.u32MinIQp = 10;
+                stH264Cbr.u32MaxIQp = 51;
+                stH264Cbr.s32IntraQpDelta = -2;
+                memcpy(&stVencChnAttr.stRcAttr.stH264Cbr, &stH264Cbr, sizeof(AX_VENC_H264_CBR_S));
+            }
+        }
+
+        int Open(const VideoEncoderAttr& attr)
+        {
+            if (m_isOpen)
+                return AX_SUCCESS;
+
+            int ret = Channels().Acquire(m_nRequestChn);
+            if (ret < 0)
+            {
+                printf("no free venc channel! ret=0x%x\n", ret);
+                return ret;
+            }
+            m_nVencChn = ret;
+            m_attr = attr;
+
+            // 创建编码通道
+            AX_VENC_CHN_ATTR_S stVencChnAttr;
+            SetChnAttr(attr, stVencChnAttr);
+            ret = AX_VENC_CreateChn(m_nVencChn, &stVencChnAttr);
+            if (ret != AX_SUCCESS)
+            {
+                printf("AX_VENC_CreateChn failed! ret=0x%x\n", ret);
+                Channels().Release(m_nVencChn);
+                m_nVencChn = -1;
+                return ret;
+            }
+
+            // 开始接收图像
+            AX_VENC_RECV_PIC_PARAM_S stRecvParam;
+            memset(&stRecvParam, 0, sizeof(AX_VENC_RECV_PIC_PARAM_S));
+            stRecvParam.s32RecvPicNum = -1;
+            ret = AX_VENC_StartRecvFrame(m_nVencChn, &stRecvParam);
+            if (ret != AX_SUCCESS)
+            {
+                printf("AX_VENC_StartRecvFrame failed! ret=0x%x\n", ret);
+                AX_VENC_DestroyChn(m_nVencChn);
+                Channels().Release(m_nVencChn);
+                m_nVencChn = -1;
+                return ret;
+            }
+
+            m_isOpen = true;
+            return AX_SUCCESS;
+        }
+
+        void Close()
+        {
+            if (!m_isOpen)
+                return;
+
+            int ret = AX_VENC_StopRecvFrame(m_nVencChn);
+            if (ret != AX_SUCCESS)
+                printf("AX_VENC_StopRecvFrame failed! ret=0x%x\n", ret);
+
+            // 销毁编码通道
+            ret = AX_VENC_DestroyChn(m_nVencChn);
+            if (ret != AX_SUCCESS)
+                printf("AX_VENC_DestroyChn failed! ret=0x%x\n", ret);
+
+            // 最后一个编码通道释放时关闭VENC
+            Channels().Release(m_nVencChn);
+            m_nVencChn = -1;
+            m_isOpen = false;
+        }
+
+        int Channel() const { return m_nVencChn; }
+
+        int SendFrame(const DecodedFrame& frame, int timeout)
+        {
+            AX_VIDEO_FRAME_INFO_S stFrameInfo;
+            memset(&stFrameInfo, 0, sizeof(AX_VIDEO_FRAME_INFO_S));
+            AX_VIDEO_FRAME_S& vf = stFrameInfo.stVFrame;
+            vf.u32Width = frame.width;
+            vf.u32Height = frame.height;
+            vf.enImgFormat = AX_YUV420_SEMIPLANAR;
+            vf.u32PicStride[0] = frame.stride;
+            vf.u32PicStride[1] = frame.uv_stride ? frame.uv_stride : frame.stride;
+            vf.u64PhyAddr[0] = frame.phy_addr;
+            vf.u64PhyAddr[1] = frame.uv_phy_addr ? frame.uv_phy_addr : frame.phy_addr + frame.stride * frame.height;
+            vf.u64VirAddr[0] = (AX_U64)(uintptr_t)frame.vir_addr;
+            vf.u64VirAddr[1] = frame.uv_vir_addr ? (AX_U64)(uintptr_t)frame.uv_vir_addr : vf.u64VirAddr[0] + frame.stride * frame.height;
+            vf.u32BlkId[0] = AX_POOL_PhysAddr2Handle(frame.phy_addr);
+            vf.u32FrameSize = frame.size;
+            vf.u64PTS = frame.pts;
+
+            return AX_VENC_SendFrame(m_nVencChn, &stFrameInfo, timeout);
+        }
+
+        int GetStream(EncodedPacket& packet, int timeout)
+        {
+            AX_VENC_STREAM_S* pstStream = new AX_VENC_STREAM_S;
+            memset(pstStream, 0, sizeof(AX_VENC_STREAM_S));
+            int ret = AX_VENC_GetStream(m_nVencChn, pstStream, timeout);
+            if (ret != AX_SUCCESS)
+            {
+                delete pstStream;
+                return ret;
+            }
+
+            packet.data = pstStream->stPack.pu8Addr;
+            packet.size = pstStream->stPack.u32Len;
+            packet.pts = pstStream->stPack.u64PTS;
+            packet.keyframe = pstStream->stPack.enCodingType == VENC_INTRA_FRAME;
+            packet.priv = pstStream;
+            return AX_SUCCESS;
+        }
+
+        int ReleaseStream(EncodedPacket& packet)
+        {
+            AX_VENC_STREAM_S* pstStream = (AX_VENC_STREAM_S*)packet.priv;
+            if (!pstStream)
+                return AX_ERR_NULL_PTR;
+
+            int ret = AX_VENC_ReleaseStream(m_nVencChn, pstStream);
+            delete pstStream;
+            packet.priv = nullptr;
+            return ret;
+        }
+
+    private:
+        int m_nRequestChn;
+        int m_nVencChn;
+        bool m_isOpen;
+        VideoEncoderAttr m_attr;
+    };
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "json/json.h"
+
+#include "hal/media_system.hpp"
+#include "hal/video_encoder.hpp"
+#include "codec/video_decoder.hpp"
+#include "codec/stub_video_decoder.hpp"
+
+// AX_HAL_HOST 由 toolchains/host.cmake 定义, 不依赖BSP
+#ifdef AX_HAL_HOST
+#include "hal/host_media_system.hpp"
+#include "hal/host_video_decoder.hpp"
+#include "hal/host_video_encoder.hpp"
+#else
+#include "hal/ax_media_system.hpp"
+#include "hal/ax_video_encoder.hpp"
+#include "codec/ax_video_decoder.hpp"
+#endif
+
+namespace ax
+{
+    /// @brief Entry points nodes and solutions use instead of the AX_* APIs.
+    /// @details The board build backs them with AX_SYS/AX_POOL, VDEC and VENC.
+    ///     Built with AX_HAL_HOST they run on the host: heap blocks for the
+    ///     CMM, a decoder making up NV12 frames and an encoder emitting canned
+    ///     access units, so nodes can be built, profiled and tested off-board.
+    namespace hal
+    {
+        /// @brief true when built against the host backends
+        inline bool IsHost()
+        {
+#ifdef AX_HAL_HOST
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        /// @brief the process-wide system and common pools
+        inline MediaSystem& System()
+        {
+#ifdef AX_HAL_HOST
+            static HostMediaSystem system;
+#else
+            static AXMediaSystem system;
+#endif
+            return system;
+        }
+
+        /// @brief decoder from a channel config
+        /// @details "decoder": "stub" gives the grey frame stub on any build,
+        ///     otherwise VDEC, or on the host a pattern generator paced by
+        ///     "host_fps" (0 for one frame per access unit) and "host_latency_ms"
+        /// @param grp decoder group, -1 for any free one
+        inline std::unique_ptr<VideoDecoder> CreateVideoDecoder(const Json::Value& config, int grp = -1)
+        {
+            if (config.get("decoder", "vdec").asString() == "stub")
+                return std::unique_ptr<VideoDecoder>(new StubVideoDecoder(config.get("stub_latency_ms", 0).asInt(), grp));
+
+#ifdef AX_HAL_HOST
+            return std::unique_ptr<VideoDecoder>(new HostVideoDecoder(config.get("host_fps", 25).asInt(),
+                config.get("host_latency_ms", 0).asInt(), grp));
+#else
+            return std::unique_ptr<VideoDecoder>(new AXVideoDecoder(grp));
+#endif
+        }
+
+        /// @brief encoder from a node config, on the host "host_latency_ms" delays every access unit
+        /// @param chn encoder channel, -1 for any free one
+        inline std::unique_ptr<VideoEncoder> CreateVideoEncoder(const Json::Value& config, int chn = -1)
+        {
+#ifdef AX_HAL_HOST
+            return std::unique_ptr<VideoEncoder>(new HostVideoEncoder(config.get("host_latency_ms", 0).asInt(), chn));
+#else
+            (void)config;
+            return std::unique_ptr<VideoEncoder>(new AXVideoEncoder(chn));
+#endif
+        }
+    }
+}
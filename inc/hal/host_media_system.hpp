@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "hal/media_system.hpp"
+
+namespace ax
+{
+    /// @brief Host stand-in for AX_SYS and the CMM: each common pool is a
+    ///     set of page aligned heap blocks with made-up, non-overlapping
+    ///     physical addresses. Blocks run out like on the board, so pool
+    ///     sizing mistakes show up off-board too.
+    class HostMediaSystem : public MediaSystem
+    {
+    public:
+        static const uint32_t BLOCK_ALIGN = 4096;
+        static const uint64_t PHY_BASE = 0x40000000ull;
+
+        HostMediaSystem():
+            m_isInit(false)
+        { }
+
+        ~HostMediaSystem() { ExitPool(); }
+
+        int Init()
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_isInit = true;
+            return AX_SUCCESS;
+        }
+
+        int Deinit()
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_isInit = false;
+            return AX_SUCCESS;
+        }
+
+        int InitPool(const std::vector<PoolConfig>& pools)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            if (!m_isInit)
+                return AX_ERR_NOT_INIT;
+            if (!m_pools.empty())
+                return AX_ERR_INIT_FAIL;
+
+            uint64_t phy_addr = PHY_BASE;
+            for (const auto& config : pools)
+            {
+                if (config.blk_size == 0 || config.blk_cnt == 0)
+                    continue;
+
+                Pool pool;
+                pool.blk_size = config.blk_size;
+                uint32_t aligned_size = (config.blk_size + BLOCK_ALIGN - 1) / BLOCK_ALIGN * BLOCK_ALIGN;
+                for (uint32_t i = 0; i < config.blk_cnt; i++)
+                {
+                    void* ptr = nullptr;
+                    if (posix_memalign(&ptr, BLOCK_ALIGN, aligned_size) != 0)
+                    {
+                        printf("host pool: out of memory for %u x %u bytes\n", config.blk_cnt, config.blk_size);
+                        m_pools.push_back(pool);
+                        FreePools();
+                        return AX_ERR_INIT_FAIL;
+                    }
+                    pool.vir_addrs.push_back(ptr);
+                    pool.phy_addrs.push_back(phy_addr);
+                    pool.free_blocks.push_back(i);
+                    phy_addr += aligned_size;
+                }
+                m_pools.push_back(pool);
+            }
+            return AX_SUCCESS;
+        }
+
+        int ExitPool()
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            FreePools();
+            return AX_SUCCESS;
+        }
+
+        int GetBlock(uint32_t size, PoolBlock& block)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            int best = -1;
+            for (size_t i = 0; i < m_pools.size(); i++)
+            {
+                const Pool& pool = m_pools[i];
+                if (pool.blk_size < size || pool.free_blocks.empty())
+                    continue;
+                if (best < 0 || pool.blk_size < m_pools[best].blk_size)
+                    best = i;
+            }
+            if (best < 0)
+                return AX_ERR_QUEUE_FULL;
+
+            Pool& pool = m_pools[best];
+            uint32_t index = pool.free_blocks.front();
+            pool.free_blocks.pop_front();
+
+            // 高16位为池号, 低16位为块号
+            block.handle = ((uint32_t)best << 16) | index;
+            block.phy_addr = pool.phy_addrs[index];
+            block.vir_addr = pool.vir_addrs[index];
+            block.size = size;
+            return AX_SUCCESS;
+        }
+
+        int ReleaseBlock(PoolBlock& block)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            uint32_t pool_id = block.handle >> 16;
+            uint32_t index = block.handle & 0xffff;
+            if (pool_id >= m_pools.size() || index >= m_pools[pool_id].vir_addrs.size())
+                return AX_ERR_ILLEGAL_PARAM;
+
+            m_pools[pool_id].free_blocks.push_back(index);
+            block.vir_addr = nullptr;
+            return AX_SUCCESS;
+        }
+
+    private:
+        struct Pool
+        {
+            uint32_t blk_size;
+            std::vector<void*> vir_addrs;
+            std::vector<uint64_t> phy_addrs;
+            std::deque<uint32_t> free_blocks;
+        };
+
+        void FreePools()
+        {
+            for (auto& pool : m_pools)
+            {
+                for (void* ptr : pool.vir_addrs)
+                    free(ptr);
+            }
+            m_pools.clear();
+        }
+
+    private:
+        std::mutex m_lock;
+        bool m_isInit;
+        std::vector<Pool> m_pools;
+    };
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+#include "codec/stub_video_decoder.hpp"
+
+namespace ax
+{
+    /// @brief Host stand-in for VDEC that makes up its own pictures.
+    /// @details With fps > 0 a generator thread emits a moving NV12 test
+    ///     pattern at that rate, whatever is sent in, so a pull node runs
+    ///     without a camera. With fps 0 every access unit becomes one frame.
+    ///     Either way a frame can be taken latency_ms after it was made.
+    ///     Frames come from frame_buf_cnt buffers: while none is released the
+    ///     generator skips ticks and SendStream times out, like VDEC. Buffers,
+    ///     groups and frame hand-out are StubVideoDecoder's.
+    class HostVideoDecoder : public StubVideoDecoder
+    {
+    public:
+        HostVideoDecoder(int fps = 25, int latency_ms = 0, int grp = -1):
+            StubVideoDecoder(latency_ms, grp),
+            m_fps(fps),
+            m_frameIndex(0),
+            m_skipped(0)
+        { }
+
+        ~HostVideoDecoder() { HostVideoDecoder::Close(); }
+
+        int Open(const VideoDecoderAttr& attr)
+        {
+            bool opened;
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                opened = m_isOpen;
+                m_frameIndex = 0;
+                m_skipped = 0;
+            }
+            int ret = StubVideoDecoder::Open(attr);
+            if (ret == AX_SUCCESS && !opened && m_fps > 0)
+                m_thread = std::thread(&HostVideoDecoder::Generate, this);
+            return ret;
+        }
+
+        void Close()
+        {
+            StubVideoDecoder::Close();
+            if (m_thread.joinable())
+                m_thread.join();
+        }
+
+        /// @brief generator ticks without a free buffer
+        uint64_t Skipped()
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            return m_skipped;
+        }
+
+        int SendStream(const uint8_t* buf, int len, uint64_t pts, int timeout)
+        {
+            if (!buf || len <= 0)
+                return AX_ERR_ILLEGAL_PARAM;
+
+            // 自产帧模式下丢弃码流
+            if (m_fps > 0)
+                return AX_SUCCESS;
+            return Decode(pts, timeout, m_latencyMs);
+        }
+
+    protected:
+        // 斜向渐变, 每帧平移, 下游能看出丢帧和乱序
+        void Draw(uint8_t* nv12)
+        {
+            uint32_t shift = m_frameIndex * 4;
+            for (int y = 0; y < m_attr.height; y++)
+            {
+                uint8_t* row = nv12 + y * m_stride;
+                for (int x = 0; x < m_attr.width; x++)
+                    row[x] = (uint8_t)(x + y + shift);
+            }
+            m_frameIndex++;
+        }
+
+    private:
+        void Generate()
+        {
+            auto period = std::chrono::microseconds(1000000 / m_fps);
+            auto next = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lk(m_lock);
+            while (m_isOpen)
+            {
+                next += period;
+                if (m_cond.wait_until(lk, next, [this] { return !m_isOpen; }))
+                    break;
+
+                if (m_freeBuffers.empty())
+                {
+                    m_skipped++;
+                    continue;
+                }
+                uint64_t pts = std::chrono::duration_cast<std::chrono::microseconds>(next.time_since_epoch()).count();
+                Emit(pts, next + std::chrono::milliseconds(m_latencyMs));
+            }
+        }
+
+    private:
+        int m_fps;
+        uint32_t m_frameIndex;
+        uint64_t m_skipped;
+        std::thread m_thread;
+    };
+}
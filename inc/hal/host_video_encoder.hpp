@@ -0,0 +1,239 @@
+#pragma once
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "hal/video_encoder.hpp"
+#include "codec/decoder_group_allocator.hpp"
+
+namespace ax
+{
+    /// @brief Host stand-in for VENC: every frame becomes a canned Annex-B
+    ///     access unit, parameter sets and an IDR slice every gop frames,
+    ///     a P slice otherwise, padded to the configured bitrate. The slice
+    ///     data is filler, not a picture, but start codes, NAL types and
+    ///     sizes match what the RTSP path sees from the board.
+    class HostVideoEncoder : public VideoEncoder
+    {
+    public:
+        static const int MAX_PENDING = 8;
+
+        HostVideoEncoder(int latency_ms = 0, int chn = -1):
+            m_latencyMs(latency_ms),
+            m_isOpen(false),
+            m_requestChn(chn),
+            m_chn(-1),
+            m_frameIndex(0)
+        { }
+
+        ~HostVideoEncoder() { Close(); }
+
+        static DecoderGroupAllocator& Channels()
+        {
+            static DecoderGroupAllocator allocator(16);
+            return allocator;
+        }
+
+        int Open(const VideoEncoderAttr& attr)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            if (m_isOpen)
+                return AX_SUCCESS;
+            if (attr.width <= 0 || attr.height <= 0)
+                return AX_ERR_ILLEGAL_PARAM;
+
+            int chn = Channels().Acquire(m_requestChn);
+            if (chn < 0)
+                return chn;
+            m_chn = chn;
+
+            m_attr = attr;
+            if (m_attr.fps <= 0)
+                m_attr.fps = 30;
+            if (m_attr.gop <= 0)
+                m_attr.gop = m_attr.fps;
+            if (m_attr.bitrate_kbps <= 0)
+                m_attr.bitrate_kbps = 2048;
+
+            m_buffers.assign(MAX_PENDING, std::vector<uint8_t>());
+            m_freeBuffers.clear();
+            for (int i = 0; i < MAX_PENDING; i++)
+                m_freeBuffers.push_back(i);
+            m_ready.clear();
+            m_frameIndex = 0;
+            m_isOpen = true;
+            return AX_SUCCESS;
+        }
+
+        void Close()
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            if (!m_isOpen)
+                return;
+
+            Channels().Release(m_chn);
+            m_chn = -1;
+            m_isOpen = false;
+            m_cond.notify_all();
+        }
+
+        int Channel() const { return m_chn; }
+
+        int SendFrame(const DecodedFrame& frame, int timeout)
+        {
+            if (!frame.vir_addr)
+                return AX_ERR_NULL_PTR;
+
+            std::unique_lock<std::mutex> lk(m_lock);
+            if (m_isOpen && (frame.width != m_attr.width || frame.height != m_attr.height))
+                return AX_ERR_ILLEGAL_PARAM;
+            auto has_buffer = [this] { return !m_freeBuffers.empty() || !m_isOpen; };
+            if (timeout < 0)
+                m_cond.wait(lk, has_buffer);
+            else if (!m_cond.wait_for(lk, std::chrono::milliseconds(timeout), has_buffer))
+                return AX_ERR_TIMEOUT;
+            if (!m_isOpen)
+                return AX_ERR_NOT_INIT;
+
+            int index = m_freeBuffers.front();
+            m_freeBuffers.pop_front();
+
+            bool keyframe = m_frameIndex % m_attr.gop == 0;
+            std::vector<uint8_t>& au = m_buffers[index];
+            BuildAccessUnit(au, keyframe);
+            m_frameIndex++;
+
+            PendingPacket pending;
+            pending.packet.data = au.data();
+            pending.packet.size = au.size();
+            pending.packet.pts = frame.pts;
+            pending.packet.keyframe = keyframe;
+            pending.packet.priv = (void*)(intptr_t)index;
+            pending.ready = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_latencyMs);
+            m_ready.push_back(pending);
+            m_cond.notify_all();
+            return AX_SUCCESS;
+        }
+
+        int GetStream(EncodedPacket& packet, int timeout)
+        {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout < 0 ? 0 : timeout);
+            std::unique_lock<std::mutex> lk(m_lock);
+            while (true)
+            {
+                if (!m_isOpen)
+                    return AX_ERR_NOT_INIT;
+
+                auto now = std::chrono::steady_clock::now();
+                if (!m_ready.empty() && m_ready.front().ready <= now)
+                    break;
+
+                auto until = m_ready.empty() ? deadline : std::min(deadline, m_ready.front().ready);
+                if (timeout < 0 && m_ready.empty())
+                    m_cond.wait(lk);
+                else if (timeout < 0)
+                    m_cond.wait_until(lk, m_ready.front().ready);
+                else if (now >= deadline)
+                    return AX_ERR_TIMEOUT;
+                else
+                    m_cond.wait_until(lk, until);
+            }
+
+            packet = m_ready.front().packet;
+            m_ready.pop_front();
+            return AX_SUCCESS;
+        }
+
+        int ReleaseStream(EncodedPacket& packet)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_freeBuffers.push_back((int)(intptr_t)packet.priv);
+            packet.priv = nullptr;
+            m_cond.notify_all();
+            return AX_SUCCESS;
+        }
+
+    private:
+        struct PendingPacket
+        {
+            EncodedPacket packet;
+            std::chrono::steady_clock::time_point ready;
+        };
+
+        static void Append(std::vector<uint8_t>& au, const uint8_t* nal, size_t len)
+        {
+            static const uint8_t start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+            au.insert(au.end(), start_code, start_code + sizeof(start_code));
+            au.insert(au.end(), nal, nal + len);
+        }
+
+        /// @brief parameter sets and slice header of the codec, then filler up to the frame budget
+        void BuildAccessUnit(std::vector<uint8_t>& au, bool keyframe)
+        {
+            // 1080p main profile的参数集, 只保证NAL类型正确
+            static const uint8_t h264_sps[] = { 0x67, 0x4d, 0x40, 0x28, 0x95, 0xa0, 0x1e, 0x00, 0x89, 0xf9, 0x61, 0x00, 0x00, 0x03, 0x00, 0x01, 0x00, 0x00, 0x03, 0x00, 0x32, 0x84 };
+            static const uint8_t h264_pps[] = { 0x68, 0xee, 0x3c, 0x80 };
+            static const uint8_t h264_idr[] = { 0x65, 0x88, 0x84, 0x00 };
+            static const uint8_t h264_p[] = { 0x41, 0x9a, 0x02, 0x04 };
+            static const uint8_t h265_vps[] = { 0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5d, 0x95, 0x98, 0x09 };
+            static const uint8_t h265_sps[] = { 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5d, 0xa0, 0x02, 0x80, 0x80, 0x2d, 0x16, 0x59, 0x59, 0xa4, 0x93, 0x2b, 0xc0, 0x5a, 0x70, 0x80 };
+            static const uint8_t h265_pps[] = { 0x44, 0x01, 0xc1, 0x72, 0xb4, 0x62, 0x40 };
+            static const uint8_t h265_idr[] = { 0x26, 0x01, 0xaf, 0x08 };
+            static const uint8_t h265_p[] = { 0x02, 0x01, 0xd0, 0x08 };
+
+            au.clear();
+            bool h265 = m_attr.codec == VIDEO_CODEC_H265;
+            if (keyframe && h265)
+            {
+                Append(au, h265_vps, sizeof(h265_vps));
+                Append(au, h265_sps, sizeof(h265_sps));
+                Append(au, h265_pps, sizeof(h265_pps));
+                Append(au, h265_idr, sizeof(h265_idr));
+            }
+            else if (keyframe)
+            {
+                Append(au, h264_sps, sizeof(h264_sps));
+                Append(au, h264_pps, sizeof(h264_pps));
+                Append(au, h264_idr, sizeof(h264_idr));
+            }
+            else if (h265)
+            {
+                Append(au, h265_p, sizeof(h265_p));
+            }
+            else
+            {
+                Append(au, h264_p, sizeof(h264_p));
+            }
+
+            // 码率预算, I帧按4倍P帧计, 填充字节不含0以免出现起始码
+            size_t budget = (size_t)m_attr.bitrate_kbps * 1000 / 8 / m_attr.fps;
+            if (keyframe)
+                budget *= 4;
+            budget = std::max(budget, au.size() + 16);
+            size_t offset = au.size();
+            au.resize(budget);
+            for (size_t i = offset; i < budget; i++)
+                au[i] = (uint8_t)((i * 31 + m_frameIndex) | 0x01);
+        }
+
+    private:
+        int m_latencyMs;
+        bool m_isOpen;
+        int m_requestChn;
+        int m_chn;
+        VideoEncoderAttr m_attr;
+        uint32_t m_frameIndex;
+
+        std::mutex m_lock;
+        std::condition_variable m_cond;
+        std::vector<std::vector<uint8_t>> m_buffers;
+        std::deque<int> m_freeBuffers;
+        std::deque<PendingPacket> m_ready;
+    };
+}
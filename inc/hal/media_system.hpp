@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "err.hpp"
+
+namespace ax
+{
+    /// @brief one common pool, blk_cnt blocks of blk_size bytes
+    struct PoolConfig
+    {
+        uint32_t blk_size;
+        uint32_t blk_cnt;
+    };
+
+    /// @brief block taken from a common pool, held until ReleaseBlock
+    struct PoolBlock
+    {
+        uint32_t handle;
+        uint64_t phy_addr;
+        void* vir_addr;
+        uint32_t size;
+    };
+
+    /// @brief System and media memory of the platform, hardware or host
+    class MediaSystem
+    {
+    public:
+        virtual ~MediaSystem() {}
+
+        virtual int Init() = 0;
+
+        virtual int Deinit() = 0;
+
+        /// @brief set up the common pools, before any module takes frames from them
+        virtual int InitPool(const std::vector<PoolConfig>& pools) = 0;
+
+        /// @brief free the common pools, only after every module using them is closed
+        virtual int ExitPool() = 0;
+
+        /// @brief take a block of at least size bytes from the smallest fitting pool
+        /// @return AX_ERR_QUEUE_FULL when every fitting block is in use
+        virtual int GetBlock(uint32_t size, PoolBlock& block) = 0;
+
+        virtual int ReleaseBlock(PoolBlock& block) = 0;
+    };
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "err.hpp"
+#include "codec/video_decoder.hpp"
+
+namespace ax
+{
+    struct VideoEncoderAttr
+    {
+        int codec;
+        int width;
+        int height;
+        int fps;
+        int bitrate_kbps;
+        int gop;
+    };
+
+    /// @brief one Annex-B access unit owned by the encoder until ReleaseStream
+    struct EncodedPacket
+    {
+        const uint8_t* data;
+        uint32_t size;
+        uint64_t pts;
+        bool keyframe;
+        void* priv;
+    };
+
+    /// @brief Encoder backend used by push nodes, hardware or host
+    class VideoEncoder
+    {
+    public:
+        virtual ~VideoEncoder() {}
+
+        /// @brief reserve an encoder channel and start it
+        virtual int Open(const VideoEncoderAttr& attr) = 0;
+
+        virtual void Close() = 0;
+
+        /// @brief submit one NV12 frame, on the board phy_addr must point into a common pool block
+        /// @param timeout -1 for blocking, otherwise milliseconds, AX_ERR_TIMEOUT if encoder stays busy
+        virtual int SendFrame(const DecodedFrame& frame, int timeout) = 0;
+
+        virtual int GetStream(EncodedPacket& packet, int timeout) = 0;
+
+        virtual int ReleaseStream(EncodedPacket& packet) = 0;
+
+        /// @brief channel held since Open, -1 when closed
+        virtual int Channel() const = 0;
+    };
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ax
+{
+    /// @brief Splits an image into row bands and runs them on a few resident threads.
+    /// @details The calling thread works on bands too, so BandPool(1) starts
+    ///     no thread and runs everything inline. Threads are started once,
+    ///     a Run costs two wake ups instead of thread creation. Runs from
+    ///     several threads are serialised.
+    class BandPool
+    {
+    public:
+        /// @param threads threads working on a Run, the caller included
+        explicit BandPool(int threads = 1):
+            m_threads(std::max(threads, 1)),
+            m_stop(false),
+            m_generation(0),
+            m_active(0),
+            m_fn(nullptr),
+            m_bands(0),
+            m_rows(0),
+            m_align(1),
+            m_next(0),
+            m_remaining(0)
+        {
+            for (int i = 1; i < m_threads; i++)
+                m_workers.emplace_back([this] { Work(); });
+        }
+
+        ~BandPool()
+        {
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for (auto& t : m_workers)
+                t.join();
+        }
+
+        BandPool(const BandPool&) = delete;
+        BandPool& operator=(const BandPool&) = delete;
+
+        int threads() const { return m_threads; }
+
+        /// @brief call fn(begin, end) on bands covering [0, rows), returns when all are done
+        /// @param align band boundaries are multiples of it, 2 keeps NV12 row pairs together
+        void Run(int rows, int align, const std::function<void(int, int)>& fn)
+        {
+            if (rows <= 0)
+                return;
+            align = std::max(align, 1);
+            int bands = std::min(m_threads, (rows + align - 1) / align);
+            if (bands <= 1)
+            {
+                fn(0, rows);
+                return;
+            }
+
+            std::lock_guard<std::mutex> run_lg(m_runLock);
+            {
+                // 上一轮的线程全部退出后才换任务
+                std::unique_lock<std::mutex> lk(m_lock);
+                m_idle.wait(lk, [this] { return m_active == 0; });
+                m_fn = &fn;
+                m_rows = rows;
+                m_align = align;
+                m_bands = bands;
+                m_next.store(0, std::memory_order_relaxed);
+                m_remaining.store(bands, std::memory_order_relaxed);
+                m_generation++;
+            }
+            m_wake.notify_all();
+
+            RunBands(&fn, rows, align, bands);
+
+            std::unique_lock<std::mutex> lk(m_lock);
+            m_idle.wait(lk, [this] { return m_remaining.load(std::memory_order_acquire) == 0; });
+            m_fn = nullptr;
+        }
+
+    private:
+        /// @brief take bands until none is left, fn is not touched once they are all taken
+        void RunBands(const std::function<void(int, int)>* fn, int rows, int align, int bands)
+        {
+            int units = (rows + align - 1) / align;
+            while (true)
+            {
+                int band = m_next.fetch_add(1, std::memory_order_relaxed);
+                if (band >= bands)
+                    return;
+                int begin = std::min(rows, (int)((int64_t)units * band / bands) * align);
+                int end = std::min(rows, (int)((int64_t)units * (band + 1) / bands) * align);
+                if (begin < end)
+                    (*fn)(begin, end);
+                if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    std::lock_guard<std::mutex> lg(m_lock);
+                    m_idle.notify_all();
+                }
+            }
+        }
+
+        void Work()
+        {
+            uint64_t seen = 0;
+            while (true)
+            {
+                const std::function<void(int, int)>* fn;
+                int rows, align, bands;
+                {
+                    std::unique_lock<std::mutex> lk(m_lock);
+                    m_wake.wait(lk, [this, seen] { return m_stop || (m_generation != seen && m_fn); });
+                    if (m_stop)
+                        return;
+                    seen = m_generation;
+                    fn = m_fn;
+                    rows = m_rows;
+                    align = m_align;
+                    bands = m_bands;
+                    m_active++;
+                }
+
+                RunBands(fn, rows, align, bands);
+
+                std::lock_guard<std::mutex> lg(m_lock);
+                if (--m_active == 0)
+                    m_idle.notify_all();
+            }
+        }
+
+    private:
+        int m_threads;
+        std::vector<std::thread> m_workers;
+
+        std::mutex m_runLock;
+        std::mutex m_lock;
+        std::condition_variable m_wake;
+        std::condition_variable m_idle;
+        bool m_stop;
+        uint64_t m_generation;
+        int m_active;
+
+        // 当前任务
+        const std::function<void(int, int)>* m_fn;
+        int m_bands;
+        int m_rows;
+        int m_align;
+        std::atomic<int> m_next;
+        std::atomic<int> m_remaining;
+    };
+}
@@ -0,0 +1,527 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AX_COLOR_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#define AX_COLOR_SSE2 1
+#endif
+
+#include "err.hpp"
+#include "video_frame.hpp"
+#include "tensor.hpp"
+#include "imgproc/band_pool.hpp"
+
+namespace ax
+{
+    /// @brief what nv12_to_rgb writes
+    /// @details INT8 and FLOAT32 get (pixel - mean) * scale, INT8 rounded half
+    ///     away from zero and saturated. UINT8 gets the pixel. mean and scale
+    ///     are in output channel order.
+    struct ColorConvertParams
+    {
+        int format;             // PIXEL_FORMAT_BGR or PIXEL_FORMAT_RGB
+        int layout;
+        int type;
+        float mean[3];
+        float scale[3];
+
+        ColorConvertParams():
+            format(PIXEL_FORMAT_BGR),
+            layout(TENSOR_LAYOUT_NHWC),
+            type(TENSOR_TYPE_UINT8)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                mean[c] = 0;
+                scale[c] = 1;
+            }
+        }
+    };
+
+    namespace color
+    {
+        // BT.601 limited range like VDEC output, Q6 fixed point. Every path
+        // uses the same integer math, so SIMD and scalar results are identical.
+        static const int CY = 74;
+        static const int CVR = 102;
+        static const int CUG = -25;
+        static const int CVG = -52;
+        static const int CUB = 129;
+
+        /// @brief where the rows go
+        struct Target
+        {
+            uint8_t* dst;
+            size_t stride;          // bytes per row
+            size_t plane;           // bytes per channel plane, NCHW only
+            int layout;
+            int type;
+            bool bgr;
+            float scale[3];
+            float bias[3];          // -mean * scale
+        };
+
+        inline Target make_target(const ColorConvertParams& params, void* dst, size_t stride, size_t plane)
+        {
+            Target t;
+            t.dst = (uint8_t*)dst;
+            t.stride = stride;
+            t.plane = plane;
+            t.layout = params.layout;
+            t.type = params.type;
+            t.bgr = params.format == PIXEL_FORMAT_BGR;
+            for (int k = 0; k < 3; k++)
+            {
+                t.scale[k] = params.scale[k];
+                t.bias[k] = -params.mean[k] * params.scale[k];
+            }
+            return t;
+        }
+
+        inline uint8_t clamp_u8(int v) { return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v)); }
+
+        inline int8_t quantize(float v)
+        {
+            v = std::min(std::max(v, -128.0f), 127.0f);
+            return (int8_t)(int)(v + (v >= 0 ? 0.5f : -0.5f));
+        }
+
+        inline uint8_t* pixel_ptr(const Target& t, int row, int x, int channel)
+        {
+            size_t elem = tensor_type_size(t.type);
+            if (t.layout == TENSOR_LAYOUT_NHWC)
+                return t.dst + row * t.stride + ((size_t)x * 3 + channel) * elem;
+            return t.dst + channel * t.plane + row * t.stride + (size_t)x * elem;
+        }
+
+        inline void store_pixel(const Target& t, int row, int x, const uint8_t c[3])
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint8_t* p = pixel_ptr(t, row, x, k);
+                if (t.type == TENSOR_TYPE_UINT8)
+                {
+                    *p = c[k];
+                    continue;
+                }
+                float v = c[k] * t.scale[k] + t.bias[k];
+                if (t.type == TENSOR_TYPE_INT8)
+                    *(int8_t*)p = quantize(v);
+                else
+                    memcpy(p, &v, sizeof(v));
+            }
+        }
+
+        /// @brief pixels [x, width) of a row pair, one UV pair per 2x2 block
+        inline void convert_pairs_scalar(const Target& t, int row, const uint8_t* y0, const uint8_t* y1,
+            const uint8_t* uv, int x, int width)
+        {
+            for (; x < width; x += 2)
+            {
+                int d = uv[x] - 128;
+                int e = uv[x + 1] - 128;
+                int rv = CVR * e + 32;
+                int guv = CUG * d + CVG * e + 32;
+                int bu = CUB * d + 32;
+                for (int r = 0; r < 2; r++)
+                {
+                    const uint8_t* y = r ? y1 : y0;
+                    for (int i = 0; i < 2; i++)
+                    {
+                        int c = CY * (y[x + i] - 16);
+                        uint8_t red = clamp_u8((c + rv) >> 6);
+                        uint8_t green = clamp_u8((c + guv) >> 6);
+                        uint8_t blue = clamp_u8((c + bu) >> 6);
+                        uint8_t px[3] = {t.bgr ? blue : red, green, t.bgr ? red : blue};
+                        store_pixel(t, row + r, x + i, px);
+                    }
+                }
+            }
+        }
+
+#if AX_COLOR_SSE2
+        /// @brief 16 pixels [c0 c1 c2] interleaved to 48 bytes
+        inline void store3_u8(uint8_t* p, __m128i c0, __m128i c1, __m128i c2)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i lo = _mm_unpacklo_epi8(c0, c1);
+            __m128i hi = _mm_unpackhi_epi8(c0, c1);
+            __m128i lo2 = _mm_unpacklo_epi8(c2, zero);
+            __m128i hi2 = _mm_unpackhi_epi8(c2, zero);
+            // 每像素4字节 c0 c1 c2 0
+            __m128i q[4] = {
+                _mm_unpacklo_epi16(lo, lo2), _mm_unpackhi_epi16(lo, lo2),
+                _mm_unpacklo_epi16(hi, hi2), _mm_unpackhi_epi16(hi, hi2)
+            };
+#if defined(__SSSE3__)
+            const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+            for (int i = 0; i < 4; i++)
+                q[i] = _mm_shuffle_epi8(q[i], pack);
+#else
+            // 无pshufb时用移位去掉填充字节: 先合并每个64位内的两像素, 再合并两半
+            const __m128i lo24 = _mm_set1_epi64x(0xffffff);
+            const __m128i lo64 = _mm_set_epi32(0, 0, -1, -1);
+            for (int i = 0; i < 4; i++)
+            {
+                __m128i t = _mm_or_si128(_mm_and_si128(q[i], lo24), _mm_srli_epi64(_mm_andnot_si128(lo24, q[i]), 8));
+                q[i] = _mm_or_si128(_mm_and_si128(t, lo64), _mm_srli_si128(_mm_andnot_si128(lo64, t), 2));
+            }
+#endif
+            _mm_storeu_si128((__m128i*)p, _mm_or_si128(q[0], _mm_slli_si128(q[1], 12)));
+            _mm_storeu_si128((__m128i*)(p + 16), _mm_or_si128(_mm_srli_si128(q[1], 4), _mm_slli_si128(q[2], 8)));
+            _mm_storeu_si128((__m128i*)(p + 32), _mm_or_si128(_mm_srli_si128(q[2], 8), _mm_slli_si128(q[3], 4)));
+        }
+
+        /// @brief 16 pixels to 4 x 4 floats of value * scale + bias
+        inline void normalize16(__m128i c, float scale, float bias, __m128 out[4])
+        {
+            const __m128i zero = _mm_setzero_si128();
+            __m128 s = _mm_set1_ps(scale);
+            __m128 b = _mm_set1_ps(bias);
+            __m128i lo = _mm_unpacklo_epi8(c, zero);
+            __m128i hi = _mm_unpackhi_epi8(c, zero);
+            __m128i w[4] = {
+                _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+                _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+            };
+            for (int i = 0; i < 4; i++)
+                out[i] = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(w[i]), s), b);
+        }
+
+        inline __m128i quantize16(const __m128 f[4])
+        {
+            const __m128 lo = _mm_set1_ps(-128.0f);
+            const __m128 hi = _mm_set1_ps(127.0f);
+            const __m128 half = _mm_set1_ps(0.5f);
+            const __m128 sign = _mm_set1_ps(-0.0f);
+            __m128i q[4];
+            for (int i = 0; i < 4; i++)
+            {
+                __m128 v = _mm_min_ps(_mm_max_ps(f[i], lo), hi);
+                // 加上同号0.5再截断, 与标量一致
+                v = _mm_add_ps(v, _mm_or_ps(_mm_and_ps(v, sign), half));
+                q[i] = _mm_cvttps_epi32(v);
+            }
+            return _mm_packs_epi16(_mm_packs_epi32(q[0], q[1]), _mm_packs_epi32(q[2], q[3]));
+        }
+
+        inline void store16(const Target& t, int row, int x, __m128i c0, __m128i c1, __m128i c2)
+        {
+            if (t.type == TENSOR_TYPE_UINT8)
+            {
+                if (t.layout == TENSOR_LAYOUT_NHWC)
+                    store3_u8(pixel_ptr(t, row, x, 0), c0, c1, c2);
+                else
+                {
+                    _mm_storeu_si128((__m128i*)pixel_ptr(t, row, x, 0), c0);
+                    _mm_storeu_si128((__m128i*)pixel_ptr(t, row, x, 1), c1);
+                    _mm_storeu_si128((__m128i*)pixel_ptr(t, row, x, 2), c2);
+                }
+                return;
+            }
+
+            __m128i c[3] = {c0, c1, c2};
+            __m128 f[3][4];
+            for (int k = 0; k < 3; k++)
+                normalize16(c[k], t.scale[k], t.bias[k], f[k]);
+
+            if (t.type == TENSOR_TYPE_INT8)
+            {
+                __m128i q[3] = {quantize16(f[0]), quantize16(f[1]), quantize16(f[2])};
+                if (t.layout == TENSOR_LAYOUT_NHWC)
+                    store3_u8(pixel_ptr(t, row, x, 0), q[0], q[1], q[2]);
+                else
+                {
+                    for (int k = 0; k < 3; k++)
+                        _mm_storeu_si128((__m128i*)pixel_ptr(t, row, x, k), q[k]);
+                }
+                return;
+            }
+
+            if (t.layout == TENSOR_LAYOUT_NCHW)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    float* p = (float*)pixel_ptr(t, row, x, k);
+                    for (int i = 0; i < 4; i++)
+                        _mm_storeu_ps(p + i * 4, f[k][i]);
+                }
+                return;
+            }
+            // 浮点交错输出: 先逐通道算好再按像素写
+            float tmp[3][16];
+            for (int k = 0; k < 3; k++)
+                for (int i = 0; i < 4; i++)
+                    _mm_storeu_ps(tmp[k] + i * 4, f[k][i]);
+            float* p = (float*)pixel_ptr(t, row, x, 0);
+            for (int i = 0; i < 16; i++)
+            {
+                p[i * 3] = tmp[0][i];
+                p[i * 3 + 1] = tmp[1][i];
+                p[i * 3 + 2] = tmp[2][i];
+            }
+        }
+
+        /// @brief 16 pixels of one row from its luma and the shared chroma terms
+        inline void yuv16(const uint8_t* y, __m128i rv_lo, __m128i rv_hi, __m128i guv_lo, __m128i guv_hi,
+            __m128i bu_lo, __m128i bu_hi, __m128i& red, __m128i& green, __m128i& blue)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i k16 = _mm_set1_epi16(16);
+            const __m128i cy = _mm_set1_epi16(CY);
+            __m128i yv = _mm_loadu_si128((const __m128i*)y);
+            __m128i c_lo = _mm_mullo_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(yv, zero), k16), cy);
+            __m128i c_hi = _mm_mullo_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(yv, zero), k16), cy);
+            red = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(c_lo, rv_lo), 6), _mm_srai_epi16(_mm_adds_epi16(c_hi, rv_hi), 6));
+            green = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(c_lo, guv_lo), 6), _mm_srai_epi16(_mm_adds_epi16(c_hi, guv_hi), 6));
+            blue = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(c_lo, bu_lo), 6), _mm_srai_epi16(_mm_adds_epi16(c_hi, bu_hi), 6));
+        }
+
+        /// @brief 16 columns at a time, returns the first column left for the scalar tail
+        inline int convert_pairs_simd(const Target& t, int row, const uint8_t* y0, const uint8_t* y1,
+            const uint8_t* uv, int width)
+        {
+            const __m128i mask = _mm_set1_epi16(0xff);
+            const __m128i k128 = _mm_set1_epi16(128);
+            const __m128i k32 = _mm_set1_epi16(32);
+            int x = 0;
+            for (; x + 16 <= width; x += 16)
+            {
+                // 8对UV, 每对覆盖2x2像素
+                __m128i uvv = _mm_loadu_si128((const __m128i*)(uv + x));
+                __m128i d = _mm_sub_epi16(_mm_and_si128(uvv, mask), k128);
+                __m128i e = _mm_sub_epi16(_mm_srli_epi16(uvv, 8), k128);
+                __m128i rv = _mm_add_epi16(_mm_mullo_epi16(e, _mm_set1_epi16(CVR)), k32);
+                __m128i guv = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(d, _mm_set1_epi16(CUG)),
+                    _mm_mullo_epi16(e, _mm_set1_epi16(CVG))), k32);
+                __m128i bu = _mm_add_epi16(_mm_mullo_epi16(d, _mm_set1_epi16(CUB)), k32);
+                __m128i rv_lo = _mm_unpacklo_epi16(rv, rv), rv_hi = _mm_unpackhi_epi16(rv, rv);
+                __m128i guv_lo = _mm_unpacklo_epi16(guv, guv), guv_hi = _mm_unpackhi_epi16(guv, guv);
+                __m128i bu_lo = _mm_unpacklo_epi16(bu, bu), bu_hi = _mm_unpackhi_epi16(bu, bu);
+
+                for (int r = 0; r < 2; r++)
+                {
+                    __m128i red, green, blue;
+                    yuv16((r ? y1 : y0) + x, rv_lo, rv_hi, guv_lo, guv_hi, bu_lo, bu_hi, red, green, blue);
+                    if (t.bgr)
+                        store16(t, row + r, x, blue, green, red);
+                    else
+                        store16(t, row + r, x, red, green, blue);
+                }
+            }
+            return x;
+        }
+#elif AX_COLOR_NEON
+        inline void normalize16(uint8x16_t c, float scale, float bias, float32x4_t out[4])
+        {
+            float32x4_t s = vdupq_n_f32(scale);
+            float32x4_t b = vdupq_n_f32(bias);
+            uint16x8_t lo = vmovl_u8(vget_low_u8(c));
+            uint16x8_t hi = vmovl_u8(vget_high_u8(c));
+            uint32x4_t w[4] = {
+                vmovl_u16(vget_low_u16(lo)), vmovl_u16(vget_high_u16(lo)),
+                vmovl_u16(vget_low_u16(hi)), vmovl_u16(vget_high_u16(hi))
+            };
+            for (int i = 0; i < 4; i++)
+                out[i] = vaddq_f32(vmulq_f32(vcvtq_f32_u32(w[i]), s), b);
+        }
+
+        inline int8x16_t quantize16(const float32x4_t f[4])
+        {
+            const float32x4_t lo = vdupq_n_f32(-128.0f);
+            const float32x4_t hi = vdupq_n_f32(127.0f);
+            const uint32x4_t half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+            const uint32x4_t sign = vdupq_n_u32(0x80000000u);
+            int16x4_t q[4];
+            for (int i = 0; i < 4; i++)
+            {
+                float32x4_t v = vminq_f32(vmaxq_f32(f[i], lo), hi);
+                // 加上同号0.5再截断, 与标量一致
+                v = vaddq_f32(v, vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(v), sign), half)));
+                q[i] = vqmovn_s32(vcvtq_s32_f32(v));
+            }
+            return vcombine_s8(vqmovn_s16(vcombine_s16(q[0], q[1])), vqmovn_s16(vcombine_s16(q[2], q[3])));
+        }
+
+        inline void store16(const Target& t, int row, int x, uint8x16_t c0, uint8x16_t c1, uint8x16_t c2)
+        {
+            if (t.type == TENSOR_TYPE_UINT8)
+            {
+                if (t.layout == TENSOR_LAYOUT_NHWC)
+                {
+                    uint8x16x3_t v = {{c0, c1, c2}};
+                    vst3q_u8(pixel_ptr(t, row, x, 0), v);
+                }
+                else
+                {
+                    vst1q_u8(pixel_ptr(t, row, x, 0), c0);
+                    vst1q_u8(pixel_ptr(t, row, x, 1), c1);
+                    vst1q_u8(pixel_ptr(t, row, x, 2), c2);
+                }
+                return;
+            }
+
+            uint8x16_t c[3] = {c0, c1, c2};
+            float32x4_t f[3][4];
+            for (int k = 0; k < 3; k++)
+                normalize16(c[k], t.scale[k], t.bias[k], f[k]);
+
+            if (t.type == TENSOR_TYPE_INT8)
+            {
+                int8x16x3_t q = {{quantize16(f[0]), quantize16(f[1]), quantize16(f[2])}};
+                if (t.layout == TENSOR_LAYOUT_NHWC)
+                    vst3q_s8((int8_t*)pixel_ptr(t, row, x, 0), q);
+                else
+                {
+                    for (int k = 0; k < 3; k++)
+                        vst1q_s8((int8_t*)pixel_ptr(t, row, x, k), q.val[k]);
+                }
+                return;
+            }
+
+            if (t.layout == TENSOR_LAYOUT_NCHW)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    float* p = (float*)pixel_ptr(t, row, x, k);
+                    for (int i = 0; i < 4; i++)
+                        vst1q_f32(p + i * 4, f[k][i]);
+                }
+                return;
+            }
+            float* p = (float*)pixel_ptr(t, row, x, 0);
+            for (int i = 0; i < 4; i++)
+            {
+                float32x4x3_t v = {{f[0][i], f[1][i], f[2][i]}};
+                vst3q_f32(p + i * 12, v);
+            }
+        }
+
+        inline void yuv16(const uint8_t* y, int16x8x2_t rv, int16x8x2_t guv, int16x8x2_t bu,
+            uint8x16_t& red, uint8x16_t& green, uint8x16_t& blue)
+        {
+            uint8x16_t yv = vld1q_u8(y);
+            uint8x8_t k16 = vdup_n_u8(16);
+            int16x8_t c_lo = vmulq_n_s16(vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(yv), k16)), CY);
+            int16x8_t c_hi = vmulq_n_s16(vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(yv), k16)), CY);
+            red = vcombine_u8(vqshrun_n_s16(vqaddq_s16(c_lo, rv.val[0]), 6), vqshrun_n_s16(vqaddq_s16(c_hi, rv.val[1]), 6));
+            green = vcombine_u8(vqshrun_n_s16(vqaddq_s16(c_lo, guv.val[0]), 6), vqshrun_n_s16(vqaddq_s16(c_hi, guv.val[1]), 6));
+            blue = vcombine_u8(vqshrun_n_s16(vqaddq_s16(c_lo, bu.val[0]), 6), vqshrun_n_s16(vqaddq_s16(c_hi, bu.val[1]), 6));
+        }
+
+        inline int convert_pairs_simd(const Target& t, int row, const uint8_t* y0, const uint8_t* y1,
+            const uint8_t* uv, int width)
+        {
+            const uint8x8_t k128 = vdup_n_u8(128);
+            const int16x8_t k32 = vdupq_n_s16(32);
+            int x = 0;
+            for (; x + 16 <= width; x += 16)
+            {
+                // 8对UV, 每对覆盖2x2像素
+                uint8x8x2_t uvv = vld2_u8(uv + x);
+                int16x8_t d = vreinterpretq_s16_u16(vsubl_u8(uvv.val[0], k128));
+                int16x8_t e = vreinterpretq_s16_u16(vsubl_u8(uvv.val[1], k128));
+                int16x8_t rv = vaddq_s16(vmulq_n_s16(e, CVR), k32);
+                int16x8_t guv = vaddq_s16(vmlaq_n_s16(vmulq_n_s16(d, CUG), e, CVG), k32);
+                int16x8_t bu = vaddq_s16(vmulq_n_s16(d, CUB), k32);
+                int16x8x2_t rv2 = vzipq_s16(rv, rv);
+                int16x8x2_t guv2 = vzipq_s16(guv, guv);
+                int16x8x2_t bu2 = vzipq_s16(bu, bu);
+
+                for (int r = 0; r < 2; r++)
+                {
+                    uint8x16_t red, green, blue;
+                    yuv16((r ? y1 : y0) + x, rv2, guv2, bu2, red, green, blue);
+                    if (t.bgr)
+                        store16(t, row + r, x, blue, green, red);
+                    else
+                        store16(t, row + r, x, red, green, blue);
+                }
+            }
+            return x;
+        }
+#endif
+
+        /// @brief output rows row and row + 1 from two luma rows and their chroma row
+        inline void convert_rows(const Target& t, int row, const uint8_t* y0, const uint8_t* y1,
+            const uint8_t* uv, int width, bool simd)
+        {
+            int x = 0;
+#if AX_COLOR_SSE2 || AX_COLOR_NEON
+            if (simd)
+                x = convert_pairs_simd(t, row, y0, y1, uv, width);
+#endif
+            convert_pairs_scalar(t, row, y0, y1, uv, x, width);
+        }
+
+        /// @brief convert rows [begin, end) of src, begin and end even
+        inline void convert_band(const VideoFrame& src, const Target& t, int begin, int end, bool simd)
+        {
+            for (int row = begin; row < end; row += 2)
+            {
+                const uint8_t* y0 = src.data[0] + (size_t)row * src.stride[0];
+                const uint8_t* uv = src.data[1] + (size_t)(row / 2) * src.stride[1];
+                convert_rows(t, row, y0, y0 + src.stride[0], uv, src.width, simd);
+            }
+        }
+
+        /// @brief nv12_to_rgb with the SIMD path selectable, for comparisons
+        inline int convert(const VideoFrame& src, void* dst, const ColorConvertParams& params,
+            int dst_stride, BandPool* pool, bool simd)
+        {
+            if (!src.valid() || !dst)
+                return AX_ERR_NULL_PTR;
+            if (src.format != PIXEL_FORMAT_NV12 || (src.width & 1) || (src.height & 1) ||
+                (params.format != PIXEL_FORMAT_BGR && params.format != PIXEL_FORMAT_RGB))
+                return AX_ERR_ILLEGAL_PARAM;
+
+            size_t row_bytes = (size_t)src.width * tensor_type_size(params.type) * (params.layout == TENSOR_LAYOUT_NHWC ? 3 : 1);
+            size_t stride = dst_stride > 0 ? (size_t)dst_stride : row_bytes;
+            if (stride < row_bytes)
+                return AX_ERR_ILLEGAL_PARAM;
+            Target t = make_target(params, dst, stride, stride * src.height);
+
+            auto band = [&src, &t, simd](int begin, int end) { convert_band(src, t, begin, end, simd); };
+            if (pool)
+                pool->Run(src.height, 2, band);
+            else
+                band(0, src.height);
+            return AX_SUCCESS;
+        }
+    }
+
+    /// @brief NV12 to interleaved or planar BGR/RGB, normalised on the way, in one pass
+    /// @details NEON on ARM, SSE2 (SSSE3 if enabled) on x86, scalar elsewhere,
+    ///     all bit identical. Width and height must be even.
+    /// @param dst          NHWC: height rows of width * 3 values, NCHW: 3 planes of height rows
+    /// @param dst_stride   bytes per output row, 0 for unpadded rows
+    /// @param pool         converts bands of rows on its threads, nullptr on the calling thread
+    inline int nv12_to_rgb(const VideoFrame& src, void* dst, const ColorConvertParams& params,
+        int dst_stride = 0, BandPool* pool = nullptr)
+    {
+        return color::convert(src, dst, params, dst_stride, pool, true);
+    }
+
+    /// @brief NV12 frame into a BGR or RGB frame of the same size
+    inline int nv12_to_rgb(const VideoFrame& src, VideoFrame& dst, BandPool* pool = nullptr)
+    {
+        if (dst.width != src.width || dst.height != src.height)
+            return AX_ERR_ILLEGAL_PARAM;
+        ColorConvertParams params;
+        params.format = dst.format;
+        int ret = nv12_to_rgb(src, dst.data[0], params, dst.stride[0], pool);
+        if (ret == AX_SUCCESS)
+            dst.pts = src.pts;
+        return ret;
+    }
+}
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "err.hpp"
+#include "video_frame.hpp"
+#include "tensor.hpp"
+#include "imgproc/band_pool.hpp"
+#include "imgproc/color_convert.hpp"
+
+namespace ax
+{
+    /// @brief model input Preprocessor makes of a frame
+    struct PreprocessParams
+    {
+        int width;              // tensor width and height, even
+        int height;
+        bool keep_ratio;        // letterbox, else the frame is stretched over the tensor
+        bool center;            // letterbox padding on both sides, else right and bottom only
+        int pad_value;          // pixel value of the padding, normalised like the pixels
+        ColorConvertParams color;
+
+        PreprocessParams():
+            width(640),
+            height(640),
+            keep_ratio(true),
+            center(true),
+            pad_value(114)
+        { }
+    };
+
+    namespace resize
+    {
+        /// @brief source position of every destination column or row
+        /// @details destination d samples index[d] and index[d] + 1 with
+        ///     weights 256 - weight[d] and weight[d], pixel centres aligned.
+        struct Map
+        {
+            std::vector<int> index;
+            std::vector<int16_t> weight;
+        };
+
+        /// @param pair_safe index[d] + 1 is always inside the source, needs src >= 2.
+        ///     Otherwise the edge is index src - 1 with weight 0, index + 1 must not be read then.
+        inline void make_map(int src, int dst, bool pair_safe, Map& map)
+        {
+            map.index.resize(dst);
+            map.weight.resize(dst);
+            double ratio = (double)src / dst;
+            for (int d = 0; d < dst; d++)
+            {
+                double f = std::max((d + 0.5) * ratio - 0.5, 0.0);
+                int i = (int)f;
+                int w = (int)((f - i) * 256 + 0.5);
+                if (w == 256)
+                {
+                    i++;
+                    w = 0;
+                }
+                if (i >= src - 1)
+                {
+                    i = src - 1;
+                    w = 0;
+                }
+                if (pair_safe && i == src - 1)
+                {
+                    i = src - 2;
+                    w = 256;
+                }
+                map.index[d] = i;
+                map.weight[d] = (int16_t)w;
+            }
+        }
+
+        /// @brief dst[i] = (a[i] * (256 - w) + b[i] * w + 128) >> 8, 0 < w < 256
+        inline void blend_rows(const uint8_t* a, const uint8_t* b, int w, uint8_t* dst, int n)
+        {
+            int i = 0;
+#if AX_COLOR_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i wa = _mm_set1_epi16(256 - w);
+            const __m128i wb = _mm_set1_epi16(w);
+            const __m128i half = _mm_set1_epi16(128);
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+                __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+                // 乘积和不超过 255 * 256, 无符号16位不溢出
+                __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                    _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb)), half);
+                __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                    _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb)), half);
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+            }
+#elif AX_COLOR_NEON
+            const uint8x8_t wa = vdup_n_u8((uint8_t)(256 - w));
+            const uint8x8_t wb = vdup_n_u8((uint8_t)w);
+            for (; i + 16 <= n; i += 16)
+            {
+                uint8x16_t va = vld1q_u8(a + i);
+                uint8x16_t vb = vld1q_u8(b + i);
+                uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(va), wa), vget_low_u8(vb), wb);
+                uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(va), wa), vget_high_u8(vb), wb);
+                vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+            }
+#endif
+            for (; i < n; i++)
+                dst[i] = (uint8_t)((a[i] * (256 - w) + b[i] * w + 128) >> 8);
+        }
+
+        /// @brief n luma pixels from a row, map is pair safe
+        inline void blend_cols(const uint8_t* src, const Map& map, uint8_t* dst, int n)
+        {
+            // 逐像素查表, 收集读取无法有效向量化, 但只按输出宽度计算
+            const int* index = map.index.data();
+            const int16_t* weight = map.weight.data();
+            for (int d = 0; d < n; d++)
+            {
+                const uint8_t* s = src + index[d];
+                int w = weight[d];
+                dst[d] = (uint8_t)((s[0] * (256 - w) + s[1] * w + 128) >> 8);
+            }
+        }
+
+        /// @brief n UV pairs from an interleaved chroma row, map is pair safe and counts pairs
+        inline void blend_cols_uv(const uint8_t* src, const Map& map, uint8_t* dst, int n)
+        {
+            const int* index = map.index.data();
+            const int16_t* weight = map.weight.data();
+            for (int d = 0; d < n; d++)
+            {
+                const uint8_t* s = src + index[d] * 2;
+                int w = weight[d];
+                dst[d * 2] = (uint8_t)((s[0] * (256 - w) + s[2] * w + 128) >> 8);
+                dst[d * 2 + 1] = (uint8_t)((s[1] * (256 - w) + s[3] * w + 128) >> 8);
+            }
+        }
+    }
+
+    /// @brief NV12 frame or ROI to a model input tensor in one pass: bilinear
+    ///     resize, letterbox, colour conversion, normalisation and layout.
+    /// @details Works row pair by row pair of the tensor. Resized luma and
+    ///     chroma rows live in a small per thread scratch buffer, so the
+    ///     frame is read once and the tensor written once, with no full
+    ///     size intermediate. The resize tables are kept for the last ROI
+    ///     size. Run may be called from several threads.
+    class Preprocessor
+    {
+    public:
+        explicit Preprocessor(const PreprocessParams& params):
+            m_params(params)
+        {
+            // 填充值按输出布局预先生成一整行, 填充时直接拷贝
+            int elem = tensor_type_size(params.color.type);
+            m_pad.resize((size_t)params.width * 3 * elem);
+            bool nhwc = params.color.layout == TENSOR_LAYOUT_NHWC;
+            color::Target t = color::make_target(params.color, m_pad.data(),
+                nhwc ? m_pad.size() : (size_t)params.width * elem, (size_t)params.width * elem);
+            uint8_t px = (uint8_t)std::min(std::max(params.pad_value, 0), 255);
+            uint8_t c[3] = {px, px, px};
+            for (int x = 0; x < params.width; x++)
+                color::store_pixel(t, 0, x, c);
+        }
+
+        const PreprocessParams& params() const { return m_params; }
+
+        /// @brief bytes of the tensor Run writes
+        size_t TensorBytes() const
+        {
+            return (size_t)m_params.width * m_params.height * 3 * tensor_type_size(m_params.color.type);
+        }
+
+        /// @brief whole frame, see the ROI version
+        int Run(const VideoFrame& src, Tensor& dst, BandPool* pool = nullptr)
+        {
+            return Run(src, 0, 0, src.width, src.height, dst, pool);
+        }
+
+        /// @brief convert the ROI x, y, w, h of an NV12 frame into dst
+        /// @details the ROI is rounded to even coordinates and must be at least 4 x 4.
+        ///     dst.data must hold TensorBytes, its shape, type, layout, pts
+        ///     and transform are set here.
+        /// @param simd false runs the scalar code, for comparisons
+        int Run(const VideoFrame& src, int x, int y, int w, int h, Tensor& dst, BandPool* pool = nullptr, bool simd = true)
+        {
+            if (!src.valid() || !dst.data)
+                return AX_ERR_NULL_PTR;
+            if (src.format != PIXEL_FORMAT_NV12)
+                return AX_ERR_ILLEGAL_PARAM;
+            x &= ~1;
+            y &= ~1;
+            w &= ~1;
+            h &= ~1;
+            VideoFrame roi = src.crop(x, y, w, h);
+            if (!roi.valid() || w < 4 || h < 4)
+                return AX_ERR_ILLEGAL_PARAM;
+
+            std::shared_ptr<const Geometry> geo = GetGeometry(w, h);
+            const PreprocessParams& p = m_params;
+            int elem = tensor_type_size(p.color.type);
+            bool nhwc = p.color.layout == TENSOR_LAYOUT_NHWC;
+            size_t stride = (size_t)p.width * elem * (nhwc ? 3 : 1);
+            size_t plane = stride * p.height;
+            color::Target t = color::make_target(p.color, dst.data, stride, plane);
+            color::Target content = t;
+            content.dst += (size_t)geo->pad_x * elem * (nhwc ? 3 : 1);
+
+            auto band = [this, &roi, &geo, &t, &content, simd](int begin, int end) {
+                Band(roi, *geo, t, content, begin, end, simd);
+            };
+            if (pool)
+                pool->Run(p.height, 2, band);
+            else
+                band(0, p.height);
+
+            dst.type = p.color.type;
+            dst.layout = p.color.layout;
+            dst.batch = 1;
+            dst.channels = 3;
+            dst.height = p.height;
+            dst.width = p.width;
+            dst.pts = src.pts;
+            dst.transform.scale_x = (float)w / geo->width;
+            dst.transform.scale_y = (float)h / geo->height;
+            dst.transform.offset_x = x - geo->pad_x * dst.transform.scale_x;
+            dst.transform.offset_y = y - geo->pad_y * dst.transform.scale_y;
+            return AX_SUCCESS;
+        }
+
+    private:
+        /// @brief placement and resize tables for one ROI size
+        struct Geometry
+        {
+            int roi_width;
+            int roi_height;
+            int width;          // resized content inside the tensor
+            int height;
+            int pad_x;
+            int pad_y;
+            resize::Map x;      // luma, pair safe
+            resize::Map y;
+            resize::Map cx;     // chroma pairs, pair safe
+            resize::Map cy;
+        };
+
+        std::shared_ptr<const Geometry> GetGeometry(int w, int h)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            if (m_geometry && m_geometry->roi_width == w && m_geometry->roi_height == h)
+                return m_geometry;
+
+            const PreprocessParams& p = m_params;
+            std::shared_ptr<Geometry> geo = std::make_shared<Geometry>();
+            geo->roi_width = w;
+            geo->roi_height = h;
+            geo->width = p.width;
+            geo->height = p.height;
+            if (p.keep_ratio)
+            {
+                double s = std::min((double)p.width / w, (double)p.height / h);
+                geo->width = std::min(p.width, std::max(2, (int)(w * s + 0.5) & ~1));
+                geo->height = std::min(p.height, std::max(2, (int)(h * s + 0.5) & ~1));
+            }
+            geo->pad_x = p.center ? (p.width - geo->width) / 2 & ~1 : 0;
+            geo->pad_y = p.center ? (p.height - geo->height) / 2 & ~1 : 0;
+            resize::make_map(w, geo->width, true, geo->x);
+            resize::make_map(h, geo->height, false, geo->y);
+            resize::make_map(w / 2, geo->width / 2, true, geo->cx);
+            resize::make_map(h / 2, geo->height / 2, false, geo->cy);
+            m_geometry = geo;
+            return m_geometry;
+        }
+
+        /// @brief padding of n pixels from column x of a tensor row
+        void Fill(const color::Target& t, int row, int x, int n) const
+        {
+            if (n <= 0)
+                return;
+            int elem = tensor_type_size(t.type);
+            if (t.layout == TENSOR_LAYOUT_NHWC)
+            {
+                memcpy(color::pixel_ptr(t, row, x, 0), m_pad.data() + (size_t)x * 3 * elem, (size_t)n * 3 * elem);
+                return;
+            }
+            for (int k = 0; k < 3; k++)
+                memcpy(color::pixel_ptr(t, row, x, k), m_pad.data() + ((size_t)k * m_params.width + x) * elem, (size_t)n * elem);
+        }
+
+        /// @brief resized row of a plane, source rows blended into scratch unless the weight is 0
+        /// @param pair 2 for the chroma plane, the map counts pairs then
+        static const uint8_t* SourceRow(const VideoFrame& roi, int plane, const resize::Map& rows, const resize::Map& cols,
+            int r, int pair, uint8_t* scratch, bool simd)
+        {
+            const uint8_t* a = roi.data[plane] + (size_t)rows.index[r] * roi.stride[plane];
+            int w = rows.weight[r];
+            if (w == 0)
+                return a;
+            // 只混合水平映射用到的列
+            int begin = cols.index.front() * pair;
+            int end = (cols.index.back() + 2) * pair;
+            if (simd)
+                resize::blend_rows(a + begin, a + begin + roi.stride[plane], w, scratch + begin, end - begin);
+            else
+            {
+                for (int i = begin; i < end; i++)
+                    scratch[i] = (uint8_t)((a[i] * (256 - w) + a[i + roi.stride[plane]] * w + 128) >> 8);
+            }
+            return scratch;
+        }
+
+        /// @brief tensor rows [begin, end), both even
+        void Band(const VideoFrame& roi, const Geometry& geo, const color::Target& t, const color::Target& content,
+            int begin, int end, bool simd) const
+        {
+            int width = m_params.width;
+            int right = geo.pad_x + geo.width;
+
+            // 每线程一块暂存: 垂直混合行, 两行亮度, 一行色度
+            static thread_local std::vector<uint8_t> scratch;
+            size_t need = (size_t)roi.width + (size_t)geo.width * 3;
+            if (scratch.size() < need)
+                scratch.resize(need);
+            uint8_t* blend = scratch.data();
+            uint8_t* y0 = blend + roi.width;
+            uint8_t* y1 = y0 + geo.width;
+            uint8_t* uv = y1 + geo.width;
+
+            for (int row = begin; row < end; row += 2)
+            {
+                if (row < geo.pad_y || row >= geo.pad_y + geo.height)
+                {
+                    Fill(t, row, 0, width);
+                    Fill(t, row + 1, 0, width);
+                    continue;
+                }
+                for (int r = row; r < row + 2; r++)
+                {
+                    Fill(t, r, 0, geo.pad_x);
+                    Fill(t, r, right, width - right);
+                }
+
+                int cy = row - geo.pad_y;
+                const uint8_t* src = SourceRow(roi, 0, geo.y, geo.x, cy, 1, blend, simd);
+                resize::blend_cols(src, geo.x, y0, geo.width);
+                src = SourceRow(roi, 0, geo.y, geo.x, cy + 1, 1, blend, simd);
+                resize::blend_cols(src, geo.x, y1, geo.width);
+                src = SourceRow(roi, 1, geo.cy, geo.cx, cy / 2, 2, blend, simd);
+                resize::blend_cols_uv(src, geo.cx, uv, geo.width / 2);
+                color::convert_rows(content, row, y0, y1, uv, geo.width, simd);
+            }
+        }
+
+    private:
+        PreprocessParams m_params;
+        std::vector<uint8_t> m_pad;
+
+        std::mutex m_lock;
+        std::shared_ptr<const Geometry> m_geometry;
+    };
+}
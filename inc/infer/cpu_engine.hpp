@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "infer/inference_engine.hpp"
+
+namespace ax
+{
+    /// @brief Reference engine running on the CPU, to exercise batching,
+    ///     queueing and latency of InferenceNode without the NPU.
+    /// @details {"engine": "cpu", "max_batch": 8, "max_inflight": 2,
+    ///     "cpu_threads": 1, "latency_ms": 0, "batch_latency_ms": 0,
+    ///     "input": [3, 640, 640]}
+    ///     The "model" outputs the mean of every input channel as a float32
+    ///     N x C x 1 x 1 tensor, so results can be checked per frame.
+    ///     "cpu_threads" requests run at once like NPU cores. A request of n
+    ///     inputs takes at least "latency_ms" + (n - 1) * "batch_latency_ms",
+    ///     modelling how batching amortises the fixed cost of a run.
+    ///     "input" C, H, W restricts the accepted shape, empty accepts any.
+    class CpuInferenceEngine : public InferenceEngine
+    {
+    private:
+        struct Request
+        {
+            uint64_t id;
+            std::vector<Tensor> inputs;
+        };
+
+        int m_maxBatch;
+        int m_maxInflight;
+        int m_threads;
+        double m_latencyMs;
+        double m_batchLatencyMs;
+        int m_input[3];
+
+        std::mutex m_lock;
+        std::condition_variable m_workCond;
+        std::condition_variable m_doneCond;
+        bool m_loaded;
+        bool m_stop;
+        int m_outstanding;
+        std::deque<Request> m_queue;
+        std::deque<InferenceCompletion> m_done;
+        std::vector<std::thread> m_workers;
+
+    public:
+        CpuInferenceEngine():
+            m_maxBatch(8),
+            m_maxInflight(2),
+            m_threads(1),
+            m_latencyMs(0),
+            m_batchLatencyMs(0),
+            m_loaded(false),
+            m_stop(false),
+            m_outstanding(0)
+        {
+            for (int i = 0; i < 3; i++)
+                m_input[i] = 0;
+        }
+
+        ~CpuInferenceEngine()
+        {
+            Unload();
+        }
+
+        int Load(const Json::Value& config)
+        {
+            Unload();
+
+            m_maxBatch = std::max(config.get("max_batch", m_maxBatch).asInt(), 1);
+            m_maxInflight = std::max(config.get("max_inflight", m_maxInflight).asInt(), 1);
+            m_threads = std::max(config.get("cpu_threads", m_threads).asInt(), 1);
+            m_latencyMs = config.get("latency_ms", m_latencyMs).asDouble();
+            m_batchLatencyMs = config.get("batch_latency_ms", m_batchLatencyMs).asDouble();
+            if (config["input"].isArray() && config["input"].size() == 3)
+            {
+                for (int i = 0; i < 3; i++)
+                    m_input[i] = config["input"][i].asInt();
+            }
+
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_stop = false;
+            m_loaded = true;
+            for (int i = 0; i < m_threads; i++)
+                m_workers.emplace_back([this] { Work(); });
+            return AX_SUCCESS;
+        }
+
+        void Unload()
+        {
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                if (!m_loaded)
+                    return;
+                m_stop = true;
+                m_loaded = false;
+            }
+            m_workCond.notify_all();
+            for (auto& t : m_workers)
+                t.join();
+            m_workers.clear();
+
+            // 未执行的请求以失败返回, 调用方仍能收回
+            std::lock_guard<std::mutex> lg(m_lock);
+            while (!m_queue.empty())
+            {
+                InferenceCompletion completion;
+                completion.id = m_queue.front().id;
+                completion.status = AX_ERR_CLOSED;
+                m_done.push_back(completion);
+                m_queue.pop_front();
+            }
+            m_doneCond.notify_all();
+        }
+
+        int MaxBatch() const { return m_maxBatch; }
+
+        int MaxInflight() const { return m_maxInflight; }
+
+        bool Accepts(const Tensor& input) const
+        {
+            if (!input.valid() || input.batch != 1)
+                return false;
+            return !m_input[0] || (input.channels == m_input[0] && input.height == m_input[1] && input.width == m_input[2]);
+        }
+
+        int Submit(uint64_t id, const std::vector<Tensor>& inputs)
+        {
+            if (inputs.empty() || (int)inputs.size() > m_maxBatch)
+                return AX_ERR_ILLEGAL_PARAM;
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                if (!m_loaded)
+                    return AX_ERR_NOT_INIT;
+                if (m_outstanding >= m_maxInflight)
+                    return AX_ERR_QUEUE_FULL;
+                Request request;
+                request.id = id;
+                request.inputs = inputs;
+                m_queue.push_back(std::move(request));
+                m_outstanding++;
+            }
+            m_workCond.notify_one();
+            return AX_SUCCESS;
+        }
+
+        int Poll(InferenceCompletion& completion, int timeout)
+        {
+            std::unique_lock<std::mutex> lk(m_lock);
+            auto ready = [this] { return !m_done.empty(); };
+            if (timeout < 0)
+                m_doneCond.wait(lk, ready);
+            else
+                m_doneCond.wait_for(lk, std::chrono::milliseconds(timeout), ready);
+            if (m_done.empty())
+                return AX_ERR_TIMEOUT;
+            completion = std::move(m_done.front());
+            m_done.pop_front();
+            m_outstanding--;
+            return AX_SUCCESS;
+        }
+
+    private:
+        void Work()
+        {
+            while (true)
+            {
+                Request request;
+                {
+                    std::unique_lock<std::mutex> lk(m_lock);
+                    m_workCond.wait(lk, [this] { return m_stop || !m_queue.empty(); });
+                    if (m_stop)
+                        return;
+                    request = std::move(m_queue.front());
+                    m_queue.pop_front();
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                InferenceCompletion completion;
+                completion.id = request.id;
+                completion.status = Run(request.inputs, completion.outputs);
+
+                // 模拟NPU耗时: 固定开销加每多一帧的增量
+                double ms = m_latencyMs + m_batchLatencyMs * (request.inputs.size() - 1);
+                std::this_thread::sleep_until(start + std::chrono::microseconds((int64_t)(ms * 1000)));
+
+                {
+                    std::lock_guard<std::mutex> lg(m_lock);
+                    m_done.push_back(std::move(completion));
+                }
+                m_doneCond.notify_all();
+            }
+        }
+
+        template <typename T>
+        static double Sum(const T* p, size_t count, size_t step)
+        {
+            double sum = 0;
+            for (size_t i = 0; i < count; i++)
+                sum += p[i * step];
+            return sum;
+        }
+
+        /// @brief mean of every channel of every input
+        static int Run(const std::vector<Tensor>& inputs, std::vector<Tensor>& outputs)
+        {
+            const Tensor& first = inputs[0];
+            int n = inputs.size();
+            int c = first.channels;
+            Tensor out = Tensor::Allocate(TENSOR_TYPE_FLOAT32, TENSOR_LAYOUT_NCHW, n, c, 1, 1);
+            if (!out.valid())
+                return AX_ERR_INIT_FAIL;
+
+            float* dst = out.as<float>();
+            size_t pixels = (size_t)first.height * first.width;
+            for (int i = 0; i < n; i++)
+            {
+                const Tensor& in = inputs[i];
+                if (in.channels != c || (size_t)in.height * in.width != pixels)
+                    return AX_ERR_ILLEGAL_PARAM;
+                for (int k = 0; k < c; k++)
+                {
+                    // NCHW按平面连续, NHWC按像素交错
+                    size_t offset = in.layout == TENSOR_LAYOUT_NCHW ? k * pixels : k;
+                    size_t step = in.layout == TENSOR_LAYOUT_NCHW ? 1 : c;
+                    double sum;
+                    if (in.type == TENSOR_TYPE_FLOAT32)
+                        sum = Sum(in.as<float>() + offset, pixels, step);
+                    else if (in.type == TENSOR_TYPE_INT8)
+                        sum = Sum(in.as<int8_t>() + offset, pixels, step);
+                    else
+                        sum = Sum(in.data + offset, pixels, step);
+                    dst[i * c + k] = (float)(sum / pixels);
+                }
+            }
+            outputs.clear();
+            outputs.push_back(out);
+            return AX_SUCCESS;
+        }
+    };
+}
+
+AX_REGISTER_INFERENCE_ENGINE("cpu", []() { return std::unique_ptr<ax::InferenceEngine>(new ax::CpuInferenceEngine); })
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "json/json.h"
+
+#include "err.hpp"
+#include "tensor.hpp"
+
+namespace ax
+{
+    /// @brief a finished request of an InferenceEngine
+    struct InferenceCompletion
+    {
+        uint64_t id;
+        int status;                     // AX_SUCCESS or why the request failed
+        std::vector<Tensor> outputs;    // batch is the number of inputs submitted
+    };
+
+    /// @brief model outputs of one input tensor, what InferenceNode sends
+    struct InferenceOutput
+    {
+        std::vector<Tensor> tensors;    // batch 1 views into the outputs of the whole batch
+        TensorTransform transform;      // of the input, maps model coordinates to the frame
+        uint64_t pts;
+    };
+
+    /// @brief Model runner used by InferenceNode, NPU or CPU reference.
+    /// @details Submit returns at once, the engine works on up to
+    ///     MaxInflight requests and hands them back through Poll in the order
+    ///     they finish. Engines are used from two threads, one submitting and
+    ///     one polling.
+    class InferenceEngine
+    {
+    public:
+        virtual ~InferenceEngine() {}
+
+        /// @brief load the model, config is the config of the node
+        virtual int Load(const Json::Value& config) = 0;
+
+        /// @brief fail what is still queued and free the model, Poll still returns the failures
+        virtual void Unload() = 0;
+
+        /// @brief inputs of one request at most
+        virtual int MaxBatch() const = 0;
+
+        /// @brief requests submitted and not yet polled at most
+        virtual int MaxInflight() const = 0;
+
+        /// @brief whether the tensor fits the model input, checked before batching
+        virtual bool Accepts(const Tensor& input) const = 0;
+
+        /// @brief start a request on batch 1 input tensors of the same shape
+        /// @param id passed back in the InferenceCompletion
+        /// @return AX_ERR_QUEUE_FULL with MaxInflight requests outstanding
+        virtual int Submit(uint64_t id, const std::vector<Tensor>& inputs) = 0;
+
+        /// @brief next finished request
+        /// @param timeout milliseconds, -1 to wait for ever
+        /// @return AX_ERR_TIMEOUT when none finished in time
+        virtual int Poll(InferenceCompletion& completion, int timeout) = 0;
+    };
+
+    typedef std::function<std::unique_ptr<InferenceEngine>()> InferenceEngineFactory;
+
+    /// @brief engines InferenceNode can create, by the "engine" name of its config
+    class InferenceEngineRegistry
+    {
+    public:
+        static InferenceEngineRegistry& Instance()
+        {
+            static InferenceEngineRegistry registry;
+            return registry;
+        }
+
+        /// @brief register an engine, registering the same name again replaces it
+        void Register(const std::string& name, const InferenceEngineFactory& factory)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_factories[name] = factory;
+        }
+
+        /// @brief nullptr for an unknown name
+        std::unique_ptr<InferenceEngine> Create(const std::string& name) const
+        {
+            InferenceEngineFactory factory;
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                auto it = m_factories.find(name);
+                if (it == m_factories.end())
+                    return nullptr;
+                factory = it->second;
+            }
+            return factory();
+        }
+
+    private:
+        InferenceEngineRegistry() = default;
+
+        mutable std::mutex m_lock;
+        std::map<std::string, InferenceEngineFactory> m_factories;
+    };
+
+    /// @brief registers an engine when the program loads
+    struct InferenceEngineRegistrar
+    {
+        InferenceEngineRegistrar(const std::string& name, const InferenceEngineFactory& factory)
+        {
+            InferenceEngineRegistry::Instance().Register(name, factory);
+        }
+    };
+}
+
+#define AX_INFERENCE_ENGINE_CONCAT_(a, b)   a##b
+#define AX_INFERENCE_ENGINE_CONCAT(a, b)    AX_INFERENCE_ENGINE_CONCAT_(a, b)
+
+/// @brief AX_REGISTER_INFERENCE_ENGINE("cpu", []() { return std::unique_ptr<ax::InferenceEngine>(new ax::CpuInferenceEngine); })
+#define AX_REGISTER_INFERENCE_ENGINE(name, ...) \
+    namespace { ax::InferenceEngineRegistrar AX_INFERENCE_ENGINE_CONCAT(s_inferenceEngineRegistrar, __COUNTER__)(name, __VA_ARGS__); }
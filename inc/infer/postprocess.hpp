@@ -0,0 +1,406 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AX_POST_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AX_POST_SSE2 1
+#endif
+
+#include "err.hpp"
+#include "tensor.hpp"
+#include "detections.hpp"
+
+namespace ax
+{
+    /// @brief how Postprocessor reads a YOLO style detection head
+    /// @details The output is float32 NCHW with the anchors along H x W and
+    ///     the attributes along C, one contiguous row per attribute:
+    ///     cx, cy, w, h, [objectness], class 0, class 1, ... like YOLOv8
+    ///     exports [1, 84, 8400]. Boxes are in model input pixels.
+    struct PostprocessParams
+    {
+        int classes;                // 0: every channel after box and objectness
+        bool objectness;            // a row of objectness before the classes, YOLOv5/X
+        bool sigmoid;               // scores are logits
+        bool xyxy;                  // boxes are corners instead of centre and size
+        float score_threshold;      // kept when score > threshold
+        float iou_threshold;        // suppressed when IoU > threshold
+        int top_k;                  // candidates entering NMS at most
+        int max_detections;
+        bool class_agnostic;        // NMS across classes
+
+        PostprocessParams():
+            classes(0),
+            objectness(false),
+            sigmoid(false),
+            xyxy(false),
+            score_threshold(0.25f),
+            iou_threshold(0.45f),
+            top_k(1000),
+            max_detections(100),
+            class_agnostic(false)
+        { }
+    };
+
+    namespace post
+    {
+        /// @brief anchors per pass of max_rows, best and label stay in L1
+        static const int TILE = 512;
+
+        struct Candidate
+        {
+            float score;
+            int32_t index;
+            int32_t label;
+        };
+
+        /// @brief higher score first, the lower anchor on ties so every path keeps the same order
+        inline bool before(const Candidate& a, const Candidate& b)
+        {
+            return a.score > b.score || (a.score == b.score && a.index < b.index);
+        }
+
+        inline float activate(float v, bool sigmoid)
+        {
+            return sigmoid ? 1.0f / (1.0f + expf(-v)) : v;
+        }
+
+        /// @brief best[i], label[i] = max and first argmax over classes of scores[c * stride + i]
+        /// @details the classes are streamed row by row over the n anchors,
+        ///     which stay in L1, so every row is read sequentially. Labels are
+        ///     kept as floats so they blend with the same masks.
+        inline void max_rows(const float* scores, size_t stride, int classes, int n, float* best, float* label, bool simd)
+        {
+            memcpy(best, scores, n * sizeof(float));
+            std::fill(label, label + n, 0.0f);
+            for (int c = 1; c < classes; c++)
+            {
+                const float* row = scores + c * stride;
+                int i = 0;
+#if AX_POST_SSE2
+                if (simd)
+                {
+                    __m128 lc = _mm_set1_ps((float)c);
+                    for (; i + 4 <= n; i += 4)
+                    {
+                        __m128 v = _mm_loadu_ps(row + i);
+                        __m128 b = _mm_loadu_ps(best + i);
+                        __m128 m = _mm_cmpgt_ps(v, b);
+                        _mm_storeu_ps(best + i, _mm_max_ps(b, v));
+                        _mm_storeu_ps(label + i, _mm_or_ps(_mm_and_ps(m, lc), _mm_andnot_ps(m, _mm_loadu_ps(label + i))));
+                    }
+                }
+#elif AX_POST_NEON
+                if (simd)
+                {
+                    float32x4_t lc = vdupq_n_f32((float)c);
+                    for (; i + 4 <= n; i += 4)
+                    {
+                        float32x4_t v = vld1q_f32(row + i);
+                        float32x4_t b = vld1q_f32(best + i);
+                        uint32x4_t m = vcgtq_f32(v, b);
+                        vst1q_f32(best + i, vmaxq_f32(b, v));
+                        vst1q_f32(label + i, vbslq_f32(m, lc, vld1q_f32(label + i)));
+                    }
+                }
+#endif
+                for (; i < n; i++)
+                {
+                    if (row[i] > best[i])
+                    {
+                        best[i] = row[i];
+                        label[i] = (float)c;
+                    }
+                }
+            }
+        }
+
+        /// @brief first anchor from i on whose best (and objectness) reach the prefilter, n if none
+        inline int next_above(const float* best, const float* obj, float pre, int i, int n, bool simd)
+        {
+#if AX_POST_SSE2
+            if (simd)
+            {
+                __m128 p = _mm_set1_ps(pre);
+                for (; i + 4 <= n; i += 4)
+                {
+                    __m128 m = _mm_cmpge_ps(_mm_loadu_ps(best + i), p);
+                    if (obj)
+                        m = _mm_and_ps(m, _mm_cmpge_ps(_mm_loadu_ps(obj + i), p));
+                    int bits = _mm_movemask_ps(m);
+                    if (bits)
+                        return i + __builtin_ctz(bits);
+                }
+            }
+#elif AX_POST_NEON
+            if (simd)
+            {
+                float32x4_t p = vdupq_n_f32(pre);
+                for (; i + 4 <= n; i += 4)
+                {
+                    uint32x4_t m = vcgeq_f32(vld1q_f32(best + i), p);
+                    if (obj)
+                        m = vandq_u32(m, vcgeq_f32(vld1q_f32(obj + i), p));
+                    uint32x2_t any = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+                    if (vget_lane_u32(any, 0) | vget_lane_u32(any, 1))
+                        break;
+                }
+            }
+#endif
+            for (; i < n; i++)
+            {
+                if (best[i] >= pre && (!obj || obj[i] >= pre))
+                    return i;
+            }
+            return n;
+        }
+
+        /// @brief boxes as separate arrays, padded to a multiple of 4 with empty boxes of label -1
+        struct Boxes
+        {
+            std::vector<float> x0;
+            std::vector<float> y0;
+            std::vector<float> x1;
+            std::vector<float> y1;
+            std::vector<float> area;
+            std::vector<float> label;
+            int count;
+
+            Boxes(): count(0) { }
+
+            void reset(int capacity)
+            {
+                size_t n = (capacity + 3) & ~3;
+                for (std::vector<float>* v : {&x0, &y0, &x1, &y1, &area})
+                    v->assign(n, 0.0f);
+                label.assign(n, -1.0f);
+                count = 0;
+            }
+
+            void push(float bx0, float by0, float bx1, float by1, float blabel)
+            {
+                x0[count] = bx0;
+                y0[count] = by0;
+                x1[count] = bx1;
+                y1[count] = by1;
+                area[count] = (bx1 - bx0) * (by1 - by0);
+                label[count] = blabel;
+                count++;
+            }
+        };
+
+        /// @brief whether a kept box of the same label (any if label < 0) overlaps the box by more than iou
+        /// @details IoU > t is tested as inter * (1 + t) > t * (a + b), no division.
+        inline bool overlaps(const Boxes& kept, float x0, float y0, float x1, float y1, float label, float iou, bool simd)
+        {
+            float area = (x1 - x0) * (y1 - y0);
+            int k = 0;
+#if AX_POST_SSE2
+            if (simd)
+            {
+                __m128 bx0 = _mm_set1_ps(x0), by0 = _mm_set1_ps(y0), bx1 = _mm_set1_ps(x1), by1 = _mm_set1_ps(y1);
+                __m128 barea = _mm_set1_ps(area), blabel = _mm_set1_ps(label);
+                __m128 t = _mm_set1_ps(iou), t1 = _mm_set1_ps(1 + iou), zero = _mm_setzero_ps();
+                for (; k < kept.count; k += 4)
+                {
+                    __m128 w = _mm_sub_ps(_mm_min_ps(bx1, _mm_loadu_ps(&kept.x1[k])), _mm_max_ps(bx0, _mm_loadu_ps(&kept.x0[k])));
+                    __m128 h = _mm_sub_ps(_mm_min_ps(by1, _mm_loadu_ps(&kept.y1[k])), _mm_max_ps(by0, _mm_loadu_ps(&kept.y0[k])));
+                    __m128 inter = _mm_mul_ps(_mm_max_ps(w, zero), _mm_max_ps(h, zero));
+                    __m128 m = _mm_cmpgt_ps(_mm_mul_ps(inter, t1), _mm_mul_ps(t, _mm_add_ps(barea, _mm_loadu_ps(&kept.area[k]))));
+                    if (label >= 0)
+                        m = _mm_and_ps(m, _mm_cmpeq_ps(blabel, _mm_loadu_ps(&kept.label[k])));
+                    if (_mm_movemask_ps(m))
+                        return true;
+                }
+                return false;
+            }
+#elif AX_POST_NEON
+            if (simd)
+            {
+                float32x4_t bx0 = vdupq_n_f32(x0), by0 = vdupq_n_f32(y0), bx1 = vdupq_n_f32(x1), by1 = vdupq_n_f32(y1);
+                float32x4_t barea = vdupq_n_f32(area), blabel = vdupq_n_f32(label);
+                float32x4_t t = vdupq_n_f32(iou), t1 = vdupq_n_f32(1 + iou), zero = vdupq_n_f32(0);
+                for (; k < kept.count; k += 4)
+                {
+                    float32x4_t w = vsubq_f32(vminq_f32(bx1, vld1q_f32(&kept.x1[k])), vmaxq_f32(bx0, vld1q_f32(&kept.x0[k])));
+                    float32x4_t h = vsubq_f32(vminq_f32(by1, vld1q_f32(&kept.y1[k])), vmaxq_f32(by0, vld1q_f32(&kept.y0[k])));
+                    float32x4_t inter = vmulq_f32(vmaxq_f32(w, zero), vmaxq_f32(h, zero));
+                    uint32x4_t m = vcgtq_f32(vmulq_f32(inter, t1), vmulq_f32(t, vaddq_f32(barea, vld1q_f32(&kept.area[k]))));
+                    if (label >= 0)
+                        m = vandq_u32(m, vceqq_f32(blabel, vld1q_f32(&kept.label[k])));
+                    uint32x2_t any = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+                    if (vget_lane_u32(any, 0) | vget_lane_u32(any, 1))
+                        return true;
+                }
+                return false;
+            }
+#endif
+            for (; k < kept.count; k++)
+            {
+                if (label >= 0 && kept.label[k] != label)
+                    continue;
+                float w = std::max(std::min(x1, kept.x1[k]) - std::max(x0, kept.x0[k]), 0.0f);
+                float h = std::max(std::min(y1, kept.y1[k]) - std::max(y0, kept.y0[k]), 0.0f);
+                float inter = w * h;
+                if (inter * (1 + iou) > iou * (area + kept.area[k]))
+                    return true;
+            }
+            return false;
+        }
+    }
+
+    /// @brief Detection head output to Detections: threshold, top K, NMS.
+    /// @details Per tile of anchors, the best class of every anchor is found
+    ///     streaming the class rows, and anchors below the threshold are
+    ///     skipped four at a time. Only the survivors get their exact score,
+    ///     so sigmoid is computed for few anchors. The top_k best are
+    ///     partially sorted, their boxes decoded into separate coordinate
+    ///     arrays, and greedy NMS compares each candidate with the kept boxes
+    ///     four at a time. It stops at max_detections. Boxes are mapped to the
+    ///     frame with Tensor::transform. Run may be called from several
+    ///     threads.
+    class Postprocessor
+    {
+    public:
+        explicit Postprocessor(const PostprocessParams& params):
+            m_params(params)
+        {
+            // sigmoid单调, 在logit空间预筛, 留出余量由精确分数决定
+            float t = std::min(std::max(params.score_threshold, 1e-6f), 1 - 1e-6f);
+            m_prefilter = params.sigmoid ? logf(t / (1 - t)) - 1e-3f : params.score_threshold;
+        }
+
+        const PostprocessParams& params() const { return m_params; }
+
+        /// @brief every item of a batched output, dets gets one Detections per item
+        int Run(const Tensor& output, std::vector<Detections>& dets, bool simd = true) const
+        {
+            dets.resize(std::max(output.batch, 0));
+            for (int b = 0; b < output.batch; b++)
+            {
+                int ret = Run(output, b, dets[b], simd);
+                if (ret != AX_SUCCESS)
+                    return ret;
+            }
+            return AX_SUCCESS;
+        }
+
+        /// @brief item index of a batched output
+        /// @param simd false runs the scalar code, for comparisons
+        int Run(const Tensor& output, int index, Detections& dets, bool simd = true) const
+        {
+            dets.pts = output.pts;
+            dets.boxes.clear();
+            if (!output.valid() || index < 0 || index >= output.batch)
+                return AX_ERR_NULL_PTR;
+            int first = 4 + (m_params.objectness ? 1 : 0);
+            int classes = m_params.classes > 0 ? m_params.classes : output.channels - first;
+            if (output.type != TENSOR_TYPE_FLOAT32 || output.layout != TENSOR_LAYOUT_NCHW
+                || classes <= 0 || first + classes > output.channels)
+                return AX_ERR_ILLEGAL_PARAM;
+
+            const PostprocessParams& p = m_params;
+            size_t n = (size_t)output.height * output.width;
+            const float* rows = (const float*)(output.data + output.item_bytes() * index);
+            const float* obj = p.objectness ? rows + 4 * n : nullptr;
+            const float* scores = rows + first * n;
+
+            Scratch& s = scratch();
+            s.candidates.clear();
+            for (size_t base = 0; base < n; base += post::TILE)
+            {
+                int m = (int)std::min((size_t)post::TILE, n - base);
+                post::max_rows(scores + base, n, classes, m, s.best, s.label, simd);
+                const float* tile_obj = obj ? obj + base : nullptr;
+                for (int i = post::next_above(s.best, tile_obj, m_prefilter, 0, m, simd); i < m;
+                    i = post::next_above(s.best, tile_obj, m_prefilter, i + 1, m, simd))
+                {
+                    float score = post::activate(s.best[i], p.sigmoid);
+                    if (tile_obj)
+                        score *= post::activate(tile_obj[i], p.sigmoid);
+                    if (score > p.score_threshold)
+                        s.candidates.push_back(post::Candidate{score, (int32_t)(base + i), (int32_t)s.label[i]});
+                }
+            }
+
+            // 只对前top_k部分排序
+            std::vector<post::Candidate>& c = s.candidates;
+            if (p.top_k > 0 && (int)c.size() > p.top_k)
+            {
+                std::nth_element(c.begin(), c.begin() + p.top_k, c.end(), post::before);
+                c.resize(p.top_k);
+            }
+            std::sort(c.begin(), c.end(), post::before);
+
+            int limit = p.max_detections > 0 ? p.max_detections : (int)c.size();
+            s.kept.reset(std::min(limit, (int)c.size()));
+            for (const post::Candidate& cand : c)
+            {
+                float x0, y0, x1, y1;
+                box(rows, n, cand.index, x0, y0, x1, y1);
+                float label = p.class_agnostic ? -1.0f : (float)cand.label;
+                if (post::overlaps(s.kept, x0, y0, x1, y1, label, p.iou_threshold, simd))
+                    continue;
+                s.kept.push(x0, y0, x1, y1, label);
+
+                Detection d;
+                d.x0 = output.transform.source_x(x0);
+                d.y0 = output.transform.source_y(y0);
+                d.x1 = output.transform.source_x(x1);
+                d.y1 = output.transform.source_y(y1);
+                d.score = cand.score;
+                d.label = cand.label;
+                d.track = -1;
+                dets.boxes.push_back(d);
+                if (s.kept.count >= limit)
+                    break;
+            }
+            return AX_SUCCESS;
+        }
+
+    private:
+        struct Scratch
+        {
+            float best[post::TILE];
+            float label[post::TILE];
+            std::vector<post::Candidate> candidates;
+            post::Boxes kept;
+        };
+
+        static Scratch& scratch()
+        {
+            // 每线程一份, 多个节点实例共用
+            static thread_local Scratch s;
+            return s;
+        }
+
+        void box(const float* rows, size_t n, int i, float& x0, float& y0, float& x1, float& y1) const
+        {
+            float a = rows[i], b = rows[n + i], c = rows[2 * n + i], d = rows[3 * n + i];
+            if (m_params.xyxy)
+            {
+                x0 = a;
+                y0 = b;
+                x1 = c;
+                y1 = d;
+                return;
+            }
+            x0 = a - c * 0.5f;
+            y0 = b - d * 0.5f;
+            x1 = a + c * 0.5f;
+            y1 = b + d * 0.5f;
+        }
+
+        PostprocessParams m_params;
+        float m_prefilter;
+    };
+}
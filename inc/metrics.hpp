@@ -0,0 +1,454 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <map>
+#include <set>
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "json/json.h"
+
+namespace ax
+{
+    /// @brief monotonic count, relaxed increments from any thread
+    class Counter
+    {
+    public:
+        Counter(): m_value(0) { }
+
+        void add(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> m_value;
+    };
+
+    /// @brief current value and the peak it reached
+    class Gauge
+    {
+    public:
+        Gauge(): m_value(0), m_peak(0) { }
+
+        void set(int64_t v)
+        {
+            m_value.store(v, std::memory_order_relaxed);
+            int64_t peak = m_peak.load(std::memory_order_relaxed);
+            while (v > peak && !m_peak.compare_exchange_weak(peak, v, std::memory_order_relaxed))
+                ;
+        }
+
+        int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+        int64_t peak() const { return m_peak.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> m_value;
+        std::atomic<int64_t> m_peak;
+    };
+
+    /// @brief durations in power of two microsecond buckets,
+    ///     bucket i counts [2^(i-1), 2^i) us, the last one everything above
+    class Histogram
+    {
+    public:
+        enum { NUM_BUCKETS = 26 };     // up to ~33 s
+
+        Histogram(): m_count(0), m_sum(0)
+        {
+            for (int i = 0; i < NUM_BUCKETS; i++)
+                m_buckets[i].store(0, std::memory_order_relaxed);
+        }
+
+        void record(uint64_t us)
+        {
+            int idx = 0;
+            while (idx < NUM_BUCKETS - 1 && us >= (1ull << idx))
+                idx++;
+            m_buckets[idx].fetch_add(1, std::memory_order_relaxed);
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            m_sum.fetch_add(us, std::memory_order_relaxed);
+        }
+
+        uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+        uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+        uint64_t bucket(int i) const { return m_buckets[i].load(std::memory_order_relaxed); }
+
+        /// @brief upper bound in us of the bucket holding quantile q (0..1)
+        uint64_t quantile(double q) const
+        {
+            uint64_t total = count();
+            if (total == 0)
+                return 0;
+            uint64_t rank = (uint64_t)(q * total);
+            uint64_t seen = 0;
+            for (int i = 0; i < NUM_BUCKETS; i++)
+            {
+                seen += bucket(i);
+                if (seen > rank)
+                    return 1ull << i;
+            }
+            return 1ull << (NUM_BUCKETS - 1);
+        }
+
+    private:
+        std::atomic<uint64_t> m_buckets[NUM_BUCKETS];
+        std::atomic<uint64_t> m_count;
+        std::atomic<uint64_t> m_sum;
+    };
+
+    /// @brief recorded by a Stream
+    struct StreamMetrics
+    {
+        Counter pushed;
+        Counter popped;
+        Counter dropped;        // by the drop policy
+        Gauge depth;
+        Counter push_wait_us;   // producers blocked on a full stream
+        Counter pop_wait_us;    // consumers waiting on an empty stream
+    };
+
+    /// @brief recorded by a Node and its ports
+    struct NodeMetrics
+    {
+        Counter packets_in;
+        Counter packets_out;
+        Counter busy_us;
+        Histogram process_us;   // per Process call or timed section
+
+        /// @brief adds the lifetime of the scope to busy time and the histogram
+        class ScopedTimer
+        {
+        public:
+            ScopedTimer(NodeMetrics& metrics):
+                m_metrics(metrics),
+                m_start(std::chrono::steady_clock::now())
+            { }
+
+            ~ScopedTimer()
+            {
+                uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+                m_metrics.busy_us.add(us);
+                m_metrics.process_us.record(us);
+            }
+
+        private:
+            NodeMetrics& m_metrics;
+            std::chrono::steady_clock::time_point m_start;
+        };
+    };
+
+    /// @brief Names the metrics of nodes and streams for snapshots
+    /// @details Recording only touches the atomics owned by the node or
+    ///     stream, the registry keeps weak references taken when a pipeline
+    ///     starts and skips metrics whose owner is gone.
+    class MetricsRegistry
+    {
+    public:
+        static MetricsRegistry& Instance()
+        {
+            static MetricsRegistry registry;
+            return registry;
+        }
+
+        void AddNode(const std::string& name, const std::shared_ptr<NodeMetrics>& metrics)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_nodes[name] = metrics;
+        }
+
+        void AddStream(const std::string& name, const std::shared_ptr<StreamMetrics>& metrics)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_streams[name] = metrics;
+        }
+
+        /// @brief values published by other modules, e.g. RTSP servers
+        /// @param family   group of the values, e.g. "rtsp"
+        /// @param instance who publishes them, e.g. the node name
+        /// @param collect  fills an object of numbers, called on every snapshot
+        ///     from the scraping thread, must not block
+        /// @param counters values of the object that only grow, exported as
+        ///     counters instead of gauges
+        void AddSource(const std::string& family, const std::string& instance, const std::function<void(Json::Value&)>& collect,
+                       const std::set<std::string>& counters = std::set<std::string>())
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            Source& source = m_sources[std::make_pair(family, instance)];
+            source.collect = collect;
+            source.counters = counters;
+        }
+
+        void RemoveSource(const std::string& family, const std::string& instance)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_sources.erase(std::make_pair(family, instance));
+        }
+
+        /// @brief {"nodes": {name: {...}}, "streams": {name: {...}}, "<family>": {instance: {...}}}
+        Json::Value Snapshot()
+        {
+            Json::Value snapshot(Json::objectValue);
+            SourceMap sources;
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                for (auto it = m_nodes.begin(); it != m_nodes.end();)
+                {
+                    auto m = it->second.lock();
+                    if (!m)
+                    {
+                        it = m_nodes.erase(it);
+                        continue;
+                    }
+                    Json::Value& n = snapshot["nodes"][it->first];
+                    n["packets_in"] = (Json::UInt64)m->packets_in.value();
+                    n["packets_out"] = (Json::UInt64)m->packets_out.value();
+                    n["busy_us"] = (Json::UInt64)m->busy_us.value();
+                    n["calls"] = (Json::UInt64)m->process_us.count();
+                    n["process_us_sum"] = (Json::UInt64)m->process_us.sum();
+                    n["process_us_p50"] = (Json::UInt64)m->process_us.quantile(0.5);
+                    n["process_us_p99"] = (Json::UInt64)m->process_us.quantile(0.99);
+                    Json::Value& buckets = n["process_us_buckets"];
+                    buckets = Json::Value(Json::arrayValue);
+                    for (int i = 0; i < Histogram::NUM_BUCKETS; i++)
+                        buckets.append((Json::UInt64)m->process_us.bucket(i));
+                    ++it;
+                }
+
+                for (auto it = m_streams.begin(); it != m_streams.end();)
+                {
+                    auto m = it->second.lock();
+                    if (!m)
+                    {
+                        it = m_streams.erase(it);
+                        continue;
+                    }
+                    Json::Value& s = snapshot["streams"][it->first];
+                    s["pushed"] = (Json::UInt64)m->pushed.value();
+                    s["popped"] = (Json::UInt64)m->popped.value();
+                    s["dropped"] = (Json::UInt64)m->dropped.value();
+                    s["depth"] = (Json::Int64)m->depth.value();
+                    s["peak_depth"] = (Json::Int64)m->depth.peak();
+                    s["push_wait_us"] = (Json::UInt64)m->push_wait_us.value();
+                    s["pop_wait_us"] = (Json::UInt64)m->pop_wait_us.value();
+                    ++it;
+                }
+                sources = m_sources;
+            }
+
+            for (const auto& src : sources)
+                src.second.collect(snapshot[src.first.first][src.first.second]);
+            return snapshot;
+        }
+
+        std::string Dump()
+        {
+            Json::StreamWriterBuilder builder;
+            builder["indentation"] = "  ";
+            return Json::writeString(builder, Snapshot());
+        }
+
+        /// @brief snapshot in the Prometheus text exposition format
+        /// @details ax_node_*{node=...}, ax_stream_*{stream=...} and
+        ///     ax_<family>_<value>{name="<instance>"} for the sources, with a
+        ///     _total suffix for the values their publisher marked as counters
+        std::string Prometheus()
+        {
+            Json::Value snapshot = Snapshot();
+            std::map<std::string, std::set<std::string>> counters;
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                for (const auto& src : m_sources)
+                    counters[src.first.first].insert(src.second.counters.begin(), src.second.counters.end());
+            }
+            std::string out;
+
+            static const char* node_counters[][2] = {
+                {"packets_in", "packets taken from the input ports"},
+                {"packets_out", "packets sent on the output ports"},
+                {"busy_us", "microseconds spent processing"}};
+            for (const auto& c : node_counters)
+            {
+                Family(out, std::string("ax_node_") + c[0] + "_total", "counter", c[1]);
+                for (const auto& name : snapshot["nodes"].getMemberNames())
+                    Sample(out, std::string("ax_node_") + c[0] + "_total", "node", name, "", snapshot["nodes"][name][c[0]].asUInt64());
+            }
+
+            Family(out, "ax_node_process_us", "histogram", "microseconds per Process call");
+            for (const auto& name : snapshot["nodes"].getMemberNames())
+            {
+                const Json::Value& n = snapshot["nodes"][name];
+                uint64_t cumulative = 0;
+                for (int i = 0; i < Histogram::NUM_BUCKETS; i++)
+                {
+                    cumulative += n["process_us_buckets"][i].asUInt64();
+                    std::string le = i == Histogram::NUM_BUCKETS - 1 ? "+Inf" : std::to_string((1ull << i) - 1);
+                    Sample(out, "ax_node_process_us_bucket", "node", name, ",le=\"" + le + "\"", cumulative);
+                }
+                Sample(out, "ax_node_process_us_sum", "node", name, "", n["process_us_sum"].asUInt64());
+                Sample(out, "ax_node_process_us_count", "node", name, "", n["calls"].asUInt64());
+            }
+
+            static const char* stream_values[][3] = {
+                {"pushed_total", "counter", "packets pushed"},
+                {"popped_total", "counter", "packets popped"},
+                {"dropped_total", "counter", "packets dropped by the stream policy"},
+                {"depth", "gauge", "packets queued"},
+                {"peak_depth", "gauge", "most packets queued at once"},
+                {"push_wait_us_total", "counter", "microseconds producers waited for room"},
+                {"pop_wait_us_total", "counter", "microseconds consumers waited for packets"}};
+            for (const auto& v : stream_values)
+            {
+                std::string key = v[0];
+                if (key.size() > 6 && key.compare(key.size() - 6, 6, "_total") == 0)
+                    key = key.substr(0, key.size() - 6);
+                Family(out, std::string("ax_stream_") + v[0], v[1], v[2]);
+                for (const auto& name : snapshot["streams"].getMemberNames())
+                    Sample(out, std::string("ax_stream_") + v[0], "stream", name, "", snapshot["streams"][name][key].asUInt64());
+            }
+
+            for (const auto& family : snapshot.getMemberNames())
+            {
+                if (family == "nodes" || family == "streams")
+                    continue;
+                std::set<std::string> values;
+                for (const auto& instance : snapshot[family].getMemberNames())
+                {
+                    for (const auto& v : snapshot[family][instance].getMemberNames())
+                        values.insert(v);
+                }
+                for (const auto& v : values)
+                {
+                    bool counter = counters[family].count(v) > 0;
+                    std::string metric = "ax_" + family + "_" + v + (counter ? "_total" : "");
+                    Family(out, metric, counter ? "counter" : "gauge", "");
+                    for (const auto& instance : snapshot[family].getMemberNames())
+                    {
+                        const Json::Value& value = snapshot[family][instance][v];
+                        if (value.isNumeric())
+                            Sample(out, metric, "name", instance, "", Number(value));
+                    }
+                }
+            }
+            return out;
+        }
+
+    private:
+        struct Source
+        {
+            std::function<void(Json::Value&)> collect;
+            std::set<std::string> counters;
+        };
+        typedef std::map<std::pair<std::string, std::string>, Source> SourceMap;
+
+        MetricsRegistry() = default;
+
+        static void Family(std::string& out, const std::string& metric, const char* type, const char* help)
+        {
+            if (help[0])
+                out += "# HELP " + metric + " " + help + "\n";
+            out += "# TYPE " + metric + " " + type + "\n";
+        }
+
+        /// @brief integers exactly, other numbers as doubles, e.g. averages or negative gauges
+        static std::string Number(const Json::Value& value)
+        {
+            if (value.isUInt64())
+                return std::to_string(value.asUInt64());
+            if (value.isInt64())
+                return std::to_string(value.asInt64());
+
+            double d = value.asDouble();
+            if (std::isnan(d))
+                return "NaN";
+            if (std::isinf(d))
+                return d > 0 ? "+Inf" : "-Inf";
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%.17g", d);
+            return buf;
+        }
+
+        static void Sample(std::string& out, const std::string& metric, const char* label,
+                           const std::string& value, const std::string& extra_labels, uint64_t sample)
+        {
+            Sample(out, metric, label, value, extra_labels, std::to_string(sample));
+        }
+
+        static void Sample(std::string& out, const std::string& metric, const char* label,
+                           const std::string& value, const std::string& extra_labels, const std::string& sample)
+        {
+            out += metric + "{" + label + "=\"";
+            for (char c : value)
+            {
+                if (c == '\\' || c == '"')
+                    out += '\\';
+                if (c == '\n')
+                    out += "\\n";
+                else
+                    out += c;
+            }
+            out += "\"" + extra_labels + "} " + sample + "\n";
+        }
+
+        std::mutex m_lock;      // registration and snapshots only
+        std::map<std::string, std::weak_ptr<NodeMetrics>> m_nodes;
+        std::map<std::string, std::weak_ptr<StreamMetrics>> m_streams;
+        SourceMap m_sources;
+    };
+
+    /// @brief Stats of a module published as a MetricsRegistry source
+    /// @details Owns a T of atomics written by the module's threads and
+    ///     read lock free by the scraping thread. The registered collector
+    ///     holds a weak reference, so a snapshot racing with the owner's
+    ///     destruction skips it; the source is removed on destruction.
+    template <typename T>
+    class MetricsSource
+    {
+    public:
+        MetricsSource(): m_stats(std::make_shared<T>()) { }
+
+        ~MetricsSource() { Remove(); }
+
+        /// @brief register as family/instance, replacing an earlier registration
+        /// @param collect  fills an object of numbers from the stats, see AddSource
+        /// @param counters values of the object exported as counters
+        void Publish(const std::string& family, const std::string& instance, const std::function<void(const T&, Json::Value&)>& collect,
+                     const std::set<std::string>& counters = std::set<std::string>())
+        {
+            Remove();
+            m_family = family;
+            m_instance = instance;
+
+            std::weak_ptr<T> weak = m_stats;
+            MetricsRegistry::Instance().AddSource(family, instance, [weak, collect](Json::Value& out) {
+                auto st = weak.lock();
+                if (st)
+                    collect(*st, out);
+            }, counters);
+        }
+
+        void Remove()
+        {
+            if (m_family.empty())
+                return;
+            MetricsRegistry::Instance().RemoveSource(m_family, m_instance);
+            m_family.clear();
+        }
+
+        T* operator->() const { return m_stats.get(); }
+        T& operator*() const { return *m_stats; }
+
+    private:
+        MetricsSource(const MetricsSource&) = delete;
+        MetricsSource& operator=(const MetricsSource&) = delete;
+
+        std::shared_ptr<T> m_stats;
+        std::string m_family;
+        std::string m_instance;
+    };
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+
+#include "err.hpp"
+#include "metrics.hpp"
+#include "thread_utils.hpp"
+
+namespace ax
+{
+    /// @brief Minimal HTTP responder for MetricsRegistry, for Prometheus scrapes
+    /// @details Serves GET /metrics in the Prometheus text format and
+    ///     GET /metrics.json as the JSON dump, one connection at a time on its
+    ///     own thread. Counters are read with relaxed loads, a scrape never
+    ///     takes a lock on the packet path.
+    class MetricsServer
+    {
+    public:
+        MetricsServer():
+            m_fd(-1),
+            m_isRunning(false)
+        { }
+
+        ~MetricsServer()
+        {
+            Stop();
+        }
+
+        /// @param address  "9100" or "127.0.0.1:9100" for TCP, "unix:/run/ax_metrics.sock" for a Unix socket
+        int Start(const std::string& address)
+        {
+            if (m_isRunning)
+                return AX_SUCCESS;
+
+            m_fd = Listen(address);
+            if (m_fd < 0)
+                return AX_ERR_INIT_FAIL;
+
+            m_isRunning = true;
+            m_thread = std::thread(&MetricsServer::Loop, this);
+            printf("metrics served on %s\n", address.c_str());
+            return AX_SUCCESS;
+        }
+
+        void Stop()
+        {
+            if (!m_isRunning)
+                return;
+
+            m_isRunning = false;
+            if (m_thread.joinable())
+                m_thread.join();
+            close(m_fd);
+            m_fd = -1;
+            if (!m_unixPath.empty())
+            {
+                unlink(m_unixPath.c_str());
+                m_unixPath.clear();
+            }
+        }
+
+    private:
+        int Listen(const std::string& address)
+        {
+            int fd = -1;
+            if (address.compare(0, 5, "unix:") == 0)
+            {
+                struct sockaddr_un addr;
+                memset(&addr, 0, sizeof(addr));
+                addr.sun_family = AF_UNIX;
+                std::string path = address.substr(5);
+                if (path.empty() || path.size() >= sizeof(addr.sun_path))
+                {
+                    printf("bad metrics socket path \"%s\"\n", path.c_str());
+                    return -1;
+                }
+                strcpy(addr.sun_path, path.c_str());
+
+                fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                unlink(path.c_str());   // left by a previous run
+                if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+                {
+                    printf("bind metrics socket %s failed: %s\n", path.c_str(), strerror(errno));
+                    if (fd >= 0)
+                        close(fd);
+                    return -1;
+                }
+                m_unixPath = path;
+            }
+            else
+            {
+                struct sockaddr_in addr;
+                memset(&addr, 0, sizeof(addr));
+                addr.sin_family = AF_INET;
+                addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+                std::string port = address;
+                size_t pos = address.rfind(':');
+                if (pos != std::string::npos)
+                {
+                    port = address.substr(pos + 1);
+                    if (inet_pton(AF_INET, address.substr(0, pos).c_str(), &addr.sin_addr) != 1)
+                    {
+                        printf("bad metrics address \"%s\"\n", address.c_str());
+                        return -1;
+                    }
+                }
+                addr.sin_port = htons((uint16_t)atoi(port.c_str()));
+
+                fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                int on = 1;
+                if (fd >= 0)
+                    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+                if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+                {
+                    printf("bind metrics address %s failed: %s\n", address.c_str(), strerror(errno));
+                    if (fd >= 0)
+                        close(fd);
+                    return -1;
+                }
+            }
+
+            if (listen(fd, 8) != 0)
+            {
+                printf("listen on metrics address %s failed: %s\n", address.c_str(), strerror(errno));
+                close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+        void Loop()
+        {
+            utils::set_thread_name("ax_metrics");
+            while (m_isRunning)
+            {
+                // wake up regularly to notice Stop
+                struct pollfd pfd = { m_fd, POLLIN, 0 };
+                if (poll(&pfd, 1, 200) <= 0)
+                    continue;
+
+                int client = accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (client < 0)
+                    continue;
+                Serve(client);
+                close(client);
+            }
+        }
+
+        void Serve(int client)
+        {
+            // a stalled scraper must not hold the thread
+            struct timeval tv = { 1, 0 };
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+            std::string request;
+            char buf[1024];
+            while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192)
+            {
+                ssize_t n = recv(client, buf, sizeof(buf), 0);
+                if (n <= 0)
+                    break;
+                request.append(buf, n);
+            }
+
+            std::string path;
+            if (request.compare(0, 4, "GET ") == 0)
+                path = request.substr(4, request.find(' ', 4) - 4);
+
+            if (path == "/metrics" || path == "/")
+                Reply(client, "200 OK", "text/plain; version=0.0.4", MetricsRegistry::Instance().Prometheus());
+            else if (path == "/metrics.json")
+                Reply(client, "200 OK", "application/json", MetricsRegistry::Instance().Dump());
+            else
+                Reply(client, "404 Not Found", "text/plain", "not found\n");
+        }
+
+        static void Reply(int client, const char* status, const char* type, const std::string& body)
+        {
+            std::string response = std::string("HTTP/1.0 ") + status + "\r\n"
+                "Content-Type: " + type + "\r\n"
+                "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                "Connection: close\r\n\r\n" + body;
+
+            size_t sent = 0;
+            while (sent < response.size())
+            {
+                ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0)
+                    return;
+                sent += n;
+            }
+        }
+
+    private:
+        int m_fd;
+        std::atomic<bool> m_isRunning;
+        std::thread m_thread;
+        std::string m_unixPath;
+    };
+}
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
 #include "json/json.h"
 
 #include "port.hpp"
@@ -14,26 +20,205 @@ namespace ax
     {
     public:        
         Node():
-            m_isRunning(false)
+            m_metrics(std::make_shared<NodeMetrics>()),
+            m_traceId(0),
+            m_isRunning(false),
+            m_parallelism(1),
+            m_takeSeq(0),
+            m_releaseSeq(0)
         { }
 
-        ~Node() = default;
+        virtual ~Node() = default;
 
         Node(const std::string& name):
             m_name(name),
-            m_isRunning(false)
+            m_metrics(std::make_shared<NodeMetrics>()),
+            m_traceId(0),
+            m_isRunning(false),
+            m_parallelism(1),
+            m_takeSeq(0),
+            m_releaseSeq(0)
         { }
 
         const char* name() const { return m_name.c_str(); }
 
+        /// @brief rename before the node is added to a pipeline
+        void SetName(const std::string& name) { m_name = name; }
+
         void SetRunning() { m_isRunning = true; }
 
+        /// @brief declare ports and read the config, must not block
         virtual int Init(const Json::Value& config) = 0;
 
-        virtual int Run() = 0;
+        /// @brief slow part of initialisation, e.g. a network handshake
+        /// @details run on its own thread concurrently with the other nodes,
+        ///     retried until it succeeds, Run is only called afterwards
+        virtual int Prepare() { return AX_SUCCESS; }
 
+        /// @brief thread mode entry, the default polls the input ports and calls Process
+        virtual int Run()
+        {
+            std::vector<Packet> inputs;
+            uint64_t seq;
+            while (m_isRunning)
+            {
+                if (!TakeInputs(inputs, seq))
+                {
+                    WaitInputs(100);
+                    continue;
+                }
+                Dispatch(inputs, seq);
+            }
+            return AX_SUCCESS;
+        }
+
+        /// @brief ask Run to return, the pipeline closes the streams to wake it
         virtual void Stop() { m_isRunning = false; }
 
+        bool IsRunning() const { return m_isRunning; }
+
+        /// @brief packets in and out of the ports, time spent in Process,
+        ///     Run loops time their own work with NodeMetrics::ScopedTimer
+        const std::shared_ptr<NodeMetrics>& metrics() const { return m_metrics; }
+
+        /// @brief Tracer id stamped on the traces of packets through the node, call after Init
+        void SetTraceId(uint16_t id)
+        {
+            m_traceId = id;
+            for (auto& p : m_inputPorts)
+                p->set_trace_id(id);
+            for (auto& p : m_outputPorts)
+                p->set_trace_id(id);
+        }
+
+        /// @brief event mode entry, called with one packet per input port in port order
+        /// @details runs on up to Parallelism() workers at once, must then be
+        ///     safe to call concurrently. Outputs keep the order of the inputs.
+        virtual int Process(std::vector<Packet>&) { return AX_ERR_ILLEGAL_PARAM; }
+
+        /// @brief nodes implementing Process can be dispatched by the scheduler,
+        ///     the others keep their own Run thread
+        virtual bool Schedulable() const { return false; }
+
+        int Parallelism() const { return m_parallelism; }
+        /// @brief call before the node starts
+        void SetParallelism(int n) { m_parallelism = n > 0 ? n : 1; }
+
+        /// @brief every input port has a packet waiting
+        bool InputsReady() const
+        {
+            if (m_inputPorts.empty())
+                return false;
+            for (const auto& p : m_inputPorts)
+            {
+                auto s = p->stream();
+                if (!s || s->empty())
+                    return false;
+            }
+            return true;
+        }
+
+        /// @brief some output stream is full, a send would block or overflow it
+        bool OutputsFull() const
+        {
+            for (const auto& p : m_outputPorts)
+            {
+                for (const auto& s : p->streams())
+                {
+                    if (s->full())
+                        return true;
+                }
+            }
+            return false;
+        }
+
+        /// @brief block until an empty input port gets a packet, its stream is closed or timeout
+        void WaitInputs(int timeout)
+        {
+            for (const auto& p : m_inputPorts)
+            {
+                auto s = p->stream();
+                if (!s || s->closed())
+                    break;
+                if (s->empty())
+                {
+                    s->wait(timeout);
+                    return;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        /// @brief pop one packet from every input port, all or nothing
+        /// @param seq  order of this input set, passed back to Dispatch
+        bool TakeInputs(std::vector<Packet>& inputs, uint64_t& seq)
+        {
+            std::lock_guard<std::mutex> lg(m_inputLock);
+            if (!InputsReady())
+                return false;
+
+            inputs.resize(m_inputPorts.size());
+            for (size_t i = 0; i < m_inputPorts.size(); i++)
+            {
+                const auto& port = m_inputPorts[i];
+                if (port->batch() > 1)
+                {
+                    PacketBatch batch;
+                    if (port->stream()->pop_batch(batch, port->batch()) != AX_SUCCESS)
+                        return false;
+                    m_metrics->packets_in.add(batch.size());
+                    inputs[i] = Packet(batch);
+                }
+                else if (port->take(inputs[i]) != AX_SUCCESS)
+                    return false;
+            }
+            seq = m_takeSeq++;
+
+            // the first input carries the trace on, the first packet of a batch
+            const Packet& lead = inputs[0].isType<PacketBatch>() ? inputs[0].get<PacketBatch>()[0] : inputs[0];
+            TraceCursor::Enter(lead, m_traceId);
+            return true;
+        }
+
+        /// @brief call Process, with parallelism above 1 its sends are held
+        ///     back and released in input order
+        int Dispatch(std::vector<Packet>& inputs, uint64_t seq)
+        {
+            if (m_parallelism <= 1)
+            {
+                m_releaseSeq = seq + 1;
+                int ret;
+                {
+                    NodeMetrics::ScopedTimer timer(*m_metrics);
+                    ret = Process(inputs);
+                }
+                TraceCursor::End();
+                return ret;
+            }
+
+            OutputCapture capture;
+            current_output_capture() = &capture;
+            int ret;
+            {
+                NodeMetrics::ScopedTimer timer(*m_metrics);
+                ret = Process(inputs);
+            }
+            current_output_capture() = nullptr;
+            TraceCursor::End();
+
+            // the call holding the oldest sequence sends for every completed one after it
+            std::lock_guard<std::mutex> lg(m_orderLock);
+            m_reorder[seq].swap(capture.packets);
+            while (!m_reorder.empty() && m_reorder.begin()->first == m_releaseSeq)
+            {
+                for (auto& out : m_reorder.begin()->second)
+                    out.first->send_now(out.second);
+                m_reorder.erase(m_reorder.begin());
+                m_releaseSeq++;
+            }
+            return ret;
+        }
+
         int GetInputPortNum() const { return m_inputPorts.size(); }
         int GetOutputPortNum() const { return m_outputPorts.size(); }
 
@@ -79,6 +264,7 @@ namespace ax
                 return false;
             
             auto iport = std::make_shared<InputPort>(port_name);
+            iport->set_metrics(m_metrics);
             m_inputPorts.push_back(iport);
             return true;
         }
@@ -89,6 +275,7 @@ namespace ax
                 return false;
 
             auto oport = std::make_shared<OutputPort>(port_name);
+            oport->set_metrics(m_metrics);
             m_outputPorts.push_back(oport);
             return true;
         }
@@ -153,6 +340,16 @@ namespace ax
         std::string m_name;
         std::vector<InputPortPtr> m_inputPorts;
         std::vector<OutputPortPtr> m_outputPorts;
-        bool m_isRunning;
+        std::shared_ptr<NodeMetrics> m_metrics;
+        uint16_t m_traceId;
+        std::atomic<bool> m_isRunning;
+        int m_parallelism;
+        std::mutex m_inputLock;     // inputs are taken by one worker at a time
+        uint64_t m_takeSeq;
+
+        // outputs of calls finished ahead of an older one
+        std::mutex m_orderLock;
+        uint64_t m_releaseSeq;
+        std::map<uint64_t, std::vector<std::pair<OutputPort*, Packet>>> m_reorder;
     };
 } // namespace ppl
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "node.hpp"
+
+namespace ax
+{
+    /// @brief creates a node from its entry in the graph config
+    typedef std::function<std::shared_ptr<Node>(const Json::Value& node_config)> NodeFactory;
+
+    /// @brief Node types available to PipelineBuilder, by type name
+    class NodeRegistry
+    {
+    public:
+        static NodeRegistry& Instance()
+        {
+            static NodeRegistry registry;
+            return registry;
+        }
+
+        /// @brief register a type, registering the same name again replaces it
+        void Register(const std::string& type, const NodeFactory& factory)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_factories[type] = factory;
+        }
+
+        bool Has(const std::string& type) const
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            return m_factories.count(type) > 0;
+        }
+
+        std::vector<std::string> Types() const
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            std::vector<std::string> types;
+            for (const auto& f : m_factories)
+                types.push_back(f.first);
+            return types;
+        }
+
+        /// @brief create a node of type named name, nullptr for an unknown type
+        std::shared_ptr<Node> Create(const std::string& type, const std::string& name, const Json::Value& node_config) const
+        {
+            NodeFactory factory;
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                auto it = m_factories.find(type);
+                if (it == m_factories.end())
+                    return nullptr;
+                factory = it->second;
+            }
+
+            std::shared_ptr<Node> node = factory(node_config);
+            if (node)
+                node->SetName(name);
+            return node;
+        }
+
+    private:
+        NodeRegistry() = default;
+
+        mutable std::mutex m_lock;
+        std::map<std::string, NodeFactory> m_factories;
+    };
+
+    /// @brief registers a node type when the program loads
+    struct NodeRegistrar
+    {
+        NodeRegistrar(const std::string& type, const NodeFactory& factory)
+        {
+            NodeRegistry::Instance().Register(type, factory);
+        }
+    };
+}
+
+#define AX_NODE_REGISTRAR_CONCAT_(a, b)     a##b
+#define AX_NODE_REGISTRAR_CONCAT(a, b)      AX_NODE_REGISTRAR_CONCAT_(a, b)
+
+/// @brief AX_REGISTER_NODE("RTSPPush", [](const Json::Value&) { return std::make_shared<ax::RTSPPushNode>(); })
+#define AX_REGISTER_NODE(type, ...) \
+    namespace { ax::NodeRegistrar AX_NODE_REGISTRAR_CONCAT(s_nodeRegistrar, __COUNTER__)(type, __VA_ARGS__); }
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+
+#include "node.hpp"
+#include "node_registry.hpp"
+
+#include "codec/annexb_file.hpp"
+
+namespace ax
+{
+    /// @brief Plays an H.264/H.265 elementary stream file as AccessUnit packets.
+    /// @details {"file": "cam0.264", "codec": "h264", "fps": 25, "rate": 1, "loop": true}
+    ///     "codec" defaults to the file extension. "rate" 1 is real time,
+    ///     4 is 4x, 0 is as fast as the consumer takes them. Units carry
+    ///     the same bytes RTSPClient hands RTSPPullNode, so a recorded
+    ///     camera stream replays the decode and push paths without a network.
+    class AnnexBFileSourceNode : public Node
+    {
+    private:
+        std::string m_path;
+        AnnexBFile m_file;
+        double m_fps;
+        double m_rate;
+        bool m_loop;
+
+    public:
+        AnnexBFileSourceNode():
+            Node("AnnexB_File_Source"),
+            m_fps(25),
+            m_rate(1),
+            m_loop(false)
+        { }
+
+        int Init(const Json::Value& config)
+        {
+            AddOutputPort("au_output");
+
+            if (!config.isMember("file"))
+            {
+                printf("[%s]: no file!\n", name());
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+            m_path = config["file"].asString();
+            m_fps = config.get("fps", m_fps).asDouble();
+            m_rate = config.get("rate", m_rate).asDouble();
+            m_loop = config.get("loop", m_loop).asBool();
+
+            int codec = -1;
+            if (config.isMember("codec"))
+                codec = config["codec"].asString() == "h265" ? VIDEO_CODEC_H265 : VIDEO_CODEC_H264;
+
+            // 映射文件并建立访问单元索引
+            int ret = m_file.Open(m_path, codec);
+            if (ret != AX_SUCCESS)
+                return ret;
+
+            printf("[%s]: %s, %d access units, %.1f fps x%.1f%s\n", name(), m_path.c_str(),
+                (int)m_file.Count(), m_fps, m_rate, m_loop ? ", loop" : "");
+            return AX_SUCCESS;
+        }
+
+        int Run()
+        {
+            const char* node_name = m_name.c_str();
+            printf("[%s]: %s start\n", node_name, node_name);
+
+            auto au_output_port = FindOutputPort("au_output");
+            AnnexBPlayer player(m_file, m_fps, m_rate, m_loop);
+
+            while (m_isRunning)
+            {
+                const uint8_t* buf;
+                int len;
+                uint64_t pts;
+                bool key;
+                if (player.Next(buf, len, pts, &key) != AX_SUCCESS)
+                {
+                    printf("[%s]: end of %s after %llu access units\n", node_name, m_path.c_str(), (unsigned long long)player.Frames());
+                    break;
+                }
+
+                // 统计拷贝和发送耗时
+                NodeMetrics::ScopedTimer timer(*m_metrics);
+                AccessUnit au;
+                au.data.assign(buf, buf + len);
+                au.pts = pts;
+                au.key = key;
+                au_output_port->send(Packet(au));
+            }
+
+            printf("[%s]: Stop\n", node_name);
+            return AX_SUCCESS;
+        }
+    };
+}
+
+AX_REGISTER_NODE("AnnexBFileSource", [](const Json::Value&) { return std::make_shared<ax::AnnexBFileSourceNode>(); })
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "node.hpp"
+#include "node_registry.hpp"
+
+namespace ax
+{
+    /// @brief Consumes packets and only counts them, the cheapest possible sink.
+    /// @details {"samples": 0}
+    ///     Checks Packet::seq for gaps (dropped upstream) and steps back
+    ///     (reordered or duplicated), records source-to-sink latency from
+    ///     Packet::timestamp into a histogram, and keeps the first "samples"
+    ///     raw latencies in ns for exact percentiles. Counters are published
+    ///     to MetricsRegistry as the "sink" family. Packets without seq or
+    ///     timestamp are only counted.
+    class CountingSinkNode : public Node
+    {
+    private:
+        struct SinkStats
+        {
+            std::atomic<uint64_t> received;
+            std::atomic<uint64_t> missing;
+            std::atomic<uint64_t> reordered;
+            std::atomic<uint64_t> last_ns;
+            Histogram latency_us;
+
+            SinkStats(): received(0), missing(0), reordered(0), last_ns(0) { }
+        };
+
+        MetricsSource<SinkStats> m_stats;
+        size_t m_maxSamples;
+
+        std::mutex m_lock;
+        uint64_t m_lastSeq;
+        std::vector<uint64_t> m_samples;
+
+    public:
+        CountingSinkNode():
+            Node("Counting_Sink"),
+            m_maxSamples(0),
+            m_lastSeq(0)
+        { }
+
+        int Init(const Json::Value& config)
+        {
+            AddInputPort("input");
+
+            m_maxSamples = config.get("samples", 0).asUInt64();
+            m_samples.reserve(m_maxSamples);
+
+            m_stats.Publish("sink", m_name, [](const SinkStats& st, Json::Value& out) {
+                out["received"] = (Json::UInt64)st.received.load(std::memory_order_relaxed);
+                out["missing"] = (Json::UInt64)st.missing.load(std::memory_order_relaxed);
+                out["reordered"] = (Json::UInt64)st.reordered.load(std::memory_order_relaxed);
+                out["latency_p50_us"] = (Json::UInt64)st.latency_us.quantile(0.5);
+                out["latency_p99_us"] = (Json::UInt64)st.latency_us.quantile(0.99);
+            }, {"received", "missing", "reordered"});
+            return AX_SUCCESS;
+        }
+
+        bool Schedulable() const { return true; }
+
+        int Process(std::vector<Packet>& inputs)
+        {
+            uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            const Packet& packet = inputs[0];
+
+            uint64_t seq = packet.seq();
+            uint64_t latency = packet.timestamp() && now > packet.timestamp() ? now - packet.timestamp() : 0;
+            if (seq || (latency && m_maxSamples))
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                if (seq > m_lastSeq + 1 && m_lastSeq)
+                    m_stats->missing.fetch_add(seq - m_lastSeq - 1, std::memory_order_relaxed);
+                else if (seq && seq <= m_lastSeq)
+                    m_stats->reordered.fetch_add(1, std::memory_order_relaxed);
+                if (seq > m_lastSeq)
+                    m_lastSeq = seq;
+                if (latency && m_samples.size() < m_maxSamples)
+                    m_samples.push_back(latency);
+            }
+            if (latency)
+                m_stats->latency_us.record(latency / 1000);
+
+            m_stats->last_ns.store(now, std::memory_order_relaxed);
+            m_stats->received.fetch_add(1, std::memory_order_release);
+            return AX_SUCCESS;
+        }
+
+        uint64_t Received() const { return m_stats->received.load(std::memory_order_acquire); }
+
+        /// @brief packets skipped between received sequence numbers
+        uint64_t Missing() const { return m_stats->missing.load(std::memory_order_relaxed); }
+
+        uint64_t Reordered() const { return m_stats->reordered.load(std::memory_order_relaxed); }
+
+        /// @brief steady clock ns of the last packet
+        uint64_t LastReceived() const { return m_stats->last_ns.load(std::memory_order_relaxed); }
+
+        const Histogram& Latency() const { return m_stats->latency_us; }
+
+        /// @brief raw latencies in ns, call after the node stopped
+        const std::vector<uint64_t>& Samples() const { return m_samples; }
+    };
+}
+
+AX_REGISTER_NODE("CountingSink", [](const Json::Value&) { return std::make_shared<ax::CountingSinkNode>(); })
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "node.hpp"
+#include "node_registry.hpp"
+#include "track/detect_schedule.hpp"
+
+namespace ax
+{
+    /// @brief Lets through only the frames a TrackerNode wants detected.
+    /// @details {"tracker": "tracker", "channel": 0}
+    ///     Put in front of the detector of one channel. Forwards one frame
+    ///     in the interval the tracker named "tracker" publishes for
+    ///     "channel", by Packet::seq, and drops the others. The tracker
+    ///     predicts its tracks over the frames skipped. Packets without a
+    ///     seq are numbered in arrival order and leave with that number.
+    ///     Everything passes until the tracker asks for less.
+    class DetectGateNode : public Node
+    {
+    private:
+        struct GateStats
+        {
+            std::atomic<uint64_t> passed;
+            std::atomic<uint64_t> skipped;
+
+            GateStats(): passed(0), skipped(0) { }
+        };
+
+        std::shared_ptr<std::atomic<int>> m_interval;
+        std::mutex m_lock;
+        uint64_t m_last;
+        uint64_t m_count;
+        MetricsSource<GateStats> m_stats;
+
+    public:
+        DetectGateNode():
+            Node("Detect_Gate"),
+            m_last(0),
+            m_count(0)
+        { }
+
+        int Init(const Json::Value& config)
+        {
+            AddInputPort("input");
+            AddOutputPort("output");
+
+            std::string tracker = config.get("tracker", "tracker").asString();
+            int channel = config.get("channel", 0).asInt();
+            m_interval = DetectSchedule::Instance().Get(DetectSchedule::Key(tracker, channel));
+
+            m_stats.Publish("detect_gate", m_name, [](const GateStats& st, Json::Value& out) {
+                out["passed"] = (Json::UInt64)st.passed.load(std::memory_order_relaxed);
+                out["skipped"] = (Json::UInt64)st.skipped.load(std::memory_order_relaxed);
+            }, {"passed", "skipped"});
+            printf("[%s]: scheduled by %s channel %d\n", name(), tracker.c_str(), channel);
+            return AX_SUCCESS;
+        }
+
+        bool Schedulable() const { return true; }
+
+        int Process(std::vector<Packet>& inputs)
+        {
+            Packet packet = inputs[0];
+            int interval = m_interval->load(std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                // 无序号的包按到达计数, 并写入转发的包, 跟踪器由序号差预测跳过的帧
+                if (!packet.seq())
+                    packet.set_seq(++m_count);
+                uint64_t seq = packet.seq();
+                if (m_last && seq > m_last && seq - m_last < (uint64_t)interval)
+                {
+                    m_stats->skipped.fetch_add(1, std::memory_order_relaxed);
+                    return AX_SUCCESS;
+                }
+                m_last = seq;
+            }
+
+            auto output_port = FindOutputPort("output");
+            output_port->send(packet);
+            m_stats->passed.fetch_add(1, std::memory_order_relaxed);
+            return AX_SUCCESS;
+        }
+
+        uint64_t Passed() const { return m_stats->passed.load(std::memory_order_relaxed); }
+
+        uint64_t Skipped() const { return m_stats->skipped.load(std::memory_order_relaxed); }
+    };
+}
+
+AX_REGISTER_NODE("DetectGate", [](const Json::Value&) { return std::make_shared<ax::DetectGateNode>(); })
@@ -0,0 +1,494 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "node.hpp"
+#include "node_registry.hpp"
+#include "tensor.hpp"
+#include "infer/inference_engine.hpp"
+#include "infer/cpu_engine.hpp"
+
+namespace ax
+{
+    /// @brief Runs a model on Tensors of several channels, batched dynamically.
+    /// @details {"engine": "cpu", "channels": 4, "max_batch": 8,
+    ///     "max_wait_ms": 5, "max_inflight": 2, ...engine options}
+    ///     Tensors from ports "input0".."input<channels - 1>" are collected
+    ///     round robin into batches. A batch is submitted once it has
+    ///     "max_batch" tensors or its oldest tensor waited "max_wait_ms", and
+    ///     the engine has fewer than "max_inflight" requests running. The
+    ///     outputs of every tensor go out of the port with the number of its
+    ///     input as an InferenceOutput, keeping seq, timestamp and the
+    ///     transform of the input. While the engine is saturated no input is
+    ///     taken, the input streams' capacity and policy decide what backs up
+    ///     or drops. Input tensors are held until their batch completes, an
+    ///     upstream pool needs "max_batch" * ("max_inflight" + 1) buffers more
+    ///     than the input edge's capacity. Outputs of a channel keep its input
+    ///     order. The whole config is passed to the engine's Load, which runs
+    ///     in Prepare on every start and pairs with the Unload at the end of
+    ///     Run. Batch and in flight limits are the smaller of node and engine.
+    class InferenceNode : public Node
+    {
+    private:
+        struct InferenceStats
+        {
+            std::atomic<uint64_t> frames;
+            std::atomic<uint64_t> batches;
+            std::atomic<uint64_t> rejected;
+            std::atomic<uint64_t> failed;
+            std::atomic<uint64_t> poll_errors;
+            std::atomic<int> inflight;
+            Histogram queue_us;         // arrival to submit
+            Histogram infer_us;         // submit to completion
+
+            InferenceStats(): frames(0), batches(0), rejected(0), failed(0), poll_errors(0), inflight(0) { }
+        };
+
+        struct Item
+        {
+            int channel;
+            Packet packet;
+            std::chrono::steady_clock::time_point arrival;
+        };
+
+        struct Batch
+        {
+            std::vector<Item> items;
+            bool done;
+            int status;
+            std::vector<Tensor> outputs;
+            std::chrono::steady_clock::time_point submitted;
+            std::chrono::steady_clock::time_point completed;
+
+            Batch(): done(false), status(AX_SUCCESS) { }
+        };
+
+        std::string m_engineName;
+        Json::Value m_engineConfig;
+        std::unique_ptr<InferenceEngine> m_engine;
+        int m_channels;
+        int m_maxBatch;
+        int m_maxInflight;
+        int m_maxWaitUs;
+        MetricsSource<InferenceStats> m_stats;
+
+        // 收集线程等待输入或空闲请求
+        std::mutex m_lock;
+        std::condition_variable m_cond;
+        bool m_signaled;
+        std::map<uint64_t, Batch> m_running;   // 已提交未发送, 按提交顺序
+        int m_inflight;                         // 已提交未完成
+        uint64_t m_nextId;
+        bool m_unloaded;
+
+    public:
+        InferenceNode():
+            Node("Inference"),
+            m_channels(1),
+            m_maxBatch(8),
+            m_maxInflight(2),
+            m_maxWaitUs(5000),
+            m_signaled(false),
+            m_inflight(0),
+            m_nextId(1),
+            m_unloaded(false)
+        { }
+
+        int Init(const Json::Value& config)
+        {
+            m_channels = config.get("channels", m_channels).asInt();
+            if (m_channels <= 0)
+            {
+                printf("[%s]: bad channels %d!\n", name(), m_channels);
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+            for (int i = 0; i < m_channels; i++)
+            {
+                AddInputPort("input" + std::to_string(i));
+                AddOutputPort("output" + std::to_string(i));
+            }
+
+            m_engineName = config.get("engine", "cpu").asString();
+            m_engine = InferenceEngineRegistry::Instance().Create(m_engineName);
+            if (!m_engine)
+            {
+                printf("[%s]: no engine %s!\n", name(), m_engineName.c_str());
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+            m_engineConfig = config;
+            m_maxWaitUs = (int)(config.get("max_wait_ms", m_maxWaitUs / 1000.0).asDouble() * 1000);
+
+            m_stats.Publish("inference", m_name, [](const InferenceStats& st, Json::Value& out) {
+                uint64_t frames = st.frames.load(std::memory_order_relaxed);
+                uint64_t batches = st.batches.load(std::memory_order_relaxed);
+                out["frames"] = (Json::UInt64)frames;
+                out["batches"] = (Json::UInt64)batches;
+                out["batch_avg"] = batches ? (double)frames / batches : 0.0;
+                out["rejected"] = (Json::UInt64)st.rejected.load(std::memory_order_relaxed);
+                out["failed"] = (Json::UInt64)st.failed.load(std::memory_order_relaxed);
+                out["poll_errors"] = (Json::UInt64)st.poll_errors.load(std::memory_order_relaxed);
+                out["inflight"] = st.inflight.load(std::memory_order_relaxed);
+                out["queue_p50_us"] = (Json::UInt64)st.queue_us.quantile(0.5);
+                out["queue_p99_us"] = (Json::UInt64)st.queue_us.quantile(0.99);
+                out["infer_p50_us"] = (Json::UInt64)st.infer_us.quantile(0.5);
+                out["infer_p99_us"] = (Json::UInt64)st.infer_us.quantile(0.99);
+            }, {"frames", "batches", "rejected", "failed", "poll_errors"});
+            return AX_SUCCESS;
+        }
+
+        /// @brief load the model, Run unloads it on exit
+        int Prepare()
+        {
+            int ret = m_engine->Load(m_engineConfig);
+            if (ret != AX_SUCCESS)
+            {
+                printf("[%s]: load %s failed %d!\n", name(), m_engineName.c_str(), ret);
+                return AX_ERR_INIT_FAIL;
+            }
+            m_maxBatch = std::max(1, std::min(m_engineConfig.get("max_batch", m_maxBatch).asInt(), m_engine->MaxBatch()));
+            m_maxInflight = std::max(1, std::min(m_engineConfig.get("max_inflight", m_maxInflight).asInt(), m_engine->MaxInflight()));
+            printf("[%s]: %s, %d channels, batch %d, wait %.1f ms, inflight %d\n", name(), m_engineName.c_str(),
+                m_channels, m_maxBatch, m_maxWaitUs / 1000.0, m_maxInflight);
+            return AX_SUCCESS;
+        }
+
+        void Stop()
+        {
+            Node::Stop();
+            Signal();
+        }
+
+        uint64_t Frames() const { return m_stats->frames.load(std::memory_order_relaxed); }
+
+        uint64_t Batches() const { return m_stats->batches.load(std::memory_order_relaxed); }
+
+        /// @brief tensors the engine does not accept
+        uint64_t Rejected() const { return m_stats->rejected.load(std::memory_order_relaxed); }
+
+        /// @brief time tensors waited for their batch to be submitted
+        const Histogram& QueueLatency() const { return m_stats->queue_us; }
+
+        /// @brief time from submission to completion of a batch
+        const Histogram& InferLatency() const { return m_stats->infer_us; }
+
+        int Run()
+        {
+            const char* node_name = m_name.c_str();
+            printf("[%s]: %s start\n", node_name, node_name);
+
+            // 输入到达时唤醒收集线程, 本节点不经过调度器, 监听器空闲
+            for (int i = 0; i < m_channels; i++)
+            {
+                if (m_inputPorts[i]->has_stream())
+                    m_inputPorts[i]->stream()->set_listener([this] { Signal(); });
+            }
+
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                m_unloaded = false;
+            }
+            std::thread completer([this] { Complete(); });
+            Collect();
+
+            // 等待已提交的请求完成再退出, 输出仍然发送
+            {
+                std::unique_lock<std::mutex> lk(m_lock);
+                m_cond.wait_for(lk, std::chrono::seconds(3), [this] { return m_running.empty(); });
+            }
+            m_engine->Unload();
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                m_unloaded = true;
+            }
+            completer.join();
+
+            for (int i = 0; i < m_channels; i++)
+            {
+                if (m_inputPorts[i]->has_stream())
+                    m_inputPorts[i]->stream()->set_listener(nullptr);
+            }
+            printf("[%s]: Stop\n", node_name);
+            return AX_SUCCESS;
+        }
+
+    private:
+        void Signal()
+        {
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                m_signaled = true;
+            }
+            m_cond.notify_all();
+        }
+
+        static bool SameShape(const Tensor& a, const Tensor& b)
+        {
+            return a.type == b.type && a.layout == b.layout && a.channels == b.channels && a.height == b.height && a.width == b.width;
+        }
+
+        /// @brief take inputs round robin into the pending batch, up to max_batch
+        /// @return false when a tensor of another shape ends the batch, it is left in next_item
+        bool Gather(std::vector<Item>& pending, Item& next_item, int& next)
+        {
+            bool took = true;
+            while (took && (int)pending.size() < m_maxBatch)
+            {
+                took = false;
+                for (int n = 0; n < m_channels && (int)pending.size() < m_maxBatch; n++)
+                {
+                    int channel = (next + n) % m_channels;
+                    Item item;
+                    if (m_inputPorts[channel]->take(item.packet) != AX_SUCCESS)
+                        continue;
+                    took = true;
+                    if (!item.packet.isValid() || !item.packet.isType<Tensor>() || !m_engine->Accepts(item.packet.get<Tensor>()))
+                    {
+                        m_stats->rejected.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    item.channel = channel;
+                    item.arrival = std::chrono::steady_clock::now();
+                    if (!pending.empty() && !SameShape(pending.front().packet.get<Tensor>(), item.packet.get<Tensor>()))
+                    {
+                        next = (channel + 1) % m_channels;
+                        next_item = std::move(item);
+                        return false;
+                    }
+                    pending.push_back(std::move(item));
+                }
+                next = (next + 1) % m_channels;
+            }
+            return true;
+        }
+
+        void Collect()
+        {
+            std::vector<Item> pending;
+            Item next_item;
+            int next = 0;
+            while (m_isRunning)
+            {
+                int inflight;
+                {
+                    std::lock_guard<std::mutex> lg(m_lock);
+                    m_signaled = false;
+                    inflight = m_inflight;
+                }
+
+                // 形状不同的张量开始下一批
+                if (pending.empty() && next_item.packet.isValid())
+                {
+                    pending.push_back(std::move(next_item));
+                    next_item = Item();
+                }
+
+                // 引擎满时不取输入, 由输入流反压
+                bool complete = next_item.packet.isValid();
+                if (!complete && inflight < m_maxInflight)
+                    complete = !Gather(pending, next_item, next);
+
+                // 引擎满时只等完成线程唤醒, 批次期限已过也不空转
+                auto now = std::chrono::steady_clock::now();
+                auto deadline = now + std::chrono::milliseconds(100);
+                if (!pending.empty() && inflight < m_maxInflight)
+                {
+                    auto due = pending.front().arrival + std::chrono::microseconds(m_maxWaitUs);
+                    if (complete || (int)pending.size() >= m_maxBatch || now >= due)
+                    {
+                        Submit(pending);
+                        continue;
+                    }
+                    deadline = due;
+                }
+
+                std::unique_lock<std::mutex> lk(m_lock);
+                m_cond.wait_until(lk, deadline, [this] { return m_signaled || !m_isRunning; });
+            }
+        }
+
+        void Submit(std::vector<Item>& pending)
+        {
+            NodeMetrics::ScopedTimer timer(*m_metrics);
+            std::vector<Tensor> inputs;
+            inputs.reserve(pending.size());
+            for (const Item& item : pending)
+                inputs.push_back(item.packet.get<Tensor>());
+
+            uint64_t id;
+            auto now = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                id = m_nextId++;
+                Batch& batch = m_running[id];
+                batch.items.swap(pending);
+                batch.submitted = now;
+                for (const Item& item : batch.items)
+                    m_stats->queue_us.record(std::chrono::duration_cast<std::chrono::microseconds>(now - item.arrival).count());
+                m_inflight++;
+                m_stats->inflight.store(m_inflight, std::memory_order_relaxed);
+            }
+
+            int ret = m_engine->Submit(id, inputs);
+            if (ret != AX_SUCCESS)
+            {
+                printf("[%s]: submit failed %d\n", name(), ret);
+                std::lock_guard<std::mutex> lg(m_lock);
+                m_stats->failed.fetch_add(m_running[id].items.size(), std::memory_order_relaxed);
+                m_running.erase(id);
+                m_inflight--;
+                m_stats->inflight.store(m_inflight, std::memory_order_relaxed);
+            }
+            pending.clear();
+        }
+
+        /// @brief completion thread, splits batch outputs into per tensor views and sends them
+        /// @details Poll errors are counted and do not end the thread, they
+        ///     fail the request they name, or else the oldest one running,
+        ///     so the in flight limit is not held by requests that will
+        ///     never complete. Requests still running once the engine is
+        ///     unloaded are failed too.
+        void Complete()
+        {
+            while (true)
+            {
+                InferenceCompletion completion;
+                completion.id = 0;
+                int ret = m_engine->Poll(completion, 100);
+                if (ret != AX_SUCCESS && ret != AX_ERR_TIMEOUT)
+                {
+                    m_stats->poll_errors.fetch_add(1, std::memory_order_relaxed);
+                    printf("[%s]: poll failed %d\n", name(), ret);
+                    // 未指明请求时按最早未完成的请求失败, 它若之后返回则忽略
+                    bool found = false;
+                    {
+                        std::lock_guard<std::mutex> lg(m_lock);
+                        auto it = m_running.find(completion.id);
+                        if (it == m_running.end() || it->second.done)
+                        {
+                            it = m_running.begin();
+                            while (it != m_running.end() && it->second.done)
+                                ++it;
+                        }
+                        if (it != m_running.end())
+                        {
+                            completion.id = it->first;
+                            found = true;
+                        }
+                    }
+                    if (found)
+                    {
+                        completion.status = ret;
+                        completion.outputs.clear();
+                        ret = AX_SUCCESS;
+                    }
+                    else
+                    {
+                        // 没有未完成的请求, 稍等后继续, 避免引擎持续出错时空转
+                        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                        ret = AX_ERR_TIMEOUT;
+                    }
+                }
+                if (ret == AX_ERR_TIMEOUT)
+                {
+                    std::vector<Batch> dropped;
+                    {
+                        std::lock_guard<std::mutex> lg(m_lock);
+                        if (!m_isRunning && m_running.empty())
+                            return;
+                        if (!m_unloaded)
+                            continue;
+                        // 卸载后仍未返回的请求不会再完成, 按失败释放
+                        auto now = std::chrono::steady_clock::now();
+                        for (auto& running : m_running)
+                        {
+                            if (!running.second.done)
+                            {
+                                running.second.status = AX_ERR_CLOSED;
+                                running.second.completed = now;
+                            }
+                            dropped.push_back(std::move(running.second));
+                        }
+                        m_running.clear();
+                        m_inflight = 0;
+                        m_stats->inflight.store(0, std::memory_order_relaxed);
+                    }
+                    for (const Batch& batch : dropped)
+                        Send(batch);
+                    Signal();
+                    return;
+                }
+
+                // 请求可能乱序完成, 按提交顺序发送以保持各通道帧序
+                std::vector<Batch> ready;
+                {
+                    std::lock_guard<std::mutex> lg(m_lock);
+                    auto it = m_running.find(completion.id);
+                    if (it == m_running.end() || it->second.done)
+                        continue;
+                    it->second.done = true;
+                    it->second.status = completion.status;
+                    it->second.outputs.swap(completion.outputs);
+                    it->second.completed = std::chrono::steady_clock::now();
+                    m_inflight--;
+                    m_stats->inflight.store(m_inflight, std::memory_order_relaxed);
+                    while (!m_running.empty() && m_running.begin()->second.done)
+                    {
+                        ready.push_back(std::move(m_running.begin()->second));
+                        m_running.erase(m_running.begin());
+                    }
+                }
+                // 有空闲请求, 唤醒收集线程
+                Signal();
+
+                for (const Batch& batch : ready)
+                    Send(batch);
+            }
+        }
+
+        void Send(const Batch& batch)
+        {
+            NodeMetrics::ScopedTimer timer(*m_metrics);
+            m_stats->infer_us.record(std::chrono::duration_cast<std::chrono::microseconds>(batch.completed - batch.submitted).count());
+            if (batch.status != AX_SUCCESS)
+            {
+                m_stats->failed.fetch_add(batch.items.size(), std::memory_order_relaxed);
+                return;
+            }
+
+            for (size_t i = 0; i < batch.items.size(); i++)
+            {
+                const Item& item = batch.items[i];
+                const Tensor& input = item.packet.get<Tensor>();
+                InferenceOutput output;
+                output.transform = input.transform;
+                output.pts = input.pts;
+                for (const Tensor& out : batch.outputs)
+                {
+                    // 按批次切分, 共享整批输出的缓冲
+                    Tensor view = out;
+                    view.batch = 1;
+                    view.data = out.data + out.item_bytes() * i;
+                    view.transform = input.transform;
+                    view.pts = input.pts;
+                    output.tensors.push_back(view);
+                }
+
+                Packet packet(output);
+                packet.set_seq(item.packet.seq());
+                packet.set_timestamp(item.packet.timestamp());
+                m_outputPorts[item.channel]->send(packet);
+            }
+            m_stats->frames.fetch_add(batch.items.size(), std::memory_order_relaxed);
+            m_stats->batches.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+}
+
+AX_REGISTER_NODE("Inference", [](const Json::Value&) { return std::make_shared<ax::InferenceNode>(); })
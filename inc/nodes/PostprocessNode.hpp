@@ -0,0 +1,139 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "node.hpp"
+#include "node_registry.hpp"
+#include "tensor.hpp"
+#include "detections.hpp"
+#include "infer/inference_engine.hpp"
+#include "infer/postprocess.hpp"
+
+namespace ax
+{
+    /// @brief Turns detection head outputs into Detections.
+    /// @details {"classes": 0, "objectness": false, "sigmoid": false,
+    ///     "box": "xywh", "score_threshold": 0.25, "iou_threshold": 0.45,
+    ///     "top_k": 1000, "max_detections": 100, "class_agnostic": false,
+    ///     "output": 0}
+    ///     Takes InferenceOutput, decoding its tensor number "output", or a
+    ///     Tensor, e.g. from a replayed recording. The output is float32
+    ///     NCHW with one row per attribute over the anchors, see
+    ///     PostprocessParams. "box" "xyxy" for corner boxes. A batched
+    ///     Tensor gives one Detections packet per item, all with its seq.
+    ///     Boxes are in frame pixels through the tensor's transform.
+    class PostprocessNode : public Node
+    {
+    private:
+        struct PostprocessStats
+        {
+            std::atomic<uint64_t> frames;
+            std::atomic<uint64_t> detections;
+            std::atomic<uint64_t> unsupported;
+            Histogram decode_us;
+
+            PostprocessStats(): frames(0), detections(0), unsupported(0) { }
+        };
+
+        PostprocessParams m_params;
+        int m_output;
+        std::unique_ptr<Postprocessor> m_postprocessor;
+        MetricsSource<PostprocessStats> m_stats;
+
+    public:
+        PostprocessNode():
+            Node("Postprocess"),
+            m_output(0)
+        { }
+
+        int Init(const Json::Value& config)
+        {
+            AddInputPort("input");
+            AddOutputPort("output");
+
+            m_params.classes = config.get("classes", m_params.classes).asInt();
+            m_params.objectness = config.get("objectness", m_params.objectness).asBool();
+            m_params.sigmoid = config.get("sigmoid", m_params.sigmoid).asBool();
+            m_params.xyxy = config.get("box", "xywh").asString() == "xyxy";
+            m_params.score_threshold = config.get("score_threshold", m_params.score_threshold).asFloat();
+            m_params.iou_threshold = config.get("iou_threshold", m_params.iou_threshold).asFloat();
+            m_params.top_k = config.get("top_k", m_params.top_k).asInt();
+            m_params.max_detections = config.get("max_detections", m_params.max_detections).asInt();
+            m_params.class_agnostic = config.get("class_agnostic", m_params.class_agnostic).asBool();
+            m_output = config.get("output", m_output).asInt();
+            if (m_params.score_threshold <= 0 || m_params.score_threshold >= 1 || m_params.iou_threshold <= 0)
+            {
+                printf("[%s]: bad thresholds %f %f!\n", name(), m_params.score_threshold, m_params.iou_threshold);
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+            m_postprocessor.reset(new Postprocessor(m_params));
+
+            m_stats.Publish("postprocess", m_name, [](const PostprocessStats& st, Json::Value& out) {
+                out["frames"] = (Json::UInt64)st.frames.load(std::memory_order_relaxed);
+                out["detections"] = (Json::UInt64)st.detections.load(std::memory_order_relaxed);
+                out["unsupported"] = (Json::UInt64)st.unsupported.load(std::memory_order_relaxed);
+                out["decode_p50_us"] = (Json::UInt64)st.decode_us.quantile(0.5);
+                out["decode_p99_us"] = (Json::UInt64)st.decode_us.quantile(0.99);
+            }, {"frames", "detections", "unsupported"});
+            printf("[%s]: score > %.2f, iou > %.2f, top %d, max %d%s\n", name(), m_params.score_threshold,
+                m_params.iou_threshold, m_params.top_k, m_params.max_detections, m_params.class_agnostic ? ", agnostic" : "");
+            return AX_SUCCESS;
+        }
+
+        bool Schedulable() const { return true; }
+
+        int Process(std::vector<Packet>& inputs)
+        {
+            const Packet& input = inputs[0];
+            const Tensor* tensor = nullptr;
+            if (input.isValid() && input.isType<InferenceOutput>())
+            {
+                const InferenceOutput& out = input.get<InferenceOutput>();
+                if (m_output >= 0 && m_output < (int)out.tensors.size())
+                    tensor = &out.tensors[m_output];
+            }
+            else if (input.isValid() && input.isType<Tensor>())
+                tensor = &input.get<Tensor>();
+            if (!tensor)
+            {
+                m_stats->unsupported.fetch_add(1, std::memory_order_relaxed);
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<Detections> dets;
+            int ret = m_postprocessor->Run(*tensor, dets);
+            if (ret != AX_SUCCESS)
+            {
+                m_stats->unsupported.fetch_add(1, std::memory_order_relaxed);
+                return ret;
+            }
+            m_stats->decode_us.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count());
+
+            auto output_port = FindOutputPort("output");
+            for (Detections& d : dets)
+            {
+                m_stats->detections.fetch_add(d.size(), std::memory_order_relaxed);
+                Packet packet(d);
+                packet.set_seq(input.seq());
+                packet.set_timestamp(input.timestamp());
+                output_port->send(packet);
+            }
+            m_stats->frames.fetch_add(dets.size(), std::memory_order_relaxed);
+            return AX_SUCCESS;
+        }
+
+        uint64_t Frames() const { return m_stats->frames.load(std::memory_order_relaxed); }
+
+        uint64_t DetectionCount() const { return m_stats->detections.load(std::memory_order_relaxed); }
+
+        /// @brief time to decode one output, all of its batch
+        const Histogram& DecodeLatency() const { return m_stats->decode_us; }
+    };
+}
+
+AX_REGISTER_NODE("Postprocess", [](const Json::Value&) { return std::make_shared<ax::PostprocessNode>(); })
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "node.hpp"
+#include "node_registry.hpp"
+#include "buffer_pool.hpp"
+#include "video_frame.hpp"
+#include "tensor.hpp"
+#include "imgproc/preprocess.hpp"
+
+namespace ax
+{
+    /// @brief Turns NV12 VideoFrames into model input Tensors in one fused pass.
+    /// @details {"width": 640, "height": 640, "format": "rgb", "layout": "nchw",
+    ///     "type": "float32", "mean": [0, 0, 0], "scale": [0.0039216, 0.0039216, 0.0039216],
+    ///     "keep_ratio": true, "center": true, "pad_value": 114,
+    ///     "roi": [0, 0, 0, 0], "pool": 4, "timeout_ms": 20, "threads": 1}
+    ///     "format" "rgb"/"bgr", "layout" "nchw"/"nhwc", "type"
+    ///     "float32"/"int8"/"uint8", mean and scale per output channel.
+    ///     "keep_ratio" letterboxes with "pad_value", centred unless
+    ///     "center" is false. "roi" x, y, w, h selects part of the frame, w or
+    ///     h 0 up to the frame edge. Tensors come from a pool of "pool"
+    ///     buffers, a frame is dropped when none comes back within
+    ///     "timeout_ms", at once on scheduler workers: give the output edge
+    ///     a "capacity" below "pool" there. Tensor::transform maps tensor
+    ///     coordinates back to the frame for the boxes. "threads" above 1
+    ///     splits every frame into row bands.
+    class PreprocessNode : public Node
+    {
+    private:
+        struct PreprocessStats
+        {
+            std::atomic<uint64_t> converted;
+            std::atomic<uint64_t> dropped;
+            std::atomic<uint64_t> unsupported;
+
+            PreprocessStats(): converted(0), dropped(0), unsupported(0) { }
+        };
+
+        PreprocessParams m_params;
+        int m_roi[4];
+        int m_timeout;
+        std::unique_ptr<Preprocessor> m_preprocessor;
+        std::unique_ptr<BufferPool> m_pool;
+        std::unique_ptr<BandPool> m_bands;
+        MetricsSource<PreprocessStats> m_stats;
+
+    public:
+        PreprocessNode():
+            Node("Preprocess"),
+            m_timeout(20)
+        {
+            m_params.color.format = PIXEL_FORMAT_RGB;
+            m_params.color.layout = TENSOR_LAYOUT_NCHW;
+            m_params.color.type = TENSOR_TYPE_FLOAT32;
+            for (int k = 0; k < 3; k++)
+                m_params.color.scale[k] = 1 / 255.0f;
+            for (int i = 0; i < 4; i++)
+                m_roi[i] = 0;
+        }
+
+        int Init(const Json::Value& config)
+        {
+            AddInputPort("input");
+            AddOutputPort("output");
+
+            m_params.width = config.get("width", m_params.width).asInt();
+            m_params.height = config.get("height", m_params.height).asInt();
+            if (m_params.width <= 0 || m_params.height <= 0 || m_params.width % 2 || m_params.height % 2)
+            {
+                printf("[%s]: bad tensor size %dx%d!\n", name(), m_params.width, m_params.height);
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+
+            std::string format = config.get("format", "rgb").asString();
+            std::string layout = config.get("layout", "nchw").asString();
+            std::string type = config.get("type", "float32").asString();
+            m_params.color.format = format == "bgr" ? PIXEL_FORMAT_BGR : PIXEL_FORMAT_RGB;
+            m_params.color.layout = layout == "nhwc" ? TENSOR_LAYOUT_NHWC : TENSOR_LAYOUT_NCHW;
+            if (type == "uint8")
+                m_params.color.type = TENSOR_TYPE_UINT8;
+            else if (type == "int8")
+                m_params.color.type = TENSOR_TYPE_INT8;
+            else
+                m_params.color.type = TENSOR_TYPE_FLOAT32;
+            for (int k = 0; k < 3; k++)
+            {
+                if (config["mean"].isArray() && config["mean"].size() == 3)
+                    m_params.color.mean[k] = config["mean"][k].asFloat();
+                if (config["scale"].isArray() && config["scale"].size() == 3)
+                    m_params.color.scale[k] = config["scale"][k].asFloat();
+            }
+            m_params.keep_ratio = config.get("keep_ratio", m_params.keep_ratio).asBool();
+            m_params.center = config.get("center", m_params.center).asBool();
+            m_params.pad_value = config.get("pad_value", m_params.pad_value).asInt();
+            if (config["roi"].isArray() && config["roi"].size() == 4)
+            {
+                for (int i = 0; i < 4; i++)
+                    m_roi[i] = std::max(config["roi"][i].asInt(), 0);
+            }
+            m_timeout = config.get("timeout_ms", m_timeout).asInt();
+
+            m_preprocessor.reset(new Preprocessor(m_params));
+            int pool = config.get("pool", 4).asInt();
+            m_pool.reset(new BufferPool(m_preprocessor->TensorBytes(), pool));
+            if (m_pool->count() != pool)
+            {
+                printf("[%s]: no memory for %d tensors!\n", name(), pool);
+                return AX_ERR_INIT_FAIL;
+            }
+            m_bands.reset(new BandPool(config.get("threads", 1).asInt()));
+
+            m_stats.Publish("preprocess", m_name, [](const PreprocessStats& st, Json::Value& out) {
+                out["converted"] = (Json::UInt64)st.converted.load(std::memory_order_relaxed);
+                out["dropped"] = (Json::UInt64)st.dropped.load(std::memory_order_relaxed);
+                out["unsupported"] = (Json::UInt64)st.unsupported.load(std::memory_order_relaxed);
+            }, {"converted", "dropped", "unsupported"});
+            printf("[%s]: %dx%d %s%s\n", name(), m_params.width, m_params.height, type.c_str(),
+                m_params.keep_ratio ? ", letterbox" : "");
+            return AX_SUCCESS;
+        }
+
+        bool Schedulable() const { return true; }
+
+        int Process(std::vector<Packet>& inputs)
+        {
+            const Packet& input = inputs[0];
+            if (!input.isValid() || !input.isType<VideoFrame>() || input.get<VideoFrame>().format != PIXEL_FORMAT_NV12)
+            {
+                m_stats->unsupported.fetch_add(1, std::memory_order_relaxed);
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+            const VideoFrame& frame = input.get<VideoFrame>();
+
+            // roi宽高为0时延伸到帧边缘
+            int x = std::min(m_roi[0], frame.width);
+            int y = std::min(m_roi[1], frame.height);
+            int w = m_roi[2] ? std::min(m_roi[2], frame.width - x) : frame.width - x;
+            int h = m_roi[3] ? std::min(m_roi[3], frame.height - y) : frame.height - y;
+
+            // 调度线程上不等待, 由输出流容量限制上游
+            Tensor tensor = Tensor::Allocate(*m_pool, m_params.color.type, m_params.color.layout,
+                1, 3, m_params.height, m_params.width, current_thread_never_blocks() ? 0 : m_timeout);
+            if (!tensor.valid())
+            {
+                m_stats->dropped.fetch_add(1, std::memory_order_relaxed);
+                return AX_ERR_TIMEOUT;
+            }
+            int ret = m_preprocessor->Run(frame, x, y, w, h, tensor, m_bands.get());
+            if (ret != AX_SUCCESS)
+            {
+                m_stats->unsupported.fetch_add(1, std::memory_order_relaxed);
+                return ret;
+            }
+
+            Packet packet(tensor);
+            packet.set_seq(input.seq());
+            packet.set_timestamp(input.timestamp());
+            auto output_port = FindOutputPort("output");
+            output_port->send(packet);
+            m_stats->converted.fetch_add(1, std::memory_order_relaxed);
+            return AX_SUCCESS;
+        }
+
+        uint64_t Converted() const { return m_stats->converted.load(std::memory_order_relaxed); }
+
+        /// @brief frames dropped because no tensor buffer came back in time
+        uint64_t Dropped() const { return m_stats->dropped.load(std::memory_order_relaxed); }
+    };
+}
+
+AX_REGISTER_NODE("Preprocess", [](const Json::Value&) { return std::make_shared<ax::PreprocessNode>(); })
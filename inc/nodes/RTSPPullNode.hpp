@@ -2,124 +2,272 @@
 
 #include <string.h>
 
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "node.hpp"
+#include "node_registry.hpp"
 #include "rtspclisvr/RTSPClient.h"
 
-#include "ax_sys_api.h"
-#include "ax_vdec_api.h"
-
-#include "opencv2/opencv.hpp"
-
-// 16字节对齐
-#define ALIGN_16(x)     ((x + 15) / 16 * 16)
+#include "codec/annexb_file.hpp"
+#include "codec/decoder_feeder.hpp"
+#include "hal/hal.hpp"
+#include "video_frame.hpp"
 
 namespace ax
 {
+    /// @brief Pulls one RTSP channel and decodes it.
+    /// @details Single channel config uses top level keys ("rtsp_url", ...).
+    ///     Multi channel config declares the channels under "rtsp_pull":
+    ///     {"rtsp_pull": {"decoder": "vdec", "channels": [
+    ///         {"rtsp_url": "rtsp://...", "width": 1920, "height": 1080, "codec": "h264"}, ...]}}
+    ///     Keys of "rtsp_pull" are defaults for every channel. Each channel
+    ///     takes its own decoder group.
+    ///     A "file://path.264" url plays a recorded elementary stream
+    ///     through the same path instead, paced by "file_fps" and
+    ///     "file_rate" (0 unthrottled), looping unless "file_loop" is false.
+    ///     Frames go out as NV12 VideoFrame copied into a pool of
+    ///     "frame_pool" buffers. "zero_copy": true sends the decoder's own
+    ///     buffers instead, each returns to VDEC when the last packet holding
+    ///     it is gone, so downstream queues must hold fewer frames than the
+    ///     decoder has (10) or decoding stalls. The decoder is opened by
+    ///     Prepare and closed when Run ends, once the last zero-copy frame
+    ///     is back.
     class RTSPPullNode : public Node
     {
     private:
         RTSPClient m_client;
-        const char* m_rtspUrl;
+        std::string m_rtspUrl;
+        int m_channel;
 
         // 解码参数
-        const int nVdecGrp = 0;
-        const int nPicWidth = 1280;
-        const int nPicHeight = 720;
+        int nVdecGrp;
+        int nPicWidth;
+        int nPicHeight;
+        int nCodec;
+
+        // 零拷贝帧的释放回调持有解码器, 帧未全部归还前推迟关闭
+        struct DecoderState
+        {
+            std::mutex lock;
+            bool open;
+            bool closing;
+            int outstanding;
+
+            DecoderState(): open(false), closing(false), outstanding(0) { }
+        };
+
+        std::shared_ptr<VideoDecoder> m_decoder;
+        std::shared_ptr<DecoderState> m_decoderState;
+        std::unique_ptr<DecoderFeeder> m_feeder;
+
+        // 输出帧
+        bool m_zeroCopy;
+        int m_framePoolCount;
+        std::unique_ptr<BufferPool> m_framePool;
+
+        // 文件回放, 代替RTSP
+        AnnexBFile m_file;
+        double m_fileFps;
+        double m_fileRate;
+        bool m_fileLoop;
+        std::atomic<bool> m_filePlaying;
+        std::thread m_fileThread;
 
     public:
-        RTSPPullNode():
-            Node("RTSP_Pull")
+        /// @param channel index in "rtsp_pull"/"channels", -1 for the single channel config
+        RTSPPullNode(int channel = -1):
+            Node(channel < 0 ? "RTSP_Pull" : "RTSP_Pull_" + std::to_string(channel)),
+            m_channel(channel),
+            nVdecGrp(-1),
+            nPicWidth(1280),
+            nPicHeight(720),
+            nCodec(VIDEO_CODEC_H264),
+            m_zeroCopy(false),
+            m_framePoolCount(8),
+            m_fileFps(25),
+            m_fileRate(1),
+            m_fileLoop(true),
+            m_filePlaying(false)
         { }
 
+        ~RTSPPullNode()
+        {
+            StopFile();
+            CloseGVDEC();
+        }
+
+        bool IsFile() const { return m_rtspUrl.compare(0, 7, "file://") == 0; }
+
+        /// @brief one node per declared channel
+        static std::vector<std::shared_ptr<RTSPPullNode>> CreateChannels(const Json::Value& config)
+        {
+            std::vector<std::shared_ptr<RTSPPullNode>> nodes;
+            const Json::Value& channels = config["rtsp_pull"]["channels"];
+            if (!channels.isArray())
+            {
+                nodes.push_back(std::make_shared<RTSPPullNode>());
+                return nodes;
+            }
+
+            for (Json::ArrayIndex i = 0; i < channels.size(); i++)
+                nodes.push_back(std::make_shared<RTSPPullNode>((int)i));
+            return nodes;
+        }
+
+        /// @brief config of this node's channel, channel keys override "rtsp_pull" defaults
+        Json::Value ChannelConfig(const Json::Value& config) const
+        {
+            if (m_channel < 0)
+                return config;
+
+            Json::Value channel_config = config["rtsp_pull"];
+            channel_config.removeMember("channels");
+            const Json::Value& channel = config["rtsp_pull"]["channels"][m_channel];
+            for (const auto& key : channel.getMemberNames())
+                channel_config[key] = channel[key];
+            return channel_config;
+        }
+
+        int Channel() const { return m_channel; }
+
         int Init(const Json::Value& config)
         {
             AddOutputPort("frame_output");
-            m_rtspUrl = config["rtsp_url"].asCString();
 
-            // 打开VDEC
+            Json::Value channel_config = ChannelConfig(config);
+            if (!channel_config.isMember("rtsp_url"))
+            {
+                printf("[%s]: no rtsp_url!\n", name());
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+            m_rtspUrl = channel_config["rtsp_url"].asString();
+            nPicWidth = channel_config.get("width", nPicWidth).asInt();
+            nPicHeight = channel_config.get("height", nPicHeight).asInt();
+            nVdecGrp = channel_config.get("vdec_grp", -1).asInt();
+            nCodec = channel_config.get("codec", "h264").asString() == "h265" ? VIDEO_CODEC_H265 : VIDEO_CODEC_H264;
+            m_fileFps = channel_config.get("file_fps", m_fileFps).asDouble();
+            m_fileRate = channel_config.get("file_rate", m_fileRate).asDouble();
+            m_fileLoop = channel_config.get("file_loop", m_fileLoop).asBool();
+            m_zeroCopy = channel_config.get("zero_copy", m_zeroCopy).asBool();
+            m_framePoolCount = channel_config.get("frame_pool", m_framePoolCount).asInt();
+
+            // 按配置选择解码器, "stub"只出灰帧, 主机构建下自产测试图
+            CloseGVDEC();
+            m_decoder = hal::CreateVideoDecoder(channel_config, nVdecGrp);
+            m_decoderState = std::make_shared<DecoderState>();
+
+            // 码流队列, RTP回调线程只入队, 由送流线程阻塞在解码器上
+            m_feeder.reset(new DecoderFeeder(channel_config.get("vdec_queue_size", 32).asInt(), nCodec));
+            return AX_SUCCESS;
+        }
+
+        /// @brief open VDEC, then the RTSP handshake, may take seconds on a
+        ///     slow camera, retried by the pipeline
+        int Prepare()
+        {
             if (OpenVDEC() != AX_SUCCESS)
             {
                 printf("open vdec failed!\n");
                 return AX_ERR_INIT_FAIL;
             }
+            m_feeder->Start(m_decoder.get());
+
+            if (IsFile())
+                return PlayFile();
 
             // open client
-            if (m_client.openURL(m_rtspUrl, 1) != 0)
+            if (m_client.openURL(m_rtspUrl.c_str(), 1) != 0)
             {
-                printf("open url: %s falied!\n", m_rtspUrl);
+                printf("open url: %s falied!\n", m_rtspUrl.c_str());
+                m_client.closeURL();
                 return AX_ERR_INIT_FAIL;
             }
 
             // play
             if (m_client.playURL(frameHandlerFunc, this, NULL, NULL) != 0)
             {
-                printf("play url: %s falied!\n", m_rtspUrl);
+                printf("play url: %s falied!\n", m_rtspUrl.c_str());
+                m_client.closeURL();
                 return AX_ERR_INIT_FAIL;
             }
             return AX_SUCCESS;
         }
 
-        int OpenVDEC()
+        /// @brief feed the file's access units to SendStream from a thread, like the RTP callback
+        int PlayFile()
         {
-            int ret = AX_SUCCESS;
-
-            // 初始化VDEC
-            ret = AX_VDEC_Init();
+            StopFile();
+            int ret = m_file.Open(m_rtspUrl.substr(7), nCodec);
             if (ret != AX_SUCCESS)
-            {
-                printf("AX_VDEC_Init failed! ret=0x%x\n", ret);
                 return ret;
-            }
 
-            // 创建解码通道
-            AX_VDEC_GRP_ATTR_S stGrpAttr;
-            memset(&stGrpAttr, 0, sizeof(AX_VDEC_GRP_ATTR_S));
-            stGrpAttr.enType = PT_H264;
-            stGrpAttr.enMode = VIDEO_MODE_STREAM;
-            stGrpAttr.enLinkMode = AX_NONLINK_MODE;
-            stGrpAttr.u32PicWidth = ALIGN_16(nPicWidth);
-            stGrpAttr.u32PicHeight = ALIGN_16(nPicHeight);
-            stGrpAttr.u32FrameHeight = nPicHeight;
-            stGrpAttr.u32StreamBufSize = nPicHeight * nPicWidth * 3 / 2;
-            stGrpAttr.u32FrameBufCnt = 10;
-            stGrpAttr.s32DestroyTimeout = 0;
-            stGrpAttr.stVdecVideoAttr.eOutOrder = VIDEO_OUTPUT_ORDER_DISP;
-
-            ret = AX_VDEC_CreateGrp(nVdecGrp, &stGrpAttr);
-            if (ret != AX_SUCCESS)
-            {
-                printf("AX_VDEC_CreateGrp failed! ret=0x%x\n", ret);
-                return ret;
-            }
+            m_filePlaying = true;
+            m_fileThread = std::thread([this] {
+                AnnexBPlayer player(m_file, m_fileFps, m_fileRate, m_fileLoop);
+                const uint8_t* buf;
+                int len;
+                uint64_t pts;
+                BitstreamQueue& queue = m_feeder->queue();
+                while (m_filePlaying && player.Next(buf, len, pts) == AX_SUCCESS)
+                {
+                    // 不限速时等队列有空位, 否则和RTP一样由队列丢帧
+                    while (m_filePlaying && m_fileRate <= 0 && queue.size() >= queue.capacity())
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    SendStream((unsigned char*)buf, len, pts);
+                }
+            });
+            return AX_SUCCESS;
+        }
 
-            // 开始接收码流
-            ret = AX_VDEC_StartRecvStream(nVdecGrp);
+        void StopFile()
+        {
+            m_filePlaying = false;
+            if (m_fileThread.joinable())
+                m_fileThread.join();
+        }
+
+        /// @brief open the decoder, one still waiting for frames of the last run is kept
+        int OpenVDEC()
+        {
+            std::lock_guard<std::mutex> lg(m_decoderState->lock);
+            m_decoderState->closing = false;
+            if (m_decoderState->open)
+                return AX_SUCCESS;
+
+            VideoDecoderAttr attr;
+            attr.codec = nCodec;
+            attr.width = nPicWidth;
+            attr.height = nPicHeight;
+            attr.frame_buf_cnt = 10;
+            int ret = m_decoder->Open(attr);
             if (ret != AX_SUCCESS)
-            {
-                printf("AX_VDEC_StartRecvStream failed! ret=0x%x\n", ret);
                 return ret;
-            }
-
+            m_decoderState->open = true;
+            printf("[%s]: %s %dx%d on vdec group %d\n", name(), m_rtspUrl.c_str(), nPicWidth, nPicHeight, m_decoder->Group());
             return AX_SUCCESS;
         }
 
+        /// @brief stop feeding and close the decoder, or leave that to the last zero-copy frame released
         void CloseGVDEC()
         {
-            int ret = AX_SUCCESS;
-
-            // 销毁解码通道
-            ret = AX_VDEC_DestroyGrp(nVdecGrp);
-            if (ret != AX_SUCCESS)
+            if (m_feeder)
+                m_feeder->Stop();
+            if (!m_decoderState)
+                return;
+
+            std::lock_guard<std::mutex> lg(m_decoderState->lock);
+            if (!m_decoderState->open)
+                return;
+            if (m_decoderState->outstanding > 0)
             {
-                printf("AX_VDEC_DestroyGrp failed! ret=0x%x\n", ret);
-            }
-
-            // 关闭VDEC
-            ret = AX_VDEC_DeInit();
-            if (ret != AX_SUCCESS)
-            {
-                printf("AX_VDEC_Deinit failed! ret=0x%x\n", ret);
+                m_decoderState->closing = true;
+                return;
             }
+            m_decoder->Close();
+            m_decoderState->open = false;
         }
 
         static void frameHandlerFunc(void *arg, RTP_FRAME_TYPE frame_type, int64_t timestamp, unsigned char *buf, int len)
@@ -128,7 +276,7 @@ namespace ax
             switch (frame_type)
             {
             case FRAME_TYPE_VIDEO:
-                node->SendStream(buf, len);
+                node->SendStream(buf, len, timestamp);
                 break;
             case FRAME_TYPE_AUDIO:
                 break;
@@ -139,20 +287,55 @@ namespace ax
             }
         }
 
-        int SendStream(unsigned char* buf, int len)
+        /// @brief hand the decoded frame downstream, copied or as the decoder buffer itself
+        VideoFrame TakeFrame(DecodedFrame& frame)
         {
-            int ret = AX_SUCCESS;
-            AX_VDEC_STREAM_S stream;
-            memset(&stream, 0, sizeof(AX_VDEC_STREAM_S));
-            stream.pu8Addr = buf;
-            stream.u32Len = len;
-            ret = AX_VDEC_SendStream(nVdecGrp, &stream, 100);
-            if (ret != AX_SUCCESS)
+            if (m_zeroCopy)
             {
-                printf("AX_VDEC_SendStream failed! ret=0x%x\n", ret);
-                return ret;
+                // 最后一个引用释放时归还VDEC, 停止后最后一帧归还时关闭
+                std::shared_ptr<VideoDecoder> decoder = m_decoder;
+                std::shared_ptr<DecoderState> state = m_decoderState;
+                {
+                    std::lock_guard<std::mutex> lg(state->lock);
+                    state->outstanding++;
+                }
+                std::shared_ptr<void> owner(frame.vir_addr, [decoder, state, frame](void*) mutable {
+                    std::lock_guard<std::mutex> lg(state->lock);
+                    int ret = decoder->ReleaseFrame(frame);
+                    if (ret != AX_SUCCESS)
+                        printf("ReleaseFrame failed! ret=0x%x\n", ret);
+                    if (--state->outstanding == 0 && state->closing)
+                    {
+                        decoder->Close();
+                        state->open = false;
+                        state->closing = false;
+                    }
+                });
+                return VideoFrame::FromDecoded(frame, owner);
             }
-            return AX_SUCCESS;
+
+            size_t size = VideoFrame::BufferSize(PIXEL_FORMAT_NV12, frame.height,
+                VideoFrame::DefaultStride(PIXEL_FORMAT_NV12, frame.width));
+            if (!m_framePool || m_framePool->size() < size)
+                m_framePool.reset(new BufferPool(size, m_framePoolCount));
+
+            // 缓冲都在下游时临时分配, 不丢帧
+            VideoFrame image = VideoFrame::Allocate(*m_framePool, PIXEL_FORMAT_NV12, frame.width, frame.height);
+            if (!image.valid())
+                image = VideoFrame::Allocate(PIXEL_FORMAT_NV12, frame.width, frame.height);
+            if (image.valid())
+                VideoFrame::FromDecoded(frame, nullptr).copy_to(image);
+
+            int ret = m_decoder->ReleaseFrame(frame);
+            if (ret != AX_SUCCESS)
+                printf("ReleaseFrame failed! ret=0x%x\n", ret);
+            return image;
+        }
+
+        /// @brief queue an access unit for the decoder, never blocks the network thread
+        int SendStream(unsigned char* buf, int len, int64_t timestamp = 0)
+        {
+            return m_feeder->Push(buf, len, timestamp);
         }
 
         int Run()
@@ -162,43 +345,51 @@ namespace ax
 
             auto frame_output_port = FindOutputPort("frame_output");
 
+            // 每个解码帧一个序号, 拷贝失败的帧也占号, 下游可由序号差得知丢帧
+            uint64_t seq = 1;
             int ret = AX_SUCCESS;
             while (m_isRunning)
             {
                 // 获取帧
-                AX_VIDEO_FRAME_INFO_S stFrameInfo;
-                ret = AX_VDEC_GetFrame(nVdecGrp, &stFrameInfo, 100);
+                DecodedFrame frame;
+                ret = m_decoder->GetFrame(frame, 100);
                 if (ret != AX_SUCCESS)
                 {
-                    printf("AX_VDEC_GetFrame failed! ret=0x%x\n", ret);
+                    if (ret != AX_ERR_TIMEOUT)
+                        printf("GetFrame failed! ret=0x%x\n", ret);
                     std::this_thread::sleep_for(std::chrono::milliseconds(10));
                     continue;
                 }
 
-            
-                int width = stFrameInfo.stVFrame.u32Width;
-                int height = stFrameInfo.stVFrame.u32FrameSize * 2 / 3 / width;
-
-                cv::Mat img(height, width, CV_8UC1);
-                memcpy(img.data, (void*)stFrameInfo.stVFrame.u64VirAddr[0], stFrameInfo.stVFrame.u32FrameSize);
-                
-                frame_output_port->send(Packet(img));
-
-                // 释放帧
-                ret = AX_VDEC_ReleaseFrame(nVdecGrp, &stFrameInfo);
-                if (ret != AX_SUCCESS)
                 {
-                    printf("AX_VDEC_ReleaseFrame failed! ret=0x%x\n", ret);
+                    // 统计拷贝和发送耗时
+                    NodeMetrics::ScopedTimer timer(*m_metrics);
+
+                    VideoFrame image = TakeFrame(frame);
+                    if (image.valid())
+                    {
+                        Packet packet(image);
+                        packet.set_seq(seq);
+                        packet.set_timestamp(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count());
+                        frame_output_port->send(packet);
+                    }
+                    seq++;
                 }
 
                 std::this_thread::sleep_for(std::chrono::milliseconds(1));
             }
 
             printf("[%s]: Stop\n", node_name);
-            m_client.closeURL();
+            if (IsFile())
+                StopFile();
+            else
+                m_client.closeURL();
             CloseGVDEC();
 
             return AX_SUCCESS;
         }
     };
 }
+
+AX_REGISTER_NODE("RTSPPull", [](const Json::Value& config) { return std::make_shared<ax::RTSPPullNode>(config.get("channel", -1).asInt()); })
@@ -2,39 +2,125 @@
 
 #include <string.h>
 
+#include <map>
+#include <string>
+
 #include "node.hpp"
+#include "node_registry.hpp"
 #include "libRtspServer/RtspServerWarpper.h"
 
-#include "ax_sys_api.h"
-#include "ax_venc_api.h"
-
-#include "opencv2/opencv.hpp"
-
-// 16字节对齐
-#define ALIGN_16(x)     ((x + 15) / 16 * 16)
+#include "hal/hal.hpp"
+#include "video_frame_cv.hpp"
 
 namespace ax
 {
     class RTSPPushNode : public Node
     {
     private:
+        struct ClientStats
+        {
+            std::atomic<uint32_t> clients;
+            std::atomic<uint64_t> packets_sent;
+            std::atomic<uint64_t> bytes_sent;
+            std::atomic<uint64_t> packets_dropped;
+            std::atomic<uint32_t> keyframe_only;
+            std::atomic<uint64_t> unsupported;      // 输入既非VideoFrame也非cv::Mat
+
+            ClientStats(): clients(0), packets_sent(0), bytes_sent(0), packets_dropped(0), keyframe_only(0), unsupported(0) { }
+        };
+
         rtsp_server_t m_server;
         rtsp_session_t m_session;
         const char* m_session_name;
         int m_nVencChn;
         int m_nWidth, m_nHeight;
+        VideoEncoderAttr m_encoderAttr;
+        std::unique_ptr<VideoEncoder> m_encoder;
+        MetricsSource<ClientStats> m_clientStats;
+
+        // 每个客户端上次读到的计数, 只在推流线程访问
+        struct ClientCounts
+        {
+            uint32_t packets_sent;
+            uint32_t bytes_sent;
+            uint32_t packets_dropped;
+        };
+        std::map<std::string, ClientCounts> m_clientCounts;
 
     private:
-        void start_server()
+        void start_server(bool h265)
         {
             m_server = rtsp_new_server(8554);
-            m_session = rtsp_new_session(m_server, "live", 0);
+            m_session = rtsp_new_session(m_server, "live", h265 ? 1 : 0);
         }
 
         void stop_server()
         {
+            if (!m_server)
+                return;
             rtsp_rel_session(m_server, m_session);
             rtsp_rel_server(&m_server);
+            m_server = nullptr;
+            m_session = nullptr;
+            m_clientCounts.clear();
+        }
+
+        static uint32_t count_delta(uint32_t now, uint32_t last)
+        {
+            // 变小说明客户端重连, 计数从0开始
+            return now >= last ? now - last : now;
+        }
+
+        // rtsp_get_client_stat 只能在推流线程调用
+        // 客户端的计数是32位的且断开后消失, 累加每次的增量, 导出的计数只增不减
+        void update_client_stats()
+        {
+            rtsp_client_stat_t stats[16];
+            int num = rtsp_get_client_stat(m_server, m_session, stats, 16);
+            if (num < 0)
+                return;
+
+            uint64_t packets = 0, bytes = 0, dropped = 0;
+            uint32_t keyframe_only = 0;
+            std::map<std::string, ClientCounts> counts;
+            for (int i = 0; i < num; i++)
+            {
+                // 同一地址的多个客户端按出现顺序区分
+                std::string peer(stats[i].peer_ip, strnlen(stats[i].peer_ip, sizeof(stats[i].peer_ip)));
+                while (counts.count(peer))
+                    peer += "+";
+
+                ClientCounts now = {stats[i].packets_sent, stats[i].bytes_sent, stats[i].packets_dropped};
+                ClientCounts last = {0, 0, 0};
+                auto it = m_clientCounts.find(peer);
+                if (it != m_clientCounts.end())
+                    last = it->second;
+                counts[peer] = now;
+
+                packets += count_delta(now.packets_sent, last.packets_sent);
+                bytes += count_delta(now.bytes_sent, last.bytes_sent);
+                dropped += count_delta(now.packets_dropped, last.packets_dropped);
+                keyframe_only += stats[i].keyframe_only ? 1 : 0;
+            }
+            m_clientCounts.swap(counts);
+
+            m_clientStats->clients.store(num, std::memory_order_relaxed);
+            m_clientStats->packets_sent.fetch_add(packets, std::memory_order_relaxed);
+            m_clientStats->bytes_sent.fetch_add(bytes, std::memory_order_relaxed);
+            m_clientStats->packets_dropped.fetch_add(dropped, std::memory_order_relaxed);
+            m_clientStats->keyframe_only.store(keyframe_only, std::memory_order_relaxed);
+        }
+
+        void publish_client_stats()
+        {
+            m_clientStats.Publish("rtsp", m_name, [](const ClientStats& st, Json::Value& out) {
+                out["clients"] = st.clients.load(std::memory_order_relaxed);
+                out["packets_sent"] = (Json::UInt64)st.packets_sent.load(std::memory_order_relaxed);
+                out["bytes_sent"] = (Json::UInt64)st.bytes_sent.load(std::memory_order_relaxed);
+                out["packets_dropped"] = (Json::UInt64)st.packets_dropped.load(std::memory_order_relaxed);
+                out["clients_keyframe_only"] = st.keyframe_only.load(std::memory_order_relaxed);
+                out["unsupported"] = (Json::UInt64)st.unsupported.load(std::memory_order_relaxed);
+            }, {"packets_sent", "bytes_sent", "packets_dropped", "unsupported"});
         }
 
     public:
@@ -42,84 +128,97 @@ namespace ax
             Node("RTSP_Push"),
             m_server(nullptr),
             m_session(nullptr),
-            m_nVencChn(0),
+            m_nVencChn(-1),
             m_nWidth(1920),
-            m_nHeight(1080)
+            m_nHeight(1080),
+            m_encoderAttr()
         { }
 
-        void set_venc_chn_attr(AX_VENC_CHN_ATTR_S& stVencChnAttr)
-        {
-            memset(&stVencChnAttr, 0, sizeof(AX_VENC_CHN_ATTR_S));
-
-            stVencChnAttr.stVencAttr.u32MaxPicWidth = 0;
-            stVencChnAttr.stVencAttr.u32MaxPicHeight = 0;
-
-            stVencChnAttr.stVencAttr.u32PicWidthSrc = m_nWidth;   /*the picture width*/
-            stVencChnAttr.stVencAttr.u32PicHeightSrc = m_nHeight; /*the picture height*/
-
-            stVencChnAttr.stVencAttr.u32CropOffsetX = 0;
-            stVencChnAttr.stVencAttr.u32CropOffsetY = 0;
-            stVencChnAttr.stVencAttr.u32CropWidth = 0;
-            stVencChnAttr.stVencAttr.u32CropHeight = 0;
-            stVencChnAttr.stVencAttr.u32VideoRange = 1; /* 0: Narrow Range(NR), Y[16,235], Cb/Cr[16,240]; 1: Full Range(FR), Y/Cb/Cr[0,255] */
-
-            // ALOGN("VencChn %d:w:%d, h:%d, s:%d, Crop:(%d, %d, %d, %d) rcType:%d, payload:%d", gVencChnMapping[VencChn], stVencChnAttr.stVencAttr.u32PicWidthSrc, stVencChnAttr.stVencAttr.u32PicHeightSrc, config.nStride, stVencChnAttr.stVencAttr.u32CropOffsetX, stVencChnAttr.stVencAttr.u32CropOffsetY, stVencChnAttr.stVencAttr.u32CropWidth, stVencChnAttr.stVencAttr.u32CropHeight, config.stRCInfo.eRCType, config.ePayloadType);
-
-            stVencChnAttr.stVencAttr.u32BufSize = m_nWidth * m_nHeight * 3 / 2; /*stream buffer size*/
-            stVencChnAttr.stVencAttr.u32MbLinesPerSlice = 0;                                 /*get stream mode is slice mode or frame mode?*/
-            stVencChnAttr.stVencAttr.enLinkMode = AX_NOLINK_MODE;
-            stVencChnAttr.stVencAttr.u32GdrDuration = 0;
-            /* GOP Setting */
-            stVencChnAttr.stGopAttr.enGopMode = VENC_GOPMODE_NORMALP;
-
-            stVencChnAttr.stVencAttr.enType = PT_H264;
-
-            stVencChnAttr.stVencAttr.enProfile = VENC_H264_MAIN_PROFILE;
-            stVencChnAttr.stVencAttr.enLevel = VENC_H264_LEVEL_5_2;
-
-            AX_VENC_H264_CBR_S stH264Cbr;
-            memset(&stH264Cbr, 0, sizeof(stH264Cbr));
-            stVencChnAttr.stRcAttr.enRcMode = VENC_RC_MODE_H264CBR;
-            stVencChnAttr.stRcAttr.s32FirstFrameStartQp = -1;
-            stH264Cbr.u32Gop = 50;
-            stH264Cbr.u32SrcFrameRate = 30;  /* input frame rate */
-            stH264Cbr.fr32DstFrameRate = 30; /* target frame rate */
-            stH264Cbr.u32BitRate = m_nWidth * m_nHeight * 3 / 1024;
-            stH264Cbr.u32MinQp = 10;
-            stH264Cbr.u32MaxQp = 51;
-            stH264Cbr.u32MinIQp = 10;
-            stH264Cbr.u32MaxIQp = 51;
-            stH264Cbr.s32IntraQpDelta = -2;
-            memcpy(&stVencChnAttr.stRcAttr.stH264Cbr, &stH264Cbr, sizeof(AX_VENC_H264_CBR_S));
-        }
+        ~RTSPPushNode() { stop_server(); }
 
         int Init(const Json::Value& config)
         {
             AddInputPort("frame_input");
             m_session_name = config["rtsp_session"].asCString();
 
-            start_server();
+            m_nWidth = config.get("width", m_nWidth).asInt();
+            m_nHeight = config.get("height", m_nHeight).asInt();
+            m_nVencChn = config.get("venc_chn", -1).asInt();
 
-            AX_VENC_MOD_ATTR_S vencAttr;
-            memset(&vencAttr, 0, sizeof(AX_VENC_MOD_ATTR_S));
-            vencAttr.enVencType = VENC_VIDEO_ENCODER;
-            int ret = AX_VENC_Init(&vencAttr);
+            m_encoderAttr.codec = config.get("codec", "h264").asString() == "h265" ? VIDEO_CODEC_H265 : VIDEO_CODEC_H264;
+            m_encoderAttr.width = m_nWidth;
+            m_encoderAttr.height = m_nHeight;
+            m_encoderAttr.fps = config.get("fps", 30).asInt();
+            m_encoderAttr.bitrate_kbps = config.get("bitrate_kbps", m_nWidth * m_nHeight * 3 / 1024).asInt();
+            m_encoderAttr.gop = config.get("gop", 50).asInt();
+
+            publish_client_stats();
+            m_encoder = hal::CreateVideoEncoder(config, m_nVencChn);
+            return AX_SUCCESS;
+        }
+
+        /// @brief start the server and open VENC, both closed again when Run ends
+        int Prepare()
+        {
+            if (!m_server)
+                start_server(m_encoderAttr.codec == VIDEO_CODEC_H265);
+
+            int ret = m_encoder->Open(m_encoderAttr);
             if (ret != AX_SUCCESS)
             {
-                printf("AX_VENC_Init failed! ret=0x%x\n", ret);
+                printf("open venc failed! ret=0x%x\n", ret);
+                stop_server();
                 return ret;
             }
+            return AX_SUCCESS;
+        }
 
-            AX_VENC_CHN_ATTR_S stVencChnAttr;
-            set_venc_chn_attr(stVencChnAttr);
-            ret = AX_VENC_CreateChn(m_nVencChn, &stVencChnAttr);
-            if (ret != AX_SUCCESS)
+        /// @brief submit an NV12 frame, VENC keeps its own reference
+        /// @details frames in VDEC/pool memory go to VENC as they are, the
+        ///     others are copied into a pool block first
+        int encode(const VideoFrame& image, uint64_t pts)
+        {
+            if (image.format != PIXEL_FORMAT_NV12 || image.width != m_nWidth || image.height != m_nHeight)
+                return AX_ERR_ILLEGAL_PARAM;
+
+            if (image.phy_addr[0] || hal::IsHost())
             {
-                printf("AX_VENC_CreateChn failed! ret=0x%x\n", ret);
-                return ret;
+                DecodedFrame frame = image.to_decoded();
+                frame.pts = pts;
+                return m_encoder->SendFrame(frame, 100);
             }
 
-            return AX_SUCCESS;
+            uint32_t size = VideoFrame::BufferSize(PIXEL_FORMAT_NV12, m_nHeight, m_nWidth);
+            PoolBlock block;
+            int ret = hal::System().GetBlock(size, block);
+            if (ret != AX_SUCCESS)
+                return ret;
+
+            VideoFrame copy = VideoFrame::Wrap(PIXEL_FORMAT_NV12, m_nWidth, m_nHeight,
+                (uint8_t*)block.vir_addr, m_nWidth, nullptr, block.phy_addr);
+            image.copy_to(copy);
+            DecodedFrame frame = copy.to_decoded();
+            frame.pts = pts;
+            ret = m_encoder->SendFrame(frame, 100);
+            hal::System().ReleaseBlock(block);
+            return ret;
+        }
+
+        /// @brief push every finished access unit to the session
+        void drain_stream()
+        {
+            EncodedPacket packet;
+            while (m_encoder->GetStream(packet, 0) == AX_SUCCESS)
+            {
+                rtsp_buffer_t buff;
+                memset(&buff, 0, sizeof(buff));
+                buff.vbuff = (void*)packet.data;
+                buff.vlen = packet.size;
+                buff.vts = packet.pts;
+                buff.btype = packet.keyframe ? VIDEO_FRAME_I : VIDEO_FRAME_P;
+                rtsp_push(m_server, m_session, &buff);
+                m_encoder->ReleaseStream(packet);
+            }
         }
 
         int Run()
@@ -130,25 +229,54 @@ namespace ax
             auto frame_input_port = FindInputPort("frame_input");
 
             int ret = AX_SUCCESS;
+            auto last_stats = std::chrono::steady_clock::now();
             while (m_isRunning)
             {
+                // 每秒更新一次客户端统计
+                auto now = std::chrono::steady_clock::now();
+                if (now - last_stats >= std::chrono::seconds(1))
+                {
+                    update_client_stats();
+                    last_stats = now;
+                }
+
                 Packet packet;
-                if (AX_SUCCESS != frame_input_port->recv(packet))
+                if (AX_SUCCESS != frame_input_port->recv(packet, 100))
                 {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
                     continue;
                 }
 
-                cv::Mat img = packet.get<cv::Mat>();
+                if (!packet.isValid() || !(packet.isType<VideoFrame>() || packet.isType<cv::Mat>()))
+                {
+                    m_clientStats->unsupported.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
 
+                {
+                    // 统计编码和推流耗时
+                    NodeMetrics::ScopedTimer timer(*m_metrics);
+                    // 兼容仍发送cv::Mat(NV12, height * 3 / 2行)的节点
+                    VideoFrame image = packet.isType<VideoFrame>() ? packet.get<VideoFrame>() :
+                        utils::from_mat(packet.get<cv::Mat>(), PIXEL_FORMAT_NV12);
+                    // 沿用解码或回放的时间戳, 没有时用本地时钟
+                    uint64_t pts = image.pts ? image.pts :
+                        std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+                    ret = encode(image, pts);
+                    if (ret != AX_SUCCESS && ret != AX_ERR_TIMEOUT)
+                        printf("[%s]: encode failed! ret=0x%x\n", node_name, ret);
+                    drain_stream();
+                }
 
                 std::this_thread::sleep_for(std::chrono::milliseconds(1));
             }
 
             printf("[%s]: Stop\n", node_name);
+            m_encoder->Close();
             stop_server();
 
             return AX_SUCCESS;
         }
     };
-}
\ No newline at end of file
+}
+
+AX_REGISTER_NODE("RTSPPush", [](const Json::Value&) { return std::make_shared<ax::RTSPPushNode>(); })
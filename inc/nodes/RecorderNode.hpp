@@ -0,0 +1,172 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "node.hpp"
+#include "node_registry.hpp"
+
+#include "record/segment_file.hpp"
+#include "record/packet_types.hpp"
+
+namespace ax
+{
+    /// @brief Records packets of registered payload types into segment files.
+    /// @details {"file": "/data/cam0.axrec", "segment_mb": 1024, "grow_mb": 64,
+    ///     "index_ms": 100}
+    ///     Every packet is written with its seq and timestamp into a memory
+    ///     mapped, append only segment, see segment_file.hpp. When a segment
+    ///     reaches "segment_mb" the next one is "cam0.1.axrec", "cam0.2.axrec"
+    ///     and so on, 0 never rotates. Stop closes the segment, a restarted
+    ///     node continues in a new one. Payload types without a PacketCodec
+    ///     are counted and dropped. Packets are forwarded unchanged on
+    ///     "output" when it is connected, so the recorder can sit inline.
+    class RecorderNode : public Node
+    {
+    private:
+        struct RecorderStats
+        {
+            std::atomic<uint64_t> records;
+            std::atomic<uint64_t> bytes;
+            std::atomic<uint64_t> unsupported;
+            std::atomic<uint64_t> failed;
+            std::atomic<uint64_t> segments;
+
+            RecorderStats(): records(0), bytes(0), unsupported(0), failed(0), segments(0) { }
+        };
+
+        std::string m_path;
+        uint64_t m_segmentBytes;
+        uint64_t m_growBytes;
+        uint64_t m_indexInterval;
+        MetricsSource<RecorderStats> m_stats;
+
+        std::mutex m_lock;
+        SegmentWriter m_writer;
+        int m_segment;
+
+    public:
+        RecorderNode():
+            Node("Recorder"),
+            m_segmentBytes(1024ull << 20),
+            m_growBytes(64 << 20),
+            m_indexInterval(100000000),
+            m_segment(0)
+        { }
+
+        int Init(const Json::Value& config)
+        {
+            AddInputPort("input");
+            AddOutputPort("output");
+
+            if (!config.isMember("file"))
+            {
+                printf("[%s]: no file!\n", name());
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+            m_path = config["file"].asString();
+            m_segmentBytes = config.get("segment_mb", 1024).asUInt64() << 20;
+            m_growBytes = config.get("grow_mb", 64).asUInt64() << 20;
+            m_indexInterval = config.get("index_ms", 100).asUInt64() * 1000000;
+
+            // 先建第一个分段, 路径不可写时初始化即失败
+            int ret = OpenSegment();
+            if (ret != AX_SUCCESS)
+                return ret;
+
+            m_stats.Publish("recorder", m_name, [](const RecorderStats& st, Json::Value& out) {
+                out["records"] = (Json::UInt64)st.records.load(std::memory_order_relaxed);
+                out["bytes"] = (Json::UInt64)st.bytes.load(std::memory_order_relaxed);
+                out["unsupported"] = (Json::UInt64)st.unsupported.load(std::memory_order_relaxed);
+                out["failed"] = (Json::UInt64)st.failed.load(std::memory_order_relaxed);
+                out["segments"] = (Json::UInt64)st.segments.load(std::memory_order_relaxed);
+            }, {"records", "bytes", "unsupported", "failed", "segments"});
+            return AX_SUCCESS;
+        }
+
+        bool Schedulable() const { return true; }
+
+        int Process(std::vector<Packet>& inputs)
+        {
+            const Packet& packet = inputs[0];
+            Record(packet);
+
+            auto& output = m_outputPorts[0];
+            if (output->has_stream())
+                return output->send(packet);
+            return AX_SUCCESS;
+        }
+
+        /// @brief finish the current segment, it is readable with its index afterwards
+        void Stop()
+        {
+            Node::Stop();
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_writer.Close();
+        }
+
+        uint64_t Records() const { return m_stats->records.load(std::memory_order_relaxed); }
+
+        uint64_t Unsupported() const { return m_stats->unsupported.load(std::memory_order_relaxed); }
+
+    private:
+        int OpenSegment()
+        {
+            std::string path = record::segment_path(m_path, m_segment);
+            int ret = m_writer.Open(path, m_growBytes, m_indexInterval);
+            if (ret != AX_SUCCESS)
+            {
+                printf("[%s]: can not record to %s!\n", name(), path.c_str());
+                return ret;
+            }
+            m_segment++;
+            m_stats->segments.fetch_add(1, std::memory_order_relaxed);
+            printf("[%s]: recording to %s\n", name(), path.c_str());
+            return AX_SUCCESS;
+        }
+
+        void Record(const Packet& packet)
+        {
+            const PacketCodec* codec = PacketCodecRegistry::Instance().Find(packet);
+            if (!codec)
+            {
+                m_stats->unsupported.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            uint32_t size = codec->size(packet);
+            uint64_t timestamp = packet.timestamp();
+            if (!timestamp)
+                timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+
+            std::lock_guard<std::mutex> lg(m_lock);
+            // 停止后仍在处理的包不再写入, 重启时Init打开新分段
+            if (!m_isRunning && !m_writer.IsOpen())
+                return;
+            // 分段写满换新文件
+            if (m_writer.IsOpen() && m_segmentBytes && m_writer.Count() &&
+                m_writer.Size() + record::record_span(size) > m_segmentBytes)
+                m_writer.Close();
+            if (!m_writer.IsOpen() && OpenSegment() != AX_SUCCESS)
+            {
+                m_stats->failed.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            uint8_t* dst = m_writer.Append(codec->id, timestamp, packet.seq(), size);
+            if (!dst)
+            {
+                m_stats->failed.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            codec->write(packet, dst);
+            m_writer.Commit(dst);
+            m_stats->records.fetch_add(1, std::memory_order_relaxed);
+            m_stats->bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+    };
+}
+
+AX_REGISTER_NODE("Recorder", [](const Json::Value&) { return std::make_shared<ax::RecorderNode>(); })
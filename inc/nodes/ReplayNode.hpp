@@ -0,0 +1,215 @@
+#pragma once
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "node.hpp"
+#include "node_registry.hpp"
+
+#include "record/segment_file.hpp"
+#include "record/packet_types.hpp"
+
+namespace ax
+{
+    /// @brief Plays back a recording of RecorderNode.
+    /// @details {"file": "/data/cam0.axrec", "rate": 1, "loop": false,
+    ///     "seek_ms": 0, "keep_timestamp": false}
+    ///     Follows the numbered segments "cam0.1.axrec"... after "file".
+    ///     "rate" 1 keeps the recorded spacing of the packets, 4 is 4x, 0 is
+    ///     as fast as the consumers take them. "seek_ms" starts that far into
+    ///     the recording, found through the segment index. Packets keep
+    ///     their recorded seq, loops continue the numbering. Timestamps are
+    ///     set to the send time so latency downstream is measured as live,
+    ///     "keep_timestamp" sends the recorded ones. Frame payloads point
+    ///     into the mapped file, nothing is copied.
+    class ReplayNode : public Node
+    {
+    private:
+        struct ReplayStats
+        {
+            std::atomic<uint64_t> sent;
+            std::atomic<uint64_t> skipped;
+
+            ReplayStats(): sent(0), skipped(0) { }
+        };
+
+        std::string m_path;
+        double m_rate;
+        bool m_loop;
+        uint64_t m_seek;
+        bool m_keepTimestamp;
+        SegmentReader m_reader;
+        int m_segment;
+        MetricsSource<ReplayStats> m_stats;
+
+    public:
+        ReplayNode():
+            Node("Replay"),
+            m_rate(1),
+            m_loop(false),
+            m_seek(0),
+            m_keepTimestamp(false),
+            m_segment(0)
+        { }
+
+        int Init(const Json::Value& config)
+        {
+            AddOutputPort("output");
+
+            if (!config.isMember("file"))
+            {
+                printf("[%s]: no file!\n", name());
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+            m_path = config["file"].asString();
+            m_rate = config.get("rate", m_rate).asDouble();
+            m_loop = config.get("loop", m_loop).asBool();
+            m_seek = config.get("seek_ms", 0).asUInt64() * 1000000;
+            m_keepTimestamp = config.get("keep_timestamp", m_keepTimestamp).asBool();
+            if (m_rate < 0)
+            {
+                printf("[%s]: bad rate %.2f!\n", name(), m_rate);
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+
+            // 打开首个分段, 文件无效时初始化即失败
+            m_segment = 0;
+            int ret = m_reader.Open(m_path);
+            if (ret != AX_SUCCESS)
+                return ret;
+
+            m_stats.Publish("replay", m_name, [](const ReplayStats& st, Json::Value& out) {
+                out["sent"] = (Json::UInt64)st.sent.load(std::memory_order_relaxed);
+                out["skipped"] = (Json::UInt64)st.skipped.load(std::memory_order_relaxed);
+            }, {"sent", "skipped"});
+            printf("[%s]: %s x%.1f%s\n", name(), m_path.c_str(), m_rate, m_loop ? ", loop" : "");
+            return AX_SUCCESS;
+        }
+
+        uint64_t Sent() const { return m_stats->sent.load(std::memory_order_relaxed); }
+
+        /// @brief records of payload types without a PacketCodec
+        uint64_t Skipped() const { return m_stats->skipped.load(std::memory_order_relaxed); }
+
+        int Run()
+        {
+            const char* node_name = m_name.c_str();
+            printf("[%s]: %s start\n", node_name, node_name);
+
+            auto output_port = FindOutputPort("output");
+            if (!m_reader.IsOpen() && m_reader.Open(m_path) != AX_SUCCESS)
+                return AX_ERR_INIT_FAIL;
+            m_segment = 0;
+
+            uint64_t first = m_reader.FirstTimestamp();
+            uint64_t seek = m_seek ? first + m_seek : 0;
+            if (seek)
+                m_reader.Seek(seek);
+            uint64_t seq_offset = 0;
+            uint64_t first_seq = 0;     // first recorded seq of this pass
+            uint64_t last_seq = 0;
+            bool paced = false;
+            uint64_t base_ts = 0;
+            auto base = std::chrono::steady_clock::now();
+
+            while (m_isRunning)
+            {
+                SegmentReader::Record rec;
+                if (!m_reader.Next(rec))
+                {
+                    if (OpenSegment(m_segment + 1))
+                    {
+                        if (seek)
+                            m_reader.Seek(seek);
+                        continue;
+                    }
+                    if (!m_loop)
+                    {
+                        printf("[%s]: end of %s\n", node_name, m_path.c_str());
+                        break;
+                    }
+                    // 循环回放, 序号接续, 节拍重新对齐
+                    if (!OpenSegment(0))
+                        break;
+                    seek = m_seek ? first + m_seek : 0;
+                    if (seek)
+                        m_reader.Seek(seek);
+                    if (first_seq)
+                        seq_offset = last_seq - (first_seq - 1);
+                    first_seq = 0;
+                    paced = false;
+                    continue;
+                }
+                seek = 0;
+
+                const PacketCodec* codec = PacketCodecRegistry::Instance().Find(rec.type);
+                if (!codec)
+                {
+                    m_stats->skipped.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                if (m_rate > 0)
+                {
+                    if (!paced || rec.timestamp_ns < base_ts)
+                    {
+                        base_ts = rec.timestamp_ns;
+                        base = std::chrono::steady_clock::now();
+                        paced = true;
+                    }
+                    auto due = base + std::chrono::nanoseconds((int64_t)((rec.timestamp_ns - base_ts) / m_rate));
+                    // 分段睡眠, 停止时及时退出
+                    while (m_isRunning && std::chrono::steady_clock::now() < due)
+                        std::this_thread::sleep_until(std::min(due, std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
+                    if (!m_isRunning)
+                        break;
+                }
+
+                NodeMetrics::ScopedTimer timer(*m_metrics);
+                Packet packet = codec->read(rec.data, rec.size, m_reader.Mapping());
+                if (!packet.isValid())
+                {
+                    m_stats->skipped.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                if (rec.seq)
+                {
+                    if (!first_seq)
+                        first_seq = rec.seq;
+                    last_seq = rec.seq + seq_offset;
+                    packet.set_seq(last_seq);
+                }
+                packet.set_timestamp(m_keepTimestamp ? rec.timestamp_ns :
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count());
+                output_port->send(packet);
+                m_stats->sent.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // 帧仍可引用映射, 关闭只释放本节点的引用
+            m_reader.Close();
+            printf("[%s]: Stop\n", node_name);
+            return AX_SUCCESS;
+        }
+
+    private:
+        bool OpenSegment(int segment)
+        {
+            std::string path = record::segment_path(m_path, segment);
+            struct stat st;
+            if (segment > 0 && stat(path.c_str(), &st) != 0)
+                return false;
+            if (m_reader.Open(path) != AX_SUCCESS)
+                return false;
+            m_segment = segment;
+            return true;
+        }
+    };
+}
+
+AX_REGISTER_NODE("Replay", [](const Json::Value&) { return std::make_shared<ax::ReplayNode>(); })
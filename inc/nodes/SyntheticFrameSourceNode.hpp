@@ -0,0 +1,155 @@
+#pragma once
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "node.hpp"
+#include "node_registry.hpp"
+#include "buffer_pool.hpp"
+#include "video_frame.hpp"
+
+namespace ax
+{
+    /// @brief Emits pooled VideoFrames at a fixed rate, to measure the pipeline
+    ///     without decoder cost.
+    /// @details {"width": 1920, "height": 1080, "format": "nv12", "fps": 30,
+    ///     "pool": 8, "count": 0, "pattern": false}
+    ///     "format" is "nv12", "bgr", "rgb" or "gray". "fps" 0 sends as fast
+    ///     as buffers come back, otherwise ticks without a free buffer are
+    ///     skipped like a camera drops frames. "count" 0 runs until stopped.
+    ///     Buffers are not touched unless "pattern" is set. Every packet
+    ///     carries seq and timestamp for CountingSinkNode, frames a pts of
+    ///     the capture time in microseconds.
+    class SyntheticFrameSourceNode : public Node
+    {
+    private:
+        struct SourceStats
+        {
+            std::atomic<uint64_t> sent;
+            std::atomic<uint64_t> skipped;
+
+            SourceStats(): sent(0), skipped(0) { }
+        };
+
+        int m_format;
+        int m_width;
+        int m_height;
+        double m_fps;
+        uint64_t m_count;
+        bool m_pattern;
+        std::unique_ptr<BufferPool> m_pool;
+        MetricsSource<SourceStats> m_stats;
+
+    public:
+        SyntheticFrameSourceNode():
+            Node("Synthetic_Frame_Source"),
+            m_format(PIXEL_FORMAT_NV12),
+            m_width(1920),
+            m_height(1080),
+            m_fps(30),
+            m_count(0),
+            m_pattern(false)
+        { }
+
+        int Init(const Json::Value& config)
+        {
+            AddOutputPort("frame_output");
+
+            m_width = config.get("width", m_width).asInt();
+            m_height = config.get("height", m_height).asInt();
+            std::string format = config.get("format", "nv12").asString();
+            if (format == "bgr")
+                m_format = PIXEL_FORMAT_BGR;
+            else if (format == "rgb")
+                m_format = PIXEL_FORMAT_RGB;
+            else if (format == "gray")
+                m_format = PIXEL_FORMAT_GRAY;
+            else
+                m_format = PIXEL_FORMAT_NV12;
+            m_fps = config.get("fps", m_fps).asDouble();
+            m_count = config.get("count", 0).asUInt64();
+            m_pattern = config.get("pattern", false).asBool();
+            if (m_width <= 0 || m_height <= 0 || (m_format == PIXEL_FORMAT_NV12 && (m_width % 2 || m_height % 2)))
+            {
+                printf("[%s]: bad frame size %dx%d!\n", name(), m_width, m_height);
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+
+            size_t size = VideoFrame::BufferSize(m_format, m_height, VideoFrame::DefaultStride(m_format, m_width));
+            int pool = config.get("pool", 8).asInt();
+            m_pool.reset(new BufferPool(size, pool));
+            if (m_pool->count() != pool)
+            {
+                printf("[%s]: no memory for %d frames!\n", name(), pool);
+                return AX_ERR_INIT_FAIL;
+            }
+
+            m_stats.Publish("source", m_name, [](const SourceStats& st, Json::Value& out) {
+                out["sent"] = (Json::UInt64)st.sent.load(std::memory_order_relaxed);
+                out["skipped"] = (Json::UInt64)st.skipped.load(std::memory_order_relaxed);
+            }, {"sent", "skipped"});
+            return AX_SUCCESS;
+        }
+
+        uint64_t Sent() const { return m_stats->sent.load(std::memory_order_relaxed); }
+
+        uint64_t Skipped() const { return m_stats->skipped.load(std::memory_order_relaxed); }
+
+        int Run()
+        {
+            const char* node_name = m_name.c_str();
+            printf("[%s]: %s start\n", node_name, node_name);
+
+            auto frame_output_port = FindOutputPort("frame_output");
+            auto period = std::chrono::nanoseconds(m_fps > 0 ? (int64_t)(1e9 / m_fps) : 0);
+            auto next = std::chrono::steady_clock::now();
+            uint64_t seq = 1;
+            while (m_isRunning && (m_count == 0 || seq <= m_count))
+            {
+                VideoFrame frame;
+                if (m_fps > 0)
+                {
+                    // 下游阻塞过久时不补发
+                    next = std::max(next + period, std::chrono::steady_clock::now() - period);
+                    std::this_thread::sleep_until(next);
+                    frame = VideoFrame::Allocate(*m_pool, m_format, m_width, m_height, 0);
+                    if (!frame.valid())
+                    {
+                        m_stats->skipped.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                }
+                else
+                {
+                    // 不限速, 等下游归还缓冲
+                    frame = VideoFrame::Allocate(*m_pool, m_format, m_width, m_height, 100);
+                    if (!frame.valid())
+                        continue;
+                }
+
+                NodeMetrics::ScopedTimer timer(*m_metrics);
+                // 采集时刻, pts 以微秒计, 与解码帧一致
+                auto now = std::chrono::steady_clock::now().time_since_epoch();
+                frame.pts = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+                if (m_pattern)
+                    memset(frame.data[0], (uint8_t)seq, m_pool->size());
+
+                Packet packet(frame);
+                packet.set_seq(seq++);
+                packet.set_timestamp(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+                frame_output_port->send(packet);
+                m_stats->sent.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            printf("[%s]: Stop\n", node_name);
+            return AX_SUCCESS;
+        }
+    };
+}
+
+AX_REGISTER_NODE("SyntheticFrameSource", [](const Json::Value&) { return std::make_shared<ax::SyntheticFrameSourceNode>(); })
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "node.hpp"
+#include "node_registry.hpp"
+#include "detections.hpp"
+#include "track/tracker.hpp"
+#include "track/detect_schedule.hpp"
+
+namespace ax
+{
+    /// @brief Links Detections over time into tracks, for many channels at once.
+    /// @details {"channels": 4, "high_threshold": 0.5, "low_threshold": 0.1,
+    ///     "new_threshold": 0.6, "match_iou": 0.2, "low_match_iou": 0.5,
+    ///     "new_match_iou": 0.3, "max_lost": 30, "max_tracks": 1024,
+    ///     "class_aware": true, "max_skip": 0, "motion": 0.02}
+    ///     Detections from "input<n>" go to their own channel's tracker, see
+    ///     Tracker, and the tracks matched in that frame leave "output<n>"
+    ///     as Detections with Detection::track set. One thread serves all
+    ///     channels. The gap in Packet::seq since the channel's last packet
+    ///     is how many frames the tracks are predicted, so frames
+    ///     dropped or skipped upstream are bridged. With "max_skip" above 0
+    ///     the node publishes a detection interval per channel in
+    ///     DetectSchedule for a DetectGateNode in front of the detector: it
+    ///     grows by one per frame up to "max_skip" + 1 while the channel is
+    ///     settled, i.e. every track confirmed, none born or lost, and none
+    ///     moving more than "motion" of its size per frame. Otherwise it
+    ///     drops back to 1.
+    class TrackerNode : public Node
+    {
+    private:
+        struct TrackerStats
+        {
+            std::atomic<uint64_t> frames;
+            std::atomic<uint64_t> unsupported;
+            std::atomic<int> tracks;
+            Histogram update_us;
+
+            TrackerStats(): frames(0), unsupported(0), tracks(0) { }
+        };
+
+        struct Channel
+        {
+            std::unique_ptr<Tracker> tracker;
+            std::shared_ptr<std::atomic<int>> interval;
+            uint64_t last_seq;
+            int tracks;
+        };
+
+        TrackerParams m_params;
+        int m_channels;
+        int m_maxSkip;
+        float m_motion;
+        std::vector<Channel> m_state;
+        MetricsSource<TrackerStats> m_stats;
+
+        // 处理线程等待输入
+        std::mutex m_lock;
+        std::condition_variable m_cond;
+        bool m_signaled;
+
+    public:
+        TrackerNode():
+            Node("Tracker"),
+            m_channels(1),
+            m_maxSkip(0),
+            m_motion(0.02f),
+            m_signaled(false)
+        { }
+
+        int Init(const Json::Value& config)
+        {
+            m_channels = config.get("channels", m_channels).asInt();
+            if (m_channels <= 0)
+            {
+                printf("[%s]: bad channels %d!\n", name(), m_channels);
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+            for (int i = 0; i < m_channels; i++)
+            {
+                AddInputPort("input" + std::to_string(i));
+                AddOutputPort("output" + std::to_string(i));
+            }
+
+            m_params.high_threshold = config.get("high_threshold", m_params.high_threshold).asFloat();
+            m_params.low_threshold = config.get("low_threshold", m_params.low_threshold).asFloat();
+            m_params.new_threshold = config.get("new_threshold", m_params.new_threshold).asFloat();
+            m_params.match_iou = config.get("match_iou", m_params.match_iou).asFloat();
+            m_params.low_match_iou = config.get("low_match_iou", m_params.low_match_iou).asFloat();
+            m_params.new_match_iou = config.get("new_match_iou", m_params.new_match_iou).asFloat();
+            m_params.max_lost = config.get("max_lost", m_params.max_lost).asInt();
+            m_params.max_tracks = config.get("max_tracks", m_params.max_tracks).asInt();
+            m_params.class_aware = config.get("class_aware", m_params.class_aware).asBool();
+            m_maxSkip = std::max(config.get("max_skip", m_maxSkip).asInt(), 0);
+            m_motion = config.get("motion", m_motion).asFloat();
+            if (m_params.low_threshold > m_params.high_threshold || m_params.match_iou <= 0
+                || m_params.low_match_iou <= 0 || m_params.new_match_iou <= 0)
+            {
+                printf("[%s]: bad thresholds!\n", name());
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+
+            m_state.clear();
+            m_state.resize(m_channels);
+            for (int i = 0; i < m_channels; i++)
+            {
+                m_state[i].tracker.reset(new Tracker(m_params));
+                m_state[i].interval = DetectSchedule::Instance().Get(DetectSchedule::Key(m_name, i));
+            }
+
+            m_stats.Publish("tracker", m_name, [](const TrackerStats& st, Json::Value& out) {
+                out["frames"] = (Json::UInt64)st.frames.load(std::memory_order_relaxed);
+                out["unsupported"] = (Json::UInt64)st.unsupported.load(std::memory_order_relaxed);
+                out["tracks"] = st.tracks.load(std::memory_order_relaxed);
+                out["update_p50_us"] = (Json::UInt64)st.update_us.quantile(0.5);
+                out["update_p99_us"] = (Json::UInt64)st.update_us.quantile(0.99);
+            }, {"frames", "unsupported"});
+            printf("[%s]: %d channels, max skip %d\n", name(), m_channels, m_maxSkip);
+            return AX_SUCCESS;
+        }
+
+        /// @brief every start begins without tracks, detecting every frame
+        int Prepare()
+        {
+            m_stats->tracks.store(0, std::memory_order_relaxed);
+            for (auto& ch : m_state)
+            {
+                ch.tracker->Reset();
+                ch.interval->store(1, std::memory_order_relaxed);
+                ch.last_seq = 0;
+                ch.tracks = 0;
+            }
+            return AX_SUCCESS;
+        }
+
+        void Stop()
+        {
+            Node::Stop();
+            Signal();
+        }
+
+        uint64_t Frames() const { return m_stats->frames.load(std::memory_order_relaxed); }
+
+        /// @brief tracks alive over all channels, tracked or lost
+        int Tracks() const { return m_stats->tracks.load(std::memory_order_relaxed); }
+
+        /// @brief time of one Tracker::Update
+        const Histogram& UpdateLatency() const { return m_stats->update_us; }
+
+        int Run()
+        {
+            const char* node_name = m_name.c_str();
+            printf("[%s]: %s start\n", node_name, node_name);
+
+            // 输入到达时唤醒处理线程, 本节点不经过调度器, 监听器空闲
+            for (int i = 0; i < m_channels; i++)
+            {
+                if (m_inputPorts[i]->has_stream())
+                    m_inputPorts[i]->stream()->set_listener([this] { Signal(); });
+            }
+
+            while (m_isRunning)
+            {
+                {
+                    std::lock_guard<std::mutex> lg(m_lock);
+                    m_signaled = false;
+                }
+                bool took = false;
+                for (int i = 0; i < m_channels; i++)
+                {
+                    Packet packet;
+                    while (m_isRunning && m_inputPorts[i]->take(packet) == AX_SUCCESS)
+                    {
+                        Process(i, packet);
+                        took = true;
+                    }
+                }
+                if (took)
+                    continue;
+
+                std::unique_lock<std::mutex> lk(m_lock);
+                m_cond.wait_for(lk, std::chrono::milliseconds(100), [this] { return m_signaled || !m_isRunning; });
+            }
+
+            for (int i = 0; i < m_channels; i++)
+            {
+                if (m_inputPorts[i]->has_stream())
+                    m_inputPorts[i]->stream()->set_listener(nullptr);
+            }
+            printf("[%s]: Stop\n", node_name);
+            return AX_SUCCESS;
+        }
+
+    private:
+        void Signal()
+        {
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                m_signaled = true;
+            }
+            m_cond.notify_all();
+        }
+
+        void Process(int channel, const Packet& input)
+        {
+            if (!input.isValid() || !input.isType<Detections>())
+            {
+                m_stats->unsupported.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            NodeMetrics::ScopedTimer timer(*m_metrics);
+            Channel& ch = m_state[channel];
+
+            // 按序号差预测跳过的帧, 回退或无序号时按一帧
+            uint64_t seq = input.seq();
+            int steps = 1;
+            if (seq && ch.last_seq && seq > ch.last_seq)
+                steps = (int)std::min<uint64_t>(seq - ch.last_seq, m_params.max_lost + 1);
+            if (seq)
+                ch.last_seq = seq;
+
+            Detections tracks;
+            auto start = std::chrono::steady_clock::now();
+            ch.tracker->Update(input.get<Detections>(), steps, tracks);
+            m_stats->update_us.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count());
+
+            if (m_maxSkip > 0)
+            {
+                int interval = ch.interval->load(std::memory_order_relaxed);
+                bool settled = ch.tracker->Settled() && ch.tracker->MaxMotion() <= m_motion;
+                interval = settled ? std::min(interval + 1, m_maxSkip + 1) : 1;
+                ch.interval->store(interval, std::memory_order_relaxed);
+            }
+
+            int size = ch.tracker->tracks().size();
+            m_stats->tracks.fetch_add(size - ch.tracks, std::memory_order_relaxed);
+            ch.tracks = size;
+            m_stats->frames.fetch_add(1, std::memory_order_relaxed);
+
+            Packet packet(tracks);
+            packet.set_seq(input.seq());
+            packet.set_timestamp(input.timestamp());
+            m_outputPorts[channel]->send(packet);
+        }
+    };
+}
+
+AX_REGISTER_NODE("Tracker", [](const Json::Value&) { return std::make_shared<ax::TrackerNode>(); })
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <stdint.h>
+
 #include <memory>
+#include <vector>
 #include <typeindex>
 #include <typeinfo>
 
 namespace ax
 {
+    struct TraceContext;
+
     /// @brief Type erasure data in stream
     class Packet
     {
@@ -26,17 +31,24 @@ namespace ax
 
         std::shared_ptr<PacketConcept> pack;
         bool m_isValid;
+        std::shared_ptr<TraceContext> m_trace;  // null unless tracing, see trace.hpp
+        uint64_t m_timestamp;   // steady clock ns when the source made it, 0 if unset
+        uint64_t m_seq;         // per source sequence from 1, 0 if unset
 
     public:
         template< typename _Ty > Packet( const _Ty& _pack ) :
             pack( new PacketModel<_Ty>( _pack ) ),
-            m_isValid(true)
+            m_isValid(true),
+            m_timestamp(0),
+            m_seq(0)
         { 
   
         }
 
         Packet():
-            m_isValid(false) { }
+            m_isValid(false),
+            m_timestamp(0),
+            m_seq(0) { }
 
         ~Packet()
         {
@@ -51,6 +63,9 @@ namespace ax
             pack.reset();
             pack = other.pack;
             m_isValid = other.m_isValid;
+            m_trace = other.m_trace;
+            m_timestamp = other.m_timestamp;
+            m_seq = other.m_seq;
             return *this;
         }
 
@@ -58,6 +73,9 @@ namespace ax
         {
             pack = other.pack;
             m_isValid = other.m_isValid;
+            m_trace = other.m_trace;
+            m_timestamp = other.m_timestamp;
+            m_seq = other.m_seq;
         }
 
         bool isValid() const { return m_isValid; }
@@ -68,10 +86,28 @@ namespace ax
             return pack->Type() == typeid(T); 
         }
 
+        /// @brief type of the payload, valid packets only
+        const std::type_info& type() const { return pack->Type(); }
+
+        /// @brief path of the frame through the pipeline, stamped by ports and streams
+        const std::shared_ptr<TraceContext>& trace() const { return m_trace; }
+        void set_trace(const std::shared_ptr<TraceContext>& trace) { m_trace = trace; }
+
+        /// @brief set by sources, forwarded with the packet, used for end to end latency
+        uint64_t timestamp() const { return m_timestamp; }
+        void set_timestamp(uint64_t ns) { m_timestamp = ns; }
+
+        /// @brief set by sources, lets sinks tell drops and reordering
+        uint64_t seq() const { return m_seq; }
+        void set_seq(uint64_t seq) { m_seq = seq; }
+
         template <typename T>
         T& get() const
         {
             return std::dynamic_pointer_cast<PacketModel<T>>(pack)->get();
         }
     };
+
+    /// @brief packets of an input port with batch size above 1, delivered as one packet
+    typedef std::vector<Packet> PacketBatch;
 }
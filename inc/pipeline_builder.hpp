@@ -0,0 +1,256 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <queue>
+#include <string>
+
+#include "err.hpp"
+#include "ax_pipeline.hpp"
+#include "node_registry.hpp"
+
+namespace ax
+{
+    /// @brief Creates the nodes and edges of a pipeline from its config
+    /// @details
+    ///     {"graph": {
+    ///         "default_capacity": -1, "default_policy": "block",
+    ///         "nodes": [
+    ///             {"name": "cam0", "type": "RTSPPull", "placement": "thread",
+    ///              "config": {"rtsp_url": "rtsp://..."}},
+    ///             {"name": "push", "type": "RTSPPush", "config": {"rtsp_session": "live"}}],
+    ///         "edges": [
+    ///             {"from": "cam0.frame_output", "to": "push.frame_input",
+    ///              "capacity": 4, "policy": "drop_oldest", "batch": 1}]}}
+    ///     A node is initialised with the pipeline config overlaid by its
+    ///     "config". "placement" is "thread" or "scheduler", "parallelism"
+    ///     as in the scheduler config. "capacity" -1 is unbounded, "policy"
+    ///     is "block", "drop_oldest" or "drop_newest". "batch" above 1 hands
+    ///     the consumer a PacketBatch. "thread" is the utils::ThreadPolicy of
+    ///     the node, e.g. {"cpus": "0-1", "priority": 30}.
+    class PipelineBuilder
+    {
+    public:
+        /// @brief check the graph without creating anything: names, types,
+        ///     edge endpoints, edge parameters and cycles
+        static int Validate(const Json::Value& graph)
+        {
+            const Json::Value& nodes = graph["nodes"];
+            if (!nodes.isArray() || nodes.empty())
+            {
+                printf("graph: no nodes\n");
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+
+            std::set<std::string> names;
+            for (const auto& n : nodes)
+            {
+                std::string name = n.get("name", "").asString();
+                std::string type = n.get("type", "").asString();
+                if (name.empty() || !names.insert(name).second)
+                {
+                    printf("graph: node name \"%s\" empty or duplicated\n", name.c_str());
+                    return AX_ERR_ILLEGAL_PARAM;
+                }
+                if (!NodeRegistry::Instance().Has(type))
+                {
+                    printf("graph: node %s has unknown type \"%s\"\n", name.c_str(), type.c_str());
+                    return AX_ERR_ILLEGAL_PARAM;
+                }
+                std::string placement = n.get("placement", "").asString();
+                if (!placement.empty() && placement != "thread" && placement != "scheduler")
+                {
+                    printf("graph: node %s has unknown placement \"%s\"\n", name.c_str(), placement.c_str());
+                    return AX_ERR_ILLEGAL_PARAM;
+                }
+                if (n.get("parallelism", 1).asInt() < 1)
+                {
+                    printf("graph: node %s parallelism must be at least 1\n", name.c_str());
+                    return AX_ERR_ILLEGAL_PARAM;
+                }
+            }
+
+            std::map<std::string, std::set<std::string>> successors;
+            std::map<std::string, int> in_degree;
+            std::set<std::string> targets;
+            for (const auto& name : names)
+                in_degree[name] = 0;
+
+            for (const auto& e : graph["edges"])
+            {
+                std::string from_node, from_port, to_node, to_port;
+                if (!ParseEndpoint(e["from"].asString(), from_node, from_port) ||
+                    !ParseEndpoint(e["to"].asString(), to_node, to_port))
+                {
+                    printf("graph: edge endpoints must be \"node.port\", got \"%s\" -> \"%s\"\n",
+                        e["from"].asString().c_str(), e["to"].asString().c_str());
+                    return AX_ERR_ILLEGAL_PARAM;
+                }
+                if (!names.count(from_node) || !names.count(to_node))
+                {
+                    printf("graph: edge %s -> %s references an unknown node\n", from_node.c_str(), to_node.c_str());
+                    return AX_ERR_ILLEGAL_PARAM;
+                }
+                if (!targets.insert(e["to"].asString()).second)
+                {
+                    printf("graph: input %s has more than one edge\n", e["to"].asString().c_str());
+                    return AX_ERR_ILLEGAL_PARAM;
+                }
+
+                int capacity = e.get("capacity", graph.get("default_capacity", -1)).asInt();
+                StreamPolicy policy = STREAM_BLOCK;
+                if (capacity == 0 || capacity < -1 ||
+                    !ParsePolicy(e.get("policy", graph.get("default_policy", "block")).asString(), policy) ||
+                    e.get("batch", 1).asInt() < 1)
+                {
+                    printf("graph: edge %s -> %s needs capacity -1 or above 0, a known policy and batch at least 1\n",
+                        e["from"].asString().c_str(), e["to"].asString().c_str());
+                    return AX_ERR_ILLEGAL_PARAM;
+                }
+
+                if (successors[from_node].insert(to_node).second)
+                    in_degree[to_node]++;
+            }
+
+            // Kahn, nodes left over are on a cycle
+            std::queue<std::string> ready;
+            for (const auto& d : in_degree)
+            {
+                if (d.second == 0)
+                    ready.push(d.first);
+            }
+            size_t visited = 0;
+            while (!ready.empty())
+            {
+                std::string name = ready.front();
+                ready.pop();
+                visited++;
+                for (const auto& next : successors[name])
+                {
+                    if (--in_degree[next] == 0)
+                        ready.push(next);
+                }
+            }
+            if (visited != names.size())
+            {
+                for (const auto& d : in_degree)
+                {
+                    if (d.second > 0)
+                        printf("graph: node %s is on a cycle\n", d.first.c_str());
+                }
+                return AX_ERR_ILLEGAL_PARAM;
+            }
+            return AX_SUCCESS;
+        }
+
+        /// @brief validate config["graph"], then create and connect its nodes in pipeline
+        static int Build(AX_Pipeline& pipeline, const Json::Value& config)
+        {
+            const Json::Value& graph = config["graph"];
+            int ret = Validate(graph);
+            if (ret != AX_SUCCESS)
+                return ret;
+
+            for (const auto& n : graph["nodes"])
+            {
+                std::string name = n["name"].asString();
+                Json::Value node_config = config;
+                node_config.removeMember("graph");
+                for (const auto& key : n["config"].getMemberNames())
+                    node_config[key] = n["config"][key];
+
+                auto node = NodeRegistry::Instance().Create(n["type"].asString(), name, n["config"]);
+                if (!node || !pipeline.AddNode(node, node_config))
+                {
+                    printf("graph: create node %s failed\n", name.c_str());
+                    return AX_ERR_INIT_FAIL;
+                }
+
+                node->SetParallelism(n.get("parallelism", 1).asInt());
+                std::string placement = n.get("placement", "").asString();
+                if (placement == "thread")
+                    pipeline.SetPlacement(node, NODE_PLACEMENT_THREAD);
+                else if (placement == "scheduler")
+                    pipeline.SetPlacement(node, NODE_PLACEMENT_SCHEDULER);
+                if (n.isMember("thread"))
+                    pipeline.SetThreadPolicy(node, utils::ThreadPolicy::from_json(n["thread"]));
+            }
+
+            // ports exist once the nodes are initialised
+            for (const auto& e : graph["edges"])
+            {
+                std::string from_node, from_port, to_node, to_port;
+                ParseEndpoint(e["from"].asString(), from_node, from_port);
+                ParseEndpoint(e["to"].asString(), to_node, to_port);
+
+                auto oport = pipeline.FindNode(from_node)->FindOutputPort(from_port);
+                auto iport = pipeline.FindNode(to_node)->FindInputPort(to_port);
+                if (!oport || !iport)
+                {
+                    printf("graph: node %s has no port %s\n",
+                        oport ? to_node.c_str() : from_node.c_str(), oport ? to_port.c_str() : from_port.c_str());
+                    return AX_ERR_ILLEGAL_PARAM;
+                }
+
+                StreamPolicy policy = STREAM_BLOCK;
+                ParsePolicy(e.get("policy", graph.get("default_policy", "block")).asString(), policy);
+                oport->connect(iport, e.get("capacity", graph.get("default_capacity", -1)).asInt(), policy);
+                iport->set_batch(e.get("batch", 1).asInt());
+            }
+
+            for (int i = 0; i < pipeline.GetNodeNum(); i++)
+            {
+                auto node = pipeline.GetNode(i);
+                for (int j = 0; j < node->GetInputPortNum(); j++)
+                {
+                    if (!node->GetInputPort(j)->has_stream())
+                        printf("graph: %s.%s has no edge, fed by the pipeline input\n", node->name(), node->GetInputPort(j)->name().c_str());
+                }
+            }
+            return AX_SUCCESS;
+        }
+
+    private:
+        static bool ParseEndpoint(const std::string& endpoint, std::string& node, std::string& port)
+        {
+            size_t pos = endpoint.rfind('.');
+            if (pos == std::string::npos || pos == 0 || pos + 1 == endpoint.size())
+                return false;
+            node = endpoint.substr(0, pos);
+            port = endpoint.substr(pos + 1);
+            return true;
+        }
+
+        static bool ParsePolicy(const std::string& name, StreamPolicy& policy)
+        {
+            if (name == "block")
+                policy = STREAM_BLOCK;
+            else if (name == "drop_oldest")
+                policy = STREAM_DROP_OLDEST;
+            else if (name == "drop_newest")
+                policy = STREAM_DROP_NEWEST;
+            else
+                return false;
+            return true;
+        }
+    };
+
+    /// @brief Pipeline declared entirely by config["graph"]
+    class GraphPipeline : public AX_Pipeline
+    {
+    public:
+        GraphPipeline(const Json::Value& config):
+            AX_Pipeline(config)
+        { }
+
+        int Init(const Json::Value& config)
+        {
+            int ret = PipelineBuilder::Build(*this, config);
+            if (ret != AX_SUCCESS)
+                return ret;
+
+            m_hasInit = true;
+            return AX_SUCCESS;
+        }
+    };
+}
@@ -3,18 +3,37 @@
 #include "err.hpp"
 #include "stream.hpp"
 #include "packet.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 
 #include <memory>
 #include <vector>
 
 namespace ax
 {
+    class OutputPort;
+
+    /// @brief sends made by the current thread, held back for reordering
+    struct OutputCapture
+    {
+        std::vector<std::pair<OutputPort*, Packet>> packets;
+    };
+
+    inline OutputCapture*& current_output_capture()
+    {
+        static thread_local OutputCapture* capture = nullptr;
+        return capture;
+    }
+
     class Port
     {
     public:
-        Port() = default;
+        Port():
+            m_traceId(0)
+            { }
         Port(const std::string& port_name):
-            m_portName(port_name)
+            m_portName(port_name),
+            m_traceId(0)
             { }
 
         std::string name() const {
@@ -25,34 +44,77 @@ namespace ax
             m_portName = port_name;
         }
 
+        /// @brief packets through the port are counted on the owning node
+        void set_metrics(const std::shared_ptr<NodeMetrics>& metrics) {
+            m_metrics = metrics;
+        }
+
+        /// @brief Tracer id of the owning node
+        void set_trace_id(uint16_t id) {
+            m_traceId = id;
+        }
+
     protected:
         std::string m_portName;
+        std::shared_ptr<NodeMetrics> m_metrics;
+        uint16_t m_traceId;
     };
 
     class InputPort : public Port
     {
         std::shared_ptr<Stream> m_stream;
+        int m_batch;
 
     public:
         InputPort():
-            m_stream(nullptr)
+            m_stream(nullptr),
+            m_batch(1)
         { }
 
         InputPort(const std::string& port_name):
             Port(port_name),
-            m_stream(nullptr)
+            m_stream(nullptr),
+            m_batch(1)
         { }
 
+        /// @brief above 1 the scheduler hands up to batch packets to Process
+        ///     at once, as one Packet holding a PacketBatch
+        int batch() const { return m_batch; }
+        void set_batch(int batch) { m_batch = batch > 0 ? batch : 1; }
+
         ~InputPort() = default;
 
+        /// @brief receive the packet the node works on next, its trace
+        ///     continues in the packets the node sends
         int recv(Packet& packet)
+        {
+            int ret = take(packet);
+            if (ret == AX_SUCCESS)
+                TraceCursor::Enter(packet, m_traceId);
+            return ret;
+        }
+
+        /// @brief wait up to timeout milliseconds for a packet
+        int recv(Packet& packet, int timeout)
+        {
+            int ret = take(packet, timeout);
+            if (ret == AX_SUCCESS)
+                TraceCursor::Enter(packet, m_traceId);
+            return ret;
+        }
+
+        /// @brief recv without touching the trace cursor, for nodes combining several inputs
+        int take(Packet& packet, int timeout = 0)
         {
             if (!has_stream())
             {
                 return AX_ERR_NULL_PTR;
             }
-                
-            return m_stream->pop(packet);
+
+            int ret = timeout > 0 ? m_stream->pop(packet, timeout) : m_stream->pop(packet);
+            if (ret == AX_SUCCESS && m_metrics)
+                m_metrics->packets_in.add();
+            return ret;
         }
 
         bool set_stream(const std::shared_ptr<Stream>& stream) 
@@ -68,16 +130,25 @@ namespace ax
         {
             return m_stream != nullptr;
         }
+
+        std::shared_ptr<Stream> stream() const
+        {
+            return m_stream;
+        }
     };
 
     class OutputPort : public Port
     {
         std::vector<std::shared_ptr<Stream>> m_streams;
+        uint64_t m_traceSeq;
 
     public:
-        OutputPort() = default;
+        OutputPort():
+            m_traceSeq(0)
+        { }
         OutputPort(const std::string& port_name):
-            Port(port_name)
+            Port(port_name),
+            m_traceSeq(0)
         { }
 
         ~OutputPort() = default;
@@ -87,17 +158,41 @@ namespace ax
             if (!packet.isValid())
                 return AX_ERR_ILLEGAL_PARAM;
 
+            Packet out = packet;
+            if (Tracer::Instance().Enabled())
+                StampTrace(out);
+
+            OutputCapture* capture = current_output_capture();
+            if (capture)
+            {
+                capture->packets.emplace_back(this, out);
+                return AX_SUCCESS;
+            }
+            return send_now(out);
+        }
+
+        /// @brief send bypassing any capture
+        int send_now(const Packet& packet)
+        {
             int ret = AX_SUCCESS;
             if (!has_stream())
             {
                 return -1;
             }
+            if (m_metrics)
+                m_metrics->packets_out.add();
 
-            for (const auto& s : m_streams)
+            // a full or closed stream does not starve the others
+            for (size_t i = 0; i < m_streams.size(); i++)
             {
-                ret = s->push(packet);
-                if (ret != AX_SUCCESS)
-                    return ret;
+                // each branch records its own path, the original goes last
+                Packet p = packet;
+                if (packet.trace() && i + 1 < m_streams.size())
+                    p.set_trace(std::make_shared<TraceContext>(*packet.trace()));
+
+                int r = m_streams[i]->push(p);
+                if (r != AX_SUCCESS && ret == AX_SUCCESS)
+                    ret = r;
             }
             return ret;
         }
@@ -112,21 +207,49 @@ namespace ax
             return !m_streams.empty();
         }
 
-        void connect(InputPort& iport)
+        const std::vector<std::shared_ptr<Stream>>& streams() const
+        {
+            return m_streams;
+        }
+
+        void connect(InputPort& iport, int max_size = -1, StreamPolicy policy = STREAM_BLOCK)
         {
             if (iport.has_stream())
             {
                 return;
             }
 
-            auto new_s = std::make_shared<Stream>();
+            auto new_s = std::make_shared<Stream>(max_size, policy);
             iport.set_stream(new_s);
             add_stream(new_s);
         }
 
-        void connect(std::shared_ptr<InputPort> iport)
+        void connect(std::shared_ptr<InputPort> iport, int max_size = -1, StreamPolicy policy = STREAM_BLOCK)
+        {
+            return connect(*iport, max_size, policy);
+        }
+
+    private:
+        /// @brief continue the trace of the input being worked on, or start
+        ///     one when the node is a source
+        void StampTrace(Packet& packet)
         {
-            return connect(*iport);
+            TraceCursor& cursor = TraceCursor::Current();
+            if (cursor.trace && (!packet.trace() || packet.trace() == cursor.trace))
+            {
+                packet.set_trace(TraceCursor::Forward());
+                return;
+            }
+
+            if (!packet.trace())
+                Tracer::Begin(packet, TraceContext::now_ns(), m_traceSeq++);
+            // capture to send is spent in the source
+            TraceContext& trace = *packet.trace();
+            if (trace.num_spans == 0 && m_traceId)
+            {
+                trace.enter(m_traceId, trace.capture_ns);
+                trace.exit(m_traceId, TraceContext::now_ns());
+            }
         }
     };
 }
\ No newline at end of file
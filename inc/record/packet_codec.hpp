@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeindex>
+
+#include "packet.hpp"
+
+namespace ax
+{
+    /// @brief How one payload type is written to and read from a recording
+    struct PacketCodec
+    {
+        uint16_t id;                // stored in the file, never reuse one
+        std::string name;
+        /// @brief bytes write will produce
+        std::function<uint32_t(const Packet& packet)> size;
+        /// @brief serialise into dst, which has size(packet) bytes, 32 byte aligned
+        std::function<void(const Packet& packet, uint8_t* dst)> write;
+        /// @brief rebuild the payload from src, keep holds the recording mapped
+        ///     and may be aliased to hand out the bytes without a copy
+        std::function<Packet(const uint8_t* src, uint32_t size, const std::shared_ptr<void>& keep)> read;
+    };
+
+    /// @brief Payload types RecorderNode can record and ReplayNode can replay
+    class PacketCodecRegistry
+    {
+    public:
+        static PacketCodecRegistry& Instance()
+        {
+            static PacketCodecRegistry registry;
+            return registry;
+        }
+
+        /// @brief register T, registering the same type or id again replaces it
+        template <typename T>
+        void Register(const PacketCodec& codec)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            auto it = m_ids.find(codec.id);
+            if (it != m_ids.end())
+            {
+                m_byType.erase(it->second);
+                m_ids.erase(it);
+            }
+            m_byType[std::type_index(typeid(T))] = codec;
+            m_ids.insert(std::make_pair(codec.id, std::type_index(typeid(T))));
+        }
+
+        /// @brief codec of the packet's payload, nullptr if its type is not registered
+        const PacketCodec* Find(const Packet& packet) const
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            auto it = m_byType.find(std::type_index(packet.type()));
+            return it == m_byType.end() ? nullptr : &it->second;
+        }
+
+        const PacketCodec* Find(uint16_t id) const
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            auto it = m_ids.find(id);
+            return it == m_ids.end() ? nullptr : &m_byType.find(it->second)->second;
+        }
+
+    private:
+        PacketCodecRegistry() = default;
+
+        mutable std::mutex m_lock;
+        std::map<std::type_index, PacketCodec> m_byType;
+        std::map<uint16_t, std::type_index> m_ids;
+    };
+
+    /// @brief registers a payload type when the program loads
+    template <typename T>
+    struct PacketCodecRegistrar
+    {
+        PacketCodecRegistrar(const PacketCodec& codec)
+        {
+            PacketCodecRegistry::Instance().Register<T>(codec);
+        }
+    };
+}
+
+#define AX_PACKET_CODEC_CONCAT_(a, b)       a##b
+#define AX_PACKET_CODEC_CONCAT(a, b)        AX_PACKET_CODEC_CONCAT_(a, b)
+
+/// @brief AX_REGISTER_PACKET_CODEC(ax::AccessUnit, access_unit_codec())
+#define AX_REGISTER_PACKET_CODEC(type, ...) \
+    namespace { ax::PacketCodecRegistrar<type> AX_PACKET_CODEC_CONCAT(s_packetCodecRegistrar, __COUNTER__)(__VA_ARGS__); }
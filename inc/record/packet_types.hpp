@@ -0,0 +1,293 @@
+#pragma once
+
+#include <string.h>
+
+#include "record/packet_codec.hpp"
+#include "codec/bitstream_queue.hpp"
+#include "video_frame.hpp"
+#include "tensor.hpp"
+#include "detections.hpp"
+
+namespace ax
+{
+    namespace record
+    {
+        // 类型编号写入文件, 只能新增不能修改
+        enum PacketTypeId
+        {
+            TYPE_ACCESS_UNIT = 1,
+            TYPE_SYNTHETIC_FRAME = 2,       // 旧版 SyntheticFrame, 只读, 回放为 VideoFrame
+            TYPE_TENSOR = 3,
+            TYPE_DETECTIONS = 4,
+            TYPE_VIDEO_FRAME = 5,
+        };
+
+        struct AccessUnitHeader
+        {
+            uint64_t pts;
+            uint8_t key;
+            uint8_t reserved[7];
+        };
+
+        /// @brief pixel data stays 32 byte aligned behind it
+        struct FrameHeader
+        {
+            int32_t format;
+            int32_t width;
+            int32_t height;
+            int32_t stride[2];      // rows are written with these strides
+            uint32_t reserved;
+            uint64_t pts;
+        };
+
+        static_assert(sizeof(FrameHeader) == 32, "FrameHeader");
+
+        /// @brief header of TYPE_SYNTHETIC_FRAME records, size bytes of one block follow
+        struct SyntheticFrameHeader
+        {
+            int32_t format;         // 0 NV12, 1 BGR, same values as PixelFormat
+            int32_t width;
+            int32_t height;
+            int32_t stride;
+            uint32_t size;
+            uint8_t reserved[12];
+        };
+
+        static_assert(sizeof(SyntheticFrameHeader) == 32, "SyntheticFrameHeader");
+
+        /// @brief registry key of the read-only codec, no packet carries it
+        struct LegacySyntheticFrame { };
+
+        /// @brief tensor data stays 32 byte aligned behind it
+        struct TensorHeader
+        {
+            int32_t type;
+            int32_t layout;
+            int32_t batch;
+            int32_t channels;
+            int32_t height;
+            int32_t width;
+            float transform[4];     // scale_x, scale_y, offset_x, offset_y
+            uint64_t pts;
+            uint8_t reserved[16];
+        };
+
+        static_assert(sizeof(TensorHeader) == 64, "TensorHeader");
+
+        struct DetectionsHeader
+        {
+            uint64_t pts;
+            uint32_t count;         // Detection records behind the header
+            uint32_t reserved;
+        };
+
+        static_assert(sizeof(DetectionsHeader) == 16, "DetectionsHeader");
+
+        /// @brief bitstream is copied on replay, AccessUnit owns its bytes
+        inline PacketCodec access_unit_codec()
+        {
+            PacketCodec codec;
+            codec.id = TYPE_ACCESS_UNIT;
+            codec.name = "AccessUnit";
+            codec.size = [](const Packet& packet) {
+                return (uint32_t)(sizeof(AccessUnitHeader) + packet.get<AccessUnit>().data.size());
+            };
+            codec.write = [](const Packet& packet, uint8_t* dst) {
+                const AccessUnit& au = packet.get<AccessUnit>();
+                AccessUnitHeader header;
+                memset(&header, 0, sizeof(header));
+                header.pts = au.pts;
+                header.key = au.key;
+                memcpy(dst, &header, sizeof(header));
+                if (!au.data.empty())
+                    memcpy(dst + sizeof(header), au.data.data(), au.data.size());
+            };
+            codec.read = [](const uint8_t* src, uint32_t size, const std::shared_ptr<void>&) {
+                if (size < sizeof(AccessUnitHeader))
+                    return Packet();
+                const AccessUnitHeader* header = (const AccessUnitHeader*)src;
+                AccessUnit au;
+                au.pts = header->pts;
+                au.key = header->key != 0;
+                au.data.assign(src + sizeof(AccessUnitHeader), src + size);
+                return Packet(au);
+            };
+            return codec;
+        }
+
+        /// @brief pixels are replayed straight out of the mapping, planes one after the other
+        inline PacketCodec video_frame_codec()
+        {
+            PacketCodec codec;
+            codec.id = TYPE_VIDEO_FRAME;
+            codec.name = "VideoFrame";
+            codec.size = [](const Packet& packet) {
+                const VideoFrame& frame = packet.get<VideoFrame>();
+                size_t size = sizeof(FrameHeader);
+                for (int p = 0; p < frame.planes(); p++)
+                    size += (size_t)frame.row_bytes(p) * frame.plane_height(p);
+                return (uint32_t)size;
+            };
+            codec.write = [](const Packet& packet, uint8_t* dst) {
+                const VideoFrame& frame = packet.get<VideoFrame>();
+                FrameHeader header;
+                memset(&header, 0, sizeof(header));
+                header.format = frame.format;
+                header.width = frame.width;
+                header.height = frame.height;
+                // 按行紧凑写入, 裁剪出的帧最后一行之后不一定还有 stride 字节可读
+                header.stride[0] = frame.row_bytes(0);
+                header.stride[1] = frame.planes() > 1 ? frame.row_bytes(1) : 0;
+                header.pts = frame.pts;
+                memcpy(dst, &header, sizeof(header));
+                dst += sizeof(header);
+                if (frame.contiguous())
+                {
+                    memcpy(dst, frame.data[0], VideoFrame::BufferSize(frame.format, frame.height, frame.stride[0]));
+                    return;
+                }
+                for (int p = 0; p < frame.planes(); p++)
+                {
+                    int bytes = frame.row_bytes(p);
+                    for (int r = 0; r < frame.plane_height(p); r++)
+                    {
+                        memcpy(dst, frame.data[p] + (size_t)r * frame.stride[p], bytes);
+                        dst += bytes;
+                    }
+                }
+            };
+            codec.read = [](const uint8_t* src, uint32_t size, const std::shared_ptr<void>& keep) {
+                const FrameHeader* header = (const FrameHeader*)src;
+                if (size < sizeof(FrameHeader) || header->width <= 0 || header->height <= 0)
+                    return Packet();
+                VideoFrame frame;
+                frame.format = header->format;
+                frame.width = header->width;
+                frame.height = header->height;
+                frame.pts = header->pts;
+                size_t offset = sizeof(FrameHeader);
+                for (int p = 0; p < frame.planes(); p++)
+                {
+                    frame.data[p] = (uint8_t*)src + offset;
+                    frame.stride[p] = header->stride[p];
+                    offset += (size_t)header->stride[p] * frame.plane_height(p);
+                }
+                if (offset > size)
+                    return Packet();
+                // 与映射共享引用计数, 最后一帧释放后才解除映射
+                frame.buffer = keep;
+                return Packet(frame);
+            };
+            return codec;
+        }
+
+        /// @brief replays recordings made before VideoFrame as VideoFrame, never written
+        inline PacketCodec synthetic_frame_codec()
+        {
+            PacketCodec codec;
+            codec.id = TYPE_SYNTHETIC_FRAME;
+            codec.name = "SyntheticFrame";
+            codec.size = [](const Packet&) { return (uint32_t)0; };
+            codec.write = [](const Packet&, uint8_t*) { };
+            codec.read = [](const uint8_t* src, uint32_t size, const std::shared_ptr<void>& keep) {
+                const SyntheticFrameHeader* header = (const SyntheticFrameHeader*)src;
+                if (size < sizeof(SyntheticFrameHeader) || header->width <= 0 || header->height <= 0 ||
+                    (header->format != PIXEL_FORMAT_NV12 && header->format != PIXEL_FORMAT_BGR) ||
+                    VideoFrame::BufferSize(header->format, header->height, header->stride) > header->size ||
+                    sizeof(SyntheticFrameHeader) + (uint64_t)header->size > size)
+                    return Packet();
+                VideoFrame frame = VideoFrame::Wrap(header->format, header->width, header->height,
+                    (uint8_t*)src + sizeof(SyntheticFrameHeader), header->stride, keep);
+                return Packet(frame);
+            };
+            return codec;
+        }
+
+        /// @brief tensors are replayed straight out of the mapping, like frames
+        inline PacketCodec tensor_codec()
+        {
+            PacketCodec codec;
+            codec.id = TYPE_TENSOR;
+            codec.name = "Tensor";
+            codec.size = [](const Packet& packet) {
+                return (uint32_t)(sizeof(TensorHeader) + packet.get<Tensor>().bytes());
+            };
+            codec.write = [](const Packet& packet, uint8_t* dst) {
+                const Tensor& tensor = packet.get<Tensor>();
+                TensorHeader header;
+                memset(&header, 0, sizeof(header));
+                header.type = tensor.type;
+                header.layout = tensor.layout;
+                header.batch = tensor.batch;
+                header.channels = tensor.channels;
+                header.height = tensor.height;
+                header.width = tensor.width;
+                header.transform[0] = tensor.transform.scale_x;
+                header.transform[1] = tensor.transform.scale_y;
+                header.transform[2] = tensor.transform.offset_x;
+                header.transform[3] = tensor.transform.offset_y;
+                header.pts = tensor.pts;
+                memcpy(dst, &header, sizeof(header));
+                if (tensor.data)
+                    memcpy(dst + sizeof(header), tensor.data, tensor.bytes());
+            };
+            codec.read = [](const uint8_t* src, uint32_t size, const std::shared_ptr<void>& keep) {
+                if (size < sizeof(TensorHeader))
+                    return Packet();
+                const TensorHeader* header = (const TensorHeader*)src;
+                Tensor tensor = Tensor::Wrap(header->type, header->layout, header->batch, header->channels,
+                    header->height, header->width, (uint8_t*)src + sizeof(TensorHeader), keep);
+                if (!tensor.valid() || sizeof(TensorHeader) + tensor.bytes() > size)
+                    return Packet();
+                tensor.transform.scale_x = header->transform[0];
+                tensor.transform.scale_y = header->transform[1];
+                tensor.transform.offset_x = header->transform[2];
+                tensor.transform.offset_y = header->transform[3];
+                tensor.pts = header->pts;
+                return Packet(tensor);
+            };
+            return codec;
+        }
+
+        /// @brief boxes are copied on replay, Detections owns its vector
+        inline PacketCodec detections_codec()
+        {
+            PacketCodec codec;
+            codec.id = TYPE_DETECTIONS;
+            codec.name = "Detections";
+            codec.size = [](const Packet& packet) {
+                return (uint32_t)(sizeof(DetectionsHeader) + packet.get<Detections>().size() * sizeof(Detection));
+            };
+            codec.write = [](const Packet& packet, uint8_t* dst) {
+                const Detections& dets = packet.get<Detections>();
+                DetectionsHeader header;
+                memset(&header, 0, sizeof(header));
+                header.pts = dets.pts;
+                header.count = dets.size();
+                memcpy(dst, &header, sizeof(header));
+                if (!dets.empty())
+                    memcpy(dst + sizeof(header), dets.boxes.data(), dets.size() * sizeof(Detection));
+            };
+            codec.read = [](const uint8_t* src, uint32_t size, const std::shared_ptr<void>&) {
+                if (size < sizeof(DetectionsHeader))
+                    return Packet();
+                const DetectionsHeader* header = (const DetectionsHeader*)src;
+                if (sizeof(DetectionsHeader) + (uint64_t)header->count * sizeof(Detection) > size)
+                    return Packet();
+                Detections dets;
+                dets.pts = header->pts;
+                dets.boxes.resize(header->count);
+                if (header->count)
+                    memcpy(dets.boxes.data(), src + sizeof(DetectionsHeader), header->count * sizeof(Detection));
+                return Packet(dets);
+            };
+            return codec;
+        }
+    }
+}
+
+AX_REGISTER_PACKET_CODEC(ax::AccessUnit, ax::record::access_unit_codec())
+AX_REGISTER_PACKET_CODEC(ax::VideoFrame, ax::record::video_frame_codec())
+AX_REGISTER_PACKET_CODEC(ax::record::LegacySyntheticFrame, ax::record::synthetic_frame_codec())
+AX_REGISTER_PACKET_CODEC(ax::Tensor, ax::record::tensor_codec())
+AX_REGISTER_PACKET_CODEC(ax::Detections, ax::record::detections_codec())
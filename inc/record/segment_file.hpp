@@ -0,0 +1,440 @@
+#pragma once
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "err.hpp"
+
+namespace ax
+{
+    /// @details Layout of a segment, all integers little endian:
+    ///     FileHeader                          64 bytes
+    ///     RecordHeader + payload, ...         each record 64 byte aligned,
+    ///                                         payload at +32, so 32 byte aligned
+    ///     IndexEntry[count]                   one per index interval
+    ///     FileFooter                          16 bytes, last in the file
+    ///     A segment that was not closed has no index and no footer. The reader
+    ///     then scans the records and stops at the first torn one, so a crash
+    ///     loses at most the record being written.
+    namespace record
+    {
+        static const char FILE_MAGIC[8] = {'A', 'X', 'R', 'E', 'C', '0', '0', '1'};
+        static const uint32_t RECORD_MAGIC = 0x52525841;    // "AXRR"
+        static const uint32_t FOOTER_MAGIC = 0x46525841;    // "AXRF"
+        static const uint32_t RECORD_ALIGN = 64;
+
+        struct FileHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t header_size;
+            uint64_t created_ns;        // wall clock, for file listings only
+            uint8_t reserved[40];
+        };
+
+        struct RecordHeader
+        {
+            uint32_t magic;
+            uint16_t type;              // PacketCodec::id
+            uint16_t flags;
+            uint32_t size;              // payload bytes
+            uint32_t reserved;
+            uint64_t timestamp_ns;
+            uint64_t seq;
+        };
+
+        struct IndexEntry
+        {
+            uint64_t timestamp_ns;
+            uint64_t offset;
+        };
+
+        struct FileFooter
+        {
+            uint64_t index_offset;
+            uint32_t index_count;
+            uint32_t magic;
+        };
+
+        static_assert(sizeof(FileHeader) == 64, "FileHeader");
+        static_assert(sizeof(RecordHeader) == 32, "RecordHeader");
+        static_assert(sizeof(FileFooter) == 16, "FileFooter");
+
+        inline uint64_t record_span(uint32_t payload)
+        {
+            return (sizeof(RecordHeader) + (uint64_t)payload + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN;
+        }
+
+        /// @brief n-th segment of a recording, "cam0.axrec", "cam0.1.axrec", "cam0.2.axrec"...
+        inline std::string segment_path(const std::string& path, int n)
+        {
+            if (n == 0)
+                return path;
+            size_t slash = path.rfind('/');
+            size_t dot = path.rfind('.');
+            if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+                return path + "." + std::to_string(n);
+            return path.substr(0, dot) + "." + std::to_string(n) + path.substr(dot);
+        }
+    }
+
+    /// @brief Appends records to a memory mapped segment file.
+    /// @details The file grows by "grow" bytes at a time and the mapping with
+    ///     it, records are written in place, nothing is copied through a
+    ///     write buffer. Close writes the timestamp index and trims the file.
+    ///     Not thread safe.
+    class SegmentWriter
+    {
+    public:
+        SegmentWriter():
+            m_fd(-1),
+            m_data(nullptr),
+            m_capacity(0),
+            m_size(0),
+            m_grow(0),
+            m_interval(0),
+            m_count(0)
+        { }
+
+        ~SegmentWriter() { Close(); }
+
+        SegmentWriter(const SegmentWriter&) = delete;
+        SegmentWriter& operator=(const SegmentWriter&) = delete;
+
+        /// @param grow bytes the file is extended by when full
+        /// @param index_interval_ns minimum time between two index entries
+        int Open(const std::string& path, uint64_t grow = 64 << 20, uint64_t index_interval_ns = 100000000)
+        {
+            Close();
+
+            m_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (m_fd < 0)
+            {
+                printf("create %s failed!\n", path.c_str());
+                return AX_ERR_INIT_FAIL;
+            }
+            m_path = path;
+            m_grow = std::max<uint64_t>(grow, 1 << 20) / record::RECORD_ALIGN * record::RECORD_ALIGN;
+            m_interval = index_interval_ns;
+            if (!Reserve(sizeof(record::FileHeader)))
+            {
+                Close();
+                return AX_ERR_INIT_FAIL;
+            }
+
+            record::FileHeader* header = (record::FileHeader*)m_data;
+            memcpy(header->magic, record::FILE_MAGIC, sizeof(header->magic));
+            header->version = 1;
+            header->header_size = sizeof(record::FileHeader);
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            header->created_ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+            m_size = sizeof(record::FileHeader);
+            return AX_SUCCESS;
+        }
+
+        bool IsOpen() const { return m_fd >= 0; }
+
+        /// @brief reserve a record and let the caller fill its payload in place
+        /// @return where size payload bytes go, nullptr when the disk is full
+        uint8_t* Append(uint16_t type, uint64_t timestamp_ns, uint64_t seq, uint32_t size)
+        {
+            uint64_t span = record::record_span(size);
+            if (!IsOpen() || !Reserve(m_size + span))
+                return nullptr;
+
+            if (m_index.empty() || timestamp_ns >= m_index.back().timestamp_ns + m_interval)
+                m_index.push_back({timestamp_ns, m_size});
+
+            uint8_t* rec = m_data + m_size;
+            record::RecordHeader* header = (record::RecordHeader*)rec;
+            header->type = type;
+            header->flags = 0;
+            header->size = size;
+            header->reserved = 0;
+            header->timestamp_ns = timestamp_ns;
+            header->seq = seq;
+            // 魔数最后写, 崩溃时扫描以它判断记录是否完整
+            header->magic = 0;
+            m_size += span;
+            m_count++;
+            return rec + sizeof(record::RecordHeader);
+        }
+
+        /// @brief mark the record returned by the last Append complete
+        void Commit(uint8_t* payload)
+        {
+            record::RecordHeader* header = (record::RecordHeader*)(payload - sizeof(record::RecordHeader));
+            __atomic_store_n(&header->magic, record::RECORD_MAGIC, __ATOMIC_RELEASE);
+        }
+
+        /// @brief bytes written so far, header and records
+        uint64_t Size() const { return m_size; }
+
+        uint64_t Count() const { return m_count; }
+
+        const std::string& Path() const { return m_path; }
+
+        /// @brief write index and footer, trim the file to its content
+        void Close()
+        {
+            if (m_fd < 0)
+                return;
+
+            uint64_t index_bytes = m_index.size() * sizeof(record::IndexEntry);
+            if (m_data && Reserve(m_size + index_bytes + sizeof(record::FileFooter)))
+            {
+                record::FileFooter footer;
+                footer.index_offset = m_size;
+                footer.index_count = m_index.size();
+                footer.magic = record::FOOTER_MAGIC;
+                if (index_bytes)
+                    memcpy(m_data + m_size, m_index.data(), index_bytes);
+                m_size += index_bytes;
+                memcpy(m_data + m_size, &footer, sizeof(footer));
+                m_size += sizeof(footer);
+            }
+            if (m_data)
+                munmap(m_data, m_capacity);
+            if (ftruncate(m_fd, m_size) != 0)
+                printf("trim %s failed!\n", m_path.c_str());
+            close(m_fd);
+
+            m_fd = -1;
+            m_data = nullptr;
+            m_capacity = 0;
+            m_size = 0;
+            m_count = 0;
+            m_index.clear();
+        }
+
+    private:
+        bool Reserve(uint64_t size)
+        {
+            if (size <= m_capacity)
+                return true;
+
+            uint64_t capacity = (size + m_grow - 1) / m_grow * m_grow;
+            // 先分配磁盘空间, 避免写映射时SIGBUS; 仅文件系统不支持时退回稀疏文件, 空间不足等直接失败
+            int err = posix_fallocate(m_fd, 0, capacity);
+            if (err == EOPNOTSUPP || err == EINVAL)
+                err = ftruncate(m_fd, capacity) == 0 ? 0 : errno;
+            if (err != 0)
+            {
+                printf("grow %s to %llu bytes failed! %s\n", m_path.c_str(), (unsigned long long)capacity, strerror(err));
+                return false;
+            }
+
+            void* data = m_data
+                ? mremap(m_data, m_capacity, capacity, MREMAP_MAYMOVE)
+                : mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+            if (data == MAP_FAILED)
+            {
+                printf("map %s failed!\n", m_path.c_str());
+                return false;
+            }
+            m_data = (uint8_t*)data;
+            m_capacity = capacity;
+            return true;
+        }
+
+    private:
+        int m_fd;
+        std::string m_path;
+        uint8_t* m_data;
+        uint64_t m_capacity;
+        uint64_t m_size;
+        uint64_t m_grow;
+        uint64_t m_interval;
+        uint64_t m_count;
+        std::vector<record::IndexEntry> m_index;
+    };
+
+    /// @brief Reads a segment file through a private mapping.
+    /// @details Payload pointers stay valid as long as Mapping() is held,
+    ///     even after the reader is closed, so payloads can be handed
+    ///     downstream without a copy. The mapping is copy on write, a
+    ///     consumer writing into a payload does not change the file.
+    class SegmentReader
+    {
+    public:
+        struct Record
+        {
+            uint16_t type;
+            uint64_t timestamp_ns;
+            uint64_t seq;
+            const uint8_t* data;
+            uint32_t size;
+        };
+
+        SegmentReader():
+            m_data(nullptr),
+            m_size(0),
+            m_end(0),
+            m_offset(0)
+        { }
+
+        int Open(const std::string& path)
+        {
+            Close();
+
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                printf("open %s failed!\n", path.c_str());
+                return AX_ERR_INIT_FAIL;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(record::FileHeader))
+            {
+                printf("%s is not a recording!\n", path.c_str());
+                close(fd);
+                return AX_ERR_INIT_FAIL;
+            }
+
+            void* data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (data == MAP_FAILED)
+            {
+                printf("mmap %s failed!\n", path.c_str());
+                return AX_ERR_INIT_FAIL;
+            }
+            size_t size = st.st_size;
+            m_mapping = std::shared_ptr<void>(data, [size](void* p) { munmap(p, size); });
+            m_data = (const uint8_t*)data;
+            m_size = size;
+
+            const record::FileHeader* header = (const record::FileHeader*)m_data;
+            if (memcmp(header->magic, record::FILE_MAGIC, sizeof(header->magic)) != 0 || header->version != 1)
+            {
+                printf("%s is not a recording!\n", path.c_str());
+                Close();
+                return AX_ERR_INIT_FAIL;
+            }
+            madvise(data, size, MADV_SEQUENTIAL);
+
+            if (!LoadIndex())
+            {
+                printf("%s was not closed, recovering\n", path.c_str());
+                Scan();
+            }
+            m_path = path;
+            m_offset = sizeof(record::FileHeader);
+            return AX_SUCCESS;
+        }
+
+        void Close()
+        {
+            m_mapping.reset();
+            m_data = nullptr;
+            m_size = 0;
+            m_end = 0;
+            m_offset = 0;
+            m_index.clear();
+            m_path.clear();
+        }
+
+        bool IsOpen() const { return m_data != nullptr; }
+
+        const std::string& Path() const { return m_path; }
+
+        /// @brief keeps the file mapped, alias it for zero copy payloads
+        const std::shared_ptr<void>& Mapping() const { return m_mapping; }
+
+        /// @brief read the record at the cursor and advance
+        /// @return false at the end of the segment
+        bool Next(Record& rec)
+        {
+            if (!Peek(m_offset, rec))
+                return false;
+            m_offset += record::record_span(rec.size);
+            return true;
+        }
+
+        /// @brief move the cursor to the first record at or after timestamp_ns
+        void Seek(uint64_t timestamp_ns)
+        {
+            // 稀疏索引定位, 再顺序扫描到精确位置
+            auto it = std::upper_bound(m_index.begin(), m_index.end(), timestamp_ns,
+                [](uint64_t ts, const record::IndexEntry& e) { return ts < e.timestamp_ns; });
+            m_offset = it == m_index.begin() ? sizeof(record::FileHeader) : (it - 1)->offset;
+
+            Record rec;
+            while (Peek(m_offset, rec) && rec.timestamp_ns < timestamp_ns)
+                m_offset += record::record_span(rec.size);
+        }
+
+        void Rewind() { m_offset = sizeof(record::FileHeader); }
+
+        /// @brief timestamp of the first record, 0 when empty
+        uint64_t FirstTimestamp() const { return m_index.empty() ? 0 : m_index.front().timestamp_ns; }
+
+    private:
+        bool Peek(uint64_t offset, Record& rec) const
+        {
+            if (offset + sizeof(record::RecordHeader) > m_end)
+                return false;
+            const record::RecordHeader* header = (const record::RecordHeader*)(m_data + offset);
+            if (header->magic != record::RECORD_MAGIC || offset + record::record_span(header->size) > m_end)
+                return false;
+            rec.type = header->type;
+            rec.timestamp_ns = header->timestamp_ns;
+            rec.seq = header->seq;
+            rec.data = m_data + offset + sizeof(record::RecordHeader);
+            rec.size = header->size;
+            return true;
+        }
+
+        bool LoadIndex()
+        {
+            if (m_size < sizeof(record::FileHeader) + sizeof(record::FileFooter))
+                return false;
+            const record::FileFooter* footer = (const record::FileFooter*)(m_data + m_size - sizeof(record::FileFooter));
+            if (footer->magic != record::FOOTER_MAGIC ||
+                footer->index_offset < sizeof(record::FileHeader) ||
+                footer->index_offset + (uint64_t)footer->index_count * sizeof(record::IndexEntry) + sizeof(record::FileFooter) != m_size)
+                return false;
+
+            const record::IndexEntry* entries = (const record::IndexEntry*)(m_data + footer->index_offset);
+            m_index.assign(entries, entries + footer->index_count);
+            m_end = footer->index_offset;
+            return true;
+        }
+
+        /// @brief rebuild the index of a segment cut short, one entry per record
+        void Scan()
+        {
+            m_end = m_size;
+            m_index.clear();
+            uint64_t offset = sizeof(record::FileHeader);
+            Record rec;
+            while (Peek(offset, rec))
+            {
+                m_index.push_back({rec.timestamp_ns, offset});
+                offset += record::record_span(rec.size);
+            }
+            m_end = offset;
+        }
+
+    private:
+        std::string m_path;
+        std::shared_ptr<void> m_mapping;
+        const uint8_t* m_data;
+        uint64_t m_size;
+        uint64_t m_end;             // first byte after the last record
+        uint64_t m_offset;
+        std::vector<record::IndexEntry> m_index;
+    };
+}
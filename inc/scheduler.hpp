@@ -0,0 +1,350 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include "err.hpp"
+#include "node.hpp"
+#include "thread_utils.hpp"
+
+namespace ax
+{
+    /// @brief Dispatches schedulable nodes onto a fixed pool of workers
+    /// @details A node is queued when a packet is pushed into one of its
+    ///     input streams, and runs Process once every input port has a
+    ///     packet. At most Parallelism() calls of one node run at once,
+    ///     pushes arriving above that limit are picked up when a call ends.
+    ///     Each worker owns a deque: nodes woken from a worker go to its own
+    ///     deque and run LIFO while hot, idle workers steal FIFO from others.
+    ///     Workers never block on a full output stream: a node whose outputs
+    ///     are full is not dispatched until its consumer makes room.
+    class Scheduler
+    {
+        struct NodeState
+        {
+            std::shared_ptr<Node> node;
+            std::mutex lock;
+            int queued;
+            int running;
+            bool pending;
+            bool removed;
+        };
+
+        struct WorkerQueue
+        {
+            std::mutex lock;
+            std::deque<NodeState*> tasks;
+        };
+
+    public:
+        Scheduler(int num_workers = 0):
+            m_numWorkers(num_workers > 0 ? num_workers : std::max(1u, std::thread::hardware_concurrency())),
+            m_isRunning(false),
+            m_numTasks(0),
+            m_nextQueue(0)
+        {
+            for (int i = 0; i < m_numWorkers; i++)
+                m_queues.emplace_back(new WorkerQueue);
+        }
+
+        ~Scheduler()
+        {
+            Stop();
+        }
+
+        int NumWorkers() const { return m_numWorkers; }
+
+        /// @brief cpu set and priority of the workers, call before Start
+        void SetWorkerPolicy(const utils::ThreadPolicy& policy) { m_workerPolicy = policy; }
+
+        /// @brief hook the node's input streams, call before Start and after the node is connected
+        int Add(const std::shared_ptr<Node>& node)
+        {
+            if (!node || !node->Schedulable())
+                return AX_ERR_ILLEGAL_PARAM;
+
+            std::shared_ptr<NodeState> state = std::make_shared<NodeState>();
+            state->node = node;
+            state->queued = 0;
+            state->running = 0;
+            state->pending = false;
+            state->removed = false;
+
+            for (int i = 0; i < node->GetInputPortNum(); i++)
+            {
+                auto stream = node->GetInputPort(i)->stream();
+                if (!stream)
+                {
+                    printf("[%s]: input port %s is not connected\n", node->name(), node->GetInputPort(i)->name().c_str());
+                    return AX_ERR_NULL_PTR;
+                }
+                NodeState* s = state.get();
+                stream->set_listener([this, s]() { Notify(s); });
+            }
+            for (int i = 0; i < node->GetOutputPortNum(); i++)
+            {
+                NodeState* s = state.get();
+                for (const auto& stream : node->GetOutputPort(i)->streams())
+                    stream->set_space_listener([this, s]() { Notify(s); });
+            }
+
+            std::lock_guard<std::mutex> lg(m_statesLock);
+            m_states.push_back(state);
+
+            // added while running, e.g. a restarted node
+            if (m_isRunning && node->InputsReady())
+                Notify(state.get());
+            return AX_SUCCESS;
+        }
+
+        /// @brief stop dispatching a node and wait for its calls in progress
+        /// @details the state is kept until Stop, a push racing with this may still reach it
+        void Remove(const std::shared_ptr<Node>& node)
+        {
+            NodeState* state = nullptr;
+            {
+                std::lock_guard<std::mutex> lg(m_statesLock);
+                for (auto& s : m_states)
+                {
+                    if (s->node == node && !s->removed)
+                        state = s.get();
+                }
+            }
+            if (!state)
+                return;
+
+            ClearListeners(node);
+
+            {
+                std::lock_guard<std::mutex> lg(state->lock);
+                state->removed = true;
+                state->pending = false;
+            }
+
+            // queued entries are dropped by the worker popping them
+            while (true)
+            {
+                {
+                    std::lock_guard<std::mutex> lg(state->lock);
+                    if (state->running == 0 && (state->queued == 0 || !m_isRunning))
+                        break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        int Start()
+        {
+            if (m_isRunning)
+                return AX_SUCCESS;
+
+            m_isRunning = true;
+            for (int i = 0; i < m_numWorkers; i++)
+                m_workers.emplace_back(&Scheduler::WorkerLoop, this, i);
+
+            // packets pushed before Start
+            std::lock_guard<std::mutex> lg(m_statesLock);
+            for (auto& state : m_states)
+            {
+                if (state->node->InputsReady())
+                    Notify(state.get());
+            }
+            return AX_SUCCESS;
+        }
+
+        /// @brief join the workers, calls in progress finish first
+        /// @details also unhooks nodes added to a scheduler never started
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lg(m_idleLock);
+                m_isRunning = false;
+            }
+            m_idleCond.notify_all();
+
+            for (auto& t : m_workers)
+            {
+                if (t.joinable())
+                    t.join();
+            }
+            m_workers.clear();
+            for (auto& q : m_queues)
+                q->tasks.clear();
+            m_numTasks = 0;
+
+            std::lock_guard<std::mutex> lg(m_statesLock);
+            for (auto& state : m_states)
+                ClearListeners(state->node);
+            m_states.clear();
+        }
+
+    private:
+        /// @brief index of the calling worker of this scheduler, -1 for other threads
+        int CurrentWorker()
+        {
+            return WorkerOwner() == this ? WorkerIndex() : -1;
+        }
+
+        static Scheduler*& WorkerOwner()
+        {
+            static thread_local Scheduler* owner = nullptr;
+            return owner;
+        }
+
+        static int& WorkerIndex()
+        {
+            static thread_local int index = -1;
+            return index;
+        }
+
+        static void ClearListeners(const std::shared_ptr<Node>& node)
+        {
+            for (int i = 0; i < node->GetInputPortNum(); i++)
+                node->GetInputPort(i)->stream()->set_listener(nullptr);
+            for (int i = 0; i < node->GetOutputPortNum(); i++)
+            {
+                for (const auto& stream : node->GetOutputPort(i)->streams())
+                    stream->set_space_listener(nullptr);
+            }
+        }
+
+        void Notify(NodeState* state)
+        {
+            {
+                std::lock_guard<std::mutex> lg(state->lock);
+                if (!m_isRunning || state->removed)
+                    return;
+                if (state->queued + state->running >= state->node->Parallelism())
+                {
+                    state->pending = true;
+                    return;
+                }
+                state->queued++;
+            }
+            Enqueue(state);
+        }
+
+        void Enqueue(NodeState* state)
+        {
+            int idx = CurrentWorker();
+            if (idx < 0)
+                idx = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_numWorkers;
+
+            {
+                std::lock_guard<std::mutex> lg(m_queues[idx]->lock);
+                m_queues[idx]->tasks.push_back(state);
+            }
+            m_numTasks.fetch_add(1);
+
+            std::lock_guard<std::mutex> lg(m_idleLock);
+            m_idleCond.notify_one();
+        }
+
+        NodeState* PopTask(int idx)
+        {
+            {
+                WorkerQueue& own = *m_queues[idx];
+                std::lock_guard<std::mutex> lg(own.lock);
+                if (!own.tasks.empty())
+                {
+                    NodeState* state = own.tasks.back();
+                    own.tasks.pop_back();
+                    return state;
+                }
+            }
+
+            for (int i = 1; i < m_numWorkers; i++)
+            {
+                WorkerQueue& victim = *m_queues[(idx + i) % m_numWorkers];
+                std::lock_guard<std::mutex> lg(victim.lock);
+                if (!victim.tasks.empty())
+                {
+                    NodeState* state = victim.tasks.front();
+                    victim.tasks.pop_front();
+                    return state;
+                }
+            }
+            return nullptr;
+        }
+
+        void Execute(NodeState* state)
+        {
+            {
+                std::lock_guard<std::mutex> lg(state->lock);
+                state->queued--;
+                if (state->removed)
+                    return;
+                state->running++;
+                state->pending = false;
+            }
+
+            // drain while inputs keep arriving, saves a round trip through the queues,
+            // a full output resumes the node through its space listener
+            std::vector<Packet> inputs;
+            uint64_t seq;
+            while (!state->node->OutputsFull() && state->node->TakeInputs(inputs, seq))
+            {
+                state->node->Dispatch(inputs, seq);
+                inputs.clear();
+            }
+
+            bool requeue = false;
+            {
+                std::lock_guard<std::mutex> lg(state->lock);
+                state->running--;
+                if (state->pending && m_isRunning && !state->removed && state->queued + state->running < state->node->Parallelism())
+                {
+                    state->pending = false;
+                    state->queued++;
+                    requeue = true;
+                }
+            }
+            if (requeue)
+                Enqueue(state);
+        }
+
+        void WorkerLoop(int idx)
+        {
+            WorkerOwner() = this;
+            WorkerIndex() = idx;
+            current_thread_never_blocks() = true;
+
+            std::string name = "ax_worker" + std::to_string(idx);
+            utils::set_thread_name(name);
+            utils::apply_thread_policy(m_workerPolicy, name.c_str());
+
+            while (m_isRunning)
+            {
+                NodeState* state = PopTask(idx);
+                if (state)
+                {
+                    m_numTasks.fetch_sub(1);
+                    Execute(state);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lk(m_idleLock);
+                m_idleCond.wait(lk, [this]() { return !m_isRunning || m_numTasks.load() > 0; });
+            }
+
+            WorkerOwner() = nullptr;
+        }
+
+    private:
+        int m_numWorkers;
+        utils::ThreadPolicy m_workerPolicy;
+        std::atomic<bool> m_isRunning;
+        std::atomic<int> m_numTasks;
+        std::atomic<unsigned int> m_nextQueue;
+        std::mutex m_idleLock;
+        std::condition_variable m_idleCond;
+        std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+        std::vector<std::thread> m_workers;
+        std::mutex m_statesLock;    // nodes are added by prepare threads too
+        std::vector<std::shared_ptr<NodeState>> m_states;
+    };
+}
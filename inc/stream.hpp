@@ -2,20 +2,46 @@
 
 #include <queue>
 #include <memory>
+#include <functional>
 #include <mutex>
 #include <thread>
+#include <chrono>
+#include <condition_variable>
 
 #include "err.hpp"
 #include "packet.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 
 namespace ax
 {
+    /// @brief what a push does when a fixed length stream is full
+    enum StreamPolicy
+    {
+        STREAM_BLOCK = 0,       // wait for room
+        STREAM_DROP_OLDEST,     // drop the packet at the front, keeps latency low
+        STREAM_DROP_NEWEST      // drop the packet being pushed
+    };
+
+    /// @brief set on scheduler workers: a push to a full STREAM_BLOCK stream
+    ///     then goes over the capacity instead of blocking the worker, the
+    ///     scheduler holds back producers whose outputs are full instead
+    inline bool& current_thread_never_blocks()
+    {
+        static thread_local bool never_blocks = false;
+        return never_blocks;
+    }
+
     /// @brief Fixed or non-fixed length queue between ports
     class Stream
     {
     public:
-        Stream(int max_size = -1):
-            m_maxSize(max_size)
+        Stream(int max_size = -1, StreamPolicy policy = STREAM_BLOCK):
+            m_maxSize(max_size),
+            m_policy(policy),
+            m_closed(false),
+            m_traceId(0),
+            m_metrics(std::make_shared<StreamMetrics>())
         {
 
         }
@@ -24,82 +50,233 @@ namespace ax
 
         int max_size() const { return m_maxSize; }
 
-        int size() const { return m_queue.size(); }
+        StreamPolicy policy() const { return m_policy; }
+
+        /// @brief packets dropped by the policy
+        uint64_t dropped() const { return m_metrics->dropped.value(); }
+
+        /// @brief Tracer id stamped on traced packets while they are queued, 0 for none
+        void set_trace_id(uint16_t id) { m_traceId = id; }
+
+        /// @brief counters, depth and wait time, readable at any time
+        const std::shared_ptr<StreamMetrics>& metrics() const { return m_metrics; }
+
+        int size() const
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            return m_queue.size();
+        }
+
+        bool empty() const
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            return m_queue.empty();
+        }
 
-        bool empty() const { return m_queue.empty(); }
+        /// @brief a blocking push would wait for room
+        bool full() const
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            return m_policy == STREAM_BLOCK && m_maxSize >= 0 && m_queue.size() >= (size_t)m_maxSize;
+        }
+
+        /// @brief called after every successful push, outside the stream lock
+        /// @details set before packets flow, used by the scheduler to wake the consumer
+        void set_listener(const std::function<void()>& listener)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_listener = listener;
+        }
+
+        /// @brief called when a pop makes room in a full fixed length stream, outside the stream lock
+        /// @details used by the scheduler to resume the producer
+        void set_space_listener(const std::function<void()>& listener)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_spaceListener = listener;
+        }
 
         /// @brief push packet to stream, allow timeout
         /// @param packet
-        /// @param timeout -1 for blocking push, otherwise wait for timeout milliseconds
+        /// @param timeout -1 for blocking push, otherwise wait for timeout milliseconds,
+        ///     only used by STREAM_BLOCK
+        /// @return AX_ERR_CLOSED once the stream is closed, also wakes a blocked push,
+        ///     AX_ERR_QUEUE_FULL when the packet was dropped
         int push(const Packet& packet, int timeout = -1)
         {
-            std::lock_guard<std::mutex> lg(m_lock);
-            // printf("push to 0x%x\n", this);
-            if (m_maxSize < 0)
+            std::function<void()> listener;
             {
-                m_queue.push(packet);
-                return AX_SUCCESS;
-            }
-            else
-            {
-                if (m_queue.size() >= m_maxSize)
+                std::unique_lock<std::mutex> lk(m_lock);
+                if (m_closed)
+                    return AX_ERR_CLOSED;
+
+                bool full = m_maxSize >= 0 && m_queue.size() >= (size_t)m_maxSize;
+                if (full && m_policy == STREAM_DROP_NEWEST)
                 {
-                    if (timeout > 0)
+                    m_metrics->dropped.add();
+                    return AX_ERR_QUEUE_FULL;
+                }
+                if (full && m_policy == STREAM_DROP_OLDEST)
+                {
+                    while (!m_queue.empty() && m_queue.size() >= (size_t)m_maxSize)
                     {
-                        // non-block
-                        int nMillisecs = 0;
-                        while (m_queue.size() >= m_maxSize && nMillisecs < timeout)
-                        {
-                            nMillisecs++;
-                            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                        }
-                        if (m_queue.size() >= m_maxSize)
-                            return AX_ERR_QUEUE_FULL;
-                        else
-                        {
-                            m_queue.push(packet);
-                            return AX_SUCCESS;
-                        }
+                        m_queue.pop();
+                        m_metrics->dropped.add();
                     }
-                    else
+                    if (m_maxSize == 0)
                     {
-                        // blocking wait
-                        while (m_queue.size() >= m_maxSize)
-                        {
-                            std::this_thread::sleep_for(std::chrono::microseconds(100));
-                        }
-                        m_queue.push(packet);
-                        return AX_SUCCESS;
+                        m_metrics->dropped.add();
+                        return AX_ERR_QUEUE_FULL;
                     }
                 }
-                else
+                else if (full && !current_thread_never_blocks())
                 {
-                    m_queue.push(packet);
-                    return AX_SUCCESS;
+                    auto has_room = [this]() { return m_closed || m_queue.size() < (size_t)m_maxSize; };
+                    auto start = std::chrono::steady_clock::now();
+                    bool ok = true;
+                    if (timeout > 0)
+                        ok = m_notFull.wait_for(lk, std::chrono::milliseconds(timeout), has_room);
+                    else
+                        m_notFull.wait(lk, has_room);
+                    m_metrics->push_wait_us.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+                    if (!ok)
+                        return AX_ERR_QUEUE_FULL;
                 }
+                if (m_closed)
+                    return AX_ERR_CLOSED;
+
+                if (m_traceId && packet.trace())
+                    packet.trace()->enter(m_traceId, TraceContext::now_ns());
+                m_queue.push(packet);
+                m_metrics->pushed.add();
+                m_metrics->depth.set(m_queue.size());
+                listener = m_listener;
             }
+            m_notEmpty.notify_one();
+
+            if (listener)
+                listener();
+            return AX_SUCCESS;
         }
 
+        /// @return AX_ERR_QUEUE_EMPTY, or AX_ERR_CLOSED when closed and drained
         int pop(Packet& packet)
         {
-            std::lock_guard<std::mutex> lg(m_lock);
-            // printf("poo from 0x%x\n", this);
-            if (m_queue.empty())
-            {
-                return AX_ERR_QUEUE_EMPTY;
-            }
-            else
+            std::function<void()> listener;
             {
-                // printf("queue size: %d\n", m_queue.size());
+                std::lock_guard<std::mutex> lg(m_lock);
+                if (m_queue.empty())
+                    return m_closed ? AX_ERR_CLOSED : AX_ERR_QUEUE_EMPTY;
+
+                if (m_maxSize >= 0 && m_queue.size() == (size_t)m_maxSize)
+                    listener = m_spaceListener;
                 packet = m_queue.front();
                 m_queue.pop();
-                return AX_SUCCESS;
+                m_metrics->popped.add();
+                if (m_traceId && packet.trace())
+                    packet.trace()->exit(m_traceId, TraceContext::now_ns());
+                m_metrics->depth.set(m_queue.size());
+            }
+            m_notFull.notify_one();
+
+            if (listener)
+                listener();
+            return AX_SUCCESS;
+        }
+
+        /// @brief pop up to max_num packets at once
+        /// @return AX_ERR_QUEUE_EMPTY, or AX_ERR_CLOSED when closed and drained
+        int pop_batch(std::vector<Packet>& packets, int max_num)
+        {
+            std::function<void()> listener;
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                if (m_queue.empty())
+                    return m_closed ? AX_ERR_CLOSED : AX_ERR_QUEUE_EMPTY;
+
+                bool was_full = m_maxSize >= 0 && m_queue.size() >= (size_t)m_maxSize;
+                while (!m_queue.empty() && (int)packets.size() < max_num)
+                {
+                    packets.push_back(m_queue.front());
+                    m_queue.pop();
+                    m_metrics->popped.add();
+                    if (m_traceId && packets.back().trace())
+                        packets.back().trace()->exit(m_traceId, TraceContext::now_ns());
+                }
+                m_metrics->depth.set(m_queue.size());
+                if (was_full && m_queue.size() < (size_t)m_maxSize)
+                    listener = m_spaceListener;
             }
+            m_notFull.notify_all();
+
+            if (listener)
+                listener();
+            return AX_SUCCESS;
+        }
+
+        /// @brief pop, waiting up to timeout milliseconds for a packet
+        int pop(Packet& packet, int timeout)
+        {
+            if (!wait(timeout))
+                return closed() ? AX_ERR_CLOSED : AX_ERR_TIMEOUT;
+            return pop(packet);
+        }
+
+        /// @brief wait until a packet is queued or the stream is closed
+        /// @return whether a packet is queued
+        bool wait(int timeout)
+        {
+            std::unique_lock<std::mutex> lk(m_lock);
+            if (!m_closed && m_queue.empty())
+            {
+                auto start = std::chrono::steady_clock::now();
+                m_notEmpty.wait_for(lk, std::chrono::milliseconds(timeout), [this]() { return m_closed || !m_queue.empty(); });
+                m_metrics->pop_wait_us.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+            }
+            return !m_queue.empty();
+        }
+
+        /// @brief fail pushes and wake everyone blocked on the stream,
+        ///     queued packets can still be popped
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lg(m_lock);
+                m_closed = true;
+            }
+            m_notEmpty.notify_all();
+            m_notFull.notify_all();
+        }
+
+        /// @brief accept pushes again, optionally dropping what was left
+        void reopen(bool clear = false)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_closed = false;
+            if (clear)
+            {
+                std::queue<Packet>().swap(m_queue);
+                m_metrics->depth.set(0);
+            }
+        }
+
+        bool closed() const
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            return m_closed;
         }
 
     private:
         int m_maxSize;
-        std::mutex m_lock;
+        StreamPolicy m_policy;
+        bool m_closed;
+        uint16_t m_traceId;
+        std::shared_ptr<StreamMetrics> m_metrics;
+        mutable std::mutex m_lock;
+        std::condition_variable m_notEmpty;
+        std::condition_variable m_notFull;
         std::queue<Packet> m_queue;
+        std::function<void()> m_listener;
+        std::function<void()> m_spaceListener;
     };
 }
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <memory>
+
+#include "buffer_pool.hpp"
+
+namespace ax
+{
+    enum TensorLayout
+    {
+        TENSOR_LAYOUT_NHWC = 0,     // channels interleaved, like a BGR VideoFrame
+        TENSOR_LAYOUT_NCHW          // one plane per channel
+    };
+
+    enum TensorType
+    {
+        TENSOR_TYPE_UINT8 = 0,
+        TENSOR_TYPE_INT8,
+        TENSOR_TYPE_FLOAT32
+    };
+
+    inline int tensor_type_size(int type) { return type == TENSOR_TYPE_FLOAT32 ? 4 : 1; }
+
+    /// @brief maps tensor pixel coordinates back to the source frame,
+    ///     source = tensor * scale + offset, undoes resize, letterbox and ROI
+    struct TensorTransform
+    {
+        float scale_x;
+        float scale_y;
+        float offset_x;
+        float offset_y;
+
+        TensorTransform(): scale_x(1), scale_y(1), offset_x(0), offset_y(0) { }
+
+        float source_x(float x) const { return x * scale_x + offset_x; }
+        float source_y(float y) const { return y * scale_y + offset_y; }
+    };
+
+    /// @brief Dense N x C x H x W tensor passed between nodes, model input or output.
+    /// @details The dimensions are logical, layout tells how they are laid out
+    ///     in memory, rows are not padded. Copies share the data like
+    ///     VideoFrame, buffer gives it back to its pool with the last copy.
+    ///     transform relates the H x W plane to the frame the tensor was made
+    ///     from, pts is that frame's.
+    struct Tensor
+    {
+        int type;
+        int layout;
+        int batch;
+        int channels;
+        int height;
+        int width;
+        uint8_t* data;
+        uint64_t pts;
+        TensorTransform transform;
+        std::shared_ptr<void> buffer;
+
+        Tensor():
+            type(TENSOR_TYPE_UINT8),
+            layout(TENSOR_LAYOUT_NCHW),
+            batch(0),
+            channels(0),
+            height(0),
+            width(0),
+            data(nullptr),
+            pts(0)
+        { }
+
+        bool valid() const { return data && elements() > 0; }
+
+        size_t elements() const { return (size_t)batch * channels * height * width; }
+
+        size_t bytes() const { return elements() * tensor_type_size(type); }
+
+        /// @brief bytes of one of the batch items
+        size_t item_bytes() const { return (size_t)channels * height * width * tensor_type_size(type); }
+
+        template <typename T>
+        T* as() const { return (T*)data; }
+
+        /// @brief describe a tensor at data, owner is released with the last copy
+        static Tensor Wrap(int type, int layout, int n, int c, int h, int w, void* data, std::shared_ptr<void> owner)
+        {
+            Tensor tensor;
+            tensor.type = type;
+            tensor.layout = layout;
+            tensor.batch = n;
+            tensor.channels = c;
+            tensor.height = h;
+            tensor.width = w;
+            tensor.data = (uint8_t*)data;
+            tensor.buffer = std::move(owner);
+            return tensor;
+        }
+
+        /// @brief a tensor in a buffer of the pool, invalid if none is free or it is too small
+        /// @param timeout milliseconds, see BufferPool::Get
+        static Tensor Allocate(BufferPool& pool, int type, int layout, int n, int c, int h, int w, int timeout = 0)
+        {
+            if (pool.size() < (size_t)n * c * h * w * tensor_type_size(type))
+                return Tensor();
+            std::shared_ptr<uint8_t> buffer = pool.Get(timeout);
+            if (!buffer)
+                return Tensor();
+            uint8_t* data = buffer.get();
+            return Wrap(type, layout, n, c, h, w, data, std::move(buffer));
+        }
+
+        /// @brief a tensor on its own heap buffer
+        static Tensor Allocate(int type, int layout, int n, int c, int h, int w)
+        {
+            size_t size = (size_t)n * c * h * w * tensor_type_size(type);
+            void* ptr = nullptr;
+            if (size == 0 || posix_memalign(&ptr, 64, size) != 0)
+                return Tensor();
+            std::shared_ptr<uint8_t> buffer((uint8_t*)ptr, free);
+            return Wrap(type, layout, n, c, h, w, ptr, std::move(buffer));
+        }
+    };
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "json/json.h"
+
+namespace utils
+{
+    /// @brief cpu set and scheduling of a thread
+    /// @details from {"cpus": [2, 3] or "2-3,5", "priority": 50, "nice": -5},
+    ///     priority above 0 selects SCHED_FIFO and needs CAP_SYS_NICE,
+    ///     nice applies to SCHED_OTHER threads. A cpu list with an id outside
+    ///     0..CPU_SETSIZE-1 is rejected as a whole.
+    struct ThreadPolicy
+    {
+        std::vector<int> cpus;
+        int priority;
+        bool has_nice;
+        int nice;
+
+        ThreadPolicy():
+            priority(0),
+            has_nice(false),
+            nice(0)
+        { }
+
+        bool empty() const { return cpus.empty() && priority <= 0 && !has_nice; }
+
+        static bool valid_cpu(long c) { return c >= 0 && c < CPU_SETSIZE; }
+
+        static bool parse_cpus(const std::string& list, std::vector<int>& cpus)
+        {
+            size_t pos = 0;
+            while (pos < list.size())
+            {
+                size_t end = list.find(',', pos);
+                if (end == std::string::npos)
+                    end = list.size();
+                std::string range = list.substr(pos, end - pos);
+                pos = end + 1;
+                if (range.empty())
+                    continue;
+
+                char* rest = nullptr;
+                long first = strtol(range.c_str(), &rest, 10);
+                long last = first;
+                if (*rest == '-')
+                    last = strtol(rest + 1, &rest, 10);
+                if (*rest != '\0' || !valid_cpu(first) || !valid_cpu(last) || last < first)
+                    return false;
+                for (long c = first; c <= last; c++)
+                    cpus.push_back((int)c);
+            }
+            return true;
+        }
+
+        static ThreadPolicy from_json(const Json::Value& config)
+        {
+            ThreadPolicy policy;
+            const Json::Value& cpus = config["cpus"];
+            if (cpus.isArray())
+            {
+                for (const auto& c : cpus)
+                {
+                    if (!c.isInt() || !valid_cpu(c.asInt()))
+                    {
+                        printf("bad cpu list, ids must be integers 0-%d\n", CPU_SETSIZE - 1);
+                        policy.cpus.clear();
+                        break;
+                    }
+                    policy.cpus.push_back(c.asInt());
+                }
+            }
+            else if (cpus.isString() && !parse_cpus(cpus.asString(), policy.cpus))
+            {
+                printf("bad cpu list \"%s\", ids must be 0-%d\n", cpus.asCString(), CPU_SETSIZE - 1);
+                policy.cpus.clear();
+            }
+
+            policy.priority = config.get("priority", 0).asInt();
+            if (config.isMember("nice"))
+            {
+                policy.has_nice = true;
+                policy.nice = config["nice"].asInt();
+            }
+            return policy;
+        }
+    };
+
+    /// @brief name shown by top -H and in /proc, truncated to 15 characters
+    inline void set_thread_name(const std::string& name)
+    {
+        pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+    }
+
+    /// @brief apply policy to the calling thread, threads it creates afterwards inherit it
+    /// @return 0, or the errno of the first setting that failed, the others are still applied
+    inline int apply_thread_policy(const ThreadPolicy& policy, const char* who)
+    {
+        int ret = 0;
+        if (!policy.cpus.empty())
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            int err = 0;
+            for (int c : policy.cpus)
+            {
+                if (!ThreadPolicy::valid_cpu(c))
+                {
+                    err = EINVAL;
+                    break;
+                }
+                CPU_SET(c, &set);
+            }
+            if (err == 0)
+                err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            if (err != 0)
+            {
+                printf("[%s]: set cpu affinity failed: %s\n", who, strerror(err));
+                ret = ret ? ret : err;
+            }
+        }
+
+        if (policy.priority > 0)
+        {
+            struct sched_param param;
+            memset(&param, 0, sizeof(param));
+            param.sched_priority = policy.priority;
+            int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (err != 0)
+            {
+                printf("[%s]: set SCHED_FIFO %d failed: %s\n", who, policy.priority, strerror(err));
+                ret = ret ? ret : err;
+            }
+        }
+        else if (policy.has_nice)
+        {
+            // per thread on Linux when given the thread id
+            if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), policy.nice) != 0)
+            {
+                printf("[%s]: set nice %d failed: %s\n", who, policy.nice, strerror(errno));
+                ret = ret ? ret : errno;
+            }
+        }
+        return ret;
+    }
+}
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+
+#include "json/json.h"
+
+#include "packet.hpp"
+
+namespace ax
+{
+    /// @brief time spent by a frame in one node or stream
+    struct TraceSpan
+    {
+        uint16_t id;        // Tracer::Id of the node or stream
+        uint64_t enter_ns;
+        uint64_t exit_ns;   // 0 while still inside
+    };
+
+    /// @brief Path of one frame through the pipeline, carried by its packets
+    /// @details Fixed size so that copying it along with a packet stays cheap,
+    ///     spans past MAX_SPANS are counted in overflow and not recorded.
+    struct TraceContext
+    {
+        enum { MAX_SPANS = 16 };
+
+        uint64_t capture_ns;    // when the frame was captured, or first sent
+        uint64_t frame_seq;
+        uint16_t num_spans;
+        uint16_t overflow;
+        TraceSpan spans[MAX_SPANS];
+
+        TraceContext(uint64_t capture = 0, uint64_t seq = 0):
+            capture_ns(capture),
+            frame_seq(seq),
+            num_spans(0),
+            overflow(0)
+        { }
+
+        static uint64_t now_ns()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void enter(uint16_t id, uint64_t ns)
+        {
+            if (num_spans >= MAX_SPANS)
+            {
+                overflow++;
+                return;
+            }
+            TraceSpan& s = spans[num_spans++];
+            s.id = id;
+            s.enter_ns = ns;
+            s.exit_ns = 0;
+        }
+
+        /// @brief close the latest open span of id
+        void exit(uint16_t id, uint64_t ns)
+        {
+            for (int i = num_spans - 1; i >= 0; i--)
+            {
+                if (spans[i].id == id && spans[i].exit_ns == 0)
+                {
+                    spans[i].exit_ns = ns;
+                    return;
+                }
+            }
+        }
+
+        /// @brief capture to the last recorded exit, glass to glass at a sink
+        uint64_t latency_ns() const
+        {
+            uint64_t last = capture_ns;
+            for (int i = 0; i < num_spans; i++)
+                last = std::max(last, std::max(spans[i].enter_ns, spans[i].exit_ns));
+            return last - capture_ns;
+        }
+    };
+
+    /// @brief Names trace ids and keeps the traces of frames that reached a sink
+    /// @details Disabled by default, packets then carry no context and the
+    ///     ports and streams only test a null pointer.
+    class Tracer
+    {
+    public:
+        static Tracer& Instance()
+        {
+            static Tracer tracer;
+            return tracer;
+        }
+
+        /// @param capacity  finished traces kept, the oldest are dropped first
+        void Enable(bool enable, size_t capacity = 1024)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_capacity = capacity;
+            m_enabled = enable;
+        }
+
+        bool Enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+        /// @brief id of a node or stream name, 0 is reserved for untraced
+        uint16_t Id(const std::string& name)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            auto it = m_ids.find(name);
+            if (it != m_ids.end())
+                return it->second;
+            if (m_names.size() >= 0xffff)
+                return 0;
+            m_names.push_back(name);
+            m_ids[name] = (uint16_t)m_names.size();
+            return (uint16_t)m_names.size();
+        }
+
+        std::string Name(uint16_t id)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            return id > 0 && id <= m_names.size() ? m_names[id - 1] : std::string();
+        }
+
+        /// @brief start tracing a frame from a source, e.g. with the capture
+        ///     time of the sensor instead of the time it was first sent
+        static void Begin(Packet& packet, uint64_t capture_ns, uint64_t frame_seq)
+        {
+            packet.set_trace(std::make_shared<TraceContext>(capture_ns, frame_seq));
+        }
+
+        /// @brief keep the trace of a frame that left the pipeline
+        void Finish(const TraceContext& trace)
+        {
+            if (!Enabled())
+                return;
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_finished.push_back(trace);
+            while (m_finished.size() > m_capacity)
+                m_finished.pop_front();
+        }
+
+        std::vector<TraceContext> Traces()
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            return std::vector<TraceContext>(m_finished.begin(), m_finished.end());
+        }
+
+        void Clear()
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            m_finished.clear();
+        }
+
+        /// @brief finished traces as Chrome trace events, for chrome://tracing or Perfetto
+        /// @details one row per node or stream, plus a "frame" row spanning
+        ///     capture to the last exit of each frame
+        std::string ExportChrome()
+        {
+            std::vector<TraceContext> traces = Traces();
+            Json::Value events(Json::arrayValue);
+
+            std::set<uint16_t> ids;
+            for (const auto& t : traces)
+            {
+                Json::Value frame;
+                frame["name"] = "frame " + std::to_string(t.frame_seq);
+                frame["cat"] = "frame";
+                frame["ph"] = "X";
+                frame["pid"] = 0;
+                frame["tid"] = 0;
+                frame["ts"] = (double)t.capture_ns / 1000.0;
+                frame["dur"] = (double)t.latency_ns() / 1000.0;
+                frame["args"]["frame_seq"] = (Json::UInt64)t.frame_seq;
+                frame["args"]["overflow"] = t.overflow;
+                events.append(frame);
+
+                for (int i = 0; i < t.num_spans; i++)
+                {
+                    const TraceSpan& s = t.spans[i];
+                    if (s.exit_ns == 0)
+                        continue;
+                    ids.insert(s.id);
+                    Json::Value e;
+                    e["name"] = Name(s.id);
+                    e["cat"] = "span";
+                    e["ph"] = "X";
+                    e["pid"] = 0;
+                    e["tid"] = s.id;
+                    e["ts"] = (double)s.enter_ns / 1000.0;
+                    e["dur"] = (double)(s.exit_ns - s.enter_ns) / 1000.0;
+                    e["args"]["frame_seq"] = (Json::UInt64)t.frame_seq;
+                    events.append(e);
+                }
+            }
+
+            // row labels
+            for (uint16_t id : ids)
+            {
+                Json::Value meta;
+                meta["name"] = "thread_name";
+                meta["ph"] = "M";
+                meta["pid"] = 0;
+                meta["tid"] = id;
+                meta["args"]["name"] = Name(id);
+                events.append(meta);
+            }
+
+            Json::Value root;
+            root["traceEvents"] = events;
+            root["displayTimeUnit"] = "ms";
+            Json::StreamWriterBuilder builder;
+            builder["indentation"] = "";
+            return Json::writeString(builder, root);
+        }
+
+        bool WriteChrome(const std::string& path)
+        {
+            FILE* fp = fopen(path.c_str(), "w");
+            if (!fp)
+            {
+                printf("open trace file %s failed\n", path.c_str());
+                return false;
+            }
+            std::string json = ExportChrome();
+            bool ok = fwrite(json.data(), 1, json.size(), fp) == json.size();
+            fclose(fp);
+            return ok;
+        }
+
+    private:
+        Tracer():
+            m_enabled(false),
+            m_capacity(1024)
+        { }
+
+        std::atomic<bool> m_enabled;
+        std::mutex m_lock;
+        size_t m_capacity;
+        std::map<std::string, uint16_t> m_ids;
+        std::vector<std::string> m_names;
+        std::deque<TraceContext> m_finished;
+    };
+
+    /// @brief trace of the input the calling thread is working on
+    /// @details set when a node takes an input, its node span is closed and
+    ///     handed to the packets it sends, a trace never forwarded ends at
+    ///     this node and is finished
+    struct TraceCursor
+    {
+        std::shared_ptr<TraceContext> trace;
+        uint16_t node_id;
+        bool forwarded;
+
+        static TraceCursor& Current()
+        {
+            static thread_local TraceCursor cursor = { nullptr, 0, false };
+            return cursor;
+        }
+
+        /// @brief the node starts working on packet
+        static void Enter(const Packet& packet, uint16_t node_id)
+        {
+            TraceCursor& c = Current();
+            End();
+            if (!packet.trace() || node_id == 0)
+                return;
+            c.trace = packet.trace();
+            c.node_id = node_id;
+            c.forwarded = false;
+            c.trace->enter(node_id, TraceContext::now_ns());
+        }
+
+        /// @brief the node is done with the input, finishes the trace at a sink
+        static void End()
+        {
+            TraceCursor& c = Current();
+            if (!c.trace)
+                return;
+            if (!c.forwarded)
+            {
+                c.trace->exit(c.node_id, TraceContext::now_ns());
+                Tracer::Instance().Finish(*c.trace);
+            }
+            c.trace.reset();
+        }
+
+        /// @brief a copy of the current trace for an output packet, closing the node span
+        static std::shared_ptr<TraceContext> Forward()
+        {
+            TraceCursor& c = Current();
+            if (!c.trace)
+                return nullptr;
+            c.forwarded = true;
+            auto out = std::make_shared<TraceContext>(*c.trace);
+            out->exit(c.node_id, TraceContext::now_ns());
+            return out;
+        }
+    };
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace ax
+{
+    /// @brief How often the detector has to run per channel, set by a
+    ///     TrackerNode and read by a DetectGateNode upstream of the detector.
+    /// @details Entries are keyed "<tracker>.<channel>" and made by whichever
+    ///     node asks first, so nodes may be created in any order. An
+    ///     interval of n lets one frame in n through, 1 every frame.
+    class DetectSchedule
+    {
+    public:
+        static DetectSchedule& Instance()
+        {
+            static DetectSchedule schedule;
+            return schedule;
+        }
+
+        static std::string Key(const std::string& tracker, int channel)
+        {
+            return tracker + "." + std::to_string(channel);
+        }
+
+        /// @brief the interval of a channel, starts at 1
+        std::shared_ptr<std::atomic<int>> Get(const std::string& key)
+        {
+            std::lock_guard<std::mutex> lg(m_lock);
+            std::shared_ptr<std::atomic<int>>& interval = m_intervals[key];
+            if (!interval)
+                interval = std::make_shared<std::atomic<int>>(1);
+            return interval;
+        }
+
+    private:
+        DetectSchedule() = default;
+
+        std::mutex m_lock;
+        std::map<std::string, std::shared_ptr<std::atomic<int>>> m_intervals;
+    };
+}
@@ -0,0 +1,541 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AX_TRACK_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AX_TRACK_SSE2 1
+#endif
+
+#include "detections.hpp"
+
+namespace ax
+{
+    /// @brief ByteTrack thresholds, IoU gates and track lifetime
+    struct TrackerParams
+    {
+        float high_threshold;       // detections associated first and allowed to start tracks
+        float low_threshold;        // below this a detection is ignored
+        float new_threshold;        // a new track needs this score
+        float match_iou;            // high detections to tracked and lost tracks
+        float low_match_iou;        // low detections to tracks left over
+        float new_match_iou;        // high detections left over to unconfirmed tracks
+        int max_lost;               // frames a lost track is kept for re-identification
+        int max_tracks;
+        bool class_aware;           // only match detections of the track's label
+
+        TrackerParams():
+            high_threshold(0.5f),
+            low_threshold(0.1f),
+            new_threshold(0.6f),
+            match_iou(0.2f),
+            low_match_iou(0.5f),
+            new_match_iou(0.3f),
+            max_lost(30),
+            max_tracks(1024),
+            class_aware(true)
+        { }
+    };
+
+    namespace track
+    {
+        enum TrackState
+        {
+            TRACK_NEW = 0,          // seen once, dropped unless matched next frame
+            TRACK_TRACKED,
+            TRACK_LOST
+        };
+
+        /// @brief Track state as one array per field, tracks are indices.
+        /// @details The Kalman filter is constant velocity over cx, cy, w and
+        ///     h. With diagonal noise, as in ByteTrack, it splits into one 2
+        ///     state filter per coordinate: position, velocity and a
+        ///     symmetric 2 x 2 covariance (pp, pv, vv), so predict and update
+        ///     are plain loops over the arrays. Removal moves the last track
+        ///     into the hole.
+        struct TrackSet
+        {
+            std::vector<int32_t> id;
+            std::vector<int32_t> label;
+            std::vector<uint8_t> state;
+            std::vector<int32_t> hits;
+            std::vector<int32_t> lost;      // frames since the last match
+            std::vector<float> score;
+            std::vector<float> pos[4];      // cx, cy, w, h
+            std::vector<float> vel[4];
+            std::vector<float> pp[4];
+            std::vector<float> pv[4];
+            std::vector<float> vv[4];
+
+            int size() const { return (int)id.size(); }
+
+            void clear()
+            {
+                resize(0);
+            }
+
+            void resize(size_t n)
+            {
+                id.resize(n);
+                label.resize(n);
+                state.resize(n);
+                hits.resize(n);
+                lost.resize(n);
+                score.resize(n);
+                for (int d = 0; d < 4; d++)
+                {
+                    pos[d].resize(n);
+                    vel[d].resize(n);
+                    pp[d].resize(n);
+                    pv[d].resize(n);
+                    vv[d].resize(n);
+                }
+            }
+
+            void remove(int i)
+            {
+                int last = size() - 1;
+                if (i != last)
+                {
+                    id[i] = id[last];
+                    label[i] = label[last];
+                    state[i] = state[last];
+                    hits[i] = hits[last];
+                    lost[i] = lost[last];
+                    score[i] = score[last];
+                    for (int d = 0; d < 4; d++)
+                    {
+                        pos[d][i] = pos[d][last];
+                        vel[d][i] = vel[d][last];
+                        pp[d][i] = pp[d][last];
+                        pv[d][i] = pv[d][last];
+                        vv[d][i] = vv[d][last];
+                    }
+                }
+                resize(last);
+            }
+        };
+
+        /// @brief a track and a detection overlapping by iou
+        struct Pair
+        {
+            float iou;
+            int32_t track;
+            int32_t det;
+        };
+
+        /// @brief best overlap first, then lower indices so the order is deterministic
+        inline bool before(const Pair& a, const Pair& b)
+        {
+            if (a.iou != b.iou)
+                return a.iou > b.iou;
+            return a.track != b.track ? a.track < b.track : a.det < b.det;
+        }
+
+        /// @brief predicted boxes of the tracks sorted by x0, for association
+        struct Boxes
+        {
+            std::vector<float> x0;
+            std::vector<float> y0;
+            std::vector<float> x1;
+            std::vector<float> y1;
+            std::vector<int32_t> label;
+            std::vector<int32_t> track;     // index in the TrackSet
+            float max_width;
+
+            Boxes(): max_width(0) { }
+
+            int size() const { return (int)x0.size(); }
+
+            /// @brief [begin, end) of the boxes that can overlap x0..x1 horizontally
+            void range(float bx0, float bx1, int& begin, int& end) const
+            {
+                begin = std::lower_bound(x0.begin(), x0.end(), bx0 - max_width) - x0.begin();
+                end = std::lower_bound(x0.begin() + begin, x0.end(), bx1) - x0.begin();
+            }
+        };
+
+        /// @brief append the boxes in [begin, end) overlapping the detection by more than gate
+        /// @details a row of the association cost matrix, four boxes per
+        ///     SIMD op, only entries above gate are kept since nearly all are 0.
+        inline void iou_row(const Boxes& b, int begin, int end, const Detection& d, int det, bool class_aware,
+            float gate, std::vector<Pair>& pairs, bool simd = true)
+        {
+            float area = (d.x1 - d.x0) * (d.y1 - d.y0);
+            int k = begin;
+#if AX_TRACK_SSE2
+            if (simd)
+            {
+                __m128 dx0 = _mm_set1_ps(d.x0), dy0 = _mm_set1_ps(d.y0), dx1 = _mm_set1_ps(d.x1), dy1 = _mm_set1_ps(d.y1);
+                __m128 darea = _mm_set1_ps(area), g = _mm_set1_ps(gate), zero = _mm_setzero_ps();
+                for (; k + 4 <= end; k += 4)
+                {
+                    __m128 tx0 = _mm_loadu_ps(&b.x0[k]), ty0 = _mm_loadu_ps(&b.y0[k]);
+                    __m128 tx1 = _mm_loadu_ps(&b.x1[k]), ty1 = _mm_loadu_ps(&b.y1[k]);
+                    __m128 w = _mm_max_ps(_mm_sub_ps(_mm_min_ps(dx1, tx1), _mm_max_ps(dx0, tx0)), zero);
+                    __m128 h = _mm_max_ps(_mm_sub_ps(_mm_min_ps(dy1, ty1), _mm_max_ps(dy0, ty0)), zero);
+                    __m128 inter = _mm_mul_ps(w, h);
+                    __m128 uni = _mm_sub_ps(_mm_add_ps(darea, _mm_mul_ps(_mm_sub_ps(tx1, tx0), _mm_sub_ps(ty1, ty0))), inter);
+                    // 大多数为0, 先用乘法判断门限, 命中时才做除法
+                    int bits = _mm_movemask_ps(_mm_cmpgt_ps(inter, _mm_mul_ps(g, uni)));
+                    if (!bits)
+                        continue;
+                    float in[4], un[4];
+                    _mm_storeu_ps(in, inter);
+                    _mm_storeu_ps(un, uni);
+                    for (int j = 0; j < 4; j++)
+                    {
+                        if ((bits >> j & 1) && (!class_aware || b.label[k + j] == d.label))
+                            pairs.push_back(Pair{in[j] / un[j], b.track[k + j], det});
+                    }
+                }
+            }
+#elif AX_TRACK_NEON
+            if (simd)
+            {
+                float32x4_t dx0 = vdupq_n_f32(d.x0), dy0 = vdupq_n_f32(d.y0), dx1 = vdupq_n_f32(d.x1), dy1 = vdupq_n_f32(d.y1);
+                float32x4_t darea = vdupq_n_f32(area), g = vdupq_n_f32(gate), zero = vdupq_n_f32(0);
+                for (; k + 4 <= end; k += 4)
+                {
+                    float32x4_t tx0 = vld1q_f32(&b.x0[k]), ty0 = vld1q_f32(&b.y0[k]);
+                    float32x4_t tx1 = vld1q_f32(&b.x1[k]), ty1 = vld1q_f32(&b.y1[k]);
+                    float32x4_t w = vmaxq_f32(vsubq_f32(vminq_f32(dx1, tx1), vmaxq_f32(dx0, tx0)), zero);
+                    float32x4_t h = vmaxq_f32(vsubq_f32(vminq_f32(dy1, ty1), vmaxq_f32(dy0, ty0)), zero);
+                    float32x4_t inter = vmulq_f32(w, h);
+                    float32x4_t uni = vsubq_f32(vaddq_f32(darea, vmulq_f32(vsubq_f32(tx1, tx0), vsubq_f32(ty1, ty0))), inter);
+                    uint32x4_t m = vcgtq_f32(inter, vmulq_f32(g, uni));
+                    uint32x2_t any = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+                    if (!(vget_lane_u32(any, 0) | vget_lane_u32(any, 1)))
+                        continue;
+                    float in[4], un[4];
+                    uint32_t hit[4];
+                    vst1q_f32(in, inter);
+                    vst1q_f32(un, uni);
+                    vst1q_u32(hit, m);
+                    for (int j = 0; j < 4; j++)
+                    {
+                        if (hit[j] && (!class_aware || b.label[k + j] == d.label))
+                            pairs.push_back(Pair{in[j] / un[j], b.track[k + j], det});
+                    }
+                }
+            }
+#endif
+            for (; k < end; k++)
+            {
+                float w = std::max(std::min(d.x1, b.x1[k]) - std::max(d.x0, b.x0[k]), 0.0f);
+                float h = std::max(std::min(d.y1, b.y1[k]) - std::max(d.y0, b.y0[k]), 0.0f);
+                float inter = w * h;
+                float uni = area + (b.x1[k] - b.x0[k]) * (b.y1[k] - b.y0[k]) - inter;
+                if (inter > gate * uni && (!class_aware || b.label[k] == d.label))
+                    pairs.push_back(Pair{inter / uni, b.track[k], det});
+            }
+        }
+    }
+
+    /// @brief ByteTrack style multi-object tracker of one video channel.
+    /// @details Every Update predicts the tracks, then associates in three
+    ///     rounds by IoU: high score detections with tracked and lost tracks,
+    ///     low score detections with the tracked ones left, and high score
+    ///     detections left with tracks seen only once. Detections still
+    ///     unmatched above new_threshold start tracks. Only detections
+    ///     above low_threshold are used. The predicted boxes are sorted by
+    ///     x0, so a detection is only compared with the run of tracks that
+    ///     can overlap it horizontally, four at a time with SIMD. Only the
+    ///     overlaps above the gate are kept, and each round matches greedily
+    ///     by descending IoU, which equals the optimal assignment when
+    ///     tracks do not compete for boxes, the usual case after gating.
+    ///     Frames the detector skipped are bridged by predicting several
+    ///     steps. Not thread safe, one Tracker per channel.
+    class Tracker
+    {
+    public:
+        explicit Tracker(const TrackerParams& params):
+            m_params(params),
+            m_nextId(1),
+            m_frames(0),
+            m_born(0),
+            m_ended(0)
+        { }
+
+        const TrackerParams& params() const { return m_params; }
+
+        const track::TrackSet& tracks() const { return m_tracks; }
+
+        /// @brief tracks started and tracks lost or ended in the last Update
+        int Born() const { return m_born; }
+        int Ended() const { return m_ended; }
+
+        /// @brief largest motion per frame of a tracked track relative to its size
+        float MaxMotion() const
+        {
+            float motion = 0;
+            for (int i = 0; i < m_tracks.size(); i++)
+            {
+                if (m_tracks.state[i] != track::TRACK_TRACKED)
+                    continue;
+                float size = std::max(std::min(m_tracks.pos[2][i], m_tracks.pos[3][i]), 1.0f);
+                float v = std::max(fabsf(m_tracks.vel[0][i]), fabsf(m_tracks.vel[1][i]));
+                motion = std::max(motion, v / size);
+            }
+            return motion;
+        }
+
+        /// @brief whether every track is confirmed and none appeared or went missing last frame
+        bool Settled() const
+        {
+            if (m_born || m_ended)
+                return false;
+            for (int i = 0; i < m_tracks.size(); i++)
+            {
+                if (m_tracks.state[i] != track::TRACK_TRACKED)
+                    return false;
+            }
+            return true;
+        }
+
+        void Reset()
+        {
+            m_tracks.clear();
+            m_frames = 0;
+            m_born = 0;
+            m_ended = 0;
+        }
+
+        /// @brief advance by steps frames, associate the detections of the last one
+        /// @param out the tracks matched in this frame, Kalman filtered boxes with their id
+        /// @param simd false runs the scalar IoU, for comparisons
+        void Update(const Detections& dets, int steps, Detections& out, bool simd = true)
+        {
+            const TrackerParams& p = m_params;
+            track::TrackSet& t = m_tracks;
+            steps = std::max(steps, 1);
+            Predict(steps);
+
+            int n = dets.size();
+            m_detMatched.assign(n, 0);
+            m_trackMatched.assign(t.size(), 0);
+            m_pairs.clear();
+            float gate = std::min(p.match_iou, std::min(p.low_match_iou, p.new_match_iou));
+            for (int i = 0; i < n; i++)
+            {
+                const Detection& d = dets.boxes[i];
+                if (d.score < p.low_threshold)
+                    continue;
+                int begin, end;
+                m_boxes.range(d.x0, d.x1, begin, end);
+                track::iou_row(m_boxes, begin, end, d, i, p.class_aware, gate, m_pairs, simd);
+            }
+            std::sort(m_pairs.begin(), m_pairs.end(), track::before);
+
+            // 三轮关联: 高分对已跟踪与丢失, 低分对剩余已跟踪, 高分剩余对新轨迹
+            Match(dets, true, (1 << track::TRACK_TRACKED) | (1 << track::TRACK_LOST), p.match_iou);
+            Match(dets, false, 1 << track::TRACK_TRACKED, p.low_match_iou);
+            Match(dets, true, 1 << track::TRACK_NEW, p.new_match_iou);
+
+            m_born = 0;
+            m_ended = 0;
+            for (int i = t.size() - 1; i >= 0; i--)
+            {
+                if (m_trackMatched[i])
+                    continue;
+                if (t.state[i] == track::TRACK_TRACKED)
+                {
+                    t.state[i] = track::TRACK_LOST;
+                    m_ended++;
+                }
+                else if (t.state[i] == track::TRACK_NEW || t.lost[i] > p.max_lost)
+                {
+                    if (t.state[i] == track::TRACK_NEW)
+                        m_ended++;
+                    t.remove(i);
+                }
+            }
+
+            // 未匹配的高分检测开始新轨迹, 第一帧直接确认
+            for (int i = 0; i < n && t.size() < p.max_tracks; i++)
+            {
+                const Detection& d = dets.boxes[i];
+                if (m_detMatched[i] || d.score < p.new_threshold)
+                    continue;
+                Start(d, m_frames == 0 ? track::TRACK_TRACKED : track::TRACK_NEW);
+                m_born++;
+            }
+            m_frames++;
+
+            out.pts = dets.pts;
+            out.boxes.clear();
+            for (int i = 0; i < t.size(); i++)
+            {
+                if (t.state[i] != track::TRACK_TRACKED || t.lost[i] != 0)
+                    continue;
+                Detection d;
+                d.x0 = t.pos[0][i] - t.pos[2][i] * 0.5f;
+                d.y0 = t.pos[1][i] - t.pos[3][i] * 0.5f;
+                d.x1 = t.pos[0][i] + t.pos[2][i] * 0.5f;
+                d.y1 = t.pos[1][i] + t.pos[3][i] * 0.5f;
+                d.score = t.score[i];
+                d.label = t.label[i];
+                d.track = t.id[i];
+                out.boxes.push_back(d);
+            }
+        }
+
+    private:
+        // ByteTrack的噪声权重, 按高度缩放
+        static constexpr float STD_POSITION = 1.0f / 20;
+        static constexpr float STD_VELOCITY = 1.0f / 160;
+
+        void Predict(int steps)
+        {
+            track::TrackSet& t = m_tracks;
+            int n = t.size();
+            for (int s = 0; s < steps; s++)
+            {
+                for (int d = 0; d < 4; d++)
+                {
+                    float* pos = t.pos[d].data();
+                    float* vel = t.vel[d].data();
+                    float* pp = t.pp[d].data();
+                    float* pv = t.pv[d].data();
+                    float* vv = t.vv[d].data();
+                    const float* h = t.pos[3].data();
+                    for (int i = 0; i < n; i++)
+                    {
+                        float qp = STD_POSITION * h[i];
+                        float qv = STD_VELOCITY * h[i];
+                        pos[i] += vel[i];
+                        pp[i] += 2 * pv[i] + vv[i] + qp * qp;
+                        pv[i] += vv[i];
+                        vv[i] += qv * qv;
+                    }
+                }
+            }
+            for (int i = 0; i < n; i++)
+            {
+                // 宽高不能预测为负
+                t.pos[2][i] = std::max(t.pos[2][i], 1.0f);
+                t.pos[3][i] = std::max(t.pos[3][i], 1.0f);
+                t.lost[i] += steps;
+            }
+
+            // 预测框按x0排序, 每个检测只需比较水平方向可能重叠的一段
+            m_order.resize(n);
+            m_key.resize(n);
+            for (int i = 0; i < n; i++)
+            {
+                m_order[i] = i;
+                m_key[i] = t.pos[0][i] - t.pos[2][i] * 0.5f;
+            }
+            std::sort(m_order.begin(), m_order.end(), [this](int32_t a, int32_t b) {
+                return m_key[a] < m_key[b] || (m_key[a] == m_key[b] && a < b);
+            });
+            track::Boxes& b = m_boxes;
+            b.x0.resize(n);
+            b.y0.resize(n);
+            b.x1.resize(n);
+            b.y1.resize(n);
+            b.label.resize(n);
+            b.track.resize(n);
+            b.max_width = 0;
+            for (int k = 0; k < n; k++)
+            {
+                int i = m_order[k];
+                b.x0[k] = m_key[i];
+                b.y0[k] = t.pos[1][i] - t.pos[3][i] * 0.5f;
+                b.x1[k] = t.pos[0][i] + t.pos[2][i] * 0.5f;
+                b.y1[k] = t.pos[1][i] + t.pos[3][i] * 0.5f;
+                b.label[k] = t.label[i];
+                b.track[k] = i;
+                b.max_width = std::max(b.max_width, b.x1[k] - b.x0[k]);
+            }
+        }
+
+        /// @brief greedy matching of one round over the sorted pairs
+        void Match(const Detections& dets, bool high, int states, float iou)
+        {
+            track::TrackSet& t = m_tracks;
+            for (const track::Pair& pair : m_pairs)
+            {
+                if (pair.iou <= iou)
+                    break;
+                if (m_detMatched[pair.det] || m_trackMatched[pair.track] || !(states & (1 << t.state[pair.track])))
+                    continue;
+                const Detection& d = dets.boxes[pair.det];
+                if ((d.score >= m_params.high_threshold) != high)
+                    continue;
+                m_detMatched[pair.det] = 1;
+                m_trackMatched[pair.track] = 1;
+                Correct(pair.track, d);
+            }
+        }
+
+        /// @brief Kalman update of track i with a detection
+        void Correct(int i, const Detection& det)
+        {
+            track::TrackSet& t = m_tracks;
+            float z[4] = { (det.x0 + det.x1) * 0.5f, (det.y0 + det.y1) * 0.5f, det.x1 - det.x0, det.y1 - det.y0 };
+            float r = STD_POSITION * t.pos[3][i];
+            r *= r;
+            for (int d = 0; d < 4; d++)
+            {
+                float s = t.pp[d][i] + r;
+                float kp = t.pp[d][i] / s;
+                float kv = t.pv[d][i] / s;
+                float y = z[d] - t.pos[d][i];
+                t.pos[d][i] += kp * y;
+                t.vel[d][i] += kv * y;
+                t.vv[d][i] -= kv * t.pv[d][i];
+                t.pp[d][i] *= 1 - kp;
+                t.pv[d][i] *= 1 - kp;
+            }
+            t.score[i] = det.score;
+            t.hits[i]++;
+            t.lost[i] = 0;
+            t.state[i] = track::TRACK_TRACKED;
+        }
+
+        void Start(const Detection& det, int state)
+        {
+            track::TrackSet& t = m_tracks;
+            int i = t.size();
+            t.resize(i + 1);
+            float z[4] = { (det.x0 + det.x1) * 0.5f, (det.y0 + det.y1) * 0.5f, det.x1 - det.x0, det.y1 - det.y0 };
+            float h = std::max(z[3], 1.0f);
+            for (int d = 0; d < 4; d++)
+            {
+                t.pos[d][i] = z[d];
+                t.vel[d][i] = 0;
+                t.pp[d][i] = (2 * STD_POSITION * h) * (2 * STD_POSITION * h);
+                t.pv[d][i] = 0;
+                t.vv[d][i] = (10 * STD_VELOCITY * h) * (10 * STD_VELOCITY * h);
+            }
+            t.id[i] = m_nextId++;
+            t.label[i] = det.label;
+            t.state[i] = state;
+            t.hits[i] = 1;
+            t.lost[i] = 0;
+            t.score[i] = det.score;
+        }
+
+        TrackerParams m_params;
+        track::TrackSet m_tracks;
+        int32_t m_nextId;
+        uint64_t m_frames;
+        int m_born;
+        int m_ended;
+
+        track::Boxes m_boxes;
+        std::vector<int32_t> m_order;
+        std::vector<float> m_key;
+        std::vector<track::Pair> m_pairs;
+        std::vector<uint8_t> m_detMatched;
+        std::vector<uint8_t> m_trackMatched;
+    };
+}
@@ -2,15 +2,20 @@
 #include "RTSPCommonEnv.h"
 #include "LiveServerMediaSession.h"
 
-RTSPLiveStreamer::RTSPLiveStreamer() : m_pServerSession(NULL), m_pSessionName(NULL)
+RTSPLiveStreamer::RTSPLiveStreamer() : m_pSessionName(NULL), m_nTracks(0),
+	m_nVideoCapacity(RELAY_VIDEO_CAPACITY), m_nOtherCapacity(RELAY_OTHER_CAPACITY),
+	m_bSending(false), m_bSenderIdle(false)
 {
 	m_pRtspClient = new RTSPClient();
 	m_pRtspServer = RTSPServer::instance();
 	m_nState = STREAMER_STATE_STOPPED;
+	memset(m_tracks, 0, sizeof(m_tracks));
 }
 
 RTSPLiveStreamer::~RTSPLiveStreamer()
 {
+	if (state() != STREAMER_STATE_STOPPED)
+		close();
 	delete[] m_pSessionName;
 	delete m_pRtspClient;
 }
@@ -44,10 +49,107 @@ int RTSPLiveStreamer::run()
 	if (state() != STREAMER_STATE_OPENED)
 		return -1;
 
-	if (m_pRtspClient->playURL(NULL, NULL, NULL, NULL, onRtpReceived, this, onRtcpReceived, this) < 0)
+	// register tracks before the first packet arrives
+	MediaSubsessionIterator *iter = new MediaSubsessionIterator(m_pRtspClient->mediaSession());
+	MediaSubsession *subsession = NULL;
+	while ((subsession=iter->next()) != NULL) {
+		int codec = RELAY_CODEC_OTHER;
+		if (strcmp(subsession->codecName(), "H264") == 0)
+			codec = RELAY_CODEC_H264;
+		else if (strcmp(subsession->codecName(), "H265") == 0)
+			codec = RELAY_CODEC_H265;
+		// same key the server subsession is created with, and the receive callback reports
+		char *controlPath = checkControlPath(subsession->controlPath());
+		addTrack(controlPath, codec);
+		delete[] controlPath;
+	}
+	delete iter;
+
+	resetStats();
+	startSender();
+
+	if (m_pRtspClient->playURL(NULL, NULL, NULL, NULL, onRtpReceived, this, onRtcpReceived, this) < 0) {
+		stopSender();
+		clearTracks();
+		return -1;
+	}
+
+	ServerMediaSession *session = createServerSession(m_pSessionName);
+
+	m_sessionLock.lock();
+	m_serverSessions.push_back(session);
+	m_stats->sessions.store(m_serverSessions.size(), std::memory_order_relaxed);
+	m_sessionLock.unlock();
+
+	m_nState = STREAMER_STATE_RUNNING;
+	publishStats();
+
+	return 0;
+}
+
+int RTSPLiveStreamer::addSession(const char *sessionName)
+{
+	if (state() != STREAMER_STATE_RUNNING)
+		return -1;
+
+	if (m_pRtspServer->lookupServerMediaSession(sessionName) != NULL) {
+		DPRINTF("failed to add server session, session %s already exists\n", sessionName);
 		return -1;
+	}
+
+	ServerMediaSession *session = createServerSession(sessionName);
+
+	std::lock_guard<std::mutex> lock(m_sessionLock);
+	m_serverSessions.push_back(session);
+	m_stats->sessions.store(m_serverSessions.size(), std::memory_order_relaxed);
+	return 0;
+}
+
+void RTSPLiveStreamer::removeSession(const char *sessionName)
+{
+	ServerMediaSession *session = m_pRtspServer->lookupServerMediaSession(sessionName);
+	if (session == NULL)
+		return;
+
+	bool found = false;
+	m_sessionLock.lock();
+	for (std::vector<ServerMediaSession*>::iterator it = m_serverSessions.begin(); it != m_serverSessions.end(); ++it) {
+		if (*it == session) {
+			m_serverSessions.erase(it);
+			m_sessionViewers.erase(session);
+			found = true;
+			break;
+		}
+	}
+	m_stats->sessions.store(m_serverSessions.size(), std::memory_order_relaxed);
+	m_sessionLock.unlock();
+
+	if (found)
+		m_pRtspServer->deleteServerMediaSession(session);
+}
+
+int RTSPLiveStreamer::sessionCount()
+{
+	std::lock_guard<std::mutex> lock(m_sessionLock);
+	return m_serverSessions.size();
+}
+
+void RTSPLiveStreamer::viewerChanges(std::vector<std::pair<std::string, int> > &changes)
+{
+	std::lock_guard<std::mutex> lock(m_sessionLock);
+	for (size_t i = 0; i < m_serverSessions.size(); i++) {
+		ServerMediaSession *session = m_serverSessions[i];
+		unsigned &last = m_sessionViewers[session];
+		unsigned now = session->referenceCount();
+		if (now != last)
+			changes.push_back(std::make_pair(std::string(session->streamName()), (int)now - (int)last));
+		last = now;
+	}
+}
 
-	m_pServerSession = new LiveServerMediaSession(m_pSessionName, "DXMediaPlayer", "Session streamed by \"DXMediaPlayer\"", false, NULL);
+ServerMediaSession* RTSPLiveStreamer::createServerSession(const char *sessionName)
+{
+	ServerMediaSession *serverSession = new LiveServerMediaSession(sessionName, "DXMediaPlayer", "Session streamed by \"DXMediaPlayer\"", false, NULL);
 
 	MediaSubsessionIterator *iter = new MediaSubsessionIterator(m_pRtspClient->mediaSession());
 	MediaSubsession *subsession = NULL;
@@ -60,7 +162,7 @@ int RTSPLiveStreamer::run()
 		else
 			sdpLines = updateSdpLines(subsession->savedSDPLines(), subsession->controlPath(), controlPath);
 
-		m_pServerSession->addSubsession(
+		serverSession->addSubsession(
 			new LiveServerMediaSubsession(
 				controlPath,
 				sdpLines, 
@@ -75,18 +177,57 @@ int RTSPLiveStreamer::run()
 
 	delete iter;
 
-	m_pRtspServer->addServerMediaSession(m_pServerSession);
+	m_pRtspServer->addServerMediaSession(serverSession);
 
-	m_nState = STREAMER_STATE_RUNNING;
+	return serverSession;
+}
 
-	return 0;
+void RTSPLiveStreamer::setRelayCapacity(int video, int other)
+{
+	if (video > 0)
+		m_nVideoCapacity = video;
+	if (other > 0)
+		m_nOtherCapacity = other;
+}
+
+void RTSPLiveStreamer::resetStats()
+{
+	m_stats->received = 0;
+	m_stats->dropped = 0;
+	m_stats->unknown = 0;
+	m_stats->forwarded = 0;
+}
+
+void RTSPLiveStreamer::publishStats()
+{
+	m_stats.Publish("rtsp_relay", m_pSessionName, [](const RelayStats &st, Json::Value &out) {
+		out["sessions"] = st.sessions.load(std::memory_order_relaxed);
+		out["tracks"] = st.tracks.load(std::memory_order_relaxed);
+		out["received"] = (Json::UInt64)st.received.load(std::memory_order_relaxed);
+		out["dropped"] = (Json::UInt64)st.dropped.load(std::memory_order_relaxed);
+		out["unknown"] = (Json::UInt64)st.unknown.load(std::memory_order_relaxed);
+		out["forwarded"] = (Json::UInt64)st.forwarded.load(std::memory_order_relaxed);
+	}, {"received", "dropped", "unknown", "forwarded"});
 }
 
 void RTSPLiveStreamer::close()
 {
+	// receive thread stops first, then the sender drains nothing more
 	m_pRtspClient->closeURL();
-	m_pRtspServer->deleteServerMediaSession(m_pServerSession);
-	m_pServerSession = NULL;
+	stopSender();
+	clearTracks();
+
+	std::vector<ServerMediaSession*> sessions;
+	m_sessionLock.lock();
+	sessions.swap(m_serverSessions);
+	m_sessionViewers.clear();
+	m_stats->sessions.store(0, std::memory_order_relaxed);
+	m_sessionLock.unlock();
+	m_stats.Remove();
+
+	for (size_t i = 0; i < sessions.size(); i++)
+		m_pRtspServer->deleteServerMediaSession(sessions[i]);
+
 	delete[] m_pSessionName; m_pSessionName = NULL;
 	m_nState = STREAMER_STATE_STOPPED;
 }
@@ -99,8 +240,15 @@ void RTSPLiveStreamer::onRtpReceived(void *arg, const char *trackId, char *buf,
 
 void RTSPLiveStreamer::onRtpReceived1(const char *trackId, char *buf, int len)
 {
-	if (m_pServerSession)
-		m_pServerSession->sendClientRtp(trackId, buf, len);
+	RelayTrack *track = findTrack(trackId);
+	if (track == NULL)
+		return;
+
+	m_stats->received.fetch_add(1, std::memory_order_relaxed);
+	if (track->rtp->push(buf, len, isKeyStart(track->codec, buf, len)))
+		wakeSender();
+	else
+		m_stats->dropped.fetch_add(1, std::memory_order_relaxed);
 }
 
 void RTSPLiveStreamer::onRtcpReceived(void *arg, const char *trackId, char *buf, int len)
@@ -111,8 +259,187 @@ void RTSPLiveStreamer::onRtcpReceived(void *arg, const char *trackId, char *buf,
 
 void RTSPLiveStreamer::onRtcpReceived1(const char *trackId, char *buf, int len)
 {
-	if (m_pServerSession)
-		m_pServerSession->sendClientRtcp(trackId, buf, len);
+	RelayTrack *track = findTrack(trackId);
+	if (track == NULL)
+		return;
+
+	m_stats->received.fetch_add(1, std::memory_order_relaxed);
+	if (track->rtcp->push(buf, len, true))
+		wakeSender();
+	else
+		m_stats->dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+RTSPLiveStreamer::RelayTrack* RTSPLiveStreamer::findTrack(const char *trackId)
+{
+	int n = m_nTracks.load(std::memory_order_acquire);
+	for (int i = 0; i < n; i++) {
+		if (strcmp(m_tracks[i].trackId, trackId) == 0)
+			return &m_tracks[i];
+	}
+
+	// not announced in SDP, the server sessions have no such track either
+	if (m_stats->unknown.fetch_add(1, std::memory_order_relaxed) == 0)
+		DPRINTF("unknown track %s, packets dropped\n", trackId);
+	return NULL;
+}
+
+RTSPLiveStreamer::RelayTrack* RTSPLiveStreamer::addTrack(const char *trackId, int codec)
+{
+	std::lock_guard<std::mutex> lock(m_trackLock);
+
+	int n = m_nTracks.load(std::memory_order_relaxed);
+	for (int i = 0; i < n; i++) {
+		if (strcmp(m_tracks[i].trackId, trackId) == 0)
+			return &m_tracks[i];
+	}
+
+	if (n >= RELAY_MAX_TRACKS) {
+		DPRINTF("too many tracks, drop track %s\n", trackId);
+		return NULL;
+	}
+
+	RelayTrack &track = m_tracks[n];
+	strncpy(track.trackId, trackId, sizeof(track.trackId) - 1);
+	track.codec = codec;
+	track.rtp = new RtpRelayRing(codec == RELAY_CODEC_OTHER ? m_nOtherCapacity : m_nVideoCapacity);
+	track.rtcp = new RtpRelayRing(RELAY_RTCP_CAPACITY);
+	m_nTracks.store(n + 1, std::memory_order_release);
+	m_stats->tracks.store(n + 1, std::memory_order_relaxed);
+	return &track;
+}
+
+void RTSPLiveStreamer::clearTracks()
+{
+	std::lock_guard<std::mutex> lock(m_trackLock);
+
+	int n = m_nTracks.load(std::memory_order_relaxed);
+	m_nTracks.store(0, std::memory_order_release);
+	m_stats->tracks.store(0, std::memory_order_relaxed);
+	for (int i = 0; i < n; i++) {
+		delete m_tracks[i].rtp;
+		delete m_tracks[i].rtcp;
+	}
+	memset(m_tracks, 0, sizeof(m_tracks));
+}
+
+bool RTSPLiveStreamer::isKeyStart(int codec, const char *buf, int len)
+{
+	if (codec == RELAY_CODEC_OTHER)
+		return true;
+
+	const unsigned char *pkt = (const unsigned char *)buf;
+	if (len < 12)
+		return false;
+
+	// skip rtp header, csrc list and header extension
+	int offset = 12 + (pkt[0] & 0x0f) * 4;
+	if ((pkt[0] & 0x10) && len >= offset + 4)
+		offset += 4 + ((pkt[offset + 2] << 8) | pkt[offset + 3]) * 4;
+	if (len < offset + 3)
+		return false;
+
+	const unsigned char *payload = pkt + offset;
+	int payloadLen = len - offset;
+
+	if (codec == RELAY_CODEC_H264) {
+		int type = payload[0] & 0x1f;
+		if (type == 24 && payloadLen > 3)		// STAP-A, first nal
+			type = payload[3] & 0x1f;
+		else if (type == 28)					// FU-A, start fragment only
+			type = (payload[1] & 0x80) ? (payload[1] & 0x1f) : 0;
+		return type == 5 || type == 7 || type == 8;
+	}
+
+	int type = (payload[0] >> 1) & 0x3f;
+	if (type == 48 && payloadLen > 4)			// AP, first nal
+		type = (payload[4] >> 1) & 0x3f;
+	else if (type == 49)						// FU, start fragment only
+		type = (payload[2] & 0x80) ? (payload[2] & 0x3f) : 0;
+	return (type >= 16 && type <= 21) || (type >= 32 && type <= 34);
+}
+
+void RTSPLiveStreamer::wakeSender()
+{
+	// pairs with the fence in senderLoop: either the sender sees the packet
+	// before parking, or this thread sees it parked. No lock or syscall
+	// on the receive thread unless the sender is parked
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_bSenderIdle.load(std::memory_order_relaxed) && m_bSenderIdle.exchange(false)) {
+		// the sender holds the lock until it waits, so the notify is not lost
+		std::lock_guard<std::mutex> lock(m_senderLock);
+		m_senderCond.notify_one();
+	}
+}
+
+void RTSPLiveStreamer::startSender()
+{
+	if (m_bSending)
+		return;
+
+	m_bSending = true;
+	m_sender = std::thread(&RTSPLiveStreamer::senderLoop, this);
+}
+
+void RTSPLiveStreamer::stopSender()
+{
+	if (!m_bSending)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_senderLock);
+		m_bSending = false;
+	}
+	m_senderCond.notify_one();
+	if (m_sender.joinable())
+		m_sender.join();
+}
+
+void RTSPLiveStreamer::senderLoop()
+{
+	while (m_bSending) {
+		int sent = 0;
+		int n = m_nTracks.load(std::memory_order_acquire);
+
+		{
+			// one lock per round instead of per packet
+			std::lock_guard<std::mutex> lock(m_sessionLock);
+			for (int i = 0; i < n; i++) {
+				RelayTrack &track = m_tracks[i];
+				RtpRelayRing::Slot *slot;
+
+				for (int k = 0; k < RELAY_BATCH_SIZE && (slot = track.rtcp->front()) != NULL; k++) {
+					for (size_t s = 0; s < m_serverSessions.size(); s++)
+						m_serverSessions[s]->sendClientRtcp(track.trackId, slot->data, slot->len);
+					track.rtcp->pop();
+					sent++;
+				}
+
+				for (int k = 0; k < RELAY_BATCH_SIZE && (slot = track.rtp->front()) != NULL; k++) {
+					for (size_t s = 0; s < m_serverSessions.size(); s++)
+						m_serverSessions[s]->sendClientRtp(track.trackId, slot->data, slot->len);
+					track.rtp->pop();
+					sent++;
+				}
+			}
+		}
+
+		if (sent > 0) {
+			m_stats->forwarded.fetch_add(sent, std::memory_order_relaxed);
+			continue;
+		}
+
+		// park until wakeSender, checking the rings again after announcing it
+		std::unique_lock<std::mutex> lock(m_senderLock);
+		m_bSenderIdle = true;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool pending = false;
+		for (int i = 0; i < n && !pending; i++)
+			pending = m_tracks[i].rtp->size() > 0 || m_tracks[i].rtcp->size() > 0;
+		if (!pending)
+			m_senderCond.wait(lock, [this] { return !m_bSenderIdle || !m_bSending; });
+		m_bSenderIdle = false;
+	}
 }
 
 char* RTSPLiveStreamer::checkControlPath(const char *controlPath)
@@ -1,9 +1,31 @@
 #ifndef __RTSP_LIVE_STREAMER_H__
 #define __RTSP_LIVE_STREAMER_H__
 
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
 #include "RTSPClient.h"
 #include "ServerMediaSession.h"
 #include "RTSPServer.h"
+#include "RtpRelayRing.h"
+#include "../metrics.hpp"
+
+#define RELAY_MAX_TRACKS		(8)
+#define RELAY_VIDEO_CAPACITY	(1024)	// rtp packets per H.264/H.265 track, ~1.5MB
+#define RELAY_OTHER_CAPACITY	(128)	// rtp packets per track of other codecs, e.g. audio
+#define RELAY_RTCP_CAPACITY		(64)
+#define RELAY_BATCH_SIZE		(64)	// packets forwarded per track per round
+
+typedef enum {
+	RELAY_CODEC_OTHER	= 0,	// every packet is a valid restart point
+	RELAY_CODEC_H264	= 1,
+	RELAY_CODEC_H265	= 2
+} RELAY_CODEC;
 
 typedef enum {
 	STREAMER_STATE_STOPPED	= 0,
@@ -24,6 +46,25 @@ public:
 	int run();
 	void close();
 
+	// publish the running upstream under another server session name
+	int addSession(const char *sessionName);
+	void removeSession(const char *sessionName);
+	int sessionCount();
+
+	// clients that set up (positive) or tore down (negative) on each server
+	// session since the last call, from the sessions' reference counts the
+	// server keeps for its client sessions
+	void viewerChanges(std::vector<std::pair<std::string, int> > &changes);
+
+	// rtp ring sizes in packets, for the tracks created by the next run()
+	void setRelayCapacity(int video, int other);
+
+	// packets dropped by the relay rings since run()
+	unsigned long long droppedPackets() { return m_stats->dropped.load(std::memory_order_relaxed); }
+
+	// packets of tracks the SDP did not announce, not forwarded
+	unsigned long long unknownPackets() { return m_stats->unknown.load(std::memory_order_relaxed); }
+
 protected:
 	static void onRtpReceived(void *arg, const char *trackId, char *buf, int len);
 	void onRtpReceived1(const char *trackId, char *buf, int len);
@@ -34,14 +75,68 @@ protected:
 protected:
 	char* checkControlPath(const char *controlPath);
 	char* updateSdpLines(const char *sdpLines, const char *orgControlPath, const char *newControlPath);
+	ServerMediaSession* createServerSession(const char *sessionName);
+
+	/*
+	 * Received packets go through a per track ring to a sender thread,
+	 * so a slow downstream never stalls the upstream receive thread.
+	 */
+	struct RelayTrack {
+		char			trackId[64];	// control path as published by the server session
+		int				codec;		// RELAY_CODEC
+		RtpRelayRing*	rtp;
+		RtpRelayRing*	rtcp;
+	};
+
+	/*
+	 * Published as metrics family "rtsp_relay" under the session name
+	 * while running, counters restart with every run().
+	 */
+	struct RelayStats {
+		std::atomic<int>	sessions;
+		std::atomic<int>	tracks;
+		std::atomic<unsigned long long>	received;	// receive thread
+		std::atomic<unsigned long long>	dropped;	// receive thread
+		std::atomic<unsigned long long>	unknown;	// receive thread
+		std::atomic<unsigned long long>	forwarded;	// sender thread, once per packet for all sessions
+
+		RelayStats() : sessions(0), tracks(0), received(0), dropped(0), unknown(0), forwarded(0) {}
+	};
+
+	void resetStats();
+	void publishStats();
+
+	RelayTrack* findTrack(const char *trackId);
+	RelayTrack* addTrack(const char *trackId, int codec);
+	void clearTracks();
+	static bool isKeyStart(int codec, const char *buf, int len);
+	void wakeSender();
+	void startSender();
+	void stopSender();
+	void senderLoop();
 
 protected:
 	RTSPClient*		m_pRtspClient;
 	STREAMER_STATE	m_nState;
 
-	ServerMediaSession*	m_pServerSession;
+	std::vector<ServerMediaSession*>	m_serverSessions;
+	std::map<ServerMediaSession*, unsigned>	m_sessionViewers;	// reference count at the last viewerChanges()
+	std::mutex			m_sessionLock;
 	RTSPServer*			m_pRtspServer;
 	char*				m_pSessionName;
+
+	RelayTrack			m_tracks[RELAY_MAX_TRACKS];
+	std::atomic<int>	m_nTracks;
+	std::mutex			m_trackLock;		// track registration only
+	int					m_nVideoCapacity;
+	int					m_nOtherCapacity;
+	ax::MetricsSource<RelayStats>	m_stats;
+
+	std::thread			m_sender;
+	std::atomic<bool>	m_bSending;
+	std::atomic<bool>	m_bSenderIdle;
+	std::mutex			m_senderLock;
+	std::condition_variable	m_senderCond;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include "RelayManager.h"
+#include "RTSPCommonEnv.h"
+
+#define RELAY_DEFAULT_IDLE_TIMEOUT	(10000)
+#define RELAY_HOUSEKEEPING_INTERVAL	(1000)
+
+RelayManager* RelayManager::instance()
+{
+	static RelayManager manager;
+	return &manager;
+}
+
+RelayManager::RelayManager() : m_nIdleTimeout(RELAY_DEFAULT_IDLE_TIMEOUT), m_bRunning(false)
+{
+}
+
+RelayManager::~RelayManager()
+{
+	stop();
+}
+
+int RelayManager::addRelay(const char *url, const char *sessionName, int stream_type)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	std::map<std::string, std::string>::iterator it = m_sessions.find(sessionName);
+	if (it != m_sessions.end()) {
+		if (it->second == url)
+			return 0;
+		DPRINTF("session %s already relays %s\n", sessionName, it->second.c_str());
+		return -1;
+	}
+
+	UpstreamPtr &up = m_upstreams[url];
+	if (!up) {
+		up = std::make_shared<Upstream>();
+		up->url = url;
+		up->streamType = stream_type;
+		up->streamer = NULL;
+		up->totalViewers = 0;
+		up->idleSince = std::chrono::steady_clock::now();
+	}
+
+	up->viewers[sessionName] = 0;
+	m_sessions[sessionName] = url;
+	return 0;
+}
+
+void RelayManager::removeRelay(const char *sessionName)
+{
+	UpstreamPtr up = findUpstream(sessionName);
+	if (!up)
+		return;
+
+	std::lock_guard<std::mutex> connectLock(up->connectLock);
+	bool last = false;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		std::map<std::string, int>::iterator it = up->viewers.find(sessionName);
+		if (it != up->viewers.end()) {
+			up->totalViewers -= it->second;
+			up->viewers.erase(it);
+		}
+		m_sessions.erase(sessionName);
+
+		if (up->viewers.empty()) {
+			m_upstreams.erase(up->url);
+			last = true;
+		}
+	}
+
+	if (last) {
+		disconnect(up.get());
+	} else if (up->streamer && up->published.erase(sessionName)) {
+		up->streamer->removeSession(sessionName);
+	}
+}
+
+int RelayManager::acquire(const char *sessionName)
+{
+	UpstreamPtr up;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		std::map<std::string, std::string>::iterator it = m_sessions.find(sessionName);
+		if (it == m_sessions.end())
+			return -1;
+		up = m_upstreams[it->second];
+		up->viewers[sessionName]++;
+		up->totalViewers++;
+	}
+
+	// connecting may take seconds, only viewers of the same url wait for it
+	std::lock_guard<std::mutex> connectLock(up->connectLock);
+	int ret = 0;
+	if (!up->streamer) {
+		ret = connect(up.get(), sessionName);
+	} else if (up->published.find(sessionName) == up->published.end()) {
+		ret = up->streamer->addSession(sessionName);
+		if (ret == 0)
+			up->published.insert(sessionName);
+	}
+
+	if (ret < 0) {
+		std::lock_guard<std::mutex> lock(m_lock);
+		up->viewers[sessionName]--;
+		if (--up->totalViewers == 0)
+			up->idleSince = std::chrono::steady_clock::now();
+	}
+	return ret;
+}
+
+void RelayManager::release(const char *sessionName)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	std::map<std::string, std::string>::iterator it = m_sessions.find(sessionName);
+	if (it == m_sessions.end())
+		return;
+
+	UpstreamPtr &up = m_upstreams[it->second];
+	int &viewers = up->viewers[sessionName];
+	if (viewers <= 0)
+		return;
+
+	viewers--;
+	if (--up->totalViewers == 0)
+		up->idleSince = std::chrono::steady_clock::now();
+}
+
+int RelayManager::upstreamCount()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_upstreams.size();
+}
+
+int RelayManager::connectedCount()
+{
+	std::vector<UpstreamPtr> ups;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		for (std::map<std::string, UpstreamPtr>::iterator it = m_upstreams.begin(); it != m_upstreams.end(); ++it)
+			ups.push_back(it->second);
+	}
+
+	int count = 0;
+	for (size_t i = 0; i < ups.size(); i++) {
+		std::lock_guard<std::mutex> connectLock(ups[i]->connectLock);
+		if (ups[i]->streamer)
+			count++;
+	}
+	return count;
+}
+
+int RelayManager::viewerCount(const char *url)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	std::map<std::string, UpstreamPtr>::iterator it = m_upstreams.find(url);
+	if (it == m_upstreams.end())
+		return 0;
+	return it->second->totalViewers;
+}
+
+void RelayManager::start()
+{
+	std::lock_guard<std::mutex> lock(m_threadLock);
+	if (m_bRunning)
+		return;
+
+	m_bRunning = true;
+	m_thread = std::thread(&RelayManager::housekeeping, this);
+}
+
+void RelayManager::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_threadLock);
+		if (!m_bRunning)
+			return;
+		m_bRunning = false;
+	}
+	m_cond.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+
+	std::vector<UpstreamPtr> ups;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		for (std::map<std::string, UpstreamPtr>::iterator it = m_upstreams.begin(); it != m_upstreams.end(); ++it)
+			ups.push_back(it->second);
+	}
+
+	for (size_t i = 0; i < ups.size(); i++) {
+		std::lock_guard<std::mutex> connectLock(ups[i]->connectLock);
+		disconnect(ups[i].get());
+	}
+}
+
+RelayManager::UpstreamPtr RelayManager::findUpstream(const char *sessionName)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	std::map<std::string, std::string>::iterator it = m_sessions.find(sessionName);
+	if (it == m_sessions.end())
+		return UpstreamPtr();
+	return m_upstreams[it->second];
+}
+
+// called with up->connectLock held
+int RelayManager::connect(Upstream *up, const std::string &sessionName)
+{
+	RTSPLiveStreamer *streamer = new RTSPLiveStreamer();
+
+	if (streamer->open(up->url.c_str(), up->streamType, sessionName.c_str()) < 0) {
+		DPRINTF("relay %s open failed\n", up->url.c_str());
+		delete streamer;
+		return -1;
+	}
+
+	if (streamer->run() < 0) {
+		DPRINTF("relay %s run failed\n", up->url.c_str());
+		streamer->close();
+		delete streamer;
+		return -1;
+	}
+
+	up->streamer = streamer;
+	up->published.insert(sessionName);
+	return 0;
+}
+
+// called with up->connectLock held
+void RelayManager::disconnect(Upstream *up)
+{
+	if (!up->streamer)
+		return;
+
+	up->streamer->close();
+	delete up->streamer;
+	up->streamer = NULL;
+	up->published.clear();
+}
+
+// rtsp clients set up or torn down on the published sessions since the last sync
+void RelayManager::syncViewers()
+{
+	std::vector<UpstreamPtr> ups;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		for (std::map<std::string, UpstreamPtr>::iterator it = m_upstreams.begin(); it != m_upstreams.end(); ++it)
+			ups.push_back(it->second);
+	}
+
+	ViewerChanges changes;
+	for (size_t i = 0; i < ups.size(); i++) {
+		std::lock_guard<std::mutex> connectLock(ups[i]->connectLock);
+		if (ups[i]->streamer)
+			ups[i]->streamer->viewerChanges(changes);
+	}
+	applyViewerChanges(changes);
+}
+
+// acquire() takes the connect lock, so no connect lock may be held here
+void RelayManager::applyViewerChanges(const ViewerChanges &changes)
+{
+	for (size_t i = 0; i < changes.size(); i++) {
+		const char *sessionName = changes[i].first.c_str();
+		for (int k = 0; k < changes[i].second; k++)
+			acquire(sessionName);
+		for (int k = 0; k > changes[i].second; k--)
+			release(sessionName);
+	}
+}
+
+void RelayManager::housekeeping()
+{
+	std::unique_lock<std::mutex> threadLock(m_threadLock);
+	while (m_bRunning) {
+		m_cond.wait_for(threadLock, std::chrono::milliseconds(RELAY_HOUSEKEEPING_INTERVAL));
+		if (!m_bRunning)
+			break;
+
+		threadLock.unlock();
+		syncViewers();
+
+		std::vector<UpstreamPtr> idle;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			for (std::map<std::string, UpstreamPtr>::iterator it = m_upstreams.begin(); it != m_upstreams.end(); ++it) {
+				UpstreamPtr &up = it->second;
+				if (up->totalViewers == 0 && now - up->idleSince >= std::chrono::milliseconds(m_nIdleTimeout))
+					idle.push_back(up);
+			}
+		}
+
+		ViewerChanges late;
+		for (size_t i = 0; i < idle.size(); i++) {
+			std::lock_guard<std::mutex> connectLock(idle[i]->connectLock);
+			if (!idle[i]->streamer)
+				continue;
+
+			// a viewer may have arrived since the scan, by acquire() or by setting up
+			size_t seen = late.size();
+			idle[i]->streamer->viewerChanges(late);
+			bool stillIdle = (late.size() == seen);
+			if (stillIdle) {
+				std::lock_guard<std::mutex> lock(m_lock);
+				stillIdle = (idle[i]->totalViewers == 0);
+			}
+			if (stillIdle) {
+				DPRINTF("relay %s idle, disconnect\n", idle[i]->url.c_str());
+				disconnect(idle[i].get());
+			}
+		}
+		applyViewerChanges(late);
+		threadLock.lock();
+	}
+}
@@ -0,0 +1,88 @@
+#ifndef __RELAY_MANAGER_H__
+#define __RELAY_MANAGER_H__
+
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+
+#include "RTSPLiveStreamer.h"
+
+/*
+ * Shares one upstream pull per url between any number of downstream
+ * server sessions. The upstream is connected when the first viewer
+ * acquires one of its sessions and closed once it has had no viewer
+ * for the idle timeout.
+ *
+ * Viewers come from two places. A session that is not published yet is
+ * requested with acquire(), e.g. by the handler giving out its address,
+ * and held until release(). RTSP clients setting up or tearing down on
+ * a published session are turned into acquire()/release() by the
+ * housekeeping thread, so start() must be called.
+ */
+class RelayManager
+{
+public:
+	static RelayManager* instance();
+
+	void setIdleTimeout(int timeout_ms) { m_nIdleTimeout = timeout_ms; }
+
+	// map a downstream session name to an upstream url, does not connect
+	int addRelay(const char *url, const char *sessionName, int stream_type = 0);
+	void removeRelay(const char *sessionName);
+
+	// viewer join/leave, the first acquire of an url opens the upstream
+	int acquire(const char *sessionName);
+	void release(const char *sessionName);
+
+	int upstreamCount();
+	int connectedCount();
+	int viewerCount(const char *url);
+
+	void start();
+	void stop();
+
+protected:
+	RelayManager();
+	virtual ~RelayManager();
+
+	struct Upstream {
+		std::string		url;
+		int				streamType;
+		RTSPLiveStreamer*	streamer;
+		std::set<std::string>		published;	// sessions created on the streamer
+		std::map<std::string, int>	viewers;	// session name -> viewer count
+		int				totalViewers;
+		std::chrono::steady_clock::time_point	idleSince;
+		std::mutex		connectLock;
+	};
+
+	typedef std::shared_ptr<Upstream> UpstreamPtr;
+
+	typedef std::vector<std::pair<std::string, int> > ViewerChanges;
+
+	UpstreamPtr findUpstream(const char *sessionName);
+	int connect(Upstream *up, const std::string &sessionName);
+	void disconnect(Upstream *up);
+	void syncViewers();
+	void applyViewerChanges(const ViewerChanges &changes);
+	void housekeeping();
+
+protected:
+	std::map<std::string, UpstreamPtr>	m_upstreams;	// url -> upstream
+	std::map<std::string, std::string>	m_sessions;		// session name -> url
+	std::mutex			m_lock;
+
+	int					m_nIdleTimeout;
+	bool				m_bRunning;
+	std::thread			m_thread;
+	std::mutex			m_threadLock;
+	std::condition_variable	m_cond;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef __RTP_RELAY_RING_H__
+#define __RTP_RELAY_RING_H__
+
+#include <atomic>
+#include <string.h>
+
+#define RTP_RELAY_MAX_PACKET	(1500)
+
+/*
+ * Bounded single producer / single consumer ring of RTP packets.
+ * The producer (upstream receive thread) never blocks: when the ring is
+ * full the packet is dropped and so is everything after it until the
+ * next packet that starts a key frame, so the downstream never gets a
+ * partial GOP.
+ */
+class RtpRelayRing
+{
+public:
+	struct Slot {
+		int		len;
+		char	data[RTP_RELAY_MAX_PACKET];
+	};
+
+	// capacity is rounded up to a power of two
+	RtpRelayRing(unsigned int capacity) : m_head(0), m_tail(0), m_bDropping(false), m_nDropped(0)
+	{
+		m_nCapacity = 1;
+		while (m_nCapacity < capacity)
+			m_nCapacity <<= 1;
+		m_nMask = m_nCapacity - 1;
+		m_pSlots = new Slot[m_nCapacity];
+	}
+
+	~RtpRelayRing()
+	{
+		delete[] m_pSlots;
+	}
+
+	// producer side, keyStart: packet begins a key frame (or is independently decodable)
+	bool push(const char *buf, int len, bool keyStart)
+	{
+		if (len <= 0 || len > RTP_RELAY_MAX_PACKET) {
+			m_nDropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		unsigned int tail = m_tail.load(std::memory_order_relaxed);
+		bool full = (tail - m_head.load(std::memory_order_acquire)) >= m_nCapacity;
+
+		if (m_bDropping && keyStart && !full)
+			m_bDropping = false;
+
+		if (full || m_bDropping) {
+			m_bDropping = true;
+			m_nDropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		Slot &slot = m_pSlots[tail & m_nMask];
+		memcpy(slot.data, buf, len);
+		slot.len = len;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, returns NULL when empty, pop() after the slot is consumed
+	Slot* front()
+	{
+		unsigned int head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return NULL;
+		return &m_pSlots[head & m_nMask];
+	}
+
+	void pop()
+	{
+		m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	unsigned int size() const { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+	unsigned int capacity() const { return m_nCapacity; }
+	unsigned long long dropped() const { return m_nDropped.load(std::memory_order_relaxed); }
+
+protected:
+	Slot*			m_pSlots;
+	unsigned int	m_nCapacity;
+	unsigned int	m_nMask;
+
+	// head and tail on separate cache lines, the ring is heap allocated so padding instead of alignas
+	char			m_pad0[64];
+	std::atomic<unsigned int>	m_head;		// written by consumer
+	char			m_pad1[64];
+	std::atomic<unsigned int>	m_tail;		// written by producer
+	bool			m_bDropping;			// producer only
+	std::atomic<unsigned long long>	m_nDropped;
+};
+
+#endif
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+
+#include "buffer_pool.hpp"
+#include "codec/video_decoder.hpp"
+
+namespace ax
+{
+    enum PixelFormat
+    {
+        PIXEL_FORMAT_NV12 = 0,      // Y plane, interleaved UV plane at half height
+        PIXEL_FORMAT_BGR,
+        PIXEL_FORMAT_RGB,
+        PIXEL_FORMAT_GRAY
+    };
+
+    /// @brief Image payload passed between nodes, NV12 straight from the decoder
+    ///     or packed BGR/RGB/GRAY.
+    /// @details Planes are described by pointer, physical address and stride,
+    ///     so rows may be padded and the UV plane need not follow Y. Copies
+    ///     share the pixels: buffer keeps them alive and gives them back to
+    ///     their owner (decoder, BufferPool...) with the last copy. crop
+    ///     returns a view into the same pixels. phy_addr is 0 for memory the
+    ///     hardware can not see.
+    struct VideoFrame
+    {
+        static const int MAX_PLANES = 2;
+
+        int format;
+        int width;
+        int height;
+        uint8_t* data[MAX_PLANES];
+        uint64_t phy_addr[MAX_PLANES];
+        int stride[MAX_PLANES];     // bytes per row
+        uint64_t pts;
+        std::shared_ptr<void> buffer;
+
+        VideoFrame():
+            format(PIXEL_FORMAT_NV12),
+            width(0),
+            height(0),
+            pts(0)
+        {
+            memset(data, 0, sizeof(data));
+            memset(phy_addr, 0, sizeof(phy_addr));
+            memset(stride, 0, sizeof(stride));
+        }
+
+        bool valid() const { return data[0] && width > 0 && height > 0; }
+
+        int planes() const { return format == PIXEL_FORMAT_NV12 ? 2 : 1; }
+
+        /// @brief bytes per pixel of plane 0, 1 for NV12 luma
+        static int PixelBytes(int format)
+        {
+            return (format == PIXEL_FORMAT_BGR || format == PIXEL_FORMAT_RGB) ? 3 : 1;
+        }
+
+        /// @brief stride the frames made here use, NV12 rows are 16 byte aligned like VDEC output
+        static int DefaultStride(int format, int width)
+        {
+            return format == PIXEL_FORMAT_NV12 ? (width + 15) / 16 * 16 : width * PixelBytes(format);
+        }
+
+        /// @brief bytes of a contiguous frame, UV right after Y for NV12
+        static size_t BufferSize(int format, int height, int stride)
+        {
+            return format == PIXEL_FORMAT_NV12 ? (size_t)stride * height * 3 / 2 : (size_t)stride * height;
+        }
+
+        int plane_height(int plane) const { return plane == 0 ? height : height / 2; }
+
+        /// @brief bytes of pixels in one row of the plane, without padding
+        int row_bytes(int plane) const { return plane == 0 ? width * PixelBytes(format) : width; }
+
+        /// @brief UV plane directly follows Y with the same stride, rows may be padded
+        bool one_block() const
+        {
+            return format != PIXEL_FORMAT_NV12 ||
+                (stride[1] == stride[0] && data[1] == data[0] + (size_t)stride[0] * height);
+        }
+
+        /// @brief rows without padding and planes back to back, BufferSize bytes at data[0]
+        /// @details false for crops narrower than their frame, their last row ends
+        ///     before the stride does
+        bool contiguous() const
+        {
+            for (int p = 0; p < planes(); p++)
+            {
+                if (stride[p] != row_bytes(p))
+                    return false;
+            }
+            return one_block();
+        }
+
+        /// @brief describe a contiguous frame at data, UV at stride * height for NV12
+        /// @param owner released with the last copy of the frame
+        static VideoFrame Wrap(int format, int width, int height, uint8_t* data, int stride,
+            std::shared_ptr<void> owner, uint64_t phy_addr = 0)
+        {
+            VideoFrame frame;
+            frame.format = format;
+            frame.width = width;
+            frame.height = height;
+            frame.data[0] = data;
+            frame.phy_addr[0] = phy_addr;
+            frame.stride[0] = stride;
+            if (format == PIXEL_FORMAT_NV12)
+            {
+                size_t offset = (size_t)stride * height;
+                frame.data[1] = data + offset;
+                frame.phy_addr[1] = phy_addr ? phy_addr + offset : 0;
+                frame.stride[1] = stride;
+            }
+            frame.buffer = std::move(owner);
+            return frame;
+        }
+
+        /// @brief describe an NV12 frame of the decoder, owner gives it back to the decoder
+        static VideoFrame FromDecoded(const DecodedFrame& decoded, std::shared_ptr<void> owner)
+        {
+            VideoFrame frame = Wrap(PIXEL_FORMAT_NV12, decoded.width, decoded.height,
+                (uint8_t*)decoded.vir_addr, decoded.stride, std::move(owner), decoded.phy_addr);
+            if (decoded.uv_vir_addr)
+            {
+                frame.data[1] = (uint8_t*)decoded.uv_vir_addr;
+                frame.phy_addr[1] = decoded.uv_phy_addr;
+                frame.stride[1] = decoded.uv_stride ? decoded.uv_stride : decoded.stride;
+            }
+            frame.pts = decoded.pts;
+            return frame;
+        }
+
+        /// @brief the NV12 frame as encoder input, pixels stay owned by this frame
+        DecodedFrame to_decoded() const
+        {
+            DecodedFrame decoded;
+            memset(&decoded, 0, sizeof(decoded));
+            decoded.width = width;
+            decoded.height = height;
+            decoded.stride = stride[0];
+            decoded.size = (uint32_t)BufferSize(format, height, stride[0]);
+            decoded.phy_addr = phy_addr[0];
+            decoded.vir_addr = data[0];
+            decoded.pts = pts;
+            decoded.uv_stride = stride[1];
+            decoded.uv_phy_addr = phy_addr[1];
+            decoded.uv_vir_addr = data[1];
+            return decoded;
+        }
+
+        /// @brief a frame in a buffer of the pool, invalid if none is free or it is too small
+        /// @param timeout milliseconds, see BufferPool::Get
+        static VideoFrame Allocate(BufferPool& pool, int format, int width, int height, int timeout = 0)
+        {
+            int stride = DefaultStride(format, width);
+            if (pool.size() < BufferSize(format, height, stride))
+                return VideoFrame();
+            std::shared_ptr<uint8_t> buffer = pool.Get(timeout);
+            if (!buffer)
+                return VideoFrame();
+            uint8_t* data = buffer.get();
+            return Wrap(format, width, height, data, stride, std::move(buffer));
+        }
+
+        /// @brief a frame on its own heap buffer, for the cases a pool does not fit
+        static VideoFrame Allocate(int format, int width, int height)
+        {
+            int stride = DefaultStride(format, width);
+            void* ptr = nullptr;
+            if (posix_memalign(&ptr, 64, BufferSize(format, height, stride)) != 0)
+                return VideoFrame();
+            std::shared_ptr<uint8_t> buffer((uint8_t*)ptr, free);
+            return Wrap(format, width, height, (uint8_t*)ptr, stride, std::move(buffer));
+        }
+
+        /// @brief view of a rectangle, shares the pixels, invalid if it leaves the frame
+        /// @details NV12 needs even x, y, w, h, chroma is subsampled by two
+        VideoFrame crop(int x, int y, int w, int h) const
+        {
+            if (x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > width || y + h > height)
+                return VideoFrame();
+            if (format == PIXEL_FORMAT_NV12 && ((x | y | w | h) & 1))
+                return VideoFrame();
+
+            VideoFrame view = *this;
+            view.width = w;
+            view.height = h;
+            size_t offset = (size_t)y * stride[0] + (size_t)x * PixelBytes(format);
+            view.data[0] += offset;
+            if (phy_addr[0])
+                view.phy_addr[0] += offset;
+            if (format == PIXEL_FORMAT_NV12)
+            {
+                // UV每行交错, 横向偏移与亮度相同, 纵向减半
+                size_t uv_offset = (size_t)(y / 2) * stride[1] + x;
+                view.data[1] += uv_offset;
+                if (phy_addr[1])
+                    view.phy_addr[1] += uv_offset;
+            }
+            return view;
+        }
+
+        /// @brief copy the pixels into dst, which must have the same format and size
+        bool copy_to(VideoFrame& dst) const
+        {
+            if (dst.format != format || dst.width != width || dst.height != height)
+                return false;
+            for (int p = 0; p < planes(); p++)
+            {
+                int rows = plane_height(p);
+                int bytes = row_bytes(p);
+                if (stride[p] == bytes && dst.stride[p] == bytes)
+                {
+                    memcpy(dst.data[p], data[p], (size_t)bytes * rows);
+                    continue;
+                }
+                for (int r = 0; r < rows; r++)
+                    memcpy(dst.data[p] + (size_t)r * dst.stride[p], data[p] + (size_t)r * stride[p], bytes);
+            }
+            dst.pts = pts;
+            return true;
+        }
+    };
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "video_frame.hpp"
+
+#include "opencv2/opencv.hpp"
+
+namespace utils
+{
+    /// @brief cv::Mat over one plane of the frame, no copy
+    /// @details valid while the frame (or a copy of it) is held, the Mat
+    ///     does not keep the pixels alive. NV12 plane 1 is CV_8UC2 UV pairs.
+    inline cv::Mat plane_mat(const ax::VideoFrame& frame, int plane)
+    {
+        if (!frame.valid() || plane < 0 || plane >= frame.planes())
+            return cv::Mat();
+        int type = CV_8UC1;
+        if (frame.format == ax::PIXEL_FORMAT_BGR || frame.format == ax::PIXEL_FORMAT_RGB)
+            type = CV_8UC3;
+        else if (plane == 1)
+            type = CV_8UC2;
+        int cols = plane == 1 ? frame.width / 2 : frame.width;
+        return cv::Mat(frame.plane_height(plane), cols, type, frame.data[plane], frame.stride[plane]);
+    }
+
+    /// @brief the whole frame as one Mat, NV12 as height * 3 / 2 rows of CV_8UC1
+    /// @details no copy if UV follows Y, cropped NV12 frames are copied
+    inline cv::Mat to_mat(const ax::VideoFrame& frame)
+    {
+        if (frame.format != ax::PIXEL_FORMAT_NV12 || !frame.valid())
+            return plane_mat(frame, 0);
+        if (frame.one_block())
+            return cv::Mat(frame.height * 3 / 2, frame.width, CV_8UC1, frame.data[0], frame.stride[0]);
+
+        cv::Mat mat(frame.height * 3 / 2, frame.width, CV_8UC1);
+        plane_mat(frame, 0).copyTo(mat.rowRange(0, frame.height));
+        cv::Mat uv = plane_mat(frame, 1);
+        uv.reshape(1).copyTo(mat.rowRange(frame.height, frame.height * 3 / 2));
+        return mat;
+    }
+
+    /// @brief frame over the Mat's pixels, no copy, the frame holds a reference to them
+    /// @param format PIXEL_FORMAT_NV12 for height * 3 / 2 rows of CV_8UC1
+    inline ax::VideoFrame from_mat(const cv::Mat& mat, int format)
+    {
+        int height = format == ax::PIXEL_FORMAT_NV12 ? mat.rows * 2 / 3 : mat.rows;
+        std::shared_ptr<cv::Mat> owner = std::make_shared<cv::Mat>(mat);
+        return ax::VideoFrame::Wrap(format, mat.cols, height, mat.data, (int)mat.step[0], owner);
+    }
+}
@@ -1,3 +1,5 @@
+#include "ax_pipeline.hpp"
+#include "hal/hal.hpp"
 #include "nodes/RTSPPullNode.hpp"
 
 #include <signal.h>
@@ -13,69 +15,86 @@ void sig_handler(int sig)
     }
 }
 
+class RTSPPullPipeline : public ax::AX_Pipeline
+{
+public:
+    RTSPPullPipeline(const Json::Value& config):
+        AX_Pipeline(config)
+    { }
+
+    int Init(const Json::Value& config)
+    {
+        for (auto& node : ax::RTSPPullNode::CreateChannels(config))
+        {
+            if (!AddNode(node))
+            {
+                printf("[%s]: init failed!\n", node->name());
+                return ax::AX_ERR_INIT_FAIL;
+            }
+        }
+        m_hasInit = true;
+        return ax::AX_SUCCESS;
+    }
+};
+
 int main(int argc, char** argv)
 {
     if (argc < 2)
     {
-        printf("Usage: rtsp_pull [rtsp_url]\n");
+        printf("Usage: rtsp_pull [rtsp_url] [rtsp_url ...]\n");
         return -1;
     }
 
     signal(SIGINT, sig_handler); 
 
-    int ret = AX_SUCCESS;
-    ret = AX_SYS_Init();
-    if (ret != AX_SUCCESS)
+    ax::MediaSystem& media_system = ax::hal::System();
+    int ret = media_system.Init();
+    if (ret != ax::AX_SUCCESS)
     {
-        printf("AX_SYS_Init failed! ret=0x%x\n", ret);
+        printf("system init failed! ret=0x%x\n", ret);
         return -1;
     }
 
-    AX_POOL_FLOORPLAN_T pool_plan = {0};
-    AX_POOL_CONFIG_T cmm_config = {0};
-    cmm_config.BlkSize = 1920 * 1080 * 3 / 2;
-    cmm_config.BlkCnt = 10;
-
-    memcpy(&pool_plan.CommPool[0], &cmm_config, sizeof(AX_POOL_CONFIG_T));
-
-    ret = AX_POOL_SetConfig(&pool_plan);
-    if (ret != AX_SUCCESS)
+    ax::PoolConfig cmm_config;
+    cmm_config.blk_size = 1920 * 1080 * 3 / 2;
+    cmm_config.blk_cnt = 10 * (argc - 1);
+    ret = media_system.InitPool({ cmm_config });
+    if (ret != ax::AX_SUCCESS)
     {
-        printf("AX_POOL_SetConfig failed! ret=0x%x\n", ret);
+        printf("pool init failed! ret=0x%x\n", ret);
         return -1;
     }
 
-    ret = AX_POOL_Init();
-    if (ret != AX_SUCCESS)
+    // 每个url一路, 各占一个解码组
+    Json::Value config;
+    for (int i = 1; i < argc; i++)
     {
-        printf("AX_POOL_Init failed! ret=0x%x\n", ret);
-        return -1;
+        Json::Value channel;
+        channel["rtsp_url"] = argv[i];
+        config["rtsp_pull"]["channels"].append(channel);
     }
 
-    const char* rtsp_url = argv[1];
-    Json::Value config;
-    config["rtsp_url"] = rtsp_url;
-
-    ax::RTSPPullNode node;
-    if (AX_SUCCESS != node.Init(config))
+    RTSPPullPipeline pipeline(config);
+    if (AX_SUCCESS != pipeline.Init(config) || AX_SUCCESS != pipeline.Start())
     {
-        printf("init failed!\n");
+        printf("start pipeline failed!\n");
         return -1;
     }
 
-    node.SetRunning();
-    node.Run();
-
     while(gIsRunnging)
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
 
-    node.Stop();
-    std::this_thread::sleep_for(std::chrono::seconds(3));
+    // 节点退出后才能释放内存池, 超时未退出的节点仍在使用VDEC
+    if (AX_SUCCESS != pipeline.Stop(3000))
+    {
+        printf("stop pipeline timeout, skip pool deinit\n");
+        return -1;
+    }
 
-    AX_POOL_Exit();
-    AX_SYS_Deinit();
+    media_system.ExitPool();
+    media_system.Deinit();
 
     printf("Exit\n");
     return 0;
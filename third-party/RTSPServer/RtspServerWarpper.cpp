@@ -172,9 +172,16 @@ int rtsp_push(rtsp_server_t rtsp_server, rtsp_session_t rtsp_session, rtsp_buffe
     }
     return -1;
 }
+
+int rtsp_get_client_stat(rtsp_server_t rtsp_server, rtsp_session_t rtsp_session, rtsp_client_stat_t *stats, int max_num)
+{
+    // xop server does not parse RTCP receiver reports
+    return 0;
+}
 #else
 #include "rtsp/inc/rtsp.h"
 #include "string"
+#include "string.h"
 #pragma message("build qingshui version rtsp server")
 rtsp_server_t rtsp_new_server(int port)
 {
@@ -209,4 +216,24 @@ int rtsp_push(rtsp_server_t rtsp_server, rtsp_session_t rtsp_session, rtsp_buffe
 {
     return rtsp_sever_tx_video(rtsp_server, rtsp_session, (const uint8_t *)buff->vbuff, buff->vlen, buff->vts);
 }
+
+int rtsp_get_client_stat(rtsp_server_t rtsp_server, rtsp_session_t rtsp_session, rtsp_client_stat_t *stats, int max_num)
+{
+    struct rtsp_client_stats st[16];
+    if (!stats)
+        return -1;
+    int num = rtsp_get_client_stats(rtsp_session, st, max_num < 16 ? max_num : 16);
+    for (int i = 0; i < num; i++)
+    {
+        memcpy(stats[i].peer_ip, st[i].peer_ip, sizeof(stats[i].peer_ip));
+        stats[i].packets_sent = st[i].packet_count;
+        stats[i].bytes_sent = st[i].octet_count;
+        stats[i].packets_dropped = st[i].packet_dropped;
+        stats[i].loss_permille = st[i].loss_permille;
+        stats[i].jitter_us = st[i].jitter_us;
+        stats[i].rtt_us = st[i].rtt_us;
+        stats[i].keyframe_only = (st[i].congestion_state == RTSP_CONGESTION_KEYFRAME_ONLY);
+    }
+    return num;
+}
 #endif
\ No newline at end of file
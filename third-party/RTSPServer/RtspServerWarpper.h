@@ -23,6 +23,18 @@ extern "C"
         unsigned long int ats;
     } rtsp_buffer_t;
 
+    typedef struct _rtsp_client_stat_t
+    {
+        char peer_ip[16];
+        unsigned int packets_sent;
+        unsigned int bytes_sent;
+        unsigned int packets_dropped; // skipped while the client is congested
+        unsigned int loss_permille;   // smoothed loss from RTCP receiver reports
+        unsigned int jitter_us;
+        unsigned int rtt_us;
+        int keyframe_only;
+    } rtsp_client_stat_t;
+
     typedef void *rtsp_server_t;
     typedef void *rtsp_session_t;
 
@@ -32,6 +44,8 @@ extern "C"
     void rtsp_rel_session(rtsp_server_t rtsp_server, rtsp_session_t rtsp_session);
 
     int rtsp_push(rtsp_server_t rtsp_server, rtsp_session_t rtsp_session, rtsp_buffer_t *buff);
+    // return num of playing clients filled, call it from the thread calling rtsp_push
+    int rtsp_get_client_stat(rtsp_server_t rtsp_server, rtsp_session_t rtsp_session, rtsp_client_stat_t *stats, int max_num);
 #if __cplusplus
 }
 #endif
@@ -29,6 +29,32 @@ enum rtsp_codec_id {
 typedef void * rtsp_demo_handle;
 typedef void * rtsp_session_handle;
 
+/*
+ * per client congestion state, driven by RTCP receiver reports
+ * */
+enum rtsp_congestion_state {
+	RTSP_CONGESTION_NONE = 0,			/*all video frames are sent*/
+	RTSP_CONGESTION_KEYFRAME_ONLY,		/*sustained loss, only key frames are sent*/
+};
+
+struct rtsp_client_stats {
+	char peer_ip[16];
+	int is_over_tcp;
+	uint32_t ssrc;
+	uint32_t packet_count;		/*rtp packets sent*/
+	uint32_t octet_count;		/*rtp payload octets sent*/
+	uint32_t packet_dropped;	/*rtp packets skipped by congestion control*/
+	uint32_t rr_count;			/*receiver report blocks received*/
+	uint32_t fraction_lost;		/*last reported fraction lost, 0-255 (lost/256)*/
+	uint32_t loss_permille;		/*smoothed loss rate, 0-1000*/
+	int32_t cumulative_lost;
+	uint32_t highest_seq;		/*extended highest sequence number received*/
+	uint32_t jitter;			/*interarrival jitter, rtp timestamp units*/
+	uint32_t jitter_us;
+	uint32_t rtt_us;			/*0 if unknown (no LSR yet)*/
+	int congestion_state;		/*enum rtsp_congestion_state*/
+};
+
 rtsp_demo_handle rtsp_new_demo (int port);
 rtsp_demo_handle create_rtsp_demo(int port);
 int rtsp_do_event (rtsp_demo_handle demo);
@@ -43,6 +69,18 @@ int rtsp_sever_tx_video (rtsp_demo_handle demo,rtsp_session_handle session, cons
 int rtsp_tx_video (rtsp_session_handle session, const uint8_t *frame, int len, uint64_t ts);
 int rtsp_tx_audio (rtsp_session_handle session, const uint8_t *frame, int len, uint64_t ts);
 void rtsp_del_session (rtsp_session_handle session);
+
+/*
+ * video stats of the playing clients of session, return num of clients filled.
+ * not thread safe against rtsp_do_event/rtsp_tx_video, call it from the same thread.
+ * */
+int rtsp_get_client_stats (rtsp_session_handle session, struct rtsp_client_stats *stats, int max_num);
+/*
+ * enable: 0 disable congestion control (all clients get full rate)
+ * enter_loss_permille: smoothed loss to downgrade a client to key frames only (default 100)
+ * leave_loss_permille: smoothed loss to restore full rate (default 20)
+ * */
+int rtsp_set_congestion_control (rtsp_session_handle session, int enable, int enter_loss_permille, int leave_loss_permille);
 void rtsp_del_demo (rtsp_demo_handle demo);
 
 uint64_t rtsp_get_reltime (void);
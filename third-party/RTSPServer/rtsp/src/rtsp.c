@@ -63,6 +63,11 @@ struct rtsp_session
 	rtp_enc artpe;
 	struct stream_queue *vstreamq;
 	struct stream_queue *astreamq;
+	uint8_t *vpktflags; // per vstreamq slot, RTP_PKT_FLAG_xxx
+
+	int cc_enable; // congestion control
+	int cc_enter_permille;
+	int cc_leave_permille;
 
 	uint64_t video_ntptime_of_zero_ts;
 	uint64_t audio_ntptime_of_zero_ts;
@@ -73,6 +78,14 @@ struct rtsp_session
 	demo_entry;
 };
 
+#define RTCP_SR_HISTORY (4)
+
+#define RTP_PKT_FLAG_KEY (0x01)
+
+#define RTCP_CC_ENTER_PERMILLE (100) // 10% smoothed loss
+#define RTCP_CC_LEAVE_PERMILLE (20)	 // 2% smoothed loss
+#define RTCP_CC_HOLD_REPORTS (3)	 // consecutive reports before changing state
+
 struct rtp_connection
 {
 	int is_over_tcp;
@@ -87,6 +100,26 @@ struct rtp_connection
 	uint32_t rtcp_packet_count;
 	uint32_t rtcp_octet_count;
 	uint64_t rtcp_last_ts;
+
+	// sent SRs, middle 32 bits of ntp timestamp and local send time (us), for RTT
+	uint32_t rtcp_sr_ntp[RTCP_SR_HISTORY];
+	uint64_t rtcp_sr_time[RTCP_SR_HISTORY];
+	int rtcp_sr_index;
+
+	// last receiver report block about this ssrc
+	uint32_t rr_count;
+	uint8_t rr_fraction_lost;
+	int32_t rr_cumulative_lost;
+	uint32_t rr_highest_seq;
+	uint32_t rr_jitter;
+	uint32_t rr_rtt_us;
+	uint32_t rr_loss_permille; // smoothed
+
+	// congestion state
+	int cc_state;	 // enum rtsp_congestion_state
+	int cc_counter;	 // consecutive reports beyond threshold
+	int cc_wait_key; // after leaving keyframe-only, skip until next key frame
+	uint32_t cc_packet_dropped;
 };
 
 #define RTSP_CC_STATE_INIT 0
@@ -433,6 +466,9 @@ rtsp_session_handle rtsp_new_session_internal(rtsp_demo_handle demo, const char
 	strncpy(s->path, path, sizeof(s->path) - 1);
 	s->vcodec_id = RTSP_CODEC_ID_NONE;
 	s->acodec_id = RTSP_CODEC_ID_NONE;
+	s->cc_enable = 1;
+	s->cc_enter_permille = RTCP_CC_ENTER_PERMILLE;
+	s->cc_leave_permille = RTCP_CC_LEAVE_PERMILLE;
 
 	dbg("add session path: %s\n", s->path);
 	return (rtsp_session_handle)s;
@@ -525,6 +561,17 @@ int rtsp_set_video(rtsp_session_handle session, int codec_id, const uint8_t *cod
 		}
 	}
 
+	if (!s->vpktflags)
+	{
+		s->vpktflags = (uint8_t *)calloc(1, s->vstreamq->nbpkts);
+		if (!s->vpktflags)
+		{
+			err("alloc memory for video rtp flags failed\n");
+			s->vcodec_id = RTSP_CODEC_ID_NONE;
+			return -1;
+		}
+	}
+
 	return 0;
 }
 
@@ -604,6 +651,8 @@ void rtsp_del_session(rtsp_session_handle session)
 			streamq_free(s->vstreamq);
 		if (s->astreamq)
 			streamq_free(s->astreamq);
+		if (s->vpktflags)
+			free(s->vpktflags);
 		__free_session(s);
 	}
 }
@@ -1254,12 +1303,14 @@ static int rtsp_recv_rtp_over_udp(struct rtsp_client_connection *cc, int isaudio
 	return len;
 }
 
+static int rtcp_process_frame(struct rtsp_client_connection *cc, int isaudio, const uint8_t *data, int len);
+
 static int rtsp_recv_rtcp_over_udp(struct rtsp_client_connection *cc, int isaudio)
 {
 	struct rtp_connection *rtp = isaudio ? cc->artp : cc->vrtp;
 	struct sockaddr_in inaddr;
 	SOCKLEN addrlen = sizeof(inaddr);
-	char szbuf[128];
+	char szbuf[1500];
 	int len;
 
 	len = recvfrom(rtp->udp_sockfd[1], szbuf, sizeof(szbuf), MSG_DONTWAIT, (struct sockaddr *)&inaddr, &addrlen);
@@ -1282,7 +1333,7 @@ static int rtsp_recv_rtcp_over_udp(struct rtsp_client_connection *cc, int isaudi
 		rtp->udp_peerport[1] = ntohs(inaddr.sin_port);
 	}
 
-	// TODO process rtcp frame
+	rtcp_process_frame(cc, isaudio, (const uint8_t *)szbuf, len);
 	return len;
 }
 
@@ -1353,6 +1404,7 @@ static int rtsp_tx_video_packet(struct rtsp_client_connection *cc)
 	uint8_t *ppacket = NULL;
 	int *ppktlen = NULL;
 	int count = 0;
+	int iskey;
 
 	/*dbg("index=%d head=%d tail=%d used=%d\n",
 		rtp->streamq_index,
@@ -1363,8 +1415,14 @@ static int rtsp_tx_video_packet(struct rtsp_client_connection *cc)
 	while (streamq_inused(q, rtp->streamq_index) > 0)
 	{
 		streamq_query(q, rtp->streamq_index, (char **)&ppacket, &ppktlen);
+		iskey = s->vpktflags[rtp->streamq_index] & RTP_PKT_FLAG_KEY;
 
-		if (*ppktlen > 0)
+		if (*ppktlen > 0 && !iskey && (rtp->cc_state == RTSP_CONGESTION_KEYFRAME_ONLY || rtp->cc_wait_key))
+		{
+			// congested client, only key frames are decodable for it
+			rtp->cc_packet_dropped++;
+		}
+		else if (*ppktlen > 0)
 		{
 			*((uint32_t *)(&ppacket[8])) = htonl(rtp->ssrc); // modify ssrc
 			if (rtp_tx_data(rtp, ppacket, *ppktlen) != *ppktlen)
@@ -1374,6 +1432,8 @@ static int rtsp_tx_video_packet(struct rtsp_client_connection *cc)
 
 			rtp->rtcp_packet_count++;
 			rtp->rtcp_octet_count += *ppktlen - 12; // XXX
+			if (iskey)
+				rtp->cc_wait_key = 0;
 		}
 		rtp->streamq_index = streamq_next(q, rtp->streamq_index);
 		count++;
@@ -1555,7 +1615,11 @@ int rtsp_do_event(rtsp_demo_handle demo)
 
 				if (reqmsg.type == RTSP_MSG_TYPE_INTERLEAVED)
 				{
-					// TODO process RTCP over TCP frame
+					int channel = reqmsg.hdrs.startline.interline.channel;
+					if (reqmsg.body.body && vrtp && vrtp->is_over_tcp && channel == vrtp->tcp_interleaved[1])
+						rtcp_process_frame(cc1, 0, (const uint8_t *)reqmsg.body.body, reqmsg.hdrs.startline.interline.length);
+					else if (reqmsg.body.body && artp && artp->is_over_tcp && channel == artp->tcp_interleaved[1])
+						rtcp_process_frame(cc1, 1, (const uint8_t *)reqmsg.body.body, reqmsg.hdrs.startline.interline.length);
 					rtsp_msg_free(&reqmsg);
 					continue;
 				}
@@ -1653,7 +1717,9 @@ int rtsp_tx_video(rtsp_session_handle session, const uint8_t *frame, int len, ui
 	uint8_t *packets[VRTP_MAX_NBPKTS + 1] = {NULL};
 	int pktsizs[VRTP_MAX_NBPKTS + 1] = {0};
 	int *pktlens[VRTP_MAX_NBPKTS] = {NULL};
+	int pktslots[VRTP_MAX_NBPKTS] = {0};
 	int i, index, count, start;
+	uint8_t pktflags = 0;
 
 	if (!s || !frame || s->vcodec_id == RTSP_CODEC_ID_NONE)
 		return -1;
@@ -1667,6 +1733,7 @@ int rtsp_tx_video(rtsp_session_handle session, const uint8_t *frame, int len, ui
 			streamq_pop(q);
 		streamq_query(q, index, (char **)&packets[i], &pktlens[i]);
 		pktsizs[i] = RTP_MAX_PKTSIZ;
+		pktslots[i] = index;
 		index = streamq_next(q, index);
 	}
 	packets[i] = NULL;
@@ -1757,9 +1824,16 @@ int rtsp_tx_video(rtsp_session_handle session, const uint8_t *frame, int len, ui
 		start = p - frame + size;
 	}
 
+	if ((s->vcodec_id == RTSP_CODEC_ID_VIDEO_H264 && rtsp_is_key_frame_h264(frame, len)) ||
+		(s->vcodec_id == RTSP_CODEC_ID_VIDEO_H265 && rtsp_is_key_frame_h265(frame, len)))
+	{
+		pktflags |= RTP_PKT_FLAG_KEY;
+	}
+
 	for (i = 0; i < count; i++)
 	{
 		*pktlens[i] = pktsizs[i];
+		s->vpktflags[pktslots[i]] = pktflags;
 		streamq_push(q);
 	}
 
@@ -1785,7 +1859,9 @@ int rtsp_sever_tx_video(rtsp_demo_handle demo, rtsp_session_handle session, cons
 	uint8_t *packets[VRTP_MAX_NBPKTS + 1] = {NULL};
 	int pktsizs[VRTP_MAX_NBPKTS + 1] = {0};
 	int *pktlens[VRTP_MAX_NBPKTS] = {NULL};
+	int pktslots[VRTP_MAX_NBPKTS] = {0};
 	int i, index, count, start;
+	uint8_t pktflags = 0;
 
 	if (!s || !frame || s->vcodec_id == RTSP_CODEC_ID_NONE)
 		return -1;
@@ -1799,6 +1875,7 @@ int rtsp_sever_tx_video(rtsp_demo_handle demo, rtsp_session_handle session, cons
 			streamq_pop(q);
 		streamq_query(q, index, (char **)&packets[i], &pktlens[i]);
 		pktsizs[i] = RTP_MAX_PKTSIZ;
+		pktslots[i] = index;
 		index = streamq_next(q, index);
 	}
 	packets[i] = NULL;
@@ -1889,9 +1966,16 @@ int rtsp_sever_tx_video(rtsp_demo_handle demo, rtsp_session_handle session, cons
 		start = p - frame + size;
 	}
 
+	if ((s->vcodec_id == RTSP_CODEC_ID_VIDEO_H264 && rtsp_is_key_frame_h264(frame, len)) ||
+		(s->vcodec_id == RTSP_CODEC_ID_VIDEO_H265 && rtsp_is_key_frame_h265(frame, len)))
+	{
+		pktflags |= RTP_PKT_FLAG_KEY;
+	}
+
 	for (i = 0; i < count; i++)
 	{
 		*pktlens[i] = pktsizs[i];
+		s->vpktflags[pktslots[i]] = pktflags;
 		streamq_push(q);
 	}
 
@@ -2154,6 +2238,186 @@ static int rtcp_try_tx_sr(struct rtp_connection *c, uint64_t ntptime_of_zero_ts,
 		}
 	}
 
+	c->rtcp_sr_ntp[c->rtcp_sr_index] = (ntpts_msw << 16) | (ntpts_lsw >> 16);
+	c->rtcp_sr_time[c->rtcp_sr_index] = rtsp_get_reltime();
+	c->rtcp_sr_index = (c->rtcp_sr_index + 1) % RTCP_SR_HISTORY;
+
 	c->rtcp_last_ts = ts;
 	return size;
 }
+
+static void rtcp_update_congestion(struct rtsp_session *s, struct rtsp_client_connection *cc, struct rtp_connection *c)
+{
+	if (!s->cc_enable)
+	{
+		c->cc_state = RTSP_CONGESTION_NONE;
+		c->cc_counter = 0;
+		return;
+	}
+
+	if (c->cc_state == RTSP_CONGESTION_NONE)
+	{
+		c->cc_counter = (c->rr_loss_permille >= (uint32_t)s->cc_enter_permille) ? c->cc_counter + 1 : 0;
+		if (c->cc_counter >= RTCP_CC_HOLD_REPORTS)
+		{
+			warn("client %s loss %u/1000, send key frames only\n", inet_ntoa(cc->peer_addr), c->rr_loss_permille);
+			c->cc_state = RTSP_CONGESTION_KEYFRAME_ONLY;
+			c->cc_counter = 0;
+		}
+	}
+	else
+	{
+		c->cc_counter = (c->rr_loss_permille <= (uint32_t)s->cc_leave_permille) ? c->cc_counter + 1 : 0;
+		if (c->cc_counter >= RTCP_CC_HOLD_REPORTS)
+		{
+			info("client %s loss %u/1000, restore full rate\n", inet_ntoa(cc->peer_addr), c->rr_loss_permille);
+			c->cc_state = RTSP_CONGESTION_NONE;
+			c->cc_counter = 0;
+			c->cc_wait_key = 1; // frames between key frames were skipped
+		}
+	}
+}
+
+// report block, see RFC3550 6.4.1
+static void rtcp_process_report_block(struct rtsp_client_connection *cc, struct rtp_connection *c, const uint8_t *rb)
+{
+	uint32_t lsr, dlsr, loss;
+	int32_t cumulative_lost;
+	int i;
+
+	if (ntohl(*((uint32_t *)&rb[0])) != c->ssrc)
+		return;
+
+	cumulative_lost = (rb[5] << 16) | (rb[6] << 8) | rb[7];
+	if (cumulative_lost & 0x800000)
+		cumulative_lost |= ~0xffffff; // 24bit signed
+
+	c->rr_count++;
+	c->rr_fraction_lost = rb[4];
+	c->rr_cumulative_lost = cumulative_lost;
+	c->rr_highest_seq = ntohl(*((uint32_t *)&rb[8]));
+	c->rr_jitter = ntohl(*((uint32_t *)&rb[12]));
+	lsr = ntohl(*((uint32_t *)&rb[16]));
+	dlsr = ntohl(*((uint32_t *)&rb[20]));
+
+	// rtt = now - send time of LSR - DLSR, DLSR is 1/65536 seconds
+	if (lsr)
+	{
+		for (i = 0; i < RTCP_SR_HISTORY; i++)
+		{
+			if (c->rtcp_sr_time[i] && c->rtcp_sr_ntp[i] == lsr)
+			{
+				uint64_t elapsed = rtsp_get_reltime() - c->rtcp_sr_time[i];
+				uint64_t delay = (uint64_t)dlsr * 1000000ULL / 65536;
+				c->rr_rtt_us = (uint32_t)(elapsed > delay ? elapsed - delay : 0);
+				break;
+			}
+		}
+	}
+
+	// smoothed loss, a single bad report does not change the state
+	loss = c->rr_fraction_lost * 1000 / 256;
+	if (c->rr_count == 1)
+		c->rr_loss_permille = loss;
+	else
+		c->rr_loss_permille = (c->rr_loss_permille * 3 + loss) / 4;
+}
+
+static int rtcp_process_frame(struct rtsp_client_connection *cc, int isaudio, const uint8_t *data, int len)
+{
+	struct rtp_connection *c = isaudio ? cc->artp : cc->vrtp;
+	int count = 0;
+
+	if (!c)
+		return 0;
+
+	// compound packet
+	while (len >= 4)
+	{
+		int v = data[0] >> 6;
+		int rc = data[0] & 0x1f;
+		int pt = data[1];
+		int size = (ntohs(*((uint16_t *)&data[2])) + 1) * 4;
+		const uint8_t *rb = NULL;
+		int i;
+
+		if (v != 2 || size > len)
+		{
+			dbg("invalid rtcp packet from %s\n", inet_ntoa(cc->peer_addr));
+			break;
+		}
+
+		if (pt == 200) // SR, report blocks follow the sender info
+			rb = data + 28;
+		else if (pt == 201) // RR
+			rb = data + 8;
+
+		for (i = 0; rb && i < rc && rb + 24 <= data + size; i++, rb += 24)
+		{
+			rtcp_process_report_block(cc, c, rb);
+			count++;
+		}
+
+		data += size;
+		len -= size;
+	}
+
+	if (count > 0 && !isaudio && cc->session)
+		rtcp_update_congestion(cc->session, cc, c);
+
+	return count;
+}
+
+int rtsp_get_client_stats(rtsp_session_handle session, struct rtsp_client_stats *stats, int max_num)
+{
+	struct rtsp_session *s = (struct rtsp_session *)session;
+	struct rtsp_client_connection *cc = NULL;
+	int num = 0;
+
+	if (!s || !stats || max_num <= 0)
+		return -1;
+
+	TAILQ_FOREACH(cc, &s->connections_qhead, session_entry)
+	{
+		struct rtp_connection *c = cc->vrtp;
+		struct rtsp_client_stats *st = &stats[num];
+		if (cc->state != RTSP_CC_STATE_PLAYING || !c)
+			continue;
+		if (num >= max_num)
+			break;
+
+		memset(st, 0, sizeof(*st));
+		strncpy(st->peer_ip, inet_ntoa(cc->peer_addr), sizeof(st->peer_ip) - 1);
+		st->is_over_tcp = c->is_over_tcp;
+		st->ssrc = c->ssrc;
+		st->packet_count = c->rtcp_packet_count;
+		st->octet_count = c->rtcp_octet_count;
+		st->packet_dropped = c->cc_packet_dropped;
+		st->rr_count = c->rr_count;
+		st->fraction_lost = c->rr_fraction_lost;
+		st->loss_permille = c->rr_loss_permille;
+		st->cumulative_lost = c->rr_cumulative_lost;
+		st->highest_seq = c->rr_highest_seq;
+		st->jitter = c->rr_jitter;
+		if (s->vrtpe.sample_rate)
+			st->jitter_us = (uint32_t)((uint64_t)c->rr_jitter * 1000000ULL / s->vrtpe.sample_rate);
+		st->rtt_us = c->rr_rtt_us;
+		st->congestion_state = c->cc_state;
+		num++;
+	}
+
+	return num;
+}
+
+int rtsp_set_congestion_control(rtsp_session_handle session, int enable, int enter_loss_permille, int leave_loss_permille)
+{
+	struct rtsp_session *s = (struct rtsp_session *)session;
+
+	if (!s || enter_loss_permille <= 0 || leave_loss_permille < 0 || leave_loss_permille >= enter_loss_permille)
+		return -1;
+
+	s->cc_enable = !!enable;
+	s->cc_enter_permille = enter_loss_permille;
+	s->cc_leave_permille = leave_loss_permille;
+	return 0;
+}
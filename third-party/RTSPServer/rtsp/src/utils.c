@@ -108,6 +108,44 @@ const uint8_t *rtsp_find_h264_h265_nalu(const uint8_t *buff, int len, int *size)
 	return s;
 }
 
+// return 1 if frame contains an IDR slice
+int rtsp_is_key_frame_h264(const uint8_t *frame, int len)
+{
+	const uint8_t *p = NULL;
+	int size = 0;
+
+	while (len > 0 && (p = rtsp_find_h264_h265_nalu(frame, len, &size)) != NULL)
+	{
+		const uint8_t *nal = (p[2] == 1) ? p + 3 : p + 4;
+		if (nal < p + size && (nal[0] & 0x1f) == 5)
+			return 1;
+		len -= (p - frame) + size;
+		frame = p + size;
+	}
+	return 0;
+}
+
+// return 1 if frame contains an IRAP (BLA/IDR/CRA) slice
+int rtsp_is_key_frame_h265(const uint8_t *frame, int len)
+{
+	const uint8_t *p = NULL;
+	int size = 0;
+
+	while (len > 0 && (p = rtsp_find_h264_h265_nalu(frame, len, &size)) != NULL)
+	{
+		const uint8_t *nal = (p[2] == 1) ? p + 3 : p + 4;
+		if (nal < p + size)
+		{
+			int type = (nal[0] >> 1) & 0x3f;
+			if (type >= 16 && type <= 21)
+				return 1;
+		}
+		len -= (p - frame) + size;
+		frame = p + size;
+	}
+	return 0;
+}
+
 const uint8_t *rtsp_find_aac_adts(const uint8_t *buff, int len, int *size)
 {
 	const uint8_t *s = buff;
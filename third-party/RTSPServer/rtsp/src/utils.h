@@ -44,6 +44,8 @@ extern "C"
 	};
 
 	const uint8_t *rtsp_find_h264_h265_nalu(const uint8_t *buff, int len, int *size);
+	int rtsp_is_key_frame_h264(const uint8_t *frame, int len);
+	int rtsp_is_key_frame_h265(const uint8_t *frame, int len);
 
 	int rtsp_codec_data_parse_from_user_h264(const uint8_t *codec_data, int data_len, struct codec_data_h264 *pst_codec_data);
 	int rtsp_codec_data_parse_from_user_h265(const uint8_t *codec_data, int data_len, struct codec_data_h265 *pst_codec_data);
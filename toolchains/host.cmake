@@ -0,0 +1,9 @@
+# native build against the host HAL backends (inc/hal), no BSP or cross compiler needed:
+#   cmake .. -DCMAKE_TOOLCHAIN_FILE=../../../toolchains/host.cmake
+SET (CMAKE_C_COMPILER   "gcc")
+SET (CMAKE_CXX_COMPILER "g++")
+
+# select the host backends of inc/hal/hal.hpp
+SET (AX_HAL_HOST ON)
+SET (CMAKE_C_FLAGS_INIT   "-DAX_HAL_HOST")
+SET (CMAKE_CXX_FLAGS_INIT "-DAX_HAL_HOST")